@@ -1,10 +1,15 @@
 #version 330 core
 
+// Attributes arrive packed (see vertex_format.h): the normal is snorm
+// 10:10:10:2, the UV half floats, colour and weights unorm8 and bone ids
+// unsigned bytes. The fixed-function fetch expands them to these types.
+// Meshes without UVs or colours leave them out of the vertex and read the
+// constants (0,0) and white instead.
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoord;
 layout(location = 3) in vec3 vertexColor;
-layout(location = 5) in ivec4 boneIds;
+layout(location = 5) in uvec4 boneIds;
 layout(location = 6) in vec4 weights;
 
 uniform mat4 model;
@@ -16,6 +21,9 @@ const int MAX_BONE_INFLUENCE = 4;
 
 uniform mat4 finalBonesMatrices[MAX_BONES];
 uniform bool hasBones;
+// Influences are sorted by weight at import; this is the most any vertex
+// of the current mesh uses.
+uniform int boneInfluences;
 
 out vec2 TexCoord;
 out vec3 Normal;
@@ -32,13 +40,12 @@ void main()
 
     if (hasBones)
     {
-        for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
+        for (int i = 0; i < MAX_BONE_INFLUENCE && i < boneInfluences; ++i)
         {
-            int id = boneIds[i];
+            int id = int(boneIds[i]);
             float w = weights[i];
 
-            if (w <= 0.0) continue;
-            if (id < 0) continue;
+            if (w <= 0.0) break;
             if (id >= MAX_BONES) continue;
 
             mat4 bone = finalBonesMatrices[id];
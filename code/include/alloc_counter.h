@@ -0,0 +1,35 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+using namespace std;
+
+// Heap allocations made through operator new, counted per thread. The
+// counting operator new replaces the global one for the whole program, and
+// only in builds configured with DESERT_COUNT_ALLOCS; otherwise every count
+// is zero and nothing is recorded.
+struct AllocationCount
+{
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+AllocationCount threadAllocations();
+
+// Allocations the calling thread makes while the scope is alive.
+class AllocationScope
+{
+public:
+    AllocationScope();
+    AllocationCount used() const;
+
+private:
+    AllocationCount start;
+};
+
+// Per-load totals for the load report; warm loads came from the mesh cache.
+void recordLoadAllocations(const char *path, bool warm, const AllocationCount &used);
+void printLoadAllocationReport();
+
+#endif
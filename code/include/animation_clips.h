@@ -0,0 +1,36 @@
+#ifndef ANIMATION_CLIPS_H
+#define ANIMATION_CLIPS_H
+
+#include <cstddef>
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+// Animation clips loaded on demand. Warm imports read only each clip's name,
+// duration and rate from the mesh cache; the keyframes are decoded the first
+// time something plays the clip and can be dropped again once it has gone
+// unused for a while. Clips from a cold import stay resident, since their
+// keyframes were just converted and the cache offsets are not known yet.
+
+// Off, warm imports decode every clip as before.
+void setLazyAnimationClips(bool enabled);
+bool lazyAnimationClips();
+
+// On, every clip decode and eviction prints an [anim] line. A clip that
+// cannot be read is reported either way.
+void setAnimationClipLogging(bool enabled);
+
+// GL thread: makes clip index of asset resident, decoding it from
+// asset.clipSource if needed, and marks it used now. False for an index out
+// of range or a clip that cannot be read back.
+bool requireAnimationClip(ModelAsset &asset, int index);
+
+// GL thread: drops the keyframes of every clip not required in the last
+// idleSeconds that can be decoded again. Returns the bytes freed.
+size_t evictIdleAnimationClips(ModelAsset &asset, double idleSeconds);
+
+// Keyframe and channel name bytes a clip holds while resident.
+size_t animationClipBytes(const Animation &clip);
+
+#endif
@@ -61,6 +61,7 @@ public:
 
     int getCurrentAnimation() const { return currentAnimationIndex; }
     float getCurrentTime() const { return currentTime; }
+    void setCurrentTime(float time) { currentTime = time; }
 
     void setActiveAnimation(int animationIndex);
 
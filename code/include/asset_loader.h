@@ -0,0 +1,68 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+// One model file travelling through the loader: imported on a worker
+// thread, then handed back to the GL thread for upload.
+struct ImportJob
+{
+    string path;
+    bool hierarchical;
+    bool ok;
+
+    vector<MeshInstance> meshes; // static payload
+    HierarchicalModel model;     // hierarchical payload
+
+    // Lower runs first. Written by the GL thread while the job is queued.
+    float priority;
+
+    // MeshCpuStream bits to keep after upload. Read on the GL thread only.
+    unsigned int keepCpuStreams;
+    size_t cpuBytesReleased;
+
+    // Model-space bounds, valid once the import has finished.
+    vec3 boundsMin;
+    vec3 boundsMax;
+
+    int worker;
+    chrono::steady_clock::time_point queued;
+    chrono::steady_clock::time_point importStart;
+    chrono::steady_clock::time_point importEnd;
+    chrono::steady_clock::time_point uploadStart;
+    chrono::steady_clock::time_point uploadEnd;
+};
+
+// Starts the worker pool. workerCount 0 picks one thread per core, leaving
+// one for the GL thread. Submitting a job starts the pool on demand.
+void startAssetLoader(unsigned int workerCount = 0);
+void stopAssetLoader();
+
+void submitImportJob(const shared_ptr<ImportJob> &job);
+
+// Reorders a job that has not started importing yet.
+void setImportJobPriority(const shared_ptr<ImportJob> &job, float priority);
+
+// Takes the next imported job off the upload queue. The non-blocking form
+// returns false when nothing is ready; the blocking form waits and returns
+// false only once no jobs are outstanding.
+bool popImportedJob(shared_ptr<ImportJob> &job);
+bool waitImportedJob(shared_ptr<ImportJob> &job);
+
+// GL thread: creates buffers and textures for an imported job.
+void uploadImportedJob(ImportJob &job);
+
+size_t outstandingImportJobs();
+
+// Per-asset wait/import/upload bars for every job so far, showing how much
+// of the import work overlapped.
+void printLoadTimeline();
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+using namespace std;
+
+struct aiFileIO;
+
+// Written by the desert_pack target.
+#define ASSET_PACK_PATH "assets/desert.dpak"
+
+// Maps the pack and reads its index. Without a pack (the file does not
+// exist) this returns false quietly and every asset is read loose.
+bool openAssetPack(const char *path);
+void closeAssetPack();
+bool isAssetPackOpen();
+
+// Packs the listed files under their paths as given. Entries are stored
+// zlib-compressed when that saves at least an eighth of their size; the
+// rest, images mostly, are stored as they are and read in place.
+bool writeAssetPack(const char *outputPath, const vector<string> &paths);
+
+// Whether the asset is in the pack or on disk.
+bool assetExists(const char *path);
+
+// Identifies the asset's contents without reading them: its size, and the
+// pack entry's CRC or the loose file's modification time. Equal stamps mean
+// unchanged contents; a different stamp need not mean changed contents.
+bool assetStamp(const char *path, uint64_t &size, uint64_t &stamp);
+
+// Read-only view of one asset: its pack entry when the pack has one, the
+// loose file otherwise. Stored entries point straight into the mapped pack;
+// compressed ones are inflated into a buffer the view owns. The first open
+// of each entry checks its CRC and fails on a mismatch.
+class AssetFile
+{
+public:
+    AssetFile();
+
+    bool open(const char *path);
+    void close();
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+    bool isOpen() const { return bytes != nullptr; }
+    bool isPacked() const { return packed; }
+
+private:
+    AssetFile(const AssetFile &);
+    AssetFile &operator=(const AssetFile &);
+
+    const unsigned char *bytes;
+    size_t length;
+    bool packed;
+    MappedFile loose;
+    vector<unsigned char> inflated;
+};
+
+// File system for aiImportFileEx, so Assimp (and every side file it opens)
+// reads through AssetFile too.
+aiFileIO *assetFileIO();
+
+// Reads served from the pack and from loose files, and inflate time.
+void printAssetPackReport();
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef ASSET_PREFETCH_H
+#define ASSET_PREFETCH_H
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Where one run's read order is kept for the next, beside the mesh cache.
+#define ASSET_READ_TRACE_PATH "assets/cache/asset_reads.trace"
+
+// Notes one asset read: the file and byte range it came from (a range of
+// the pack for packed assets, the whole file for loose ones). Called by
+// AssetFile for every open; only the first read of each range is kept.
+void recordAssetRead(const string &file, uint64_t offset, uint64_t size);
+
+// Writes the reads recorded so far, in the order they happened, for the
+// next launch to prefetch. Waits for a running prefetch first.
+bool writeAssetReadTrace(const char *path);
+
+// Reads the trace of an earlier run and starts a background thread that
+// asks the OS to read those ranges ahead, in the recorded order: adjacent
+// ranges of a file are merged and each file is opened once. Returns false
+// when there is no trace yet.
+bool startAssetPrefetch(const char *tracePath);
+void waitForAssetPrefetch();
+
+// What was prefetched, how long issuing it took and how many of this
+// run's reads the trace predicted.
+void printAssetPrefetchReport();
+
+#endif
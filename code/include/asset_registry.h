@@ -0,0 +1,77 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+// Reference-counted store of loaded model files. Every source path is
+// imported and uploaded once; further requests share the same GPU buffers,
+// textures, skeleton and animation clips. Imports run on the asset loader's
+// worker threads; uploads and callbacks happen on the GL thread.
+
+typedef function<void(const shared_ptr<ModelAsset> &asset)> StaticAssetReady;
+typedef function<void(const HierarchicalModel *prototype)> HierarchicalAssetReady;
+
+// Queues filePath for import on the loader threads, once per path. onReady
+// runs on the GL thread from pumpAssetUploads once the asset is resident
+// (immediately if it already is), with nullptr/empty on failure. Each
+// successful delivery takes one reference on the asset.
+void requestStaticAsset(const char *filePath, const StaticAssetReady &onReady);
+
+// The prototype passed to onReady holds the model's node tree bound to the
+// shared asset; copy it to make an instance.
+void requestHierarchicalAsset(const char *filePath, const HierarchicalAssetReady &onReady);
+
+// GL thread: uploads imported models and runs their callbacks. Stops once
+// budgetMs is spent (a negative budget drains everything ready now) and
+// returns how many models were uploaded.
+int pumpAssetUploads(double budgetMs);
+
+// GL thread: waits for and uploads every outstanding request.
+void finishAssetLoads();
+
+bool pendingAssetLoads();
+
+// Orders outstanding loads; lower priorities import and upload first.
+void setAssetPriority(const char *filePath, bool hierarchical, float priority);
+
+// Model-space bounds, known as soon as the import has finished, before the
+// asset is resident. Returns false while the file is still being imported.
+bool getAssetBounds(const char *filePath, bool hierarchical, vec3 &boundsMin, vec3 &boundsMax);
+
+// Asks for CPU-side geometry (MeshCpuStream bits) to outlive the upload,
+// e.g. positions and indices for picking or collision. Queues the import
+// like a request. Returns false if the asset is already resident without
+// those streams; call it before the first request.
+bool retainAssetGeometry(const char *filePath, bool hierarchical, unsigned int streams);
+
+// Lightweight per-instance copy of a shared mesh: GL handles and counts only.
+MeshInstance shareMeshInstance(const MeshInstance &mesh);
+
+// Drops one reference; the asset's GPU resources are freed with the last one.
+void releaseModelAsset(shared_ptr<ModelAsset> &asset);
+
+void printAssetRegistryReport();
+
+// Vertex buffer size per resident asset, packed layout against the old
+// separate float streams.
+void printVertexMemoryReport();
+
+// CPU geometry kept and freed per resident asset, with the process's
+// current and peak resident set size.
+void printResidencyReport();
+
+// GL thread: drops keyframes of clips no instance has played for
+// idleSeconds, in every resident hierarchical asset (see animation_clips.h).
+void evictIdleAssetAnimations(double idleSeconds);
+
+// Clips indexed and resident per hierarchical asset, with the keyframe
+// memory the resident ones hold.
+void printAnimationMemoryReport();
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef BAKED_ASSETS_H
+#define BAKED_ASSETS_H
+
+#include <string>
+
+// Outputs of the desert_bake target.
+#define BAKED_ASSET_DIR "assets/baked"
+
+// Flattens a source path into a single file name, so "assets/models/a.glb"
+// becomes "assets_models_a.glb". CMakeLists.txt applies the same rule when
+// it declares the bake outputs, so the two must stay in step.
+inline std::string flattenAssetPath(const std::string &sourcePath)
+{
+    std::string name = sourcePath;
+    for (char &c : name)
+    {
+        if (c == '/' || c == '\\' || c == ':')
+            c = '_';
+    }
+    return name;
+}
+
+inline std::string bakedAssetPath(const std::string &sourcePath, const char *suffix)
+{
+    return std::string(BAKED_ASSET_DIR) + "/" + flattenAssetPath(sourcePath) + suffix;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+using namespace glm;
+
+// View frustum as six inward-facing planes (xyz normal, w distance).
+struct Frustum
+{
+    vec4 planes[6];
+};
+
+Frustum extractFrustum(const mat4 &viewProj);
+
+bool sphereInFrustum(const Frustum &frustum, const vec3 &center, float radius);
+bool boxInFrustum(const Frustum &frustum, const vec3 &boundsMin, const vec3 &boundsMax);
+
+// World-space box enclosing a local box after transform.
+void transformBounds(const mat4 &transform, const vec3 &localMin, const vec3 &localMax,
+                     vec3 &worldMin, vec3 &worldMax);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include "mesh_loader.h"
+#include "skin_compaction.h"
+
+using namespace std;
+
+// Native glTF 2.0 reader for .gltf and .glb files. Accessors are read
+// straight out of the mapped file (or its side buffers), with one memcpy
+// per stream when the layout already matches ours, and the results follow
+// the conventions of the Assimp path they replace: the same texture
+// sources, node names, bone offsets and animation ticks (milliseconds).
+//
+// Files using something the reader does not handle (Draco or meshopt
+// compression, sparse accessors, other required extensions) return false
+// with the reason in error, and the caller falls back to Assimp.
+bool isGltfPath(const char *path);
+
+// One mesh per material with every node's transform baked into the
+// vertices, as aiProcess_PreTransformVertices produces.
+bool importGltfStatic(const char *filePath, vector<MeshInstance> &meshes, string &error);
+
+// One mesh per primitive, the node tree in pre-order and every animation
+// clip. model.asset must exist. skins receives one entry per mesh.
+bool importGltfHierarchical(const char *filePath, HierarchicalModel &model,
+                            vector<SkinCompactionStats> &skins, string &error);
+
+// Which importer reads glTF files. COMPARE imports each file with both,
+// keeps the native result and records how long each took; only cold
+// imports are compared, mesh cache hits parse nothing.
+enum GltfImporter
+{
+    GLTF_IMPORT_NATIVE = 0,
+    GLTF_IMPORT_ASSIMP = 1,
+    GLTF_IMPORT_COMPARE = 2
+};
+
+void setGltfImporter(GltfImporter importer);
+GltfImporter gltfImporter();
+
+struct GltfImportSample
+{
+    double ms;
+    size_t meshes;
+    size_t vertices;
+    size_t triangles;
+};
+
+void recordGltfImportComparison(const char *path, const GltfImportSample &native, const GltfImportSample &assimp);
+void printGltfImportReport();
+
+#endif
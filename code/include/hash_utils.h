@@ -0,0 +1,23 @@
+#ifndef HASH_UTILS_H
+#define HASH_UTILS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a, for cache keys and content checks rather than security.
+const uint64_t FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const uint64_t FNV1A_PRIME = 0x100000001b3ULL;
+
+// Folds size bytes at data into hash; chain calls to hash several ranges.
+inline uint64_t fnv1a(const void *data, size_t size, uint64_t hash = FNV1A_OFFSET_BASIS)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
+#endif
@@ -17,6 +17,9 @@ using namespace std;
 void rebuildNodePointers(HierarchicalModel &hmodel,
                          const vector<pair<string, string>> &parentChildPairs,
                          const string &rootName);
+// Copies src's nodes into dst and points every parent, child and the root
+// at dst's own copies, by position, without rebuilding the tree by name.
+void copyNodeTree(HierarchicalModel &dst, const HierarchicalModel &src);
 void collectHierarchy(HierarchicalNode *node, vector<pair<string, string>> &pairs, string &rootName);
 bool isValidNodePointer(HierarchicalNode *node, const vector<HierarchicalNode> &allNodes);
 void printNode(HierarchicalNode *node);
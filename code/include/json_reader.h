@@ -0,0 +1,64 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Parsed JSON document, just enough for the glTF reader. Objects keep their
+// keys beside their values, in file order. Lookups of missing keys or
+// indices return a shared null value, so chains like
+// doc["accessors"][i]["count"] can be read without checking each step.
+class JsonValue
+{
+public:
+    enum Type
+    {
+        JSON_NULL = 0,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT
+    };
+
+    JsonValue();
+
+    Type type() const { return kind; }
+    bool isNull() const { return kind == JSON_NULL; }
+    bool isNumber() const { return kind == JSON_NUMBER; }
+    bool isString() const { return kind == JSON_STRING; }
+    bool isArray() const { return kind == JSON_ARRAY; }
+    bool isObject() const { return kind == JSON_OBJECT; }
+
+    // Elements of an array or members of an object, 0 otherwise.
+    size_t size() const { return items.size(); }
+
+    const JsonValue &operator[](size_t index) const;
+    const JsonValue &operator[](const char *key) const;
+    bool has(const char *key) const;
+    const string &keyAt(size_t index) const { return keys[index]; }
+
+    bool asBool(bool fallback = false) const;
+    double asNumber(double fallback = 0.0) const;
+    int asInt(int fallback = 0) const;
+    const string &asString() const { return text; }
+
+private:
+    friend class JsonParser;
+
+    Type kind;
+    bool flag;
+    double number;
+    string text;
+    vector<JsonValue> items;
+    vector<string> keys;
+};
+
+// Parses length bytes of UTF-8 JSON. On failure returns false with the byte
+// offset and reason in error.
+bool parseJson(const char *text, size_t length, JsonValue &out, string &error);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef LOAD_PROFILER_H
+#define LOAD_PROFILER_H
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Times one load stage for as long as it is in scope. Scopes nest per
+// thread; one with an empty asset is charged to the asset of the scope
+// around it, so stages deep inside the loader (texture decodes, buffer
+// uploads) count towards the model or texture that caused them. Nothing
+// is recorded while load profiling is off.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char *stage, const string &asset = string());
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    const char *stage;
+    string asset;
+    ProfileScope *parent;
+    bool recording;
+    int depth;
+    int64_t startUs;
+};
+
+// On, closed scopes are kept for the report and the trace; off, scopes cost
+// a flag check and everything recorded so far is dropped.
+void setLoadProfiling(bool enabled);
+bool loadProfiling();
+
+// Every span recorded so far as a Chrome trace (chrome://tracing or
+// ui.perfetto.dev), one row per thread.
+bool writeLoadTrace(const char *path);
+
+// Per-asset totals with their most expensive stages, then totals per stage.
+void printLoadProfile();
+
+// Prints one line of a loader's per-asset log, adding the newline. Loader
+// threads print at once, so each line goes out whole in a single write
+// rather than piece by piece through cout.
+void printLoadLine(const string &line);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <vector>
+
+// Read-only view of a whole file. Uses mmap where available and falls back
+// to reading the file into a heap buffer otherwise.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const char *path);
+    void close();
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+    bool isOpen() const { return bytes != nullptr; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const unsigned char *bytes;
+    size_t length;
+    bool mapped;
+    std::vector<unsigned char> fallback;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+class AssetFile;
+
+// Bump whenever the cache layout or the processing done before writing changes.
+const uint32_t MESH_CACHE_VERSION = 9;
+
+enum MeshCacheKind
+{
+    MESH_CACHE_STATIC = 0,
+    MESH_CACHE_HIERARCHICAL = 1
+};
+
+struct MeshCacheKey
+{
+    string sourcePath;
+    string cachePath;
+    MeshCacheKind kind;
+    uint32_t importFlags;
+    // VertexAttribute bits the streams were imported for. An entry written
+    // for more attributes than are used now still serves.
+    uint32_t vertexAttributes;
+    // Size and stamp (assetStamp) of the source and its side buffers. An
+    // entry whose stamp differs is still used if the source hashes the same
+    // as when it was written.
+    uint64_t sourceSize;
+    uint64_t sourceStamp;
+    bool valid;
+    bool baked;
+};
+
+// Release builds load meshes only from the outputs of the desert_bake target
+// and never open the source files.
+#ifdef DESERT_BAKED_ASSETS
+const bool MESH_BAKED_ONLY = true;
+#else
+const bool MESH_BAKED_ONLY = false;
+#endif
+
+MeshCacheKey makeMeshCacheKey(const char *sourcePath, MeshCacheKind kind, uint32_t importFlags);
+
+// Baked meshes use the cache format under BAKED_ASSET_DIR, keyed by source
+// path alone: the build system, not a content hash, keeps them up to date.
+// outputPath overrides the default location when baking.
+MeshCacheKey makeBakedMeshKey(const char *sourcePath, MeshCacheKind kind, uint32_t importFlags,
+                              const char *outputPath = nullptr);
+
+// Where the mesh of sourcePath is read from, baked or cached, without
+// looking at the source the way the keys do.
+string meshCachePath(const char *sourcePath, MeshCacheKind kind);
+
+// The read functions also return the import time recorded when the cache was
+// written, so warm loads can be compared against the original cold load.
+bool readStaticMeshCache(const MeshCacheKey &key, vector<MeshInstance> &meshes, double &importMs);
+bool writeStaticMeshCache(const MeshCacheKey &key, const vector<MeshInstance> &meshes, double importMs);
+
+// Reads every clip's keyframes, or with lazy animation clips only their
+// index, pointing the asset's clipSource at the cache file.
+bool readHierarchicalMeshCache(const MeshCacheKey &key, HierarchicalModel &model, double &importMs);
+bool writeHierarchicalMeshCache(const MeshCacheKey &key, const HierarchicalModel &model, double importMs);
+
+// Where a warm-loaded mesh's streams are in the cache file it was read
+// from. The file stays open until upload, which fills the GPU buffers
+// straight from it; the CPU streams are decoded only if the upload is asked
+// to keep them.
+struct MeshCacheView
+{
+    shared_ptr<AssetFile> file;
+    size_t streamsOffset;
+    const unsigned char *vertexData;
+    size_t vertexSize;
+    const unsigned char *elementData;
+    size_t elementSize;
+};
+
+// Decodes the MeshCpuStream bits in streams from the mesh's cache view.
+bool readMeshCacheStreams(MeshInstance &mesh, unsigned int streams);
+
+// Decodes one clip's keyframes from the byte range its index entry names in
+// a hierarchical cache file.
+bool readMeshCacheClip(const string &cachePath, Animation &clip);
+
+void setMeshCacheEnabled(bool enabled);
+bool isMeshCacheEnabled();
+
+void recordMeshLoadTiming(const char *sourcePath, bool warm, double loadMs, double coldMs);
+void printMeshCacheReport();
+
+#endif
@@ -5,10 +5,16 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <chrono>
+#include <cstdint>
 #include <vector>
 #include <iostream>
 #include <functional>
 #include <map>
+#include <memory>
+#include <string>
+
+#include "vertex_format.h"
 
 using namespace std;
 using namespace glm;
@@ -16,14 +22,62 @@ using namespace glm;
 struct HierarchicalNode;
 struct HierarchicalModel;
 struct MeshInstance;
+struct ModelAsset;
 struct AnimationRule;
+struct StreamedTexture;
+struct MeshCacheView;
 
 void cleanupMesh(MeshInstance &mesh);
+void cleanupModelAsset(ModelAsset &asset);
 vector<MeshInstance> load_mesh(const char *filePath);
 
 void cleanupHierarchicalModel(HierarchicalModel &model);
 HierarchicalModel load_mesh_hierarchical(const char *filePath);
 
+// The two halves of a load. Import parses the file (or reads the mesh cache)
+// and decodes textures without touching GL, so it may run on a loader thread.
+// Upload creates the buffers and textures and must run on the GL thread.
+// With lazy texture loading on, neither touches textures beyond resolving
+// them; the first draw of a mesh requests its texture (texture_streaming.h).
+bool import_mesh(const char *filePath, vector<MeshInstance> &meshes);
+bool import_mesh_hierarchical(const char *filePath, HierarchicalModel &model);
+// Both return the CPU bytes freed after upload, see MeshCpuStream.
+size_t upload_mesh(vector<MeshInstance> &meshes, unsigned int keepCpuStreams = 0);
+size_t upload_mesh_hierarchical(HierarchicalModel &model, unsigned int keepCpuStreams = 0);
+
+// Offline conversion for desert_bake. Imports the source file without the
+// mesh cache, decodes every texture to raw RGBA and writes the result where
+// a release build's import_mesh (or import_mesh_hierarchical) looks for it.
+bool bake_mesh(const char *filePath, const char *outputPath, bool hierarchical);
+
+// CPU-side geometry a mesh keeps after upload, as MeshCpuStream bits.
+// Upload frees every stream not asked for; counts, bounds and the bone
+// tables always stay.
+enum MeshCpuStream
+{
+    MESH_CPU_POSITIONS = 1 << 0,
+    MESH_CPU_INDICES = 1 << 1,
+    MESH_CPU_ATTRIBUTES = 1 << 2, // normals, texcoords and colours
+    MESH_CPU_SKIN = 1 << 3,       // bone ids and weights
+
+    MESH_CPU_NONE = 0,
+    MESH_CPU_COLLISION = MESH_CPU_POSITIONS | MESH_CPU_INDICES,
+    MESH_CPU_ALL = MESH_CPU_COLLISION | MESH_CPU_ATTRIBUTES | MESH_CPU_SKIN
+};
+
+// The element buffer contents: indices, then the simplified levels, as 16-bit
+// values when every vertex is addressable. Returns the GL index type.
+GLenum packMeshElements(const MeshInstance &mesh, vector<unsigned char> &elements);
+
+// Frees the streams not in keepCpuStreams and returns the bytes released.
+size_t releaseMeshCpuData(MeshInstance &mesh, unsigned int keepCpuStreams);
+size_t meshCpuBytes(const MeshInstance &mesh);
+
+// Model-space bounds of an imported model. Hierarchical bounds follow the
+// node tree's rest transforms.
+void computeModelBounds(const vector<MeshInstance> &meshes, vec3 &boundsMin, vec3 &boundsMax);
+void computeHierarchicalBounds(const HierarchicalModel &model, vec3 &boundsMin, vec3 &boundsMax);
+
 struct VectorKey
 {
     float time;
@@ -44,19 +98,71 @@ struct NodeAnimation
     vector<VectorKey> scaleKeys;
 };
 
+// Name, duration and rate are always known; nodeAnimations holds the
+// keyframes only while the clip is resident (see animation_clips.h).
 struct Animation
 {
     string name;
     vector<NodeAnimation> nodeAnimations;
     float duration;
     float ticksPerSecond;
+
+    // Byte range of the keyframes in the asset's clipSource. Zero size for
+    // clips that came from a cold import and have nowhere to be reread from.
+    uint64_t sourceOffset;
+    uint64_t sourceSize;
+    bool resident;
+    chrono::steady_clock::time_point lastUsed;
+};
+
+// Where a mesh's diffuse image comes from. Resolved on the CPU during import
+// so it can be cached, decoded into pixels on the loader thread and turned
+// into a GL texture at upload time.
+struct TextureRef
+{
+    enum Source
+    {
+        NONE = 0,
+        FILE_PATH = 1,
+        EMBEDDED_COMPRESSED = 2,
+        EMBEDDED_RAW = 3
+    };
+
+    Source source;
+    string path;
+    vector<unsigned char> data;
+    int width;
+    int height;
+
+    vector<unsigned char> pixels;
+    int channels;
+
+    // Texture cache key, filled in when the import decodes textures.
+    string cacheKey;
+};
+
+// One level of detail: a range of the mesh's element buffer. Level 0 is the
+// full mesh; coarser levels index the same vertex buffer.
+struct MeshLod
+{
+    GLsizei firstIndex;
+    GLsizei indexCount;
+    float error; // model-space deviation from the full mesh
+};
+
+// Spatially coherent run of triangles in the full-detail index range, with
+// model-space bounds for culling.
+struct MeshCluster
+{
+    GLsizei firstIndex;
+    GLsizei indexCount;
+    vec3 boundsMin;
+    vec3 boundsMax;
 };
 
 struct MeshInstance {
     GLuint VAO;
-    GLuint VBO_vertices;
-    GLuint VBO_normals;
-    GLuint VBO_texcoords;
+    GLuint VBO;
     GLuint EBO;
 
     vector<vec3> vertices;
@@ -64,11 +170,23 @@ struct MeshInstance {
     vector<vec2> texcoords;
 
     vector<unsigned int> indices;
+    GLsizei indexCount;
+    GLenum indexType; // GL_UNSIGNED_SHORT when the mesh fits, else GL_UNSIGNED_INT
+
+    // Simplified levels, stored after indices in the element buffer.
+    static const int MAX_LODS = 4;
+    vector<unsigned int> lodIndices;
+    vector<MeshLod> lods;
+
+    // Set for large static meshes; covers the whole of indices.
+    vector<MeshCluster> clusters;
 
     vector<vec3> colors;
-    GLuint VBO_colors;
     GLuint diffuseTexture;
     bool hasDiffuseTexture;
+    TextureRef diffuseRef;
+    // Set instead of diffuseTexture when the texture is loaded on first draw.
+    shared_ptr<StreamedTexture> diffuseStream;
 
     static const int MAX_BONE_INFLUENCES = 4;
     static const int MAX_BONES = 200;
@@ -76,16 +194,38 @@ struct MeshInstance {
     vector<ivec4> boneIds;
     vector<vec4> boneWeights;
 
+    // Dense per-mesh palette: only bones some vertex is weighted to, in
+    // order of first use. boneIds index into it.
     vector<mat4> boneMatrices;
     map<string, int> boneNameToIndex;
     bool hasBones;
+    // Most influences any vertex uses (0-4). Influences are sorted by
+    // weight, so the vertex shader stops after this many.
+    int boneInfluences;
 
-    GLuint VBO_boneIds;
-    GLuint VBO_boneWeights;
+    // Interleaved GPU vertex stream, built on the loader thread and
+    // released once it has been uploaded.
+    vector<unsigned char> packedVertices;
+    // Set instead by a warm load; dropped at upload.
+    shared_ptr<MeshCacheView> cacheView;
+    PackedVertexLayout vertexLayout;
+    GLsizei vertexCount;
+    size_t vertexBytes;
 
     bool ready;
+    size_t gpuBytes;
+
+    // MeshCpuStream bits still held in the vectors above.
+    unsigned int cpuStreams;
+    bool hasNormals;
+
+    vec3 boundsMin;
+    vec3 boundsMax;
+
+    void draw(GLuint shaderID, const mat4 &model, const mat4 &view, const mat4 &proj, int lod = 0) const;
 
-    void draw(GLuint shaderID, const mat4 &model, const mat4 &view, const mat4 &proj) const;
+    // Full-detail draw of the listed clusters, ascending, as one multi-draw.
+    void drawClusters(GLuint shaderID, const vector<unsigned int> &visibleClusters) const;
 };
 
 struct HierarchicalNode
@@ -109,9 +249,30 @@ struct HierarchicalNode
     bool hasAnimationTransform;
 };
 
-struct HierarchicalModel
+// Data loaded once per source file and shared by every instance of it:
+// GPU buffers, textures, bone tables and animation clips.
+struct ModelAsset
 {
+    string path;
     vector<MeshInstance> meshes;
+    vector<Animation> animationClips;
+    // Mesh cache (or baked) file non-resident clips are decoded from.
+    string clipSource;
+    int refCount;
+    double loadMs;
+
+    // MeshCpuStream bits kept after upload and the bytes freed by dropping
+    // the rest.
+    unsigned int keepCpuStreams;
+    size_t cpuBytesReleased;
+
+    vec3 boundsMin;
+    vec3 boundsMax;
+};
+
+struct HierarchicalModel
+{
+    shared_ptr<ModelAsset> asset;
     vector<HierarchicalNode> nodes;
     HierarchicalNode *rootNode;
     int modelIndex;
@@ -120,7 +281,6 @@ struct HierarchicalModel
     vec3 worldScale;
     bool animated;
 
-    vector<Animation> animationClips;
     int activeAnimation;
     float currentAnimationTime;
     bool hasEmbeddedAnimation;
@@ -0,0 +1,57 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <string>
+#include <vector>
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+// Post-transform cache size the optimizer and the ACMR/ATVR figures assume.
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+struct MeshOptimizationStats
+{
+    size_t verticesBefore;
+    size_t verticesAfter;
+    size_t trianglesBefore;
+    size_t trianglesAfter;
+    float acmrBefore;
+    float acmrAfter;
+    float atvrBefore;
+    float atvrAfter;
+};
+
+// Rewrites a freshly imported mesh in place:
+//  1. welds vertices whose attributes are bit-identical,
+//  2. drops degenerate triangles,
+//  3. reorders triangles for the post-transform cache (Forsyth), then
+//     reorders cache-friendly clusters front-to-back to cut overdraw,
+//  4. renumbers vertices in first-use order for fetch locality.
+// All per-vertex streams, including bone ids and weights, move together.
+MeshOptimizationStats optimizeMesh(MeshInstance &mesh);
+
+// Static meshes with at least this many triangles are split into clusters.
+const size_t CLUSTER_MIN_MESH_TRIANGLES = 4096;
+const size_t CLUSTER_MAX_TRIANGLES = 1024;
+
+// Splits a large static mesh into spatially coherent clusters of at most
+// CLUSTER_MAX_TRIANGLES (and at least half that) by recursive median cuts
+// on triangle centroids. Clusters become contiguous ranges of
+// mesh.indices, each cache-optimised, and vertices are renumbered to match.
+// Returns the number of clusters, 0 for meshes left whole.
+size_t buildMeshClusters(MeshInstance &mesh);
+
+// Reorders an index buffer's triangles for the post-transform cache only,
+// e.g. for simplified levels that share an already optimised vertex buffer.
+void optimizeVertexCacheOrder(vector<unsigned int> &indices, size_t vertexCount);
+
+// Average cache miss ratio (misses per triangle) and average transform to
+// vertex ratio (misses per unique vertex) for a FIFO cache.
+void analyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount,
+                        unsigned int cacheSize, float &acmr, float &atvr);
+
+void printMeshOptimizationStats(const string &label, const MeshOptimizationStats &stats);
+
+#endif
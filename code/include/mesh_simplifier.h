@@ -0,0 +1,32 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <string>
+#include <vector>
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+// Quadric error metric edge collapse (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics"). Every collapse moves a
+// vertex onto one of its neighbours, so the result still indexes the
+// original vertex buffer and no attribute is ever interpolated.
+// UV and normal seams collapse only along the seam, together with the
+// vertex's twin on the other side; open borders collapse only along the
+// border; vertices with more complex topology never move.
+//
+// Stops at targetIndexCount, or once the cheapest collapse left would move
+// the surface further than maxError (model units). resultError receives
+// the largest deviation introduced.
+vector<unsigned int> simplifyMesh(const vector<unsigned int> &indices, const vector<vec3> &positions,
+                                  size_t targetIndexCount, float maxError, float &resultError);
+
+// Fills mesh.lods and mesh.lodIndices with up to MeshInstance::MAX_LODS - 1
+// coarser levels, each about half the triangles of the one before. Small
+// meshes, and levels that barely simplify, are skipped.
+void buildMeshLods(MeshInstance &mesh);
+
+void printMeshLods(const string &label, const MeshInstance &mesh);
+
+#endif
@@ -10,20 +10,53 @@
 #include "mesh_loader.h"
 #include "scene_manager.h"
 #include "shader_uniform.h"
+#include "frustum.h"
 
 using namespace std;
 using namespace glm;
 
+// Triangles submitted since the last beginLodFrame, against what full
+// detail without cluster culling would have cost.
+struct LodFrameStats
+{
+    size_t draws;
+    size_t trianglesDrawn;
+    size_t trianglesFullDetail;
+    size_t drawsPerLevel[MeshInstance::MAX_LODS];
+    size_t clustersTested;
+    size_t clustersDrawn;
+    size_t meshesCulled; // whole meshes outside the frustum, not drawn
+};
+
+// Screen-size LOD selection, shared by every renderer. A positive bias
+// picks coarser levels sooner; each step of 1 halves the screen size at
+// which a level kicks in.
+void setLodBias(float bias);
+float getLodBias();
+void beginLodFrame();
+const LodFrameStats &getLodFrameStats();
+
 class ModelRenderer
 {
 private:
     GLuint shaderProgram;
     ShaderUniformManager *uniforms;
 
+    // Unit-cube line list shared by every proxy box.
+    GLuint proxyVAO;
+    GLuint proxyVBO;
+    GLuint proxyEBO;
+
     bool isValidMatrix(const mat4 &m) const;
     mat4 buildModelMatrix(const vec3 &pos, const vec3 &rot, const vec3 &scale) const;
     mat4 buildNodeTransform(const HierarchicalNode *node, const mat4 &parentGlobal) const;
 
+    int selectLod(const MeshInstance &mesh, const mat4 &modelMatrix, const mat4 &view, const mat4 &proj) const;
+    void drawMesh(const MeshInstance &mesh, const mat4 &modelMatrix, const mat4 &view, const mat4 &proj);
+
+    // Scratch list of visible clusters, reused across draws.
+    vector<unsigned int> visibleClusters;
+
 public:
     ModelRenderer(GLuint shaderProgramID);
 
@@ -48,6 +81,9 @@ public:
                       const mat4 &view,
                       const mat4 &proj);
 
+    // Wireframe bounding boxes for models that are still streaming in.
+    void renderProxies(const vector<SceneProxy> &proxies);
+
     void setViewProjection(const mat4 &view, const mat4 &proj, const vec3 &cameraPos);
     void setMaterial(float ambientR, float ambientG, float ambientB, float specularStrength, float shininess);
     void setLighting(const vec3 &lightDir, const vec3 &lightColor);
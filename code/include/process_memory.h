@@ -0,0 +1,13 @@
+#ifndef PROCESS_MEMORY_H
+#define PROCESS_MEMORY_H
+
+#include <cstddef>
+
+// Resident set size of this process in bytes, or 0 where the platform
+// offers no way to ask.
+size_t currentResidentBytes();
+
+// Highest resident set size reached so far, or 0 where unavailable.
+size_t peakResidentBytes();
+
+#endif
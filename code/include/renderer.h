@@ -6,6 +6,7 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <functional>
+#include <map>
 #include <cmath>
 
 #include "mesh_loader.h"
@@ -29,7 +30,11 @@ struct DayNightParams
 void renderScene(float delta, const mat4 &view, const mat4 &proj, GLuint shaderProgramID, const vec3 &cameraPos, float timeOfDay = 12.0f);
 void renderHierarchicalMeshes(float delta, const mat4 &view, const mat4 &proj, GLuint shaderProgramID, const vec3 &cameraPos, float timeOfDay = 12.0f);
 
-void updateDynamicLights(GLuint shaderProgramID, float time, const vec3 &cameraPos, bool enablePointLights = true, bool enableSpotLights = true);
+// The laser hits the leviathan and the spotlight hangs under the second
+// ship; callers pass where the manifest's instances are this frame.
+void updateDynamicLights(GLuint shaderProgramID, float time, const vec3 &cameraPos,
+                         const vec3 &leviathanPos, const vec3 &ship1Pos, const vec3 &ship2Pos,
+                         bool enablePointLights = true, bool enableSpotLights = true);
 void updateOrbitalMotion(HierarchicalModel &parentModel,
                          HierarchicalModel &childModel,
                          float delta,
@@ -37,6 +42,28 @@ void updateOrbitalMotion(HierarchicalModel &parentModel,
                          float orbitSpeed = 1.0f,
                          float forwardSpeed = 5.0f);
 
+// What the renderer advances every frame besides the models themselves:
+// the shimmer clock, and per hierarchical model its animation clock, drift
+// base, orbit angle and orbit centre and its animator's clip time.
+struct RendererState
+{
+    float heatTime;
+    map<size_t, float> animationTimes;
+    map<size_t, vec3> basePositions;
+    map<size_t, float> orbitAngles;
+    map<size_t, vec3> parentBasePositions;
+    map<size_t, float> animatorTimes;
+};
+
+// For scene snapshots. Restored animator times wait for models that are not
+// resident yet.
+void saveRendererState(RendererState &state);
+void restoreRendererState(const RendererState &state);
+
+// Deletes the animator of an unloaded model; the next one made for it after
+// a reload resumes at the same clip time.
+void releaseModelAnimator(size_t modelIdx);
+
 DayNightParams calculateDayNightCycle(float timeOfDay);
 void cleanupScene();
 
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "mesh_loader.h"
+#include "asset_registry.h"
 
 using namespace std;
 using namespace glm;
@@ -26,6 +27,17 @@ struct ModelRange
     size_t count;
 };
 
+// A model that has been imported but is not resident yet, drawn as its
+// bounding box until the upload lands.
+struct SceneProxy
+{
+    vec3 position;
+    vec3 rotation;
+    vec3 scale;
+    vec3 boundsMin;
+    vec3 boundsMax;
+};
+
 extern vector<MeshInstance> meshes;
 extern vector<MeshTransform> meshTransforms;
 extern vector<HierarchicalModel> hierarchicalModels;
@@ -34,7 +46,29 @@ void setupScene(GLuint shaderProgramID);
 bool getModelRange(int modelIndex, int &start, int &count);
 void addMesh(const char *filePath);
 void addHierarchicalMesh(const char *filePath);
+// addMesh and addHierarchicalMesh only queue the import. Either block until
+// every queued model is uploaded and placed in the scene, or stream them in:
+// call updateSceneStreaming once per frame to reprioritise outstanding loads
+// by camera distance and visibility and upload within a time budget. It
+// returns true on the frame the last model becomes resident.
+void finishSceneLoads();
+bool updateSceneStreaming(const vec3 &cameraPos, const mat4 &viewProj, double uploadBudgetMs);
+void getSceneProxies(vector<SceneProxy> &proxies);
+// Zone streaming: slots are grouped into cellSize squares on the ground by
+// their position. Each updateSceneStreaming loads the cells within
+// loadRadius of the camera and unloads those beyond unloadRadius, one model
+// per frame; addMesh and addHierarchicalMesh then only reserve the slot.
+// Call after setupScene and before adding models. A cellSize of 0 (the
+// default) keeps every model loaded.
+void setSceneZoneStreaming(float cellSize, float loadRadius, float unloadRadius);
+// Runs the zone pass once for cameraPos, so the models in range are
+// requested before the first frame. Needs the slots' ground positions set.
+void startSceneZones(const vec3 &cameraPos);
+// Cells loaded, models resident and zone loads and unloads so far.
+void printSceneZoneReport();
 void setMeshTransform(int modelIndex, vec3 position, vec3 rotation, vec3 scale, bool animated = false);
+// The model's transform as last set, resident or not.
+bool getMeshTransform(int modelIndex, MeshTransform &transform);
 void setSubmeshTransform(int meshGlobalIndex, vec3 position, vec3 rotation, vec3 scale, bool animated = false);
 void setHierarchicalMeshTransform(int hierarchicalIndex, vec3 position, vec3 rotation, vec3 scale, bool animated = false);
 void setOrbitalMotion(int parentIndex, int childIndex);
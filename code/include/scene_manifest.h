@@ -0,0 +1,78 @@
+#ifndef SCENE_MANIFEST_H
+#define SCENE_MANIFEST_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// The colony's scene manifest.
+#define SCENE_MANIFEST_PATH "assets/scenes/desert_colony.json"
+
+// One model placed in the scene. The manifest lists hierarchical and static
+// instances separately, and each one's position in its list is its index
+// for setHierarchicalMeshTransform or setMeshTransform.
+struct SceneInstance
+{
+    string name;
+    string model;
+    bool hierarchical;
+
+    // Without a placement the model stays where its file puts it.
+    bool placed;
+    vec3 position;
+    vec3 rotation;
+    vec3 scale;
+    bool animated;
+
+    // Ground placement: position.y is a height above the terrain, sampled
+    // at the instance itself or at groundAt (x, z) when given.
+    bool onGround;
+    bool groundElsewhere;
+    vec2 groundAt;
+
+    // Clip to play, -1 for the model's own choice.
+    int animation;
+
+    // Slot in its list, and its position once the terrain is known.
+    int index;
+    vec3 worldPosition;
+};
+
+// Orbiting pairs by instance, as setOrbitalMotion takes them.
+struct SceneOrbit
+{
+    int parent;
+    int child;
+};
+
+struct SceneManifest
+{
+    string path;
+    vector<SceneInstance> instances;
+    vector<SceneOrbit> orbits;
+};
+
+// Reads and checks a manifest. Unknown names, instances without a model and
+// malformed values are reported to cerr and fail the whole load; a model that
+// cannot be read is reported by the loader like any other.
+bool loadSceneManifest(const char *path, SceneManifest &manifest);
+
+// Adds every instance to the scene in one pass and sets its placement (ground
+// heights still relative), animation and orbits, so the asset loader gets
+// the whole scene at once and each file is imported once however many
+// instances use it. Call after setupScene and setSceneZoneStreaming; the
+// terrain need not exist yet.
+void addSceneManifest(SceneManifest &manifest);
+
+// Resolves every ground placement against heightAt(x, z) in one batch and
+// moves the instances there. Call once the terrain is ready.
+void placeSceneManifest(SceneManifest &manifest, const function<float(float, float)> &heightAt);
+
+// Instance by name, nullptr if the manifest has none.
+const SceneInstance *findSceneInstance(const SceneManifest &manifest, const char *name);
+
+#endif
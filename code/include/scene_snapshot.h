@@ -0,0 +1,89 @@
+#ifndef SCENE_SNAPSHOT_H
+#define SCENE_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "renderer.h"
+#include "scene_manager.h"
+#include "scene_manifest.h"
+
+using namespace std;
+using namespace glm;
+
+// Written on request while running and read back at startup. Relative to
+// the working directory, like load_trace.json.
+#define SCENE_SNAPSHOT_PATH "scene.snapshot"
+
+// Bump whenever the snapshot layout changes; older files are ignored.
+const uint32_t SCENE_SNAPSHOT_VERSION = 1;
+
+// A model file the scene uses and the mesh cache or baked file it loads
+// from.
+struct SnapshotAsset
+{
+    string sourcePath;
+    bool hierarchical;
+    string cachePath;
+};
+
+struct SnapshotHierarchicalModel
+{
+    vec3 position;
+    vec3 rotation;
+    vec3 scale;
+    bool animated;
+    int activeAnimation;
+};
+
+// The running scene at one moment: enough to resume it at the same
+// simulation time without replaying anything. Geometry is not stored; the
+// assets come back through the mesh cache as on any warm start.
+struct SceneSnapshot
+{
+    // Which scene this is; a snapshot only restores onto the same manifest
+    // instances it was taken from.
+    string manifestPath;
+    vector<string> instanceModels;
+    vector<SnapshotAsset> assets;
+
+    // Viewer and world clock, owned by main.
+    vec3 cameraPosition;
+    float cameraYaw;
+    float cameraPitch;
+    float cameraZoom;
+    float timeOfDay;
+    float targetTimeOfDay;
+    float startTimeOfDay;
+    float dayNightProgress;
+    bool dayNightTransitioning;
+    bool pointLightsEnabled;
+    bool spotLightsEnabled;
+    float lightTime;
+    float leviathanSpawnTime;
+    bool leviathanSpawned;
+    float shipOrbitAngle;
+
+    // Model placement and animation, by manifest index.
+    vector<MeshTransform> staticTransforms;
+    vector<SnapshotHierarchicalModel> hierarchicalModels;
+    RendererState renderer;
+};
+
+// Fills the scene side of a snapshot (instances, assets, transforms and
+// renderer state) from the running scene; main adds its own fields.
+void captureSceneSnapshot(const SceneManifest &manifest, SceneSnapshot &snapshot);
+
+// Puts the scene side back, after addSceneManifest and placeSceneManifest.
+void restoreSceneSnapshot(const SceneSnapshot &snapshot);
+
+bool writeSceneSnapshot(const char *path, const SceneSnapshot &snapshot);
+
+// False quietly when there is no snapshot; with a message when it is from
+// another version or does not match manifest. Counts the assets whose
+// cache files are missing, since those are imported again.
+bool readSceneSnapshot(const char *path, const SceneManifest &manifest, SceneSnapshot &snapshot);
+
+#endif
@@ -24,6 +24,8 @@ private:
     GLint locLightDir;
     GLint locLightColor;
     GLint locHasBones;
+    GLint locBoneMatrices;
+    GLint locBoneInfluences;
     GLint locFogColor;
     GLint locFogDensity;
     GLint locFogStart;
@@ -49,6 +51,9 @@ public:
                      float specularStrength, float shininess);
 
     void setHasBones(bool hasBones);
+    // Uploads a mesh's bone palette (at most MeshInstance::MAX_BONES
+    // matrices) and how many influences its vertices use.
+    void setBonePalette(const vector<mat4> &palette, int influences);
     void setFog(const vec3 &fogColor, float fogDensity, float fogStart, float fogEnd, float fogHeight, float fogHeightRange);
     void setModelMatrix(const mat4 &model);
 
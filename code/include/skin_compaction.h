@@ -0,0 +1,54 @@
+#ifndef SKIN_COMPACTION_H
+#define SKIN_COMPACTION_H
+
+#include <string>
+#include <vector>
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+struct BoneInfluence
+{
+    int bone; // index into the bone list passed alongside
+    float weight;
+};
+
+// Every influence a mesh's file lists, grouped by vertex: vertex v owns
+// items[first[v]] up to items[first[v + 1]]. Two flat arrays instead of a
+// list per vertex. Fill it in two passes over the source: count() each
+// influence, allocate() once, then add() them again in the same order.
+struct SkinInfluences
+{
+    vector<unsigned int> first;
+    vector<BoneInfluence> items;
+    vector<unsigned int> cursor;
+
+    void reset(size_t vertexCount);
+    void count(size_t vertex) { first[vertex + 1]++; }
+    void allocate();
+    void add(size_t vertex, const BoneInfluence &influence) { items[cursor[vertex]++] = influence; }
+    size_t vertexCount() const { return first.empty() ? 0 : first.size() - 1; }
+};
+
+struct SkinCompactionStats
+{
+    size_t bonesListed;
+    size_t bonesKept;
+    size_t verticesCapped;
+    int maxInfluences;
+};
+
+// Builds a mesh's skinning data from every influence its file lists: each
+// vertex keeps its four strongest influences, sorted by weight and
+// renormalised, and only bones some vertex still references make it into
+// the palette, numbered densely in order of first use. Each vertex's
+// influences are reordered in place.
+SkinCompactionStats compactSkin(MeshInstance &instance,
+                                const vector<string> &boneNames,
+                                const vector<mat4> &boneOffsets,
+                                SkinInfluences &influences);
+
+void printSkinCompactionStats(const string &label, const SkinCompactionStats &stats);
+
+#endif
@@ -4,6 +4,7 @@
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <memory>
+#include <vector>
 
 #include "terrain_loader.h"
 
@@ -30,7 +31,7 @@ private:
     Terrain *terrain;
     GLuint heightmapTex;
     GLuint diffuseTex;
-    unsigned char *heightmapData;
+    std::vector<unsigned char> heightmapData;
 
     int gridSize;
     float worldSize;
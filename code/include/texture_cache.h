@@ -0,0 +1,48 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include <glad/gl.h>
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+// Shared GL textures keyed by image source and upload flags. Every mesh
+// that names the same image, in one model or across models, gets the same
+// texture; it is deleted when the last user releases it.
+
+// Normalised file path or a hash of the embedded bytes, plus the sRGB and
+// flip flags. Empty for TextureRef::NONE.
+string textureCacheKey(const TextureRef &ref, bool srgb, bool flipVertically);
+
+// GPU bytes of an 8-bit texture of that size with its full mip chain, which
+// adds roughly a third on top of the base level. What the cache and the
+// streaming budget charge a texture.
+size_t textureBytes(int width, int height, int channels);
+
+// Any thread: true if a texture for key is resident, so decoding it can be
+// skipped.
+bool isTextureCached(const string &key);
+
+// Any thread: counts a decode for the report, skipped or not.
+void recordTextureDecode(bool skipped);
+
+// GL thread: takes a reference on the texture for key, or returns 0.
+GLuint acquireCachedTexture(const string &key);
+
+// GL thread: registers a freshly uploaded texture with one reference.
+void addCachedTexture(const string &key, GLuint texture, size_t bytes);
+
+// GL thread: drops a reference and deletes the texture with the last one.
+// Textures that never went through the cache are deleted directly.
+void releaseCachedTexture(GLuint texture);
+
+// Any thread: the bookkeeping half of releaseCachedTexture. True when the
+// texture has no references left and should be deleted.
+bool releaseTextureReference(GLuint texture);
+
+void printTextureCacheReport();
+
+#endif
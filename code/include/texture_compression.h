@@ -0,0 +1,68 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+
+using namespace std;
+
+// Block-compressed images in DDS files, with every mip level stored. Each
+// 4x4 block of texels is 8 bytes (BC1) or 16 (BC3, BC5, BC7), so an RGB
+// texture takes an eighth of its RGBA8 size on the GPU and needs no mip
+// build at load.
+enum BlockFormat
+{
+    BLOCK_BC1 = 0, // RGB
+    BLOCK_BC3 = 1, // RGBA
+    BLOCK_BC5 = 2, // two channels, normal maps
+    BLOCK_BC7 = 3  // RGB(A), read only: made by external encoders
+};
+
+struct CompressedLevel
+{
+    int width;
+    int height;
+    size_t offset;
+    size_t size;
+};
+
+struct CompressedImage
+{
+    BlockFormat format;
+    int width;
+    int height;
+    int channels; // of the source image, reported to LoadTexture callers
+    vector<CompressedLevel> levels;
+    vector<unsigned char> data;
+};
+
+const char *blockFormatName(BlockFormat format);
+size_t blockFormatBytes(BlockFormat format);
+
+// Encodes tightly packed 8-bit pixels, top row first, with a box-filtered
+// mip chain down to 1x1: BC1 for one or three channels, BC3 for four and
+// BC5 for two.
+bool EncodeCompressedImage(const unsigned char *pixels, int width, int height, int channels,
+                           CompressedImage &image);
+
+bool WriteDdsFile(const char *path, const CompressedImage &image);
+
+// Reads BC1, BC3, BC5 and BC7 DDS files, legacy or DX10 headers.
+bool ReadDdsImage(const unsigned char *bytes, size_t size, CompressedImage &image, string &error);
+
+// Flips every level upside down by reordering block rows and the texel
+// rows inside each block. Not possible for BC7, or for levels whose height
+// is not a multiple of 4 (other than 1 and 2).
+bool FlipCompressedImage(CompressedImage &image);
+
+// GL thread: whether the driver takes this format, checked once against the
+// extension list.
+bool compressedFormatSupported(BlockFormat format, bool srgb);
+
+// GL thread: uploads every stored level with glCompressedTexImage2D; the
+// chain is used as is, nothing is generated.
+GLuint UploadCompressedImage(const CompressedImage &image, bool srgb);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef TEXTURE_DECODE_H
+#define TEXTURE_DECODE_H
+
+#include "mesh_loader.h"
+
+using namespace std;
+
+// The CPU side of mesh textures, shared by the game and desert_bake. The
+// GL side (streaming, uploads) is in texture_streaming.h.
+
+// Decoding and uploading on first draw instead of at import. Off, imports
+// decode every texture and uploads create them, as before.
+void setLazyTextureLoading(bool enabled);
+bool lazyTextureLoading();
+
+// Decodes ref.data (or the file at ref.path) into ref.pixels. Any thread.
+bool decodeTexturePixels(TextureRef &ref);
+
+#endif
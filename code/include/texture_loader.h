@@ -2,8 +2,52 @@
 #define TEXTURE_UTILS_H
 
 #include <cstddef>
+#include <vector>
 #include <glad/gl.h>
 
+// CPU-only decode into a tightly packed pixel buffer. Flipping is done here
+// rather than through stb's global flag, so these are safe on worker threads.
+bool DecodeImageFile(const char *path,
+                     bool flipVertically,
+                     std::vector<unsigned char> &pixels,
+                     int &width,
+                     int &height,
+                     int &channels);
+
+bool DecodeImageMemory(const unsigned char *buffer,
+                       size_t bufferSize,
+                       bool flipVertically,
+                       std::vector<unsigned char> &pixels,
+                       int &width,
+                       int &height,
+                       int &channels);
+
+// Baked textures are the decoded, unflipped pixels of a source image, written
+// by desert_bake so release builds upload them without running stb_image.
+// With DESERT_BAKED_ASSETS defined, DecodeImageFile reads the baked file for
+// a source path instead of the source itself.
+bool WriteBakedTexture(const char *sourcePath, const char *outputPath);
+
+bool ReadBakedTexture(const char *bakedPath,
+                      bool flipVertically,
+                      std::vector<unsigned char> &pixels,
+                      int &width,
+                      int &height,
+                      int &channels);
+
+// Rows [firstRow, firstRow + rows) of the next mip level of tightly packed
+// 8-bit pixels, max(1, width / 2) texels wide: a 2x2 box filter in the
+// stored (gamma) encoding, repeating the last row or column of odd sizes.
+void HalveImageRows(const unsigned char *source, int width, int height, int channels, int firstRow, int rows,
+                    unsigned char *out);
+
+// With compressed loading on, LoadTexture uploads a block-compressed DDS
+// (see texture_compression.h) in place of decoding: the path itself when it
+// ends in .dds, otherwise the file desert_bake's compress mode wrote for it.
+// Anything the driver or the flip cannot take falls back to decoding. Off
+// by default.
+void setCompressedTextureLoading(bool enabled);
+
 GLuint LoadTexture(const char *path,
                    bool srgb = false,
                    bool flipVertically = false,
@@ -19,6 +63,10 @@ GLuint LoadTextureFromMemory(const unsigned char *buffer,
                              int *outHeight = nullptr,
                              int *outChannels = nullptr);
 
+// The upload format and sized internal format for tightly packed 8-bit
+// pixels of 1 to 4 channels. False for any other channel count.
+bool deriveFormats(int channels, bool srgb, GLenum &format, GLenum &internalFormat);
+
 GLuint UploadTextureFromPixels(const unsigned char *pixels,
                                int width,
                                int height,
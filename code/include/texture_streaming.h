@@ -0,0 +1,70 @@
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <glad/gl.h>
+
+#include "mesh_loader.h"
+#include "texture_decode.h"
+
+using namespace std;
+
+// A mesh's diffuse image, left undecoded until the mesh is first drawn.
+// Every mesh naming the same image (and every shared copy of those meshes)
+// holds the same one, so it is decoded and uploaded once.
+struct StreamedTexture
+{
+    enum State
+    {
+        UNLOADED = 0,
+        QUEUED = 1, // being decoded, or decoded and waiting for or in an upload
+        RESIDENT = 2,
+        FAILED = 3
+    };
+
+    // Source bytes until the decode, then pixels until the upload. Owned by
+    // the decode thread while queued, by the GL thread otherwise.
+    TextureRef ref;
+
+    // GL thread only.
+    State state;
+    GLuint texture;
+    size_t bytes;
+    chrono::steady_clock::time_point requested;
+
+    // Meshes holding it, guarded by the streaming lock.
+    int users;
+};
+
+// Hands the mesh's diffuseRef over to a shared StreamedTexture for its
+// image, new and unloaded unless another mesh has already asked for it.
+// Encoded bytes are kept, nothing is decoded. Called by the mesh upload
+// with lazy texture loading (texture_decode.h) on.
+void deferMeshTexture(MeshInstance &instance);
+
+// GL thread: the texture to bind for a mesh about to be drawn. Returns the
+// real texture once resident; the first call queues the decode and until the
+// upload lands the 1x1 placeholder is returned instead. 0 means the image
+// could not be decoded.
+GLuint resolveStreamedTexture(const shared_ptr<StreamedTexture> &texture);
+
+// GL thread: uploads decoded textures in the order they were requested
+// until budgetMs is used up, at least one per call. Returns the count
+// uploaded. With pixel buffer uploads on (texture_upload.h) these are only
+// queued there, and become resident in a later call once the GPU has them.
+size_t pumpTextureUploads(double budgetMs);
+
+// GL thread: drops a mesh's claim; the last user frees the GL texture, or
+// the pixels if it never got that far.
+void releaseStreamedTexture(shared_ptr<StreamedTexture> &texture);
+
+// Stops the decode thread and deletes the placeholder.
+void stopTextureStreaming();
+
+// Images deferred, drawn, resident and still pending, how many were never
+// drawn at all, and the time from first draw to resident.
+void printTextureStreamingReport();
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/gl.h>
+
+using namespace std;
+
+// Texture uploads spread over frames through a ring of pixel buffer
+// objects. Each frame copies at most a fixed number of bytes of pending
+// rows into the next free buffer and issues glTexSubImage2D from it, so the
+// transfer runs on the driver's side and no single frame copies a whole
+// large image. A buffer is reused only once the fence after its last
+// upload has signalled; when none is free the frame copies nothing rather
+// than wait. The mip levels follow the same way, their rows box-filtered
+// from the level above as they are issued and counted against the same
+// budget, and the texture is complete once the fence after the 1x1 level
+// signals. All functions are GL thread only.
+
+// Off, streamed textures are uploaded whole with UploadTextureFromPixels,
+// as before. ringBytes is split evenly across the buffers.
+void setPixelBufferUploads(bool enabled, size_t ringBytes, size_t bytesPerFrame);
+bool pixelBufferUploads();
+
+// Creates the texture's storage and queues its pixels, taken from the
+// caller. The texture must not be sampled until textureUploadComplete says
+// so. Returns 0 for an unsupported channel count.
+GLuint queueTextureUpload(vector<unsigned char> &pixels, int width, int height, int channels, bool srgb);
+
+// Copies and issues this frame's share of pending rows and checks fences.
+// Returns the number of bytes issued.
+size_t pumpPixelBufferUploads();
+
+// True once every row of every level of the texture is on the GPU. True for
+// textures that were never queued.
+bool textureUploadComplete(GLuint texture);
+
+// Forgets a queued texture, complete or not; the caller deletes it.
+void cancelTextureUpload(GLuint texture);
+
+// Drops every pending upload and deletes the buffers and fences.
+void stopPixelBufferUploads();
+
+// Textures and bytes uploaded, frames used, and how often a frame found
+// every buffer still in flight.
+void printPixelBufferUploadReport();
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// Interleaved, quantized vertex used for every mesh on the GPU:
+//
+//   attribute  format                                  location
+//   position   float x3                                0
+//   normal     snorm 10:10:10:2 (w unused)             1
+//   uv         half x2                                 2
+//   colour     unorm8 x4 (alpha unused)                3
+//   bone ids   uint8 x4, or uint16 x4 when a mesh has  5
+//              more than 255 bones
+//   weights    unorm8 x4, renormalised to sum to 255   6
+//
+// in that order. uv and colour are left out of meshes that have none, or
+// whose program does not read them; the shader then sees the constant
+// generic attribute instead (uv 0,0 and colour white). That makes 16-24
+// bytes per static vertex and 24-36 per skinned one, against 44 and 76 for
+// the separate float streams this replaced.
+
+// Vertex attributes by shader location, as bits.
+enum VertexAttribute
+{
+    VERTEX_ATTRIB_POSITION = 1 << 0,
+    VERTEX_ATTRIB_NORMAL = 1 << 1,
+    VERTEX_ATTRIB_TEXCOORD = 1 << 2,
+    VERTEX_ATTRIB_COLOR = 1 << 3,
+    VERTEX_ATTRIB_BONE_IDS = 1 << 5,
+    VERTEX_ATTRIB_BONE_WEIGHTS = 1 << 6,
+
+    VERTEX_ATTRIBS_ALL = VERTEX_ATTRIB_POSITION | VERTEX_ATTRIB_NORMAL | VERTEX_ATTRIB_TEXCOORD |
+                         VERTEX_ATTRIB_COLOR | VERTEX_ATTRIB_BONE_IDS | VERTEX_ATTRIB_BONE_WEIGHTS
+};
+
+struct PackedVertexLayout
+{
+    GLsizei stride;
+    bool skinned;
+    bool wideBoneIds;
+    bool hasTexcoords;
+    bool hasColors;
+    // Byte offsets of the optional attributes; meaningless when absent.
+    GLsizei texcoordOffset;
+    GLsizei colorOffset;
+    GLsizei boneIdOffset;
+    GLsizei weightOffset;
+};
+
+// Position and normal, the part every vertex has.
+const GLsizei PACKED_VERTEX_BASE_SIZE = 16;
+
+PackedVertexLayout makePackedVertexLayout(bool skinned, size_t boneCount, bool hasTexcoords, bool hasColors);
+
+// Sets up the attributes of the layout for the VBO bound to
+// GL_ARRAY_BUFFER in the current VAO, and the constant values the shader
+// reads for the ones it leaves out.
+void bindPackedVertexLayout(const PackedVertexLayout &layout);
+
+// The VertexAttribute bits of the active inputs of a linked program.
+unsigned int queryProgramVertexAttributes(GLuint program);
+
+// Attributes the mesh program reads (VERTEX_ATTRIBS_ALL until set). Imports
+// neither generate nor keep streams outside it, and packing leaves them
+// out of the vertex. desert_bake keeps the default.
+void setUsedVertexAttributes(unsigned int attributes);
+unsigned int usedVertexAttributes();
+
+uint32_t packNormal1010102(const vec3 &n);
+uint16_t packHalf(float value);
+uint32_t packUnorm8x4(const vec4 &v);
+
+// Quantizes bone weights to unorm8 so the four bytes still sum to 255.
+uint32_t packBoneWeights(const vec4 &weights);
+
+// Per-vertex cost of the previous separate float streams, for reports.
+size_t legacyVertexSize(bool hasNormals, bool skinned);
+
+// Bytes per vertex left out of the packed vertex by elided attributes.
+size_t elidedVertexSize(const PackedVertexLayout &layout);
+
+#endif
@@ -0,0 +1,153 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Plain counters with static initialisation, so counting works for
+    // allocations made before main and on every thread.
+    thread_local uint64_t allocationCount = 0;
+    thread_local uint64_t allocationBytes = 0;
+
+#ifdef DESERT_COUNT_ALLOCS
+    const bool counting = true;
+
+    void *countedAlloc(size_t size)
+    {
+        allocationCount++;
+        allocationBytes += size;
+        return malloc(size ? size : 1);
+    }
+#else
+    const bool counting = false;
+#endif
+
+    struct LoadAllocations
+    {
+        string path;
+        bool warm;
+        AllocationCount used;
+    };
+
+    mutex recordMutex;
+    vector<LoadAllocations> loads;
+}
+
+#ifdef DESERT_COUNT_ALLOCS
+void *operator new(size_t size)
+{
+    void *p = countedAlloc(size);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    void *p = countedAlloc(size);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, const nothrow_t &) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, const nothrow_t &) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+#endif
+
+AllocationCount threadAllocations()
+{
+    AllocationCount count = {allocationCount, allocationBytes};
+    return count;
+}
+
+AllocationScope::AllocationScope()
+    : start(threadAllocations())
+{
+}
+
+AllocationCount AllocationScope::used() const
+{
+    AllocationCount now = threadAllocations();
+    AllocationCount used = {now.allocations - start.allocations, now.bytes - start.bytes};
+    return used;
+}
+
+void recordLoadAllocations(const char *path, bool warm, const AllocationCount &used)
+{
+    if (!counting)
+        return;
+
+    LoadAllocations load;
+    load.path = path ? path : "";
+    load.warm = warm;
+    load.used = used;
+
+    lock_guard<mutex> lock(recordMutex);
+    loads.push_back(load);
+}
+
+void printLoadAllocationReport()
+{
+    lock_guard<mutex> lock(recordMutex);
+    if (loads.empty())
+        return;
+
+    uint64_t totalAllocations = 0;
+    uint64_t totalBytes = 0;
+    cout << "\n=== Load allocations ===\n";
+    cout << left << setw(64) << "asset" << setw(6) << "load" << right << setw(12) << "allocs"
+         << setw(12) << "MB" << "\n";
+    for (const LoadAllocations &load : loads)
+    {
+        cout << left << setw(64) << load.path << setw(6) << (load.warm ? "warm" : "cold") << right
+             << setw(12) << load.used.allocations << fixed << setprecision(2) << setw(12)
+             << load.used.bytes / (1024.0 * 1024.0) << defaultfloat << "\n";
+        totalAllocations += load.used.allocations;
+        totalBytes += load.used.bytes;
+    }
+    cout << loads.size() << " loads: " << totalAllocations << " heap allocations, " << fixed << setprecision(2)
+         << totalBytes / (1024.0 * 1024.0) << " MB allocated" << defaultfloat << endl;
+}
@@ -0,0 +1,600 @@
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sys/stat.h>
+#include <assimp/cfileio.h>
+#include <zlib.h>
+
+#include "asset_prefetch.h"
+#include "load_profiler.h"
+
+namespace
+{
+    // Layout, little-endian:
+    //   header   magic, version, entry count, reserved (u32 each), index offset (u64)
+    //   data     entry payloads, each starting on a 16-byte boundary
+    //   index    per entry, sorted by path: offset, stored size, size (u64),
+    //            flags, CRC-32 of the unpacked bytes, path length (u32),
+    //            path bytes
+    const uint32_t PACK_MAGIC = 0x4B415044; // "DPAK"
+    const uint32_t PACK_VERSION = 2;
+    const uint32_t ENTRY_ZLIB = 1u << 0;
+    const size_t PACK_HEADER_SIZE = 24;
+    const size_t PACK_ALIGNMENT = 16;
+
+    struct PackEntry
+    {
+        string path;
+        uint64_t offset;
+        uint64_t storedSize;
+        uint64_t size;
+        uint32_t flags;
+        uint32_t crc;
+    };
+
+    struct PackStats
+    {
+        size_t packedReads;
+        size_t looseReads;
+        size_t inflatedReads;
+        uint64_t inflatedBytes;
+        double inflateMs;
+        size_t crcFailures;
+    };
+
+    MappedFile packFile;
+    vector<PackEntry> entries;
+    string packPath;
+
+    // Entries whose CRC has been checked, by index; guarded by statsMutex.
+    vector<bool> entriesVerified;
+
+    PackStats stats = {0, 0, 0, 0, 0.0, 0};
+    mutex statsMutex;
+
+    uint32_t readU32(const unsigned char *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    uint64_t readU64(const unsigned char *p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    void appendU32(vector<unsigned char> &out, uint32_t v)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(&v);
+        out.insert(out.end(), p, p + sizeof(v));
+    }
+
+    void appendU64(vector<unsigned char> &out, uint64_t v)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(&v);
+        out.insert(out.end(), p, p + sizeof(v));
+    }
+
+    // Pack keys use forward slashes with "." and ".." segments resolved, so
+    // "dir\\a/../b.bin" and "dir/b.bin" name the same entry. Assimp builds
+    // side-file paths like the former.
+    string normalizeAssetPath(const char *path)
+    {
+        vector<string> parts;
+        string part;
+        for (const char *c = path;; c++)
+        {
+            if (*c == '/' || *c == '\\' || *c == '\0')
+            {
+                if (part == "..")
+                {
+                    if (!parts.empty() && parts.back() != "..")
+                        parts.pop_back();
+                    else
+                        parts.push_back(part);
+                }
+                else if (!part.empty() && part != ".")
+                {
+                    parts.push_back(part);
+                }
+                part.clear();
+                if (*c == '\0')
+                    break;
+            }
+            else
+            {
+                part += *c;
+            }
+        }
+
+        string normalized = (path[0] == '/' || path[0] == '\\') ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            if (i > 0)
+                normalized += '/';
+            normalized += parts[i];
+        }
+        return normalized;
+    }
+
+    const PackEntry *findEntry(const char *path)
+    {
+        if (!path || entries.empty())
+            return nullptr;
+        string key = normalizeAssetPath(path);
+        auto it = lower_bound(entries.begin(), entries.end(), key, [](const PackEntry &e, const string &k)
+                              { return e.path < k; });
+        if (it == entries.end() || it->path != key)
+            return nullptr;
+        return &*it;
+    }
+
+    // Checks the unpacked bytes against the entry's CRC, the first time the
+    // entry is read only: a stored entry is then trusted in place.
+    bool verifyEntry(const PackEntry &entry, const unsigned char *data, size_t size)
+    {
+        size_t index = static_cast<size_t>(&entry - entries.data());
+        {
+            lock_guard<mutex> lock(statsMutex);
+            if (entriesVerified[index])
+                return true;
+        }
+
+        uLong crc = crc32(0L, Z_NULL, 0);
+        for (size_t done = 0; done < size;)
+        {
+            uInt chunk = static_cast<uInt>(min<size_t>(size - done, 1u << 30));
+            crc = crc32(crc, data + done, chunk);
+            done += chunk;
+        }
+
+        lock_guard<mutex> lock(statsMutex);
+        if (static_cast<uint32_t>(crc) != entry.crc)
+        {
+            stats.crcFailures++;
+            cerr << "asset pack: '" << entry.path << "' in '" << packPath << "' fails its CRC check\n";
+            return false;
+        }
+        entriesVerified[index] = true;
+        return true;
+    }
+
+    bool alreadyCompressed(const string &path)
+    {
+        static const char *const extensions[] = {".jpg", ".jpeg", ".png", ".zip", ".dpak"};
+        string lower = path;
+        transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        for (const char *extension : extensions)
+        {
+            size_t n = strlen(extension);
+            if (lower.size() >= n && lower.compare(lower.size() - n, n, extension) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // One open file handed to Assimp.
+    struct AssimpFile
+    {
+        AssetFile asset;
+        size_t position;
+    };
+
+    AssimpFile *assimpFile(aiFile *file)
+    {
+        return reinterpret_cast<AssimpFile *>(file->UserData);
+    }
+
+    size_t assimpRead(aiFile *file, char *buffer, size_t size, size_t count)
+    {
+        AssimpFile *f = assimpFile(file);
+        if (size == 0)
+            return 0;
+        size_t available = (f->asset.size() - f->position) / size;
+        count = min(count, available);
+        memcpy(buffer, f->asset.data() + f->position, count * size);
+        f->position += count * size;
+        return count;
+    }
+
+    size_t assimpWrite(aiFile *, const char *, size_t, size_t)
+    {
+        return 0;
+    }
+
+    size_t assimpTell(aiFile *file)
+    {
+        return assimpFile(file)->position;
+    }
+
+    size_t assimpSize(aiFile *file)
+    {
+        return assimpFile(file)->asset.size();
+    }
+
+    void assimpFlush(aiFile *)
+    {
+    }
+
+    aiReturn assimpSeek(aiFile *file, size_t offset, aiOrigin origin)
+    {
+        AssimpFile *f = assimpFile(file);
+        size_t base = origin == aiOrigin_SET ? 0 : (origin == aiOrigin_CUR ? f->position : f->asset.size());
+        if (offset > f->asset.size() - base)
+            return aiReturn_FAILURE;
+        f->position = base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    aiFile *assimpOpen(aiFileIO *, const char *path, const char *mode)
+    {
+        if (!path || !mode || strchr(mode, 'w') || strchr(mode, 'a'))
+            return nullptr;
+
+        AssimpFile *f = new AssimpFile();
+        f->position = 0;
+        if (!f->asset.open(path))
+        {
+            delete f;
+            return nullptr;
+        }
+
+        aiFile *file = new aiFile();
+        file->ReadProc = assimpRead;
+        file->WriteProc = assimpWrite;
+        file->TellProc = assimpTell;
+        file->FileSizeProc = assimpSize;
+        file->SeekProc = assimpSeek;
+        file->FlushProc = assimpFlush;
+        file->UserData = reinterpret_cast<aiUserData>(f);
+        return file;
+    }
+
+    void assimpClose(aiFileIO *, aiFile *file)
+    {
+        if (!file)
+            return;
+        delete assimpFile(file);
+        delete file;
+    }
+
+    aiFileIO assimpIO = {assimpOpen, assimpClose, nullptr};
+}
+
+bool openAssetPack(const char *path)
+{
+    ProfileScope scope("openAssetPack");
+    closeAssetPack();
+
+    FILE *probe = path ? fopen(path, "rb") : nullptr;
+    if (!probe)
+        return false;
+    fclose(probe);
+
+    if (!packFile.open(path) || packFile.size() < PACK_HEADER_SIZE)
+    {
+        cerr << "asset pack: cannot read '" << path << "'\n";
+        closeAssetPack();
+        return false;
+    }
+
+    const unsigned char *base = packFile.data();
+    const size_t size = packFile.size();
+    uint32_t count = readU32(base + 8);
+    uint64_t indexOffset = readU64(base + 16);
+    if (readU32(base) != PACK_MAGIC || readU32(base + 4) != PACK_VERSION || indexOffset > size)
+    {
+        cerr << "asset pack: '" << path << "' is not a version " << PACK_VERSION << " pack\n";
+        closeAssetPack();
+        return false;
+    }
+
+    const size_t entryFixedSize = 8 * 3 + 4 * 3;
+    size_t cursor = static_cast<size_t>(indexOffset);
+    if (count > (size - cursor) / entryFixedSize)
+    {
+        cerr << "asset pack: '" << path << "' has a corrupt index\n";
+        closeAssetPack();
+        return false;
+    }
+    entries.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (size - cursor < entryFixedSize)
+            break;
+        PackEntry entry;
+        entry.offset = readU64(base + cursor);
+        entry.storedSize = readU64(base + cursor + 8);
+        entry.size = readU64(base + cursor + 16);
+        entry.flags = readU32(base + cursor + 24);
+        entry.crc = readU32(base + cursor + 28);
+        uint32_t pathLength = readU32(base + cursor + 32);
+        cursor += entryFixedSize;
+        // Stored entries are read in place for size bytes.
+        if (size - cursor < pathLength || entry.offset > indexOffset ||
+            entry.storedSize > indexOffset - entry.offset ||
+            (!(entry.flags & ENTRY_ZLIB) && entry.size != entry.storedSize))
+            break;
+        entry.path.assign(reinterpret_cast<const char *>(base + cursor), pathLength);
+        cursor += pathLength;
+        entries.push_back(entry);
+    }
+
+    if (entries.size() != count)
+    {
+        cerr << "asset pack: '" << path << "' has a corrupt index\n";
+        closeAssetPack();
+        return false;
+    }
+
+    packPath = path;
+    entriesVerified.assign(entries.size(), false);
+    cout << "[pack] " << path << ": " << count << " entries, "
+         << fixed << setprecision(1) << size / (1024.0 * 1024.0) << " MB mapped" << defaultfloat << endl;
+    return true;
+}
+
+void closeAssetPack()
+{
+    entries.clear();
+    entriesVerified.clear();
+    packFile.close();
+    packPath.clear();
+}
+
+bool isAssetPackOpen()
+{
+    return packFile.isOpen();
+}
+
+bool writeAssetPack(const char *outputPath, const vector<string> &paths)
+{
+    struct PendingEntry
+    {
+        PackEntry entry;
+        vector<unsigned char> payload;
+    };
+
+    vector<PendingEntry> pending;
+    for (const string &path : paths)
+    {
+        MappedFile file;
+        if (!file.open(path.c_str()))
+        {
+            cerr << "asset pack: cannot read '" << path << "'\n";
+            return false;
+        }
+
+        PendingEntry p;
+        p.entry.path = normalizeAssetPath(path.c_str());
+        p.entry.size = file.size();
+        p.entry.flags = 0;
+        p.entry.crc = static_cast<uint32_t>(crc32(0L, file.data(), static_cast<uInt>(file.size())));
+
+        if (!alreadyCompressed(path))
+        {
+            uLongf compressedSize = compressBound(static_cast<uLong>(file.size()));
+            p.payload.resize(compressedSize);
+            if (compress2(p.payload.data(), &compressedSize, file.data(), static_cast<uLong>(file.size()),
+                          Z_BEST_COMPRESSION) == Z_OK &&
+                compressedSize <= file.size() - file.size() / 8)
+            {
+                p.payload.resize(compressedSize);
+                p.entry.flags = ENTRY_ZLIB;
+            }
+        }
+        if (p.entry.flags == 0)
+            p.payload.assign(file.data(), file.data() + file.size());
+
+        p.entry.storedSize = p.payload.size();
+        pending.push_back(move(p));
+    }
+
+    sort(pending.begin(), pending.end(), [](const PendingEntry &a, const PendingEntry &b)
+         { return a.entry.path < b.entry.path; });
+    for (size_t i = 1; i < pending.size(); i++)
+    {
+        if (pending[i].entry.path == pending[i - 1].entry.path)
+        {
+            cerr << "asset pack: '" << pending[i].entry.path << "' listed twice\n";
+            return false;
+        }
+    }
+
+    vector<unsigned char> out(PACK_HEADER_SIZE, 0);
+    uint64_t rawBytes = 0;
+    for (PendingEntry &p : pending)
+    {
+        out.resize((out.size() + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT, 0);
+        p.entry.offset = out.size();
+        out.insert(out.end(), p.payload.begin(), p.payload.end());
+        rawBytes += p.entry.size;
+    }
+
+    uint64_t indexOffset = out.size();
+    for (const PendingEntry &p : pending)
+    {
+        appendU64(out, p.entry.offset);
+        appendU64(out, p.entry.storedSize);
+        appendU64(out, p.entry.size);
+        appendU32(out, p.entry.flags);
+        appendU32(out, p.entry.crc);
+        appendU32(out, static_cast<uint32_t>(p.entry.path.size()));
+        out.insert(out.end(), p.entry.path.begin(), p.entry.path.end());
+    }
+
+    uint32_t header[4] = {PACK_MAGIC, PACK_VERSION, static_cast<uint32_t>(pending.size()), 0};
+    memcpy(out.data(), header, sizeof(header));
+    memcpy(out.data() + sizeof(header), &indexOffset, sizeof(indexOffset));
+
+    // Write to a temporary name first so an interrupted write never leaves
+    // a truncated pack behind under the real name.
+    string tempPath = string(outputPath) + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+    {
+        cerr << "asset pack: cannot write '" << tempPath << "'\n";
+        return false;
+    }
+    size_t written = fwrite(out.data(), 1, out.size(), file);
+    fclose(file);
+    if (written != out.size())
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    remove(outputPath);
+    if (rename(tempPath.c_str(), outputPath) != 0)
+        return false;
+
+    cout << "[pack] " << outputPath << ": " << pending.size() << " entries, " << fixed << setprecision(1)
+         << rawBytes / (1024.0 * 1024.0) << " MB -> " << out.size() / (1024.0 * 1024.0) << " MB"
+         << defaultfloat << endl;
+    return true;
+}
+
+bool assetExists(const char *path)
+{
+    if (!path)
+        return false;
+    if (findEntry(path))
+        return true;
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    fclose(file);
+    return true;
+}
+
+bool assetStamp(const char *path, uint64_t &size, uint64_t &stamp)
+{
+    size = 0;
+    stamp = 0;
+    if (!path)
+        return false;
+
+    const PackEntry *entry = findEntry(path);
+    if (entry)
+    {
+        size = entry->size;
+        stamp = entry->crc;
+        return true;
+    }
+
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return false;
+    size = static_cast<uint64_t>(info.st_size);
+    stamp = static_cast<uint64_t>(info.st_mtime);
+    return true;
+}
+
+AssetFile::AssetFile()
+    : bytes(nullptr), length(0), packed(false)
+{
+}
+
+bool AssetFile::open(const char *path)
+{
+    close();
+    if (!path)
+        return false;
+
+    const PackEntry *entry = findEntry(path);
+    if (!entry)
+    {
+        if (!loose.open(path))
+            return false;
+        bytes = loose.data();
+        length = loose.size();
+        recordAssetRead(path, 0, length);
+
+        lock_guard<mutex> lock(statsMutex);
+        stats.looseReads++;
+        return true;
+    }
+
+    const unsigned char *stored = packFile.data() + entry->offset;
+    packed = true;
+    recordAssetRead(packPath, entry->offset, entry->storedSize);
+    if (!(entry->flags & ENTRY_ZLIB))
+    {
+        bytes = stored;
+        length = static_cast<size_t>(entry->size);
+        if (!verifyEntry(*entry, bytes, length))
+        {
+            close();
+            return false;
+        }
+
+        lock_guard<mutex> lock(statsMutex);
+        stats.packedReads++;
+        return length > 0;
+    }
+
+    ProfileScope scope("inflateAsset");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    inflated.resize(static_cast<size_t>(entry->size));
+    uLongf inflatedSize = static_cast<uLongf>(entry->size);
+    if (uncompress(inflated.data(), &inflatedSize, stored, static_cast<uLong>(entry->storedSize)) != Z_OK ||
+        inflatedSize != entry->size)
+    {
+        cerr << "asset pack: cannot inflate '" << entry->path << "' from '" << packPath << "'\n";
+        close();
+        return false;
+    }
+    bytes = inflated.data();
+    length = inflated.size();
+    if (!verifyEntry(*entry, bytes, length))
+    {
+        close();
+        return false;
+    }
+
+    lock_guard<mutex> lock(statsMutex);
+    stats.packedReads++;
+    stats.inflatedReads++;
+    stats.inflatedBytes += entry->size;
+    stats.inflateMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return length > 0;
+}
+
+void AssetFile::close()
+{
+    loose.close();
+    vector<unsigned char>().swap(inflated);
+    bytes = nullptr;
+    length = 0;
+    packed = false;
+}
+
+aiFileIO *assetFileIO()
+{
+    return &assimpIO;
+}
+
+void printAssetPackReport()
+{
+    lock_guard<mutex> lock(statsMutex);
+    if (stats.packedReads == 0 && stats.looseReads == 0)
+        return;
+
+    cout << "\n=== Asset pack ===\n";
+    cout << (isAssetPackOpen() ? packPath : string("(no pack)")) << ": " << stats.packedReads
+         << " reads from the pack (" << stats.inflatedReads << " inflated, " << fixed << setprecision(1)
+         << stats.inflatedBytes / (1024.0 * 1024.0) << " MB in " << stats.inflateMs << " ms), "
+         << stats.looseReads << " from loose files";
+    if (stats.crcFailures > 0)
+        cout << "; " << stats.crcFailures << " entries failed their CRC check";
+    cout << "\n" << defaultfloat << endl;
+}
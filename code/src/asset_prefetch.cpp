@@ -0,0 +1,254 @@
+#include "asset_prefetch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "load_profiler.h"
+
+namespace
+{
+    struct ReadRange
+    {
+        string file;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct PrefetchStats
+    {
+        size_t files;
+        size_t ranges;
+        uint64_t bytes;
+        double ms;
+        size_t reads;
+        size_t predictedReads;
+    };
+
+    // Ranges closer than this are advised as one, so a run of small pack
+    // entries becomes a single request.
+    const uint64_t MERGE_GAP = 64 * 1024;
+
+    mutex prefetchMutex;
+    vector<ReadRange> recorded;
+    set<pair<string, uint64_t>> recordedKeys;
+    set<pair<string, uint64_t>> predictedKeys;
+    PrefetchStats stats = {0, 0, 0, 0.0, 0, 0};
+    thread prefetchThread;
+    bool prefetchStarted = false;
+
+    bool adviseRange(int fd, uint64_t offset, uint64_t size)
+    {
+#if defined(__linux__)
+        return posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED) == 0;
+#elif defined(__APPLE__)
+        struct radvisory advice;
+        advice.ra_offset = static_cast<off_t>(offset);
+        advice.ra_count = static_cast<int>(size < static_cast<uint64_t>(INT_MAX) ? size : INT_MAX);
+        return fcntl(fd, F_RDADVISE, &advice) != -1;
+#else
+        (void)fd;
+        (void)offset;
+        (void)size;
+        return false;
+#endif
+    }
+
+    // Consecutive ranges of the same file share one descriptor; the kernel
+    // queues the advised reads and fills the page cache while the loader
+    // threads are still busy with earlier assets.
+    void prefetchRanges(vector<ReadRange> ranges)
+    {
+        ProfileScope scope("prefetchAssets");
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        PrefetchStats issued = {0, 0, 0, 0.0, 0, 0};
+
+#if !defined(_WIN32)
+        size_t i = 0;
+        while (i < ranges.size())
+        {
+            const string &file = ranges[i].file;
+            size_t end = i;
+            while (end < ranges.size() && ranges[end].file == file)
+                end++;
+
+            int fd = ::open(file.c_str(), O_RDONLY);
+            if (fd >= 0)
+            {
+                issued.files++;
+                uint64_t offset = ranges[i].offset;
+                uint64_t limit = offset + ranges[i].size;
+                for (size_t r = i + 1; r <= end; r++)
+                {
+                    if (r < end && ranges[r].offset >= offset && ranges[r].offset <= limit + MERGE_GAP)
+                    {
+                        limit = max(limit, ranges[r].offset + ranges[r].size);
+                        continue;
+                    }
+                    if (adviseRange(fd, offset, limit - offset))
+                    {
+                        issued.ranges++;
+                        issued.bytes += limit - offset;
+                    }
+                    if (r < end)
+                    {
+                        offset = ranges[r].offset;
+                        limit = offset + ranges[r].size;
+                    }
+                }
+                ::close(fd);
+            }
+            i = end;
+        }
+#endif
+
+        issued.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        lock_guard<mutex> lock(prefetchMutex);
+        stats.files = issued.files;
+        stats.ranges = issued.ranges;
+        stats.bytes = issued.bytes;
+        stats.ms = issued.ms;
+    }
+
+    void makeTraceDirectory(const string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        if (slash == string::npos)
+            return;
+        string directory = path.substr(0, slash);
+        for (size_t pos = directory.find('/'); ; pos = directory.find('/', pos + 1))
+        {
+            string part = directory.substr(0, pos);
+#if defined(_WIN32)
+            _mkdir(part.c_str());
+#else
+            mkdir(part.c_str(), 0755);
+#endif
+            if (pos == string::npos)
+                break;
+        }
+    }
+}
+
+void recordAssetRead(const string &file, uint64_t offset, uint64_t size)
+{
+    lock_guard<mutex> lock(prefetchMutex);
+    pair<string, uint64_t> key(file, offset);
+    stats.reads++;
+    if (predictedKeys.count(key))
+        stats.predictedReads++;
+    if (recordedKeys.insert(key).second)
+    {
+        ReadRange range = {file, offset, size};
+        recorded.push_back(range);
+    }
+}
+
+bool writeAssetReadTrace(const char *path)
+{
+    waitForAssetPrefetch();
+
+    ostringstream text;
+    {
+        lock_guard<mutex> lock(prefetchMutex);
+        if (recorded.empty())
+            return false;
+        for (const ReadRange &range : recorded)
+            text << range.offset << ' ' << range.size << ' ' << range.file << '\n';
+    }
+
+    string target = path;
+    makeTraceDirectory(target);
+    string tempPath = target + ".tmp";
+    ofstream out(tempPath.c_str(), ios::binary);
+    if (!out)
+    {
+        cerr << "writeAssetReadTrace: cannot write '" << tempPath << "'\n";
+        return false;
+    }
+    out << text.str();
+    out.close();
+    if (!out)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    remove(target.c_str());
+    return rename(tempPath.c_str(), target.c_str()) == 0;
+}
+
+bool startAssetPrefetch(const char *tracePath)
+{
+    ifstream in(tracePath);
+    if (!in)
+        return false;
+
+    vector<ReadRange> ranges;
+    string line;
+    while (getline(in, line))
+    {
+        istringstream fields(line);
+        ReadRange range;
+        if (!(fields >> range.offset >> range.size))
+            continue;
+        fields.get();
+        getline(fields, range.file);
+        if (!range.file.empty() && range.size > 0)
+            ranges.push_back(range);
+    }
+    if (ranges.empty())
+        return false;
+
+    lock_guard<mutex> lock(prefetchMutex);
+    if (prefetchStarted)
+        return false;
+    for (const ReadRange &range : ranges)
+        predictedKeys.insert(make_pair(range.file, range.offset));
+    prefetchThread = thread(prefetchRanges, move(ranges));
+    prefetchStarted = true;
+    return true;
+}
+
+void waitForAssetPrefetch()
+{
+    if (prefetchThread.joinable())
+        prefetchThread.join();
+}
+
+void printAssetPrefetchReport()
+{
+    waitForAssetPrefetch();
+
+    lock_guard<mutex> lock(prefetchMutex);
+    if (!prefetchStarted)
+    {
+        cout << "\n=== Asset prefetch ===\nno read trace yet; " << recorded.size()
+             << " reads recorded for the next launch\n" << endl;
+        return;
+    }
+
+    cout << "\n=== Asset prefetch ===\n";
+    cout << "advised " << stats.ranges << " ranges (" << fixed << setprecision(1)
+         << stats.bytes / (1024.0 * 1024.0) << " MB) in " << stats.files << " files, issued in "
+         << stats.ms << " ms\n";
+    cout << stats.predictedReads << " of " << stats.reads << " asset reads this run were prefetched\n"
+         << defaultfloat << endl;
+}
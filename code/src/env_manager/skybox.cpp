@@ -4,6 +4,7 @@
 
 #include "skybox.h"
 #include "shader_utils.h"
+#include "load_profiler.h"
 
 using namespace glm;
 
@@ -26,6 +27,7 @@ Skybox::~Skybox()
 
 void Skybox::init(const char *vertPath, const char *fragPath)
 {
+    ProfileScope scope("Skybox::init", "skybox");
     shaderProgram = CompileShaders(vertPath, fragPath);
 
     if (shaderProgram == 0)
@@ -2,17 +2,17 @@
 #include <algorithm>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "stb_image.h"
 #include "renderer.h"
 #include "glm_compat.h"
 #include "terrain_manager.h"
 #include "texture_loader.h"
+#include "load_profiler.h"
 
 using namespace std;
 using namespace glm;
 
 TerrainManager::TerrainManager()
-    : terrain(nullptr), heightmapTex(0), diffuseTex(0), heightmapData(nullptr),
+    : terrain(nullptr), heightmapTex(0), diffuseTex(0),
       gridSize(0), worldSize(0.0f), heightScale(0.0f),
       cellSize(0.0f), textureScale(8.0f),
       heightmapWidth(0), heightmapHeight(0), heightmapChannels(0),
@@ -28,6 +28,7 @@ TerrainManager::~TerrainManager()
 bool TerrainManager::initialize(int gSize, float wSize, float hScale,
                                 const char *heightmapPath, const char *diffusePath)
 {
+    ProfileScope scope("TerrainManager::initialize", "terrain");
     if (isInitialized)
     {
         cerr << "TerrainManager already initialized!\n";
@@ -39,27 +40,28 @@ bool TerrainManager::initialize(int gSize, float wSize, float hScale,
     heightScale = hScale;
     cellSize = worldSize / static_cast<float>(gridSize);
 
-    heightmapTex = LoadTexture(heightmapPath, false, false,
-                               &heightmapWidth, &heightmapHeight);
-    if (heightmapTex == 0)
+    // One decode serves both the GPU texture and CPU height sampling.
+    if (!DecodeImageFile(heightmapPath, false, heightmapData,
+                         heightmapWidth, heightmapHeight, heightmapChannels))
     {
         cerr << "Failed to load heightmap: " << heightmapPath << "\n";
         return false;
     }
 
+    heightmapTex = UploadTextureFromPixels(heightmapData.data(), heightmapWidth,
+                                           heightmapHeight, heightmapChannels, false);
+    if (heightmapTex == 0)
+    {
+        cerr << "Failed to upload heightmap: " << heightmapPath << "\n";
+        cleanup();
+        return false;
+    }
+
     glBindTexture(GL_TEXTURE_2D, heightmapTex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    heightmapData = stbi_load(heightmapPath, &heightmapWidth,
-                              &heightmapHeight, &heightmapChannels, 0);
-    if (!heightmapData)
-    {
-        cerr << "Warning: Failed to load heightmap data for CPU sampling\n";
-    }
-
-
     diffuseTex = LoadTexture(diffusePath, true, true);
     if (diffuseTex == 0)
     {
@@ -68,8 +70,11 @@ bool TerrainManager::initialize(int gSize, float wSize, float hScale,
         return false;
     }
 
-    terrain = new Terrain(gridSize, worldSize, heightmapTex,
-                          heightScale, diffuseTex);
+    {
+        ProfileScope meshScope("buildTerrainMesh");
+        terrain = new Terrain(gridSize, worldSize, heightmapTex,
+                              heightScale, diffuseTex);
+    }
 
     isInitialized = true;
 
@@ -137,7 +142,7 @@ void TerrainManager::render(GLuint shaderProgram, const mat4 &model,
 
 float TerrainManager::getHeightAt(float worldX, float worldZ) const
 {
-    if (!heightmapData || heightmapWidth <= 0 || heightmapHeight <= 0)
+    if (heightmapData.empty() || heightmapWidth <= 0 || heightmapHeight <= 0)
     {
         return 0.0f;
     }
@@ -201,11 +206,7 @@ void TerrainManager::cleanup()
         diffuseTex = 0;
     }
 
-    if (heightmapData)
-    {
-        stbi_image_free(heightmapData);
-        heightmapData = nullptr;
-    }
+    vector<unsigned char>().swap(heightmapData);
 
     isInitialized = false;
 }
@@ -0,0 +1,360 @@
+#include "json_reader.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const JsonValue nullValue;
+
+    // Deeper documents are rejected rather than risking the stack.
+    const int MAX_DEPTH = 256;
+
+    void appendUtf8(string &out, unsigned long code)
+    {
+        if (code < 0x80)
+        {
+            out += static_cast<char>(code);
+        }
+        else if (code < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+}
+
+JsonValue::JsonValue()
+    : kind(JSON_NULL), flag(false), number(0.0)
+{
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const
+{
+    if (kind != JSON_ARRAY || index >= items.size())
+        return nullValue;
+    return items[index];
+}
+
+const JsonValue &JsonValue::operator[](const char *key) const
+{
+    if (kind != JSON_OBJECT)
+        return nullValue;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == key)
+            return items[i];
+    }
+    return nullValue;
+}
+
+bool JsonValue::has(const char *key) const
+{
+    return !(*this)[key].isNull();
+}
+
+bool JsonValue::asBool(bool fallback) const
+{
+    return kind == JSON_BOOL ? flag : fallback;
+}
+
+double JsonValue::asNumber(double fallback) const
+{
+    return kind == JSON_NUMBER ? number : fallback;
+}
+
+int JsonValue::asInt(int fallback) const
+{
+    return kind == JSON_NUMBER ? static_cast<int>(number) : fallback;
+}
+
+class JsonParser
+{
+public:
+    JsonParser(const char *text, size_t length)
+        : pos(text), end(text + length), begin(text)
+    {
+    }
+
+    bool parseDocument(JsonValue &out, string &error)
+    {
+        skipSpace();
+        if (!parseValue(out, 0))
+        {
+            error = describe();
+            return false;
+        }
+        skipSpace();
+        if (pos != end)
+        {
+            reason = "trailing characters";
+            error = describe();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const char *pos;
+    const char *end;
+    const char *begin;
+    const char *reason = "";
+
+    string describe() const
+    {
+        return string(reason) + " at byte " + to_string(pos - begin);
+    }
+
+    bool fail(const char *why)
+    {
+        reason = why;
+        return false;
+    }
+
+    void skipSpace()
+    {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+            pos++;
+    }
+
+    bool literal(const char *word)
+    {
+        size_t n = strlen(word);
+        if (static_cast<size_t>(end - pos) < n || memcmp(pos, word, n) != 0)
+            return fail("invalid literal");
+        pos += n;
+        return true;
+    }
+
+    bool parseValue(JsonValue &out, int depth)
+    {
+        if (depth > MAX_DEPTH)
+            return fail("nesting too deep");
+        if (pos >= end)
+            return fail("unexpected end of input");
+
+        switch (*pos)
+        {
+        case '{':
+            return parseObject(out, depth);
+        case '[':
+            return parseArray(out, depth);
+        case '"':
+            out.kind = JsonValue::JSON_STRING;
+            return parseString(out.text);
+        case 't':
+            out.kind = JsonValue::JSON_BOOL;
+            out.flag = true;
+            return literal("true");
+        case 'f':
+            out.kind = JsonValue::JSON_BOOL;
+            out.flag = false;
+            return literal("false");
+        case 'n':
+            out.kind = JsonValue::JSON_NULL;
+            return literal("null");
+        default:
+            return parseNumber(out);
+        }
+    }
+
+    bool parseNumber(JsonValue &out)
+    {
+        // strtod needs a terminator, and the input is not guaranteed one.
+        const char *start = pos;
+        while (pos < end && (strchr("+-0123456789.eE", *pos) != nullptr))
+            pos++;
+        if (pos == start)
+            return fail("unexpected character");
+
+        string digits(start, pos);
+        char *parsedEnd = nullptr;
+        out.number = strtod(digits.c_str(), &parsedEnd);
+        if (parsedEnd != digits.c_str() + digits.size())
+        {
+            pos = start;
+            return fail("invalid number");
+        }
+        out.kind = JsonValue::JSON_NUMBER;
+        return true;
+    }
+
+    bool parseHex4(unsigned long &code)
+    {
+        if (end - pos < 4)
+            return fail("truncated \\u escape");
+        code = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = *pos++;
+            code <<= 4;
+            if (c >= '0' && c <= '9')
+                code |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                code |= c - 'A' + 10;
+            else
+                return fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    bool parseString(string &out)
+    {
+        pos++; // opening quote
+        out.clear();
+        while (pos < end)
+        {
+            const char *run = pos;
+            while (pos < end && *pos != '"' && *pos != '\\')
+                pos++;
+            out.append(run, pos);
+            if (pos >= end)
+                break;
+            if (*pos == '"')
+            {
+                pos++;
+                return true;
+            }
+
+            pos++; // backslash
+            if (pos >= end)
+                break;
+            char escape = *pos++;
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out += escape;
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+            {
+                unsigned long code;
+                if (!parseHex4(code))
+                    return false;
+                // Surrogate pair for characters outside the BMP.
+                if (code >= 0xD800 && code < 0xDC00 && end - pos >= 6 && pos[0] == '\\' && pos[1] == 'u')
+                {
+                    pos += 2;
+                    unsigned long low;
+                    if (!parseHex4(low))
+                        return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default:
+                return fail("invalid escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool parseArray(JsonValue &out, int depth)
+    {
+        out.kind = JsonValue::JSON_ARRAY;
+        pos++;
+        skipSpace();
+        if (pos < end && *pos == ']')
+        {
+            pos++;
+            return true;
+        }
+        while (true)
+        {
+            out.items.push_back(JsonValue());
+            skipSpace();
+            if (!parseValue(out.items.back(), depth + 1))
+                return false;
+            skipSpace();
+            if (pos >= end)
+                return fail("unterminated array");
+            if (*pos == ']')
+            {
+                pos++;
+                return true;
+            }
+            if (*pos != ',')
+                return fail("expected ',' or ']'");
+            pos++;
+        }
+    }
+
+    bool parseObject(JsonValue &out, int depth)
+    {
+        out.kind = JsonValue::JSON_OBJECT;
+        pos++;
+        skipSpace();
+        if (pos < end && *pos == '}')
+        {
+            pos++;
+            return true;
+        }
+        while (true)
+        {
+            skipSpace();
+            if (pos >= end || *pos != '"')
+                return fail("expected member name");
+            out.keys.push_back(string());
+            if (!parseString(out.keys.back()))
+                return false;
+            skipSpace();
+            if (pos >= end || *pos != ':')
+                return fail("expected ':'");
+            pos++;
+            skipSpace();
+            out.items.push_back(JsonValue());
+            if (!parseValue(out.items.back(), depth + 1))
+                return false;
+            skipSpace();
+            if (pos >= end)
+                return fail("unterminated object");
+            if (*pos == '}')
+            {
+                pos++;
+                return true;
+            }
+            if (*pos != ',')
+                return fail("expected ',' or '}'");
+            pos++;
+        }
+    }
+};
+
+bool parseJson(const char *text, size_t length, JsonValue &out, string &error)
+{
+    out = JsonValue();
+    JsonParser parser(text, length);
+    return parser.parseDocument(out, error);
+}
@@ -0,0 +1,268 @@
+#include "load_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct ProfileEvent
+    {
+        const char *stage;
+        string asset;
+        int thread;
+        int depth;
+        bool assetRoot;
+        int64_t startUs;
+        int64_t durationUs;
+    };
+
+    struct StageTotal
+    {
+        int64_t us;
+        size_t calls;
+    };
+
+    const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+    atomic<bool> profiling(true);
+
+    vector<ProfileEvent> events;
+    map<thread::id, int> threadIndices;
+    // Scopes close on the loader threads as well as the GL thread.
+    mutex eventsMutex;
+    mutex printMutex;
+
+    thread_local ProfileScope *innermost = nullptr;
+    thread_local int threadIndex = -1;
+
+    const int STAGES_PER_ASSET = 8;
+
+    int64_t nowUs()
+    {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - epoch).count();
+    }
+
+    // Caller holds eventsMutex.
+    int currentThreadIndex()
+    {
+        if (threadIndex < 0)
+        {
+            thread::id id = this_thread::get_id();
+            auto found = threadIndices.find(id);
+            if (found == threadIndices.end())
+                found = threadIndices.insert(make_pair(id, static_cast<int>(threadIndices.size()))).first;
+            threadIndex = found->second;
+        }
+        return threadIndex;
+    }
+
+    string jsonEscape(const string &s)
+    {
+        string out;
+        out.reserve(s.size());
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", c);
+                out += code;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    string shortName(const string &name, size_t width)
+    {
+        if (name.size() <= width)
+            return name;
+        return "..." + name.substr(name.size() - (width - 3));
+    }
+
+    template <typename Key>
+    vector<pair<Key, StageTotal>> byTimeDescending(const map<Key, StageTotal> &totals)
+    {
+        vector<pair<Key, StageTotal>> sorted(totals.begin(), totals.end());
+        sort(sorted.begin(), sorted.end(), [](const pair<Key, StageTotal> &a, const pair<Key, StageTotal> &b)
+             { return a.second.us > b.second.us; });
+        return sorted;
+    }
+}
+
+ProfileScope::ProfileScope(const char *stageName, const string &assetName)
+    : stage(stageName), parent(innermost), recording(profiling), depth(0), startUs(0)
+{
+    if (!recording)
+        return;
+
+    asset = assetName;
+    startUs = nowUs();
+    if (parent)
+    {
+        depth = parent->depth + 1;
+        if (asset.empty())
+            asset = parent->asset;
+    }
+    if (asset.empty())
+        asset = "(startup)";
+    innermost = this;
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (!recording)
+        return;
+
+    ProfileEvent event;
+    event.stage = stage;
+    event.asset = asset;
+    event.depth = depth;
+    event.assetRoot = !parent || parent->asset != asset;
+    event.startUs = startUs;
+    event.durationUs = nowUs() - startUs;
+    innermost = parent;
+
+    lock_guard<mutex> lock(eventsMutex);
+    if (!profiling)
+        return;
+    event.thread = currentThreadIndex();
+    events.push_back(event);
+}
+
+void setLoadProfiling(bool enabled)
+{
+    lock_guard<mutex> lock(eventsMutex);
+    profiling = enabled;
+    if (!enabled)
+        vector<ProfileEvent>().swap(events);
+}
+
+bool loadProfiling()
+{
+    return profiling;
+}
+
+bool writeLoadTrace(const char *path)
+{
+    lock_guard<mutex> lock(eventsMutex);
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        cerr << "load profiler: cannot write '" << path << "'\n";
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t t = 0; t < threadIndices.size(); t++)
+    {
+        // Threads are numbered in the order they first finished a span.
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}},\n",
+                static_cast<int>(t), static_cast<int>(t));
+    }
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const ProfileEvent &e = events[i];
+        fprintf(file,
+                "{\"name\":\"%s\",\"cat\":\"load\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                "\"ts\":%lld,\"dur\":%lld,\"args\":{\"asset\":\"%s\"}}%s\n",
+                jsonEscape(e.stage).c_str(), e.thread,
+                static_cast<long long>(e.startUs), static_cast<long long>(e.durationUs),
+                jsonEscape(e.asset).c_str(), i + 1 < events.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    bool ok = ferror(file) == 0;
+    fclose(file);
+
+    cout << "Load trace: " << events.size() << " spans written to " << path << endl;
+    return ok;
+}
+
+void printLoadProfile()
+{
+    lock_guard<mutex> lock(eventsMutex);
+    if (events.empty())
+        return;
+
+    map<string, StageTotal> assetTotals;
+    map<pair<string, string>, StageTotal> assetStages;
+    map<string, StageTotal> stageTotals;
+    int64_t first = events.front().startUs;
+    int64_t last = first;
+    for (const ProfileEvent &e : events)
+    {
+        first = min(first, e.startUs);
+        last = max(last, e.startUs + e.durationUs);
+
+        if (e.assetRoot)
+        {
+            StageTotal &total = assetTotals[e.asset];
+            total.us += e.durationUs;
+            total.calls++;
+        }
+        StageTotal &perAsset = assetStages[make_pair(e.asset, string(e.stage))];
+        perAsset.us += e.durationUs;
+        perAsset.calls++;
+        StageTotal &perStage = stageTotals[e.stage];
+        perStage.us += e.durationUs;
+        perStage.calls++;
+    }
+
+    cout << "\n=== Load profile (" << fixed << setprecision(1) << (last - first) / 1000.0
+         << " ms from first to last span, " << threadIndices.size() << " threads) ===\n";
+    cout << left << setw(48) << "asset / stage" << right << setw(8) << "calls" << setw(12) << "ms" << "\n";
+    for (const auto &asset : byTimeDescending(assetTotals))
+    {
+        cout << left << setw(48) << shortName(asset.first, 48) << right << setw(8) << asset.second.calls
+             << setw(12) << asset.second.us / 1000.0 << "\n";
+
+        // Stage times are inclusive, so nested stages also count in the
+        // stage around them.
+        map<string, StageTotal> stages;
+        for (const auto &entry : assetStages)
+        {
+            if (entry.first.first == asset.first)
+                stages[entry.first.second] = entry.second;
+        }
+        int shown = 0;
+        for (const auto &stage : byTimeDescending(stages))
+        {
+            if (shown++ == STAGES_PER_ASSET)
+                break;
+            cout << "  " << left << setw(46) << shortName(stage.first, 46) << right << setw(8)
+                 << stage.second.calls << setw(12) << stage.second.us / 1000.0 << "\n";
+        }
+    }
+
+    cout << "\n"
+         << left << setw(48) << "stage (all assets)" << right << setw(8) << "calls" << setw(12) << "ms" << "\n";
+    for (const auto &stage : byTimeDescending(stageTotals))
+    {
+        cout << left << setw(48) << shortName(stage.first, 48) << right << setw(8) << stage.second.calls
+             << setw(12) << stage.second.us / 1000.0 << "\n";
+    }
+    cout << defaultfloat << endl;
+}
+
+void printLoadLine(const string &line)
+{
+    lock_guard<mutex> lock(printMutex);
+    cout << line << '\n' << flush;
+}
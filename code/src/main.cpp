@@ -21,6 +21,20 @@
 #include "renderer.h"
 #include "animate.h"
 #include "scene_manager.h"
+#include "scene_manifest.h"
+#include "scene_snapshot.h"
+#include "mesh_cache.h"
+#include "gltf_loader.h"
+#include "asset_pack.h"
+#include "asset_prefetch.h"
+#include "asset_loader.h"
+#include "texture_cache.h"
+#include "texture_streaming.h"
+#include "texture_upload.h"
+#include "animation_clips.h"
+#include "model_render.h"
+#include "load_profiler.h"
+#include "alloc_counter.h"
 #include "glm_compat.h"
 
 using namespace std;
@@ -37,6 +51,19 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 int main() {
+    // Load stages are timed for the load profile and load_trace.json, both
+    // written once the scene has loaded; recording stops there, so models
+    // streamed in later cost nothing.
+    const bool profileLoads = true;
+    setLoadProfiling(profileLoads);
+
+    // The previous run's asset reads, in order, are handed to the OS as
+    // readahead before anything else starts, so the files are in the page
+    // cache by the time the loader threads open them.
+    const bool prefetchAssetReads = true;
+    if (prefetchAssetReads)
+        startAssetPrefetch(ASSET_READ_TRACE_PATH);
+
     if (!glfwInit())
         return -1;
 
@@ -75,6 +102,10 @@ int main() {
     gLastX = width / 2.0f;
     gLastY = height / 2.0f;
 
+    // Every asset below, shaders included, is read from the pack when one
+    // has been built and from loose files otherwise.
+    openAssetPack(ASSET_PACK_PATH);
+
     Skybox skybox;
     skybox.init("assets/shaders/skybox.vert", "assets/shaders/skybox.frag");
     GLuint terrainProgram = CompileShaders("assets/shaders/terrain.vert", "assets/shaders/terrain.frag");
@@ -92,6 +123,90 @@ int main() {
         return -1;
     }
 
+    // Imports skip vertex streams the mesh program never reads.
+    setUsedVertexAttributes(queryProgramVertexAttributes(meshProgram));
+
+    // Streaming starts rendering straight away and brings models in over the
+    // first frames, nearest and visible first; otherwise block until loaded.
+    const bool streamSceneLoads = true;
+    const double streamingUploadBudgetMs = 4.0;
+
+    // Material textures are decoded and uploaded the first time a mesh using
+    // them is drawn, a few milliseconds' worth per frame; until then the
+    // mesh shows a flat placeholder.
+    const bool lazyTextureLoads = true;
+    const double textureUploadBudgetMs = 2.0;
+    setLazyTextureLoading(lazyTextureLoads);
+
+    // Those uploads go through a ring of pixel buffers, a few megabytes a
+    // frame, and a texture is drawn only once its upload and mips have
+    // completed on the GPU, so a large image never stalls a frame.
+    const bool pixelBufferTextureUploads = true;
+    const size_t pixelBufferRingBytes = 16 << 20;
+    const size_t textureUploadBytesPerFrame = 4 << 20;
+    setPixelBufferUploads(pixelBufferTextureUploads, pixelBufferRingBytes, textureUploadBytesPerFrame);
+
+    // Textures desert_bake also wrote block-compressed (the terrain's sand)
+    // are uploaded from the DDS with their stored mips, at an eighth of the
+    // memory; without the file or driver support they are decoded as before.
+    const bool compressedTextures = true;
+    setCompressedTextureLoading(compressedTextures);
+
+    // Animation keyframes are decoded from the mesh cache when a clip is
+    // first played, and dropped again after this many seconds unplayed
+    // (0 keeps them).
+    const bool lazyAnimationClipLoads = true;
+    const double animationClipIdleSeconds = 60.0;
+    setLazyAnimationClips(lazyAnimationClipLoads);
+    setAnimationClipLogging(profileLoads);
+
+    // Seconds between per-frame LOD triangle reports, printed only with
+    // profileLoads on.
+    const float lodReportInterval = 5.0f;
+
+    // glTF models are read natively. GLTF_IMPORT_COMPARE also imports each
+    // one with Assimp on a cold load and reports both times.
+    const GltfImporter gltfModelImporter = GLTF_IMPORT_NATIVE;
+    setGltfImporter(gltfModelImporter);
+
+    setupScene(meshProgram);
+
+    // Models load and unload by ground cell as the camera moves: cells within
+    // the load radius come in, cells beyond the unload radius are released,
+    // and the gap between the two keeps a cell from flickering at the edge.
+    // A cell size of 0 keeps every model loaded.
+    const float zoneCellSize = 100.0f;
+    const float zoneLoadRadius = 350.0f;
+    const float zoneUnloadRadius = 450.0f;
+    setSceneZoneStreaming(zoneCellSize, zoneLoadRadius, zoneUnloadRadius);
+
+    // The scene is described by its manifest: every model, where it stands
+    // and what it plays. All of it is queued here, before the terrain is
+    // built, so the imports run while the heightfield is generated.
+    SceneManifest sceneManifest;
+    if (!loadSceneManifest(SCENE_MANIFEST_PATH, sceneManifest))
+    {
+        return -1;
+    }
+    addSceneManifest(sceneManifest);
+
+    // A snapshot saved with F5 is resumed on the next launch: camera, clocks,
+    // model placement and animation state come back as they were, and the
+    // models themselves load through the mesh cache as usual.
+    const bool resumeSceneSnapshot = true;
+    SceneSnapshot resumedSnapshot;
+    const bool resumingSnapshot = resumeSceneSnapshot &&
+                                  readSceneSnapshot(SCENE_SNAPSHOT_PATH, sceneManifest, resumedSnapshot);
+    if (resumingSnapshot)
+    {
+        camera.position = resumedSnapshot.cameraPosition;
+        camera.Yaw = resumedSnapshot.cameraYaw;
+        camera.Pitch = resumedSnapshot.cameraPitch;
+        camera.zoom = resumedSnapshot.cameraZoom;
+        camera.updateCameraVectors();
+    }
+    startSceneZones(camera.position);
+
     TerrainManager terrainManager;
     if (!terrainManager.initialize(256, 1000.0f, 50.0f,
                                     "assets/textures/dune_heightmap-1.jpg",
@@ -109,152 +224,46 @@ int main() {
         return terrainManager.getHeightAt(x, z);
     };
 
-    setupScene(meshProgram);
+    // Ground placements wait for the heightfield and are resolved together.
+    placeSceneManifest(sceneManifest, sampleH);
+    if (resumingSnapshot)
+    {
+        restoreSceneSnapshot(resumedSnapshot);
+    }
+
+    const SceneInstance *leviathanInstance = findSceneInstance(sceneManifest, "leviathan");
+    const SceneInstance *ship1Instance = findSceneInstance(sceneManifest, "whaleTransport");
+    const SceneInstance *ship2Instance = findSceneInstance(sceneManifest, "torrent");
+
+    auto printLoadReports = []()
+    {
+        printMeshCacheReport();
+        printGltfImportReport();
+        printAssetPackReport();
+        writeAssetReadTrace(ASSET_READ_TRACE_PATH);
+        printAssetPrefetchReport();
+        printAssetRegistryReport();
+        printVertexMemoryReport();
+        printResidencyReport();
+        printSceneZoneReport();
+        printAnimationMemoryReport();
+        printTextureCacheReport();
+        printTextureStreamingReport();
+        printPixelBufferUploadReport();
+        printLoadTimeline();
+        printLoadAllocationReport();
+        printLoadProfile();
+        if (loadProfiling())
+            writeLoadTrace("load_trace.json");
+        setLoadProfiling(false);
+    };
+
+    if (!streamSceneLoads)
+    {
+        finishSceneLoads();
+        printLoadReports();
+    }
 
-    // Add Hierarchical Meshes
-    addHierarchicalMesh("assets/models/ice-worm/source/AnimatedWorm/AnimatedWorm.fbx"); // 0
-    addHierarchicalMesh("assets/models/gas_mask/scene.gltf"); // 1
-    addHierarchicalMesh("assets/models/gas_mask/scene.gltf"); // 2
-    addHierarchicalMesh("assets/models/gas_mask/scene.gltf"); // 3
-    addHierarchicalMesh("assets/models/gas_mask/scene.gltf"); // 4
-    addHierarchicalMesh("assets/models/gas_mask/scene.gltf"); // 5
-    addHierarchicalMesh("assets/models/gas_mask/scene.gltf"); // 6
-    addHierarchicalMesh("assets/models/gas_mask/scene.gltf"); // 7
-    addHierarchicalMesh("assets/models/gas_mask/scene.gltf"); // 8
-    addHierarchicalMesh("assets/models/mechanical_girl.glb"); // 9
-    addHierarchicalMesh("assets/models/worm_monster/scene.gltf"); // 10
-    addHierarchicalMesh("assets/models/worm_monster/scene.gltf"); // 11
-    addHierarchicalMesh("assets/models/worm_monster/scene.gltf"); // 12
-    addHierarchicalMesh("assets/models/worm_monster/scene.gltf"); // 13
-    addHierarchicalMesh("assets/models/worm_monster/scene.gltf"); // 14
-
-    // Set fighter moving around small worms
-    setOrbitalMotion(10, 1);
-    setOrbitalMotion(11, 3);
-    setOrbitalMotion(12, 4);
-    setOrbitalMotion(13, 7);
-    setOrbitalMotion(14, 9);
-
-    // Add regular meshes
-    addMesh("assets/models/ruined_city.glb");                                 // 0
-    addMesh("assets/models/cactus.glb");                                      // 1
-    addMesh("assets/models/cherry_tree.glb");                                 // 2
-    addMesh("assets/models/a_road_trip_in_2016_-_whale_class_transport.glb"); // 3
-    addMesh("assets/models/cactus.glb");                                      // 4
-    addMesh("assets/models/v-19_torrent_-_star_wars_-_clone_wars.glb");       // 5
-    addMesh("assets/models/ruined_city2.glb");                                // 6
-
-    // ZONE 1: City ruins cluster
-    float city1X = 0.0f;
-    float city1Z = 0.0f;
-    float city1Y = sampleH(city1X, city1Z);
-
-    float city2X = city1X - 25.0f;
-    float city2Z = city1Z - 10.0f;
-    float city2Y = sampleH(city2X, city2Z);
-
-    setMeshTransform(0, vec3(city1X, city1Y, city1Z), vec3(0, 45, 0), vec3(7, 7, 7));              // ruined_city - CENTER
-    setMeshTransform(6, vec3(city2X, city2Y, city2Z), vec3(0, -30, 0), vec3(6, 6, 6));             // ruined_skyscrapers
-    setMeshTransform(2, vec3(city1X, city1Y + 60.0f, city1Z), vec3(0, 0, 0), vec3(5, 5, 5), true); // cherry_tree floating over first city
-
-    // ZONE 2: Vegetation
-    setMeshTransform(1, vec3(city1X + 50.0f, sampleH(city1X + 50.0f, city1Z - 30.0f), city1Z - 30.0f), vec3(0, 0, 0), vec3(4, 4, 4));
-    setMeshTransform(4, vec3(city1X + 70.0f, sampleH(city1X + 50.0f, city1Z - 30.0f), city1Z - 30.0f), vec3(0, 0, 0), vec3(4, 4, 4));
-
-    // ZONE 3: Combat ships
-    float wormBurrowX = city1X + 120.0f;
-    float wormBurrowZ = city1Z + 90.0f;
-
-    // Ship 1 - whale transport
-    float ship1X = city1X + 100.0f;
-    float ship1Z = city1Z + 35.0f;
-    vec3 toBurrow1 = vec3(wormBurrowX - ship1X, 0.0f, wormBurrowZ - ship1Z);
-    float yaw1 = atan2(toBurrow1.x, toBurrow1.z) * 180.0f / 3.14159f;
-    setMeshTransform(3, vec3(ship1X, sampleH(ship1X, ship1Z) + 30.0f, ship1Z), vec3(-10, yaw1, 0), vec3(4, 4, 4), true); // whale transport
-
-    // Ship 2 - torrent
-    float ship2X = city1X + 50.0f;
-    float ship2Z = city1Z + 5.0f;
-    vec3 toBurrow2 = vec3(wormBurrowX - ship2X, 0.0f, wormBurrowZ - ship2Z);
-    float yaw2 = atan2(toBurrow2.x, toBurrow2.z) * 180.0f / 3.14159f;
-    setMeshTransform(5, vec3(ship2X, sampleH(ship2X, ship2Z) + 20.0f, ship2Z), vec3(-8, yaw2, 0), vec3(3, 3, 3), true); // torrent
-
-    float degree_x = 90;
-    float degree_y = 0;
-    float degree_z = 90;
-
-    // Mother Worm
-    setHierarchicalMeshTransform(0,
-                                    vec3(wormBurrowX - 20.0f, sampleH(wormBurrowX - 20.0f, wormBurrowZ) + 0.5f, wormBurrowZ),
-                                    vec3(degree_x, degree_y, degree_z), vec3(0.025f, 0.025f, 0.025f), true);
-    setHierarchicalActiveAnimation(0, 8);
-
-    // Fighter & Worm Pairs
-    float pair1BaseX = city1X + 50.0f;
-    float pair1BaseZ = city1Z + 50.0f;
-    setHierarchicalMeshTransform(1,
-                                    vec3(pair1BaseX + 5.0f, sampleH(pair1BaseX + 5.0f, pair1BaseZ) + 0.5f, pair1BaseZ),
-                                    vec3(-90, 0, 0), vec3(20.0f, 20.0f, 20.0f), true);
-    setHierarchicalActiveAnimation(1, 1);
-    setHierarchicalMeshTransform(10,
-                                    vec3(pair1BaseX, sampleH(pair1BaseX, pair1BaseZ) + 0.5f, pair1BaseZ),
-                                    vec3(degree_x, degree_y, degree_z), vec3(5.0f, 5.0f, 5.0f), true);
-    setHierarchicalActiveAnimation(10, 2);
-
-    float pair2BaseX = city1X + 80.0f;
-    float pair2BaseZ = city1Z + 60.0f;
-    setHierarchicalMeshTransform(3,
-                                    vec3(pair2BaseX + 5.0f, sampleH(pair2BaseX + 5.0f, pair2BaseZ) + 0.5f, pair2BaseZ),
-                                    vec3(-90, 0, 0), vec3(20.0f, 20.0f, 20.0f), true);
-    setHierarchicalActiveAnimation(3, 1);
-    setHierarchicalMeshTransform(11,
-                                    vec3(pair2BaseX, sampleH(pair2BaseX, pair2BaseZ) + 0.5f, pair2BaseZ),
-                                    vec3(degree_x, degree_y, degree_z), vec3(5.0f, 5.0f, 5.0f), true);
-    setHierarchicalActiveAnimation(11, 5);
-
-    float pair3BaseX = city1X + 100.0f;
-    float pair3BaseZ = city1Z + 270.0f;
-    setHierarchicalMeshTransform(4,
-                                    vec3(pair3BaseX + 5.0f, sampleH(pair3BaseX + 5.0f, pair3BaseZ) + 0.5f, pair3BaseZ),
-                                    vec3(-90, 0, 0), vec3(20.0f, 20.0f, 20.0f), true);
-    setHierarchicalActiveAnimation(4, 1);
-    setHierarchicalMeshTransform(12,
-                                    vec3(pair3BaseX, sampleH(pair3BaseX, pair3BaseZ) + 0.5f, pair3BaseZ),
-                                    vec3(degree_x, degree_y, degree_z), vec3(5.0f, 5.0f, 5.0f), true);
-    setHierarchicalActiveAnimation(12, 1);
-
-    float pair4BaseX = city1X + 130.0f;
-    float pair4BaseZ = city1Z + 300.0f;
-    setHierarchicalMeshTransform(7,
-                                    vec3(pair4BaseX + 5.0f, sampleH(pair4BaseX + 5.0f, pair4BaseZ) + 0.5f, pair4BaseZ),
-                                    vec3(-90, 0, 0), vec3(20.0f, 20.0f, 20.0f), true);
-    setHierarchicalActiveAnimation(7, 2);
-    setHierarchicalMeshTransform(13,
-                                    vec3(pair4BaseX, sampleH(pair4BaseX, pair4BaseZ) + 0.5f, pair4BaseZ),
-                                    vec3(degree_x, degree_y, degree_z), vec3(5.0f, 5.0f, 5.0f), true);
-    setHierarchicalActiveAnimation(13, 2);
-
-    float pair5BaseX = city1X + 150.0f;
-    float pair5BaseZ = city1Z + 150.0f;
-    setHierarchicalMeshTransform(9,
-                                    vec3(pair5BaseX + 5.0f, sampleH(pair5BaseX + 5.0f, pair5BaseZ) + 0.5f, pair5BaseZ),
-                                    vec3(-90, 0, 0), vec3(200.0f, 200.0f, 200.0f), true);
-    setHierarchicalActiveAnimation(9, 3);
-    setHierarchicalMeshTransform(14, // Worm 14 (child - will orbit Fighter 9)
-                                    vec3(pair5BaseX, sampleH(pair5BaseX, pair5BaseZ) + 0.5f, pair5BaseZ),
-                                    vec3(degree_x, degree_y, degree_z), vec3(2.0f, 2.0f, 2.0f), true);
-    setHierarchicalActiveAnimation(14, 2);
-
-    // Additional random worms
-    setHierarchicalMeshTransform(2,
-                                    vec3(city1X - 150.0f, sampleH(city1X + 30.0f, city1Z + 40.0f) + 0.5f, city1Z + 40.0f),
-                                    vec3(-90, 0, 0), vec3(20.0f, 20.0f, 20.0f), true);
-    setHierarchicalActiveAnimation(2, 6);
-
-    setHierarchicalMeshTransform(5,
-                                    vec3(city1X - 120.0f, sampleH(city1X + 60.0f, city1Z + 80.0f) + 0.5f, city1Z + 80.0f),
-                                    vec3(-90, 0, 0), vec3(20.0f, 20.0f, 20.0f), true);
-    setHierarchicalActiveAnimation(5, 5);
 
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
@@ -276,6 +285,25 @@ int main() {
     static bool togglePointLightsKeyPressed = false;
     static bool toggleSpotLightsKeyPressed = false;
 
+    static float leviathanSpawnTime = 0.0f;
+    static bool leviathanHasSpawned = false;
+    static float ship1OrbitAngle = 0.0f;
+    static float lightTime = 0.0f;
+
+    if (resumingSnapshot)
+    {
+        timeOfDay = resumedSnapshot.timeOfDay;
+        targetTimeOfDay = resumedSnapshot.targetTimeOfDay;
+        startTimeOfDay = resumedSnapshot.startTimeOfDay;
+        transitionProgress = resumedSnapshot.dayNightProgress;
+        isTransitioning = resumedSnapshot.dayNightTransitioning;
+        pointLightsEnabled = resumedSnapshot.pointLightsEnabled;
+        spotLightsEnabled = resumedSnapshot.spotLightsEnabled;
+        lightTime = resumedSnapshot.lightTime;
+        leviathanSpawnTime = resumedSnapshot.leviathanSpawnTime;
+        leviathanHasSpawned = resumedSnapshot.leviathanSpawned;
+        ship1OrbitAngle = resumedSnapshot.shipOrbitAngle;
+    }
 
     while (!glfwWindowShouldClose(window))
     {
@@ -339,6 +367,64 @@ int main() {
             toggleSpotLightsKeyPressed = false;
         }
 
+        // '[' and ']' trade mesh detail for speed
+        static bool lodBiasKeyPressed = false;
+        int lodBiasStep = 0;
+        if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+            lodBiasStep = 1;
+        else if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+            lodBiasStep = -1;
+
+        if (lodBiasStep != 0)
+        {
+            if (!lodBiasKeyPressed)
+            {
+                setLodBias(getLodBias() + 0.5f * lodBiasStep);
+                if (profileLoads)
+                    cout << "LOD bias " << getLodBias() << endl;
+                lodBiasKeyPressed = true;
+            }
+        }
+        else
+        {
+            lodBiasKeyPressed = false;
+        }
+
+        // F5 saves the running scene for the next launch to resume from.
+        static bool snapshotKeyPressed = false;
+        if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS)
+        {
+            if (!snapshotKeyPressed)
+            {
+                SceneSnapshot snapshot;
+                captureSceneSnapshot(sceneManifest, snapshot);
+                snapshot.cameraPosition = camera.position;
+                snapshot.cameraYaw = camera.Yaw;
+                snapshot.cameraPitch = camera.Pitch;
+                snapshot.cameraZoom = camera.zoom;
+                snapshot.timeOfDay = timeOfDay;
+                snapshot.targetTimeOfDay = targetTimeOfDay;
+                snapshot.startTimeOfDay = startTimeOfDay;
+                snapshot.dayNightProgress = transitionProgress;
+                snapshot.dayNightTransitioning = isTransitioning;
+                snapshot.pointLightsEnabled = pointLightsEnabled;
+                snapshot.spotLightsEnabled = spotLightsEnabled;
+                snapshot.lightTime = lightTime;
+                snapshot.leviathanSpawnTime = leviathanSpawnTime;
+                snapshot.leviathanSpawned = leviathanHasSpawned;
+                snapshot.shipOrbitAngle = ship1OrbitAngle;
+                if (writeSceneSnapshot(SCENE_SNAPSHOT_PATH, snapshot))
+                {
+                    cout << "Scene snapshot saved to " << SCENE_SNAPSHOT_PATH << endl;
+                }
+                snapshotKeyPressed = true;
+            }
+        }
+        else
+        {
+            snapshotKeyPressed = false;
+        }
+
         if (isTransitioning)
         {
             transitionProgress += deltaTime / transitionDuration;
@@ -419,14 +505,17 @@ int main() {
         mat4 view = lookAt(viewPosition, target, camera.up);
         mat4 proj = perspective(glm::radians(camera.zoom), (float)fbWidth / (float)fbHeight, 0.1f, 5000.0f);
 
+        // Zones keep running after a blocking load.
+        if (updateSceneStreaming(camera.position, proj * view, streamingUploadBudgetMs))
+        {
+            printLoadReports();
+        }
+        pumpTextureUploads(textureUploadBudgetMs);
 
         skybox.render(view, proj);
 
-        if (!hierarchicalModels.empty() && hierarchicalModels.size() > 0)
+        if (leviathanInstance)
         {
-            static float leviathanSpawnTime = 0.0f;
-            static bool leviathanHasSpawned = false;
-
             float spawnDelay = 2.0f;
             float burrowDuration = 3.0f;
 
@@ -434,11 +523,11 @@ int main() {
 
             if (leviathanSpawnTime >= spawnDelay && !leviathanHasSpawned)
             {
-                HierarchicalModel &leviathan = hierarchicalModels[0];
+                HierarchicalModel &leviathan = hierarchicalModels[leviathanInstance->index];
 
-                float finalX = wormBurrowX - 20.0f;
-                float finalZ = wormBurrowZ;
-                float finalY = sampleH(finalX, finalZ) + 0.5f;
+                float finalX = leviathanInstance->worldPosition.x;
+                float finalZ = leviathanInstance->worldPosition.z;
+                float finalY = leviathanInstance->worldPosition.y;
 
                 float startY = finalY - 15.0f;
 
@@ -458,17 +547,20 @@ int main() {
             }
         }
 
+        // Without a leviathan the ships stay where the manifest puts them.
+        vec3 leviathanPos = leviathanInstance ? hierarchicalModels[leviathanInstance->index].worldPosition
+                                              : vec3(0.0f, 0.0f, 0.0f);
+        vec3 ship1Pos = ship1Instance ? ship1Instance->worldPosition : vec3(100.0f, 30.0f, 35.0f);
+        vec3 ship2Pos = ship2Instance ? ship2Instance->worldPosition : vec3(50.0f, 20.0f, -10.0f);
+
         // Update ship positions to hover over leviathan
-        if (!hierarchicalModels.empty() && hierarchicalModels.size() > 0)
+        if (leviathanInstance && ship1Instance && ship2Instance)
         {
-
-            vec3 leviathanPos = hierarchicalModels[0].worldPosition;
             float leviathanHeight = 10.0f;
 
             float hoverRadius = 40.0f;
             float hoverHeight = leviathanPos.y + leviathanHeight + 25.0f;
 
-            static float ship1OrbitAngle = 0.0f;
             ship1OrbitAngle += deltaTime * 0.2f;
             vec3 ship1HoverPos = vec3(
                 leviathanPos.x + cos(ship1OrbitAngle) * hoverRadius,
@@ -486,17 +578,49 @@ int main() {
             float yaw1 = atan2(toLeviathan1.x, toLeviathan1.z) * 180.0f / 3.14159f;
             float yaw2 = atan2(toLeviathan2.x, toLeviathan2.z) * 180.0f / 3.14159f;
 
-            setMeshTransform(3, ship1HoverPos, vec3(-10, yaw1, 0), vec3(4, 4, 4), true); // Ship 1
-            setMeshTransform(5, ship2HoverPos, vec3(-8, yaw2, 0), vec3(3, 3, 3), true);  // Ship 2
+            setMeshTransform(ship1Instance->index, ship1HoverPos, vec3(ship1Instance->rotation.x, yaw1, 0),
+                             ship1Instance->scale, true);
+            setMeshTransform(ship2Instance->index, ship2HoverPos, vec3(ship2Instance->rotation.x, yaw2, 0),
+                             ship2Instance->scale, true);
+            ship1Pos = ship1HoverPos;
+            ship2Pos = ship2HoverPos;
         }
 
+        beginLodFrame();
         renderScene(deltaTime, view, proj, meshProgram, camera.position, timeOfDay);
 
-        static float lightTime = 0.0f;
         lightTime += deltaTime;
-        updateDynamicLights(meshProgram, lightTime, camera.position, pointLightsEnabled, spotLightsEnabled);
+        updateDynamicLights(meshProgram, lightTime, camera.position, leviathanPos, ship1Pos, ship2Pos,
+                            pointLightsEnabled, spotLightsEnabled);
 
         renderHierarchicalMeshes(deltaTime, view, proj, meshProgram, camera.position, timeOfDay);
+        if (animationClipIdleSeconds > 0.0)
+        {
+            evictIdleAssetAnimations(animationClipIdleSeconds);
+        }
+
+        static float lodReportTimer = 0.0f;
+        lodReportTimer += deltaTime;
+        if (profileLoads && lodReportTimer >= lodReportInterval)
+        {
+            lodReportTimer = 0.0f;
+            const LodFrameStats &lod = getLodFrameStats();
+            cout << "LOD: " << lod.trianglesDrawn << " of " << lod.trianglesFullDetail << " triangles in "
+                 << lod.draws << " draws, per level";
+            for (int level = 0; level < MeshInstance::MAX_LODS; level++)
+            {
+                cout << (level == 0 ? " " : "/") << lod.drawsPerLevel[level];
+            }
+            if (lod.clustersTested > 0)
+            {
+                cout << ", " << lod.clustersDrawn << " of " << lod.clustersTested << " clusters";
+            }
+            if (lod.meshesCulled > 0)
+            {
+                cout << ", " << lod.meshesCulled << " meshes culled";
+            }
+            cout << endl;
+        }
 
         mat4 model = identity_mat4();
         terrainManager.render(terrainProgram, model, view, proj, camera.position, timeOfDay, 0.000016f);
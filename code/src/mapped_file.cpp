@@ -0,0 +1,87 @@
+#include "mapped_file.h"
+
+#include <cstdio>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile()
+    : bytes(nullptr), length(0), mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *path)
+{
+    close();
+    if (!path)
+        return false;
+
+#if !defined(_WIN32)
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    bytes = static_cast<const unsigned char *>(view);
+    length = static_cast<size_t>(st.st_size);
+    mapped = true;
+    return true;
+#else
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0)
+    {
+        fclose(file);
+        return false;
+    }
+    fallback.resize(static_cast<size_t>(size));
+    size_t got = fread(fallback.data(), 1, fallback.size(), file);
+    fclose(file);
+    if (got != fallback.size())
+    {
+        fallback.clear();
+        return false;
+    }
+    bytes = fallback.data();
+    length = fallback.size();
+    return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#if !defined(_WIN32)
+    if (mapped && bytes)
+        munmap(const_cast<unsigned char *>(bytes), length);
+#endif
+    fallback.clear();
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+}
@@ -0,0 +1,54 @@
+#include "process_memory.h"
+
+#include <cstdio>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+size_t currentResidentBytes()
+{
+#if defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return static_cast<size_t>(info.resident_size);
+#elif defined(__linux__)
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file)
+        return 0;
+
+    long pages = 0;
+    long residentPages = 0;
+    int read = fscanf(file, "%ld %ld", &pages, &residentPages);
+    fclose(file);
+    if (read != 2)
+        return 0;
+    return static_cast<size_t>(residentPages) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+size_t peakResidentBytes()
+{
+#if !defined(_WIN32)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    // Bytes on macOS, kilobytes everywhere else.
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
@@ -4,6 +4,7 @@
 
 #include "animate.h"
 #include "animator.h"
+#include "animation_clips.h"
 #include "mesh_loader.h"
 #include "glm_compat.h"
 #include "scene_manager.h"
@@ -67,7 +68,15 @@ void setHierarchicalActiveAnimation(int hierarchicalIndex, int animationIndex, f
 
     HierarchicalModel &hmodel = hierarchicalModels[hierarchicalIndex];
 
-    if (animationIndex < 0 || animationIndex >= (int)hmodel.animationClips.size())
+    // Still streaming in: remember the choice, it is applied once the
+    // model's clips are known.
+    if (!hmodel.asset)
+    {
+        hmodel.activeAnimation = animationIndex;
+        return;
+    }
+
+    if (!requireAnimationClip(*hmodel.asset, animationIndex))
         return;
 
     // Use animator if available, otherwise fall back to direct setting
@@ -0,0 +1,95 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "animation_clips.h"
+#include "mesh_cache.h"
+
+using namespace std;
+
+namespace
+{
+    bool lazyClips = false;
+    bool logClips = false;
+
+    double msSince(chrono::steady_clock::time_point from)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - from).count();
+    }
+}
+
+void setLazyAnimationClips(bool enabled)
+{
+    lazyClips = enabled;
+}
+
+bool lazyAnimationClips()
+{
+    return lazyClips;
+}
+
+void setAnimationClipLogging(bool enabled)
+{
+    logClips = enabled;
+}
+
+bool requireAnimationClip(ModelAsset &asset, int index)
+{
+    if (index < 0 || index >= static_cast<int>(asset.animationClips.size()))
+        return false;
+
+    Animation &clip = asset.animationClips[index];
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (!clip.resident)
+    {
+        if (!readMeshCacheClip(asset.clipSource, clip))
+        {
+            cerr << "[anim] " << asset.path << ": cannot read clip " << index << " ('" << clip.name
+                 << "') from '" << asset.clipSource << "'" << endl;
+            return false;
+        }
+        clip.resident = true;
+        if (logClips)
+            cout << "[anim] " << asset.path << ": decoded clip " << index << " ('" << clip.name << "'), "
+                 << fixed << setprecision(1) << animationClipBytes(clip) / 1024.0 << " KB in "
+                 << msSince(now) << " ms" << defaultfloat << endl;
+    }
+    clip.lastUsed = now;
+    return true;
+}
+
+size_t evictIdleAnimationClips(ModelAsset &asset, double idleSeconds)
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    size_t freed = 0;
+    for (Animation &clip : asset.animationClips)
+    {
+        // Cold-imported clips have no byte range to come back from.
+        if (!clip.resident || clip.sourceSize == 0 || asset.clipSource.empty())
+            continue;
+        if (chrono::duration<double>(now - clip.lastUsed).count() < idleSeconds)
+            continue;
+
+        size_t bytes = animationClipBytes(clip);
+        vector<NodeAnimation>().swap(clip.nodeAnimations);
+        clip.resident = false;
+        freed += bytes;
+        if (logClips)
+            cout << "[anim] " << asset.path << ": evicted idle clip '" << clip.name << "', "
+                 << fixed << setprecision(1) << bytes / 1024.0 << " KB" << defaultfloat << endl;
+    }
+    return freed;
+}
+
+size_t animationClipBytes(const Animation &clip)
+{
+    size_t bytes = clip.nodeAnimations.capacity() * sizeof(NodeAnimation);
+    for (const NodeAnimation &channel : clip.nodeAnimations)
+    {
+        bytes += channel.nodeName.capacity();
+        bytes += channel.positionKeys.capacity() * sizeof(VectorKey);
+        bytes += channel.rotationKeys.capacity() * sizeof(QuaternionKey);
+        bytes += channel.scaleKeys.capacity() * sizeof(VectorKey);
+    }
+    return bytes;
+}
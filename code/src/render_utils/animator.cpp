@@ -7,6 +7,7 @@
 #include "transform_utils.h"
 #include "glm_compat.h"
 #include "mesh_loader.h"
+#include "animation_clips.h"
 
 using namespace glm;
 using namespace std;
@@ -14,22 +15,21 @@ using namespace std;
 Animator::Animator(HierarchicalModel *hmodel)
     : model(hmodel), currentAnimationIndex(-1), nextAnimationIndex(-1), queueAnimationIndex(-1), currentTime(0.0f), interpolating(false), haltTime(0.0f), interTime(0.0f), speedMultiplier(1.0f)
 {
-    if (model && !model->meshes.empty())
+    if (model && model->asset && !model->asset->meshes.empty())
     {
-        finalBoneMatricesPerMesh.resize(model->meshes.size());
-        for (size_t i = 0; i < model->meshes.size(); i++)
+        finalBoneMatricesPerMesh.resize(model->asset->meshes.size());
+        for (size_t i = 0; i < model->asset->meshes.size(); i++)
         {
-            if (model->meshes[i].hasBones)
+            if (model->asset->meshes[i].hasBones)
             {
                 finalBoneMatricesPerMesh[i].resize(
-                    model->meshes[i].boneMatrices.size(),
+                    model->asset->meshes[i].boneMatrices.size(),
                     mat4(1.0f));
             }
         }
 
         if (model->hasEmbeddedAnimation &&
-            model->activeAnimation >= 0 &&
-            model->activeAnimation < (int)model->animationClips.size())
+            requireAnimationClip(*model->asset, model->activeAnimation))
         {
             currentAnimationIndex = model->activeAnimation;
             currentTime = 0.0f;
@@ -39,13 +39,17 @@ Animator::Animator(HierarchicalModel *hmodel)
 
 void Animator::updateAnimation(float deltaTime)
 {
-    if (!model || currentAnimationIndex < 0 ||
-        currentAnimationIndex >= (int)model->animationClips.size())
+    // Marks the clips in use, and brings back any dropped while idle.
+    if (!model || !requireAnimationClip(*model->asset, currentAnimationIndex))
     {
         return;
     }
+    if (interpolating && !requireAnimationClip(*model->asset, nextAnimationIndex))
+    {
+        interpolating = false;
+    }
 
-    const Animation &currentAnim = model->animationClips[currentAnimationIndex];
+    const Animation &currentAnim = model->asset->animationClips[currentAnimationIndex];
     float ticksPerSecond = currentAnim.ticksPerSecond > 0.0f
                                ? currentAnim.ticksPerSecond
                                : 25.0f;
@@ -104,8 +108,7 @@ void Animator::updateAnimation(float deltaTime)
 
 void Animator::playAnimation(int animationIndex, bool repeat)
 {
-    if (!model || animationIndex < 0 ||
-        animationIndex >= (int)model->animationClips.size())
+    if (!model || !requireAnimationClip(*model->asset, animationIndex))
     {
         return;
     }
@@ -129,7 +132,7 @@ void Animator::playAnimation(int animationIndex, bool repeat)
         if (animationIndex != currentAnimationIndex)
         {
             interpolating = true;
-            haltTime = fmod(currentTime, model->animationClips[currentAnimationIndex].duration);
+            haltTime = fmod(currentTime, model->asset->animationClips[currentAnimationIndex].duration);
             nextAnimationIndex = animationIndex;
             currentTime = 0.0f;
             interTime = 0.0f;
@@ -139,8 +142,7 @@ void Animator::playAnimation(int animationIndex, bool repeat)
 
 void Animator::setActiveAnimation(int animationIndex)
 {
-    if (!model || animationIndex < 0 ||
-        animationIndex >= (int)model->animationClips.size())
+    if (!model || !requireAnimationClip(*model->asset, animationIndex))
     {
         return;
     }
@@ -161,7 +163,7 @@ void Animator::calculateBoneTransform(
     if (!node || !model || animationIndex < 0)
         return;
 
-    const Animation &anim = model->animationClips[animationIndex];
+    const Animation &anim = model->asset->animationClips[animationIndex];
     string nodeName = node->name;
 
     mat4 nodeTransform = node->localTransform;
@@ -219,8 +221,8 @@ void Animator::calculateBoneTransition(
     if (!node || !model || prevAnimationIndex < 0 || nextAnimationIndex < 0)
         return;
 
-    const Animation &prevAnim = model->animationClips[prevAnimationIndex];
-    const Animation &nextAnim = model->animationClips[nextAnimationIndex];
+    const Animation &prevAnim = model->asset->animationClips[prevAnimationIndex];
+    const Animation &nextAnim = model->asset->animationClips[nextAnimationIndex];
     string nodeName = node->name;
 
     mat4 nodeTransform = node->localTransform;
@@ -347,11 +349,11 @@ void Animator::buildFinalBoneMatrices()
     if (!model)
         return;
 
-    finalBoneMatricesPerMesh.resize(model->meshes.size());
+    finalBoneMatricesPerMesh.resize(model->asset->meshes.size());
 
-    for (size_t meshIdx = 0; meshIdx < model->meshes.size(); meshIdx++)
+    for (size_t meshIdx = 0; meshIdx < model->asset->meshes.size(); meshIdx++)
     {
-        MeshInstance &mesh = model->meshes[meshIdx];
+        MeshInstance &mesh = model->asset->meshes[meshIdx];
 
         if (!mesh.hasBones || mesh.boneMatrices.empty())
         {
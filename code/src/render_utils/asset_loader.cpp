@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "asset_loader.h"
+#include "load_profiler.h"
+
+using namespace std;
+
+namespace
+{
+    vector<thread> workers;
+    deque<shared_ptr<ImportJob>> importQueue;
+    deque<shared_ptr<ImportJob>> uploadQueue;
+    mutex queueMutex;
+    condition_variable importReady;
+    condition_variable uploadReady;
+    size_t outstanding = 0;
+    bool stopping = false;
+
+    // Finished jobs, kept for the timeline. Only touched on the GL thread.
+    vector<shared_ptr<ImportJob>> history;
+
+    double msBetween(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to)
+    {
+        return chrono::duration<double, milli>(to - from).count();
+    }
+
+    void workerLoop(int index)
+    {
+        for (;;)
+        {
+            shared_ptr<ImportJob> job;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                importReady.wait(lock, [] { return stopping || !importQueue.empty(); });
+                if (stopping && importQueue.empty())
+                    return;
+                // Queues are short, so a scan for the most urgent job is
+                // cheaper than keeping a heap in step with reprioritisation.
+                auto best = importQueue.begin();
+                for (auto it = importQueue.begin(); it != importQueue.end(); ++it)
+                {
+                    if ((*it)->priority < (*best)->priority)
+                        best = it;
+                }
+                job = *best;
+                importQueue.erase(best);
+            }
+
+            job->worker = index;
+            job->importStart = chrono::steady_clock::now();
+            if (job->hierarchical)
+            {
+                job->ok = import_mesh_hierarchical(job->path.c_str(), job->model);
+            }
+            else
+            {
+                job->ok = import_mesh(job->path.c_str(), job->meshes);
+            }
+            if (job->hierarchical && job->model.asset)
+            {
+                job->boundsMin = job->model.asset->boundsMin;
+                job->boundsMax = job->model.asset->boundsMax;
+            }
+            else
+            {
+                computeModelBounds(job->meshes, job->boundsMin, job->boundsMax);
+            }
+            job->importEnd = chrono::steady_clock::now();
+
+            {
+                lock_guard<mutex> lock(queueMutex);
+                uploadQueue.push_back(job);
+            }
+            uploadReady.notify_one();
+        }
+    }
+}
+
+void startAssetLoader(unsigned int workerCount)
+{
+    lock_guard<mutex> lock(queueMutex);
+    if (!workers.empty())
+        return;
+
+    if (workerCount == 0)
+    {
+        unsigned int cores = thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    stopping = false;
+    for (unsigned int i = 0; i < workerCount; i++)
+    {
+        workers.push_back(thread(workerLoop, static_cast<int>(i)));
+    }
+    cout << "Asset loader: " << workerCount << " worker threads" << endl;
+}
+
+void stopAssetLoader()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    importReady.notify_all();
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+
+    lock_guard<mutex> lock(queueMutex);
+    importQueue.clear();
+    uploadQueue.clear();
+    outstanding = 0;
+    stopping = false;
+}
+
+void submitImportJob(const shared_ptr<ImportJob> &job)
+{
+    startAssetLoader();
+
+    job->ok = false;
+    job->worker = -1;
+    job->queued = chrono::steady_clock::now();
+    {
+        lock_guard<mutex> lock(queueMutex);
+        importQueue.push_back(job);
+        outstanding++;
+    }
+    importReady.notify_one();
+}
+
+void setImportJobPriority(const shared_ptr<ImportJob> &job, float priority)
+{
+    lock_guard<mutex> lock(queueMutex);
+    job->priority = priority;
+}
+
+bool popImportedJob(shared_ptr<ImportJob> &job)
+{
+    lock_guard<mutex> lock(queueMutex);
+    if (uploadQueue.empty())
+        return false;
+
+    job = uploadQueue.front();
+    uploadQueue.pop_front();
+    outstanding--;
+    return true;
+}
+
+bool waitImportedJob(shared_ptr<ImportJob> &job)
+{
+    unique_lock<mutex> lock(queueMutex);
+    if (outstanding == 0)
+        return false;
+
+    uploadReady.wait(lock, [] { return !uploadQueue.empty(); });
+    job = uploadQueue.front();
+    uploadQueue.pop_front();
+    outstanding--;
+    return true;
+}
+
+void uploadImportedJob(ImportJob &job)
+{
+    ProfileScope scope("uploadImportedJob", job.path);
+    job.uploadStart = chrono::steady_clock::now();
+    job.cpuBytesReleased = 0;
+    if (job.ok)
+    {
+        if (job.hierarchical)
+        {
+            job.cpuBytesReleased = upload_mesh_hierarchical(job.model, job.keepCpuStreams);
+        }
+        else
+        {
+            job.cpuBytesReleased = upload_mesh(job.meshes, job.keepCpuStreams);
+        }
+    }
+    job.uploadEnd = chrono::steady_clock::now();
+
+    // Keep only the timings; the payload now belongs to the registry.
+    shared_ptr<ImportJob> record = make_shared<ImportJob>();
+    record->path = job.path;
+    record->hierarchical = job.hierarchical;
+    record->ok = job.ok;
+    record->worker = job.worker;
+    record->queued = job.queued;
+    record->importStart = job.importStart;
+    record->importEnd = job.importEnd;
+    record->uploadStart = job.uploadStart;
+    record->uploadEnd = job.uploadEnd;
+    history.push_back(record);
+}
+
+size_t outstandingImportJobs()
+{
+    lock_guard<mutex> lock(queueMutex);
+    return outstanding;
+}
+
+void printLoadTimeline()
+{
+    if (history.empty())
+        return;
+
+    const int columns = 48;
+
+    chrono::steady_clock::time_point begin = history.front()->queued;
+    chrono::steady_clock::time_point end = history.front()->uploadEnd;
+    double importMs = 0.0;
+    double uploadMs = 0.0;
+    for (const shared_ptr<ImportJob> &job : history)
+    {
+        begin = min(begin, job->queued);
+        end = max(end, job->uploadEnd);
+        importMs += msBetween(job->importStart, job->importEnd);
+        uploadMs += msBetween(job->uploadStart, job->uploadEnd);
+    }
+    double wallMs = max(msBetween(begin, end), 0.001);
+
+    cout << "\n=== Load timeline (" << workers.size() << " workers, "
+         << fixed << setprecision(1) << wallMs << " ms wall) ===\n";
+    cout << ". queued   # importing on a worker   - waiting for GL   U uploading\n";
+    for (const shared_ptr<ImportJob> &job : history)
+    {
+        string bar(columns, ' ');
+        for (int c = 0; c < columns; c++)
+        {
+            double t = (c + 0.5) * wallMs / columns;
+            if (t < msBetween(begin, job->queued) || t > msBetween(begin, job->uploadEnd))
+                continue;
+            if (t < msBetween(begin, job->importStart))
+                bar[c] = '.';
+            else if (t < msBetween(begin, job->importEnd))
+                bar[c] = '#';
+            else if (t < msBetween(begin, job->uploadStart))
+                bar[c] = '-';
+            else
+                bar[c] = 'U';
+        }
+
+        string name = job->path;
+        if (name.size() > 40)
+            name = "..." + name.substr(name.size() - 37);
+        cout << left << setw(40) << name << right << setw(3) << job->worker << " |" << bar << "| "
+             << setw(8) << msBetween(job->importStart, job->importEnd) << " ms import "
+             << setw(7) << msBetween(job->uploadStart, job->uploadEnd) << " ms upload"
+             << (job->ok ? "" : "  FAILED") << "\n";
+    }
+
+    cout << history.size() << " imports: " << importMs << " ms of import work and " << uploadMs
+         << " ms of uploads in " << wallMs << " ms (" << setprecision(2)
+         << (importMs + uploadMs) / wallMs << "x overlap)\n"
+         << defaultfloat << endl;
+}
@@ -0,0 +1,535 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <string>
+
+#include "asset_registry.h"
+#include "asset_loader.h"
+#include "animation_clips.h"
+#include "process_memory.h"
+
+using namespace std;
+
+namespace
+{
+    struct RegistryEntry
+    {
+        shared_ptr<ModelAsset> asset;
+        // Holds the hierarchical prototype. It stays in this heap block so
+        // the node pointers inside it remain valid.
+        shared_ptr<ImportJob> job;
+        bool hierarchical;
+        bool imported;
+        bool resident;
+        // Deliveries over the entry's life; every one after the first was
+        // served without a load. Live instances are the asset's refCount.
+        int requests;
+
+        vector<StaticAssetReady> staticWaiters;
+        vector<HierarchicalAssetReady> hierarchicalWaiters;
+    };
+
+    map<string, RegistryEntry> entries;
+
+    // Imported jobs waiting for their GL upload, most urgent first.
+    vector<shared_ptr<ImportJob>> awaitingUpload;
+
+    string registryKey(const char *filePath, bool hierarchical)
+    {
+        return string(hierarchical ? "H:" : "S:") + filePath;
+    }
+
+    size_t assetGpuBytes(const ModelAsset &asset)
+    {
+        size_t bytes = 0;
+        for (const MeshInstance &mesh : asset.meshes)
+        {
+            bytes += mesh.gpuBytes;
+        }
+        return bytes;
+    }
+}
+
+static RegistryEntry &findOrQueue(const char *filePath, bool hierarchical)
+{
+    string key = registryKey(filePath, hierarchical);
+    auto it = entries.find(key);
+    if (it != entries.end())
+        return it->second;
+
+    RegistryEntry &entry = entries[key];
+    entry.hierarchical = hierarchical;
+    entry.imported = false;
+    entry.resident = false;
+    entry.requests = 0;
+    entry.job = make_shared<ImportJob>();
+    entry.job->path = filePath;
+    entry.job->hierarchical = hierarchical;
+    entry.job->priority = 0.0f;
+    entry.job->keepCpuStreams = MESH_CPU_NONE;
+    entry.job->cpuBytesReleased = 0;
+    submitImportJob(entry.job);
+    return entry;
+}
+
+static void deliver(RegistryEntry &entry, const StaticAssetReady &onReady)
+{
+    entry.asset->refCount++;
+    entry.requests++;
+    onReady(entry.asset);
+}
+
+static void deliver(RegistryEntry &entry, const HierarchicalAssetReady &onReady)
+{
+    entry.asset->refCount++;
+    entry.requests++;
+    onReady(&entry.job->model);
+}
+
+void requestStaticAsset(const char *filePath, const StaticAssetReady &onReady)
+{
+    if (!filePath)
+    {
+        onReady(nullptr);
+        return;
+    }
+
+    RegistryEntry &entry = findOrQueue(filePath, false);
+    if (entry.resident)
+        deliver(entry, onReady);
+    else
+        entry.staticWaiters.push_back(onReady);
+}
+
+void requestHierarchicalAsset(const char *filePath, const HierarchicalAssetReady &onReady)
+{
+    if (!filePath)
+    {
+        onReady(nullptr);
+        return;
+    }
+
+    RegistryEntry &entry = findOrQueue(filePath, true);
+    if (entry.resident)
+        deliver(entry, onReady);
+    else
+        entry.hierarchicalWaiters.push_back(onReady);
+}
+
+static void completeJob(const shared_ptr<ImportJob> &job)
+{
+    uploadImportedJob(*job);
+
+    auto it = entries.find(registryKey(job->path.c_str(), job->hierarchical));
+    if (it == entries.end())
+        return;
+
+    RegistryEntry &entry = it->second;
+    vector<StaticAssetReady> staticWaiters;
+    vector<HierarchicalAssetReady> hierarchicalWaiters;
+    staticWaiters.swap(entry.staticWaiters);
+    hierarchicalWaiters.swap(entry.hierarchicalWaiters);
+
+    if (!job->ok)
+    {
+        cerr << "Asset registry: failed to load '" << job->path << "'" << endl;
+        entries.erase(it);
+        for (const StaticAssetReady &onReady : staticWaiters)
+            onReady(nullptr);
+        for (const HierarchicalAssetReady &onReady : hierarchicalWaiters)
+            onReady(nullptr);
+        return;
+    }
+
+    double loadMs = chrono::duration<double, milli>(job->importEnd - job->importStart).count() +
+                    chrono::duration<double, milli>(job->uploadEnd - job->uploadStart).count();
+    if (entry.hierarchical)
+    {
+        entry.asset = job->model.asset;
+    }
+    else
+    {
+        entry.asset = make_shared<ModelAsset>();
+        entry.asset->path = job->path;
+        entry.asset->meshes.swap(job->meshes);
+        entry.asset->refCount = 0;
+        entry.job.reset();
+    }
+    entry.asset->loadMs = loadMs;
+    entry.asset->keepCpuStreams = job->keepCpuStreams;
+    entry.asset->cpuBytesReleased = job->cpuBytesReleased;
+    entry.asset->boundsMin = job->boundsMin;
+    entry.asset->boundsMax = job->boundsMax;
+    entry.resident = true;
+
+    for (const StaticAssetReady &onReady : staticWaiters)
+        deliver(entry, onReady);
+    for (const HierarchicalAssetReady &onReady : hierarchicalWaiters)
+        deliver(entry, onReady);
+}
+
+static void collectImportedJobs()
+{
+    shared_ptr<ImportJob> job;
+    while (popImportedJob(job))
+    {
+        auto it = entries.find(registryKey(job->path.c_str(), job->hierarchical));
+        if (it != entries.end())
+            it->second.imported = true;
+        awaitingUpload.push_back(job);
+    }
+
+    stable_sort(awaitingUpload.begin(), awaitingUpload.end(),
+                [](const shared_ptr<ImportJob> &a, const shared_ptr<ImportJob> &b)
+                { return a->priority < b->priority; });
+}
+
+int pumpAssetUploads(double budgetMs)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    collectImportedJobs();
+
+    int uploaded = 0;
+    while (!awaitingUpload.empty())
+    {
+        shared_ptr<ImportJob> job = awaitingUpload.front();
+        awaitingUpload.erase(awaitingUpload.begin());
+        completeJob(job);
+        uploaded++;
+
+        double spentMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (budgetMs >= 0.0 && spentMs >= budgetMs)
+            break;
+    }
+    return uploaded;
+}
+
+void finishAssetLoads()
+{
+    shared_ptr<ImportJob> job;
+    while (waitImportedJob(job))
+    {
+        awaitingUpload.push_back(job);
+    }
+    pumpAssetUploads(-1.0);
+}
+
+bool pendingAssetLoads()
+{
+    return !awaitingUpload.empty() || outstandingImportJobs() > 0;
+}
+
+void setAssetPriority(const char *filePath, bool hierarchical, float priority)
+{
+    if (!filePath)
+        return;
+
+    auto it = entries.find(registryKey(filePath, hierarchical));
+    if (it == entries.end() || it->second.resident || !it->second.job)
+        return;
+
+    // Queued jobs are reordered for the workers; imported ones only change
+    // their place in the upload queue, which collectImportedJobs re-sorts.
+    if (it->second.imported)
+        it->second.job->priority = priority;
+    else
+        setImportJobPriority(it->second.job, priority);
+}
+
+bool getAssetBounds(const char *filePath, bool hierarchical, vec3 &boundsMin, vec3 &boundsMax)
+{
+    if (!filePath)
+        return false;
+
+    auto it = entries.find(registryKey(filePath, hierarchical));
+    if (it == entries.end())
+        return false;
+
+    const RegistryEntry &entry = it->second;
+    if (entry.resident && entry.asset)
+    {
+        boundsMin = entry.asset->boundsMin;
+        boundsMax = entry.asset->boundsMax;
+        return true;
+    }
+    if (entry.imported && entry.job && entry.job->ok)
+    {
+        boundsMin = entry.job->boundsMin;
+        boundsMax = entry.job->boundsMax;
+        return true;
+    }
+    return false;
+}
+
+bool retainAssetGeometry(const char *filePath, bool hierarchical, unsigned int streams)
+{
+    if (!filePath)
+        return false;
+
+    RegistryEntry &entry = findOrQueue(filePath, hierarchical);
+    if (entry.resident)
+    {
+        if ((entry.asset->keepCpuStreams & streams) == streams)
+            return true;
+        cerr << "Asset registry: '" << filePath << "' is already resident without the requested CPU geometry" << endl;
+        return false;
+    }
+
+    // Only the GL thread reads this, at upload time.
+    entry.job->keepCpuStreams |= streams;
+    return true;
+}
+
+MeshInstance shareMeshInstance(const MeshInstance &mesh)
+{
+    MeshInstance shared{};
+    shared.VAO = mesh.VAO;
+    shared.VBO = mesh.VBO;
+    shared.EBO = mesh.EBO;
+    shared.vertexLayout = mesh.vertexLayout;
+    shared.vertexCount = mesh.vertexCount;
+    shared.indexType = mesh.indexType;
+    shared.vertexBytes = mesh.vertexBytes;
+    shared.indexCount = mesh.indexCount;
+    shared.lods = mesh.lods;
+    shared.clusters = mesh.clusters;
+    shared.boundsMin = mesh.boundsMin;
+    shared.boundsMax = mesh.boundsMax;
+    shared.diffuseTexture = mesh.diffuseTexture;
+    shared.hasDiffuseTexture = mesh.hasDiffuseTexture;
+    shared.diffuseStream = mesh.diffuseStream;
+    shared.hasBones = mesh.hasBones;
+    shared.boneInfluences = mesh.boneInfluences;
+    shared.hasNormals = mesh.hasNormals;
+    shared.gpuBytes = mesh.gpuBytes;
+    shared.ready = mesh.ready;
+    return shared;
+}
+
+void releaseModelAsset(shared_ptr<ModelAsset> &asset)
+{
+    if (!asset)
+        return;
+
+    if (--asset->refCount <= 0)
+    {
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->second.asset == asset)
+            {
+                entries.erase(it);
+                break;
+            }
+        }
+        cleanupModelAsset(*asset);
+    }
+    asset.reset();
+}
+
+void printAssetRegistryReport()
+{
+    if (entries.empty())
+        return;
+
+    int totalInstances = 0;
+    int totalHits = 0;
+    size_t residentAssets = 0;
+    size_t residentBytes = 0;
+    size_t unsharedBytes = 0;
+    double loadMs = 0.0;
+    double savedMs = 0.0;
+
+    cout << "\n=== Asset registry ===\n";
+    cout << left << setw(64) << "asset" << right << setw(10) << "instances" << setw(10) << "hits"
+         << setw(12) << "GPU MB" << setw(12) << "saved MB" << "\n";
+    for (const auto &pair : entries)
+    {
+        const RegistryEntry &entry = pair.second;
+        if (!entry.resident)
+            continue;
+
+        // Memory is saved by the instances sharing it now, load time by every
+        // request the resident or loading asset served.
+        int instances = entry.asset->refCount;
+        int hits = entry.requests > 0 ? entry.requests - 1 : 0;
+        size_t bytes = assetGpuBytes(*entry.asset);
+        size_t saved = bytes * static_cast<size_t>(instances > 0 ? instances - 1 : 0);
+
+        cout << left << setw(64) << entry.asset->path << right << setw(10) << instances << setw(10) << hits
+             << fixed << setprecision(2) << setw(12) << bytes / (1024.0 * 1024.0)
+             << setw(12) << saved / (1024.0 * 1024.0) << "\n";
+
+        totalInstances += instances;
+        totalHits += hits;
+        residentAssets++;
+        residentBytes += bytes;
+        unsharedBytes += bytes + saved;
+        loadMs += entry.asset->loadMs;
+        savedMs += entry.asset->loadMs * hits;
+    }
+
+    cout << totalInstances << " instances share " << residentAssets << " loaded assets; "
+         << fixed << setprecision(2) << residentBytes / (1024.0 * 1024.0) << " MB resident instead of "
+         << unsharedBytes / (1024.0 * 1024.0) << " MB\n";
+    if (loadMs > 0.0)
+    {
+        cout << "load time " << setprecision(1) << loadMs << " ms, about " << savedMs
+             << " ms of duplicate loads avoided by " << totalHits << " shared requests\n";
+    }
+    cout << defaultfloat << endl;
+}
+
+void printVertexMemoryReport()
+{
+    size_t totalVertices = 0;
+    size_t totalLegacy = 0;
+    size_t totalPacked = 0;
+    size_t totalElided = 0;
+    size_t totalElidedStreams = 0;
+
+    // Elided uv and colour would have cost 4 bytes each per packed vertex,
+    // and 8 and 12 bytes per vertex of float streams during the import.
+    cout << "\n=== Vertex memory ===\n";
+    cout << left << setw(64) << "asset" << right << setw(10) << "vertices" << setw(8) << "B/vtx"
+         << setw(12) << "float MB" << setw(12) << "packed MB" << setw(8) << "ratio" << setw(12) << "elided MB"
+         << "\n";
+    for (const auto &pair : entries)
+    {
+        const RegistryEntry &entry = pair.second;
+        if (!entry.resident)
+            continue;
+
+        size_t vertices = 0;
+        size_t legacyBytes = 0;
+        size_t packedBytes = 0;
+        size_t elidedBytes = 0;
+        for (const MeshInstance &mesh : entry.asset->meshes)
+        {
+            vertices += mesh.vertexCount;
+            legacyBytes += mesh.vertexCount * legacyVertexSize(mesh.hasNormals, mesh.vertexLayout.skinned);
+            packedBytes += mesh.vertexBytes;
+            elidedBytes += mesh.vertexCount * elidedVertexSize(mesh.vertexLayout);
+            totalElidedStreams += mesh.vertexCount * ((mesh.vertexLayout.hasTexcoords ? 0 : sizeof(vec2)) +
+                                                      (mesh.vertexLayout.hasColors ? 0 : sizeof(vec3)));
+        }
+        if (vertices == 0)
+            continue;
+
+        cout << left << setw(64) << entry.asset->path << right << setw(10) << vertices
+             << fixed << setprecision(1) << setw(8) << static_cast<double>(packedBytes) / vertices
+             << setprecision(2) << setw(12) << legacyBytes / (1024.0 * 1024.0)
+             << setw(12) << packedBytes / (1024.0 * 1024.0)
+             << setw(7) << (packedBytes > 0 ? static_cast<double>(legacyBytes) / packedBytes : 0.0) << "x"
+             << setw(12) << elidedBytes / (1024.0 * 1024.0) << "\n";
+
+        totalVertices += vertices;
+        totalLegacy += legacyBytes;
+        totalPacked += packedBytes;
+        totalElided += elidedBytes;
+    }
+
+    cout << totalVertices << " vertices: " << fixed << setprecision(2) << totalLegacy / (1024.0 * 1024.0)
+         << " MB as separate float streams, " << totalPacked / (1024.0 * 1024.0) << " MB packed\n"
+         << "absent or unused uv/colour: " << totalElided / (1024.0 * 1024.0) << " MB left out of vertex buffers, "
+         << totalElidedStreams / (1024.0 * 1024.0) << " MB of float streams not built at import"
+         << defaultfloat << endl;
+}
+
+void printResidencyReport()
+{
+    size_t totalKept = 0;
+    size_t totalReleased = 0;
+
+    cout << "\n=== CPU geometry residency ===\n";
+    cout << left << setw(64) << "asset" << right << setw(8) << "keeps"
+         << setw(12) << "kept MB" << setw(12) << "freed MB" << "\n";
+    for (const auto &pair : entries)
+    {
+        const RegistryEntry &entry = pair.second;
+        if (!entry.resident)
+            continue;
+
+        size_t kept = 0;
+        for (const MeshInstance &mesh : entry.asset->meshes)
+        {
+            kept += meshCpuBytes(mesh);
+        }
+
+        unsigned int keep = entry.asset->keepCpuStreams;
+        string streams;
+        streams += (keep & MESH_CPU_POSITIONS) ? 'P' : '-';
+        streams += (keep & MESH_CPU_INDICES) ? 'I' : '-';
+        streams += (keep & MESH_CPU_ATTRIBUTES) ? 'A' : '-';
+        streams += (keep & MESH_CPU_SKIN) ? 'S' : '-';
+
+        cout << left << setw(64) << entry.asset->path << right << setw(8) << streams
+             << fixed << setprecision(2) << setw(12) << kept / (1024.0 * 1024.0)
+             << setw(12) << entry.asset->cpuBytesReleased / (1024.0 * 1024.0) << "\n";
+
+        totalKept += kept;
+        totalReleased += entry.asset->cpuBytesReleased;
+    }
+
+    cout << fixed << setprecision(2) << totalKept / (1024.0 * 1024.0) << " MB of CPU geometry kept, "
+         << totalReleased / (1024.0 * 1024.0) << " MB freed after upload\n";
+
+    size_t current = currentResidentBytes();
+    size_t peak = peakResidentBytes();
+    if (current > 0)
+    {
+        cout << "resident set " << current / (1024.0 * 1024.0) << " MB";
+        if (peak > 0)
+            cout << " (peak " << peak / (1024.0 * 1024.0) << " MB)";
+        cout << "\n";
+    }
+    cout << defaultfloat << endl;
+}
+
+void evictIdleAssetAnimations(double idleSeconds)
+{
+    for (auto &pair : entries)
+    {
+        RegistryEntry &entry = pair.second;
+        if (entry.resident && entry.hierarchical)
+            evictIdleAnimationClips(*entry.asset, idleSeconds);
+    }
+}
+
+void printAnimationMemoryReport()
+{
+    size_t totalClips = 0;
+    size_t totalResident = 0;
+    size_t totalBytes = 0;
+
+    cout << "\n=== Animation clips ===\n";
+    cout << left << setw(64) << "asset" << right << setw(8) << "clips" << setw(10) << "resident"
+         << setw(12) << "KB" << "\n";
+    for (const auto &pair : entries)
+    {
+        const RegistryEntry &entry = pair.second;
+        if (!entry.resident || !entry.hierarchical || entry.asset->animationClips.empty())
+            continue;
+
+        size_t resident = 0;
+        size_t bytes = 0;
+        for (const Animation &clip : entry.asset->animationClips)
+        {
+            if (!clip.resident)
+                continue;
+            resident++;
+            bytes += animationClipBytes(clip);
+        }
+
+        cout << left << setw(64) << entry.asset->path << right << setw(8) << entry.asset->animationClips.size()
+             << setw(10) << resident << fixed << setprecision(1) << setw(12) << bytes / 1024.0 << "\n";
+
+        totalClips += entry.asset->animationClips.size();
+        totalResident += resident;
+        totalBytes += bytes;
+    }
+
+    cout << totalResident << " of " << totalClips << " clips resident, " << fixed << setprecision(1)
+         << totalBytes / 1024.0 << " KB of keyframes" << defaultfloat << endl;
+}
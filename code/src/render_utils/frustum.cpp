@@ -0,0 +1,77 @@
+#include <cfloat>
+
+#include "frustum.h"
+
+using namespace glm;
+
+Frustum extractFrustum(const mat4 &viewProj)
+{
+    // glm is column-major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+    {
+        rows[i] = vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // left
+    frustum.planes[1] = rows[3] - rows[0]; // right
+    frustum.planes[2] = rows[3] + rows[1]; // bottom
+    frustum.planes[3] = rows[3] - rows[1]; // top
+    frustum.planes[4] = rows[3] + rows[2]; // near
+    frustum.planes[5] = rows[3] - rows[2]; // far
+
+    for (int i = 0; i < 6; i++)
+    {
+        float len = length(vec3(frustum.planes[i]));
+        if (len > 0.0f)
+        {
+            frustum.planes[i] /= len;
+        }
+    }
+    return frustum;
+}
+
+bool sphereInFrustum(const Frustum &frustum, const vec3 &center, float radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        const vec4 &p = frustum.planes[i];
+        if (dot(vec3(p), center) + p.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool boxInFrustum(const Frustum &frustum, const vec3 &boundsMin, const vec3 &boundsMax)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        const vec4 &p = frustum.planes[i];
+
+        // Corner furthest along the plane normal; if even that one is
+        // behind the plane the whole box is outside.
+        vec3 positive(p.x >= 0.0f ? boundsMax.x : boundsMin.x,
+                      p.y >= 0.0f ? boundsMax.y : boundsMin.y,
+                      p.z >= 0.0f ? boundsMax.z : boundsMin.z);
+        if (dot(vec3(p), positive) + p.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void transformBounds(const mat4 &transform, const vec3 &localMin, const vec3 &localMax,
+                     vec3 &worldMin, vec3 &worldMax)
+{
+    worldMin = vec3(FLT_MAX);
+    worldMax = vec3(-FLT_MAX);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        vec3 local((corner & 1) ? localMax.x : localMin.x,
+                   (corner & 2) ? localMax.y : localMin.y,
+                   (corner & 4) ? localMax.z : localMin.z);
+        vec3 world = vec3(transform * vec4(local, 1.0f));
+        worldMin = glm::min(worldMin, world);
+        worldMax = glm::max(worldMax, world);
+    }
+}
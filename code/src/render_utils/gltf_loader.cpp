@@ -0,0 +1,1547 @@
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include "gltf_loader.h"
+#include "json_reader.h"
+#include "asset_pack.h"
+#include "load_profiler.h"
+#include "glm_compat.h"
+
+using namespace glm;
+using namespace std;
+
+namespace
+{
+    const uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+    const uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+    const uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+    const int GLTF_BYTE = 5120;
+    const int GLTF_UNSIGNED_BYTE = 5121;
+    const int GLTF_SHORT = 5122;
+    const int GLTF_UNSIGNED_SHORT = 5123;
+    const int GLTF_UNSIGNED_INT = 5125;
+    const int GLTF_FLOAT = 5126;
+
+    const int GLTF_TRIANGLES = 4;
+    const int GLTF_TRIANGLE_STRIP = 5;
+    const int GLTF_TRIANGLE_FAN = 6;
+
+    // Required extensions the reader can ignore without changing the result.
+    const char *const SUPPORTED_EXTENSIONS[] = {
+        "KHR_materials_pbrSpecularGlossiness",
+        "KHR_materials_unlit",
+        "KHR_texture_transform",
+        "KHR_mesh_quantization"};
+
+    GltfImporter selectedImporter = GLTF_IMPORT_NATIVE;
+
+    struct ComparisonRecord
+    {
+        string path;
+        GltfImportSample native;
+        GltfImportSample assimp;
+    };
+
+    vector<ComparisonRecord> comparisons;
+    mutex comparisonsMutex;
+
+    struct BufferSpan
+    {
+        const unsigned char *data;
+        size_t size;
+    };
+
+    struct GltfDocument
+    {
+        string path;
+        string directory;
+        JsonValue json;
+        AssetFile file;
+        vector<unique_ptr<AssetFile>> sideFiles;
+        vector<vector<unsigned char>> dataUris;
+        vector<BufferSpan> buffers;
+    };
+
+    // A typed window onto one accessor's elements.
+    struct AccessorView
+    {
+        const unsigned char *data; // null when the accessor has no buffer view: all zeros
+        size_t count;
+        size_t stride;
+        int componentType;
+        int components;
+        bool normalized;
+    };
+
+    // One primitive as read from the file, before any node places it.
+    struct GltfPrimitive
+    {
+        MeshInstance mesh;
+        int material;
+        bool skipped;              // points and lines
+        SkinInfluences influences; // bone = joint slot in the node's skin
+    };
+
+    uint32_t readU32(const unsigned char *p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    size_t jsonSize(const JsonValue &value, size_t fallback = 0)
+    {
+        double n = value.asNumber(-1.0);
+        return n < 0.0 ? fallback : static_cast<size_t>(n);
+    }
+
+    string getDirectory(const string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        if (slash == string::npos)
+        {
+            return "";
+        }
+        return path.substr(0, slash + 1);
+    }
+
+    bool startsWith(const string &s, const char *prefix)
+    {
+        return s.compare(0, strlen(prefix), prefix) == 0;
+    }
+
+    string decodeUriPath(const string &uri)
+    {
+        string out;
+        out.reserve(uri.size());
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size() && isxdigit(uri[i + 1]) && isxdigit(uri[i + 2]))
+            {
+                out += static_cast<char>(strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+                i += 2;
+            }
+            else
+            {
+                out += uri[i];
+            }
+        }
+        return out;
+    }
+
+    bool decodeBase64(const char *text, size_t length, vector<unsigned char> &out)
+    {
+        out.clear();
+        out.reserve(length / 4 * 3);
+        uint32_t accumulator = 0;
+        int bits = 0;
+        for (size_t i = 0; i < length; i++)
+        {
+            char c = text[i];
+            int value;
+            if (c >= 'A' && c <= 'Z')
+                value = c - 'A';
+            else if (c >= 'a' && c <= 'z')
+                value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9')
+                value = c - '0' + 52;
+            else if (c == '+' || c == '-')
+                value = 62;
+            else if (c == '/' || c == '_')
+                value = 63;
+            else if (c == '=')
+                break;
+            else
+                return false;
+
+            accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+            bits += 6;
+            if (bits >= 8)
+            {
+                bits -= 8;
+                out.push_back(static_cast<unsigned char>((accumulator >> bits) & 0xFF));
+            }
+        }
+        return true;
+    }
+
+    // Only base64 data: URIs occur in practice, and only those are read.
+    bool decodeDataUri(const string &uri, vector<unsigned char> &out)
+    {
+        size_t marker = uri.find(";base64,");
+        if (marker == string::npos)
+            return false;
+        size_t start = marker + 8;
+        return decodeBase64(uri.data() + start, uri.size() - start, out);
+    }
+
+    size_t componentSize(int componentType)
+    {
+        switch (componentType)
+        {
+        case GLTF_BYTE:
+        case GLTF_UNSIGNED_BYTE:
+            return 1;
+        case GLTF_SHORT:
+        case GLTF_UNSIGNED_SHORT:
+            return 2;
+        case GLTF_UNSIGNED_INT:
+        case GLTF_FLOAT:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    int componentCount(const string &type)
+    {
+        if (type == "SCALAR")
+            return 1;
+        if (type == "VEC2")
+            return 2;
+        if (type == "VEC3")
+            return 3;
+        if (type == "VEC4" || type == "MAT2")
+            return 4;
+        if (type == "MAT3")
+            return 9;
+        if (type == "MAT4")
+            return 16;
+        return 0;
+    }
+
+    float readComponent(const unsigned char *p, int componentType, bool normalized)
+    {
+        switch (componentType)
+        {
+        case GLTF_FLOAT:
+        {
+            float f;
+            memcpy(&f, p, sizeof(f));
+            return f;
+        }
+        case GLTF_BYTE:
+        {
+            float v = static_cast<float>(static_cast<int8_t>(p[0]));
+            return normalized ? std::max(v / 127.0f, -1.0f) : v;
+        }
+        case GLTF_UNSIGNED_BYTE:
+            return normalized ? p[0] / 255.0f : static_cast<float>(p[0]);
+        case GLTF_SHORT:
+        {
+            int16_t s;
+            memcpy(&s, p, sizeof(s));
+            return normalized ? std::max(s / 32767.0f, -1.0f) : static_cast<float>(s);
+        }
+        case GLTF_UNSIGNED_SHORT:
+        {
+            uint16_t s;
+            memcpy(&s, p, sizeof(s));
+            return normalized ? s / 65535.0f : static_cast<float>(s);
+        }
+        case GLTF_UNSIGNED_INT:
+        {
+            uint32_t u;
+            memcpy(&u, p, sizeof(u));
+            return static_cast<float>(u);
+        }
+        default:
+            return 0.0f;
+        }
+    }
+
+    uint32_t readUnsignedComponent(const unsigned char *p, int componentType)
+    {
+        switch (componentType)
+        {
+        case GLTF_UNSIGNED_BYTE:
+            return p[0];
+        case GLTF_UNSIGNED_SHORT:
+        {
+            uint16_t s;
+            memcpy(&s, p, sizeof(s));
+            return s;
+        }
+        case GLTF_UNSIGNED_INT:
+        {
+            uint32_t u;
+            memcpy(&u, p, sizeof(u));
+            return u;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    bool getAccessor(const GltfDocument &doc, int index, AccessorView &view, string &error)
+    {
+        const JsonValue &accessor = doc.json["accessors"][static_cast<size_t>(index)];
+        if (index < 0 || !accessor.isObject())
+        {
+            error = "missing accessor " + to_string(index);
+            return false;
+        }
+        if (accessor.has("sparse"))
+        {
+            error = "sparse accessors are not supported";
+            return false;
+        }
+
+        view.count = jsonSize(accessor["count"]);
+        view.componentType = accessor["componentType"].asInt();
+        view.components = componentCount(accessor["type"].asString());
+        view.normalized = accessor["normalized"].asBool();
+        size_t elementSize = componentSize(view.componentType) * view.components;
+        if (elementSize == 0)
+        {
+            error = "accessor " + to_string(index) + " has an unknown type";
+            return false;
+        }
+
+        if (!accessor.has("bufferView"))
+        {
+            view.data = nullptr;
+            view.stride = elementSize;
+            return true;
+        }
+
+        const JsonValue &bufferView = doc.json["bufferViews"][jsonSize(accessor["bufferView"], SIZE_MAX)];
+        size_t buffer = jsonSize(bufferView["buffer"], SIZE_MAX);
+        if (!bufferView.isObject() || buffer >= doc.buffers.size())
+        {
+            error = "accessor " + to_string(index) + " has no valid buffer view";
+            return false;
+        }
+
+        size_t viewOffset = jsonSize(bufferView["byteOffset"]);
+        size_t viewLength = jsonSize(bufferView["byteLength"]);
+        size_t offset = jsonSize(accessor["byteOffset"]);
+        view.stride = jsonSize(bufferView["byteStride"]);
+        if (view.stride == 0)
+            view.stride = elementSize;
+
+        const BufferSpan &span = doc.buffers[buffer];
+        bool fits = viewOffset <= span.size && viewLength <= span.size - viewOffset;
+        if (fits && view.count > 0)
+        {
+            size_t last = offset + (view.count - 1) * view.stride + elementSize;
+            fits = (view.count - 1) <= (SIZE_MAX - offset - elementSize) / view.stride && last <= viewLength;
+        }
+        if (!fits)
+        {
+            error = "accessor " + to_string(index) + " runs past the end of its buffer";
+            return false;
+        }
+
+        view.data = span.data + viewOffset + offset;
+        return true;
+    }
+
+    // Reads the first `wanted` components of every element as floats into
+    // out, which must hold count * wanted floats. Tightly packed float data
+    // is a single copy.
+    bool readFloats(const AccessorView &view, int wanted, float *out)
+    {
+        if (view.components < wanted)
+            return false;
+
+        const size_t elementBytes = static_cast<size_t>(wanted) * sizeof(float);
+        if (!view.data)
+        {
+            memset(out, 0, view.count * elementBytes);
+            return true;
+        }
+
+        if (view.componentType == GLTF_FLOAT)
+        {
+            if (view.components == wanted && view.stride == elementBytes)
+            {
+                memcpy(out, view.data, view.count * elementBytes);
+                return true;
+            }
+            for (size_t i = 0; i < view.count; i++)
+            {
+                memcpy(out + i * wanted, view.data + i * view.stride, elementBytes);
+            }
+            return true;
+        }
+
+        const size_t size = componentSize(view.componentType);
+        for (size_t i = 0; i < view.count; i++)
+        {
+            const unsigned char *element = view.data + i * view.stride;
+            for (int c = 0; c < wanted; c++)
+            {
+                out[i * wanted + c] = readComponent(element + c * size, view.componentType, view.normalized);
+            }
+        }
+        return true;
+    }
+
+    // T is float or a glm vector or matrix of floats, filled component-wise.
+    template <typename T>
+    bool readAccessor(const GltfDocument &doc, int index, vector<T> &out, string &error)
+    {
+        AccessorView view;
+        if (!getAccessor(doc, index, view, error))
+            return false;
+
+        const int wanted = static_cast<int>(sizeof(T) / sizeof(float));
+        out.resize(view.count);
+        if (!readFloats(view, wanted, reinterpret_cast<float *>(out.data())))
+        {
+            error = "accessor " + to_string(index) + " has too few components";
+            return false;
+        }
+        return true;
+    }
+
+    bool readUnsignedAccessor(const GltfDocument &doc, int index, int wanted,
+                              vector<unsigned int> &out, string &error)
+    {
+        AccessorView view;
+        if (!getAccessor(doc, index, view, error))
+            return false;
+        if (view.components < wanted || view.componentType == GLTF_FLOAT ||
+            view.componentType == GLTF_BYTE || view.componentType == GLTF_SHORT)
+        {
+            error = "accessor " + to_string(index) + " is not unsigned integer data";
+            return false;
+        }
+
+        out.assign(view.count * wanted, 0);
+        if (!view.data)
+            return true;
+
+        if (view.componentType == GLTF_UNSIGNED_INT && view.components == wanted &&
+            view.stride == wanted * sizeof(unsigned int))
+        {
+            memcpy(out.data(), view.data, out.size() * sizeof(unsigned int));
+            return true;
+        }
+
+        const size_t size = componentSize(view.componentType);
+        for (size_t i = 0; i < view.count; i++)
+        {
+            const unsigned char *element = view.data + i * view.stride;
+            for (int c = 0; c < wanted; c++)
+            {
+                out[i * wanted + c] = readUnsignedComponent(element + c * size, view.componentType);
+            }
+        }
+        return true;
+    }
+
+    bool loadBuffers(GltfDocument &doc, const unsigned char *glbBin, size_t glbBinSize, string &error)
+    {
+        const JsonValue &buffers = doc.json["buffers"];
+        doc.dataUris.reserve(buffers.size());
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            const JsonValue &buffer = buffers[i];
+            BufferSpan span = {nullptr, 0};
+
+            if (!buffer.has("uri"))
+            {
+                // Only the first buffer of a .glb may live in its BIN chunk.
+                if (i != 0 || !glbBin)
+                {
+                    error = "buffer " + to_string(i) + " has no data";
+                    return false;
+                }
+                span.data = glbBin;
+                span.size = glbBinSize;
+            }
+            else
+            {
+                const string &uri = buffer["uri"].asString();
+                if (startsWith(uri, "data:"))
+                {
+                    doc.dataUris.push_back(vector<unsigned char>());
+                    if (!decodeDataUri(uri, doc.dataUris.back()))
+                    {
+                        error = "buffer " + to_string(i) + " has an unsupported data URI";
+                        return false;
+                    }
+                    span.data = doc.dataUris.back().data();
+                    span.size = doc.dataUris.back().size();
+                }
+                else
+                {
+                    string bufferPath = doc.directory + decodeUriPath(uri);
+                    unique_ptr<AssetFile> file(new AssetFile());
+                    if (!file->open(bufferPath.c_str()))
+                    {
+                        error = "cannot open buffer '" + bufferPath + "'";
+                        return false;
+                    }
+                    span.data = file->data();
+                    span.size = file->size();
+                    doc.sideFiles.push_back(move(file));
+                }
+            }
+
+            if (span.size < jsonSize(buffer["byteLength"]))
+            {
+                error = "buffer " + to_string(i) + " is shorter than its byteLength";
+                return false;
+            }
+            doc.buffers.push_back(span);
+        }
+        return true;
+    }
+
+    bool openDocument(const char *filePath, GltfDocument &doc, string &error)
+    {
+        doc.path = filePath;
+        doc.directory = getDirectory(doc.path);
+        if (!doc.file.open(filePath))
+        {
+            error = "cannot open file";
+            return false;
+        }
+
+        const unsigned char *bytes = doc.file.data();
+        size_t size = doc.file.size();
+        const char *jsonText = reinterpret_cast<const char *>(bytes);
+        size_t jsonLength = size;
+        const unsigned char *bin = nullptr;
+        size_t binSize = 0;
+
+        if (size >= 12 && readU32(bytes) == GLB_MAGIC)
+        {
+            if (readU32(bytes + 4) != 2)
+            {
+                error = "unsupported GLB version";
+                return false;
+            }
+            size_t length = std::min(static_cast<size_t>(readU32(bytes + 8)), size);
+            size_t offset = 12;
+            jsonText = nullptr;
+            while (offset + 8 <= length)
+            {
+                size_t chunkLength = readU32(bytes + offset);
+                uint32_t chunkType = readU32(bytes + offset + 4);
+                offset += 8;
+                if (chunkLength > length - offset)
+                {
+                    error = "truncated GLB chunk";
+                    return false;
+                }
+                if (chunkType == GLB_CHUNK_JSON && !jsonText)
+                {
+                    jsonText = reinterpret_cast<const char *>(bytes + offset);
+                    jsonLength = chunkLength;
+                }
+                else if (chunkType == GLB_CHUNK_BIN && !bin)
+                {
+                    bin = bytes + offset;
+                    binSize = chunkLength;
+                }
+                offset += (chunkLength + 3) & ~static_cast<size_t>(3);
+            }
+            if (!jsonText)
+            {
+                error = "GLB without a JSON chunk";
+                return false;
+            }
+        }
+
+        {
+            ProfileScope scope("parseGltfJson");
+            string jsonError;
+            if (!parseJson(jsonText, jsonLength, doc.json, jsonError))
+            {
+                error = "invalid JSON: " + jsonError;
+                return false;
+            }
+        }
+
+        if (!startsWith(doc.json["asset"]["version"].asString(), "2"))
+        {
+            error = "not a glTF 2.0 file";
+            return false;
+        }
+
+        const JsonValue &required = doc.json["extensionsRequired"];
+        for (size_t i = 0; i < required.size(); i++)
+        {
+            const string &name = required[i].asString();
+            bool supported = false;
+            for (const char *known : SUPPORTED_EXTENSIONS)
+            {
+                supported = supported || name == known;
+            }
+            if (!supported)
+            {
+                error = "requires extension " + name;
+                return false;
+            }
+        }
+
+        return loadBuffers(doc, bin, binSize, error);
+    }
+
+    // Assimp names unnamed nodes after their index the same way, and
+    // animation channels and bones refer to nodes by name.
+    vector<string> nodeNames(const GltfDocument &doc)
+    {
+        const JsonValue &nodes = doc.json["nodes"];
+        vector<string> names(nodes.size());
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            names[i] = nodes[i]["name"].asString();
+            if (names[i].empty())
+                names[i] = "nodes_" + to_string(i);
+        }
+        return names;
+    }
+
+    // Fills out only when array holds exactly count numbers.
+    bool readNumbers(const JsonValue &array, float *out, size_t count)
+    {
+        if (array.size() != count)
+            return false;
+        for (size_t i = 0; i < count; i++)
+            out[i] = static_cast<float>(array[i].asNumber());
+        return true;
+    }
+
+    void nodeRestPose(const JsonValue &node, vec3 &translation, quat &rotation, vec3 &scale)
+    {
+        const JsonValue &matrix = node["matrix"];
+        mat4 m;
+        if (readNumbers(matrix, glm::value_ptr(m), 16))
+        {
+            translation = vec3(m[3]);
+            scale = vec3(glm::length(vec3(m[0])), glm::length(vec3(m[1])), glm::length(vec3(m[2])));
+            mat3 basis(1.0f);
+            for (int c = 0; c < 3; c++)
+            {
+                if (scale[c] > 0.0f)
+                    basis[c] = vec3(m[c]) / scale[c];
+            }
+            rotation = glm::quat_cast(basis);
+            return;
+        }
+
+        const JsonValue &t = node["translation"];
+        const JsonValue &r = node["rotation"];
+        const JsonValue &s = node["scale"];
+        translation = vec3(0.0f);
+        rotation = quat(1.0f, 0.0f, 0.0f, 0.0f);
+        scale = vec3(1.0f);
+        readNumbers(t, glm::value_ptr(translation), 3);
+        vec4 xyzw;
+        if (readNumbers(r, glm::value_ptr(xyzw), 4))
+            rotation = quat(xyzw.w, xyzw.x, xyzw.y, xyzw.z);
+        readNumbers(s, glm::value_ptr(scale), 3);
+    }
+
+    mat4 nodeLocalTransform(const JsonValue &node)
+    {
+        // Column-major in the file, as in glm.
+        mat4 m;
+        if (readNumbers(node["matrix"], glm::value_ptr(m), 16))
+            return m;
+
+        vec3 translation, scale;
+        quat rotation;
+        nodeRestPose(node, translation, rotation, scale);
+        return glm::translate(mat4(1.0f), translation) * glm::mat4_cast(rotation) *
+               glm::scale(mat4(1.0f), scale);
+    }
+
+    TextureRef resolveImage(const GltfDocument &doc, const JsonValue &textureInfo)
+    {
+        TextureRef ref;
+        ref.source = TextureRef::NONE;
+        ref.width = 0;
+        ref.height = 0;
+        ref.channels = 0;
+
+        if (!textureInfo.has("index"))
+            return ref;
+        const JsonValue &texture = doc.json["textures"][jsonSize(textureInfo["index"], SIZE_MAX)];
+        if (!texture.has("source"))
+            return ref;
+        const JsonValue &image = doc.json["images"][jsonSize(texture["source"], SIZE_MAX)];
+
+        if (image.has("bufferView"))
+        {
+            const JsonValue &bufferView = doc.json["bufferViews"][jsonSize(image["bufferView"], SIZE_MAX)];
+            size_t buffer = jsonSize(bufferView["buffer"], SIZE_MAX);
+            size_t offset = jsonSize(bufferView["byteOffset"]);
+            size_t length = jsonSize(bufferView["byteLength"]);
+            if (buffer < doc.buffers.size() && offset <= doc.buffers[buffer].size &&
+                length <= doc.buffers[buffer].size - offset)
+            {
+                const unsigned char *data = doc.buffers[buffer].data + offset;
+                ref.source = TextureRef::EMBEDDED_COMPRESSED;
+                ref.data.assign(data, data + length);
+            }
+            return ref;
+        }
+
+        const string &uri = image["uri"].asString();
+        if (uri.empty())
+            return ref;
+        if (startsWith(uri, "data:"))
+        {
+            if (decodeDataUri(uri, ref.data))
+                ref.source = TextureRef::EMBEDDED_COMPRESSED;
+            return ref;
+        }
+
+        string fullPath = doc.directory + decodeUriPath(uri);
+        if (assetExists(fullPath.c_str()))
+        {
+            ref.source = TextureRef::FILE_PATH;
+            ref.path = fullPath;
+            return ref;
+        }
+
+        cerr << "resolveMaterialTexture: cannot open external texture '"
+             << fullPath << "' referenced by '" << doc.path << "'\n";
+        return ref;
+    }
+
+    // The diffuse texture of the spec/gloss extension wins over the base
+    // colour, as Assimp's DIFFUSE slot does.
+    TextureRef resolveMaterialTexture(const GltfDocument &doc, int materialIndex)
+    {
+        const JsonValue &material = doc.json["materials"][static_cast<size_t>(materialIndex)];
+        const JsonValue &specGloss = material["extensions"]["KHR_materials_pbrSpecularGlossiness"];
+        if (specGloss.has("diffuseTexture"))
+        {
+            TextureRef ref = resolveImage(doc, specGloss["diffuseTexture"]);
+            if (ref.source != TextureRef::NONE)
+                return ref;
+        }
+        return resolveImage(doc, material["pbrMetallicRoughness"]["baseColorTexture"]);
+    }
+
+    // Bakes the diffuse texture's KHR_texture_transform into the texcoords,
+    // as the extension defines it: scale, then rotate counter-clockwise,
+    // then offset. There is only the one set of texcoords, so a transform
+    // naming another set still applies to it.
+    void applyTextureTransform(const GltfDocument &doc, int materialIndex, vector<vec2> &texcoords)
+    {
+        const JsonValue &material = doc.json["materials"][static_cast<size_t>(materialIndex)];
+        const JsonValue &specGloss = material["extensions"]["KHR_materials_pbrSpecularGlossiness"];
+        const JsonValue &info = specGloss.has("diffuseTexture") ? specGloss["diffuseTexture"]
+                                                                 : material["pbrMetallicRoughness"]["baseColorTexture"];
+        if (!info["extensions"].has("KHR_texture_transform"))
+            return;
+
+        const JsonValue &transform = info["extensions"]["KHR_texture_transform"];
+        vec2 offset(transform["offset"][size_t(0)].asNumber(0.0), transform["offset"][size_t(1)].asNumber(0.0));
+        vec2 scale(transform["scale"][size_t(0)].asNumber(1.0), transform["scale"][size_t(1)].asNumber(1.0));
+        float rotation = static_cast<float>(transform["rotation"].asNumber(0.0));
+        float c = cos(rotation);
+        float s = sin(rotation);
+        for (vec2 &uv : texcoords)
+        {
+            vec2 scaled = uv * scale;
+            uv = vec2(c * scaled.x + s * scaled.y, c * scaled.y - s * scaled.x) + offset;
+        }
+    }
+
+    bool triangulate(int mode, vector<unsigned int> &indices)
+    {
+        if (mode == GLTF_TRIANGLES)
+        {
+            indices.resize(indices.size() - indices.size() % 3);
+            return true;
+        }
+        if (indices.size() < 3)
+        {
+            indices.clear();
+            return true;
+        }
+
+        vector<unsigned int> list;
+        list.reserve((indices.size() - 2) * 3);
+        for (size_t i = 0; i + 2 < indices.size(); i++)
+        {
+            if (mode == GLTF_TRIANGLE_FAN)
+            {
+                list.push_back(indices[0]);
+                list.push_back(indices[i + 1]);
+                list.push_back(indices[i + 2]);
+            }
+            else if (i % 2 == 0)
+            {
+                list.push_back(indices[i]);
+                list.push_back(indices[i + 1]);
+                list.push_back(indices[i + 2]);
+            }
+            else
+            {
+                list.push_back(indices[i + 1]);
+                list.push_back(indices[i]);
+                list.push_back(indices[i + 2]);
+            }
+        }
+        indices.swap(list);
+        return true;
+    }
+
+    bool lessPosition(const vec3 &a, const vec3 &b)
+    {
+        if (a.x != b.x)
+            return a.x < b.x;
+        if (a.y != b.y)
+            return a.y < b.y;
+        return a.z < b.z;
+    }
+
+    // Area-weighted smooth normals for primitives that ship without any.
+    // Vertices sharing a position share a normal, like
+    // aiProcess_GenSmoothNormals, so UV seams do not show as creases.
+    void generateSmoothNormals(MeshInstance &instance)
+    {
+        const vector<vec3> &positions = instance.vertices;
+        vector<vec3> accumulated(positions.size(), vec3(0.0f));
+        for (size_t t = 0; t + 2 < instance.indices.size(); t += 3)
+        {
+            unsigned int a = instance.indices[t];
+            unsigned int b = instance.indices[t + 1];
+            unsigned int c = instance.indices[t + 2];
+            vec3 faceNormal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+            accumulated[a] += faceNormal;
+            accumulated[b] += faceNormal;
+            accumulated[c] += faceNormal;
+        }
+
+        vector<unsigned int> order(positions.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = static_cast<unsigned int>(i);
+        sort(order.begin(), order.end(), [&positions](unsigned int a, unsigned int b)
+             { return lessPosition(positions[a], positions[b]); });
+
+        instance.normals.assign(positions.size(), vec3(0.0f, 1.0f, 0.0f));
+        for (size_t start = 0; start < order.size();)
+        {
+            size_t end = start + 1;
+            vec3 sum = accumulated[order[start]];
+            while (end < order.size() && positions[order[end]] == positions[order[start]])
+                sum += accumulated[order[end++]];
+
+            float length = glm::length(sum);
+            for (size_t i = start; i < end; i++)
+            {
+                if (length > 0.0f)
+                    instance.normals[order[i]] = sum / length;
+            }
+            start = end;
+        }
+    }
+
+    bool readPrimitive(const GltfDocument &doc, const JsonValue &primitive, bool readSkin,
+                       GltfPrimitive &out, string &error)
+    {
+        out.mesh = MeshInstance{};
+        out.material = primitive["material"].asInt(-1);
+        out.skipped = false;
+
+        int mode = primitive["mode"].asInt(GLTF_TRIANGLES);
+        if (mode != GLTF_TRIANGLES && mode != GLTF_TRIANGLE_STRIP && mode != GLTF_TRIANGLE_FAN)
+        {
+            out.skipped = true;
+            return true;
+        }
+
+        const JsonValue &attributes = primitive["attributes"];
+        if (!attributes.has("POSITION"))
+        {
+            error = "primitive without POSITION";
+            return false;
+        }
+
+        MeshInstance &mesh = out.mesh;
+        if (!readAccessor(doc, attributes["POSITION"].asInt(), mesh.vertices, error))
+            return false;
+        const size_t vertexCount = mesh.vertices.size();
+
+        if (attributes.has("NORMAL") && !readAccessor(doc, attributes["NORMAL"].asInt(), mesh.normals, error))
+            return false;
+
+        // Absent or unread streams stay empty, as on the Assimp path.
+        const unsigned int used = usedVertexAttributes();
+        if ((used & VERTEX_ATTRIB_TEXCOORD) && attributes.has("TEXCOORD_0") &&
+            !readAccessor(doc, attributes["TEXCOORD_0"].asInt(), mesh.texcoords, error))
+            return false;
+        if ((used & VERTEX_ATTRIB_COLOR) && attributes.has("COLOR_0") &&
+            !readAccessor(doc, attributes["COLOR_0"].asInt(), mesh.colors, error))
+            return false;
+
+        if ((!mesh.normals.empty() && mesh.normals.size() != vertexCount) ||
+            (!mesh.texcoords.empty() && mesh.texcoords.size() != vertexCount) ||
+            (!mesh.colors.empty() && mesh.colors.size() != vertexCount))
+        {
+            error = "primitive attributes differ in length";
+            return false;
+        }
+        if (!mesh.texcoords.empty() && out.material >= 0)
+            applyTextureTransform(doc, out.material, mesh.texcoords);
+
+        if (primitive.has("indices"))
+        {
+            if (!readUnsignedAccessor(doc, primitive["indices"].asInt(), 1, mesh.indices, error))
+                return false;
+        }
+        else
+        {
+            mesh.indices.resize(vertexCount);
+            for (size_t i = 0; i < vertexCount; i++)
+                mesh.indices[i] = static_cast<unsigned int>(i);
+        }
+        for (unsigned int index : mesh.indices)
+        {
+            if (index >= vertexCount)
+            {
+                error = "index out of range";
+                return false;
+            }
+        }
+        triangulate(mode, mesh.indices);
+
+        if (mesh.normals.empty())
+            generateSmoothNormals(mesh);
+
+        if (!readSkin)
+            return true;
+
+        // JOINTS_1/WEIGHTS_1 carry influences five to eight.
+        vector<vector<unsigned int>> jointIds;
+        vector<vector<vec4>> jointWeights;
+        for (int set = 0;; set++)
+        {
+            string joints = "JOINTS_" + to_string(set);
+            string weights = "WEIGHTS_" + to_string(set);
+            if (!attributes.has(joints.c_str()) || !attributes.has(weights.c_str()))
+                break;
+
+            jointIds.push_back(vector<unsigned int>());
+            jointWeights.push_back(vector<vec4>());
+            if (!readUnsignedAccessor(doc, attributes[joints.c_str()].asInt(), 4, jointIds.back(), error) ||
+                !readAccessor(doc, attributes[weights.c_str()].asInt(), jointWeights.back(), error))
+                return false;
+            if (jointWeights.back().size() != vertexCount || jointIds.back().size() != vertexCount * 4)
+            {
+                error = "skin attributes differ in length";
+                return false;
+            }
+        }
+        if (jointIds.empty())
+            return true;
+
+        out.influences.reset(vertexCount);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            if (pass == 1)
+                out.influences.allocate();
+            for (size_t set = 0; set < jointIds.size(); set++)
+            {
+                for (size_t v = 0; v < vertexCount; v++)
+                {
+                    for (int c = 0; c < 4; c++)
+                    {
+                        if (!(jointWeights[set][v][c] > 0.0f))
+                            continue;
+                        if (pass == 0)
+                        {
+                            out.influences.count(v);
+                            continue;
+                        }
+                        BoneInfluence influence;
+                        influence.bone = static_cast<int>(jointIds[set][v * 4 + c]);
+                        influence.weight = jointWeights[set][v][c];
+                        out.influences.add(v, influence);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // primitives[m][p] is primitive p of mesh m.
+    bool readMeshes(const GltfDocument &doc, bool readSkins,
+                    vector<vector<GltfPrimitive>> &primitives, string &error)
+    {
+        ProfileScope scope("readGltfMeshes");
+        const JsonValue &meshes = doc.json["meshes"];
+        primitives.resize(meshes.size());
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            const JsonValue &list = meshes[m]["primitives"];
+            primitives[m].resize(list.size());
+            for (size_t p = 0; p < list.size(); p++)
+            {
+                if (!readPrimitive(doc, list[p], readSkins, primitives[m][p], error))
+                {
+                    error = "mesh " + to_string(m) + ": " + error;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // The default scene's root nodes, or every parentless node when the
+    // file names no scene.
+    vector<size_t> sceneRoots(const GltfDocument &doc)
+    {
+        vector<size_t> roots;
+        const JsonValue &scenes = doc.json["scenes"];
+        if (scenes.size() > 0)
+        {
+            const JsonValue &nodes = scenes[jsonSize(doc.json["scene"])]["nodes"];
+            for (size_t i = 0; i < nodes.size(); i++)
+                roots.push_back(jsonSize(nodes[i], SIZE_MAX));
+            return roots;
+        }
+
+        const JsonValue &nodes = doc.json["nodes"];
+        vector<bool> isChild(nodes.size(), false);
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const JsonValue &children = nodes[i]["children"];
+            for (size_t c = 0; c < children.size(); c++)
+            {
+                size_t child = jsonSize(children[c], SIZE_MAX);
+                if (child < isChild.size())
+                    isChild[child] = true;
+            }
+        }
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            if (!isChild[i])
+                roots.push_back(i);
+        }
+        return roots;
+    }
+
+    // Pre-order walk of the scene. Fails on anything that is not a tree,
+    // which the format forbids but a broken file could still contain.
+    bool walkScene(const GltfDocument &doc, vector<size_t> &order, vector<int> &parents, string &error)
+    {
+        const JsonValue &nodes = doc.json["nodes"];
+        vector<bool> visited(nodes.size(), false);
+        vector<pair<size_t, int>> stack;
+        vector<size_t> roots = sceneRoots(doc);
+        for (size_t i = roots.size(); i-- > 0;)
+            stack.push_back(make_pair(roots[i], -1));
+
+        while (!stack.empty())
+        {
+            size_t node = stack.back().first;
+            int parent = stack.back().second;
+            stack.pop_back();
+            if (node >= nodes.size() || visited[node])
+            {
+                error = "node graph is not a tree";
+                return false;
+            }
+            visited[node] = true;
+            int position = static_cast<int>(order.size());
+            order.push_back(node);
+            parents.push_back(parent);
+
+            const JsonValue &children = nodes[node]["children"];
+            for (size_t c = children.size(); c-- > 0;)
+                stack.push_back(make_pair(jsonSize(children[c], SIZE_MAX), position));
+        }
+        return true;
+    }
+
+    // A merged mesh carries texcoords or colours when any of its parts does;
+    // parts without them get the constants the shader would otherwise see.
+    void appendTransformed(MeshInstance &out, const MeshInstance &part, const mat4 &world,
+                           bool withTexcoords, bool withColors)
+    {
+        const unsigned int base = static_cast<unsigned int>(out.vertices.size());
+        const mat3 linear(world);
+        const mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+        const bool mirrored = glm::determinant(linear) < 0.0f;
+
+        for (size_t v = 0; v < part.vertices.size(); v++)
+        {
+            out.vertices.push_back(vec3(world * vec4(part.vertices[v], 1.0f)));
+            vec3 normal = normalMatrix * part.normals[v];
+            float length = glm::length(normal);
+            out.normals.push_back(length > 0.0f ? normal / length : normal);
+        }
+        if (withTexcoords && part.texcoords.empty())
+            out.texcoords.resize(out.vertices.size(), vec2(0.0f, 0.0f));
+        else if (withTexcoords)
+            out.texcoords.insert(out.texcoords.end(), part.texcoords.begin(), part.texcoords.end());
+        if (withColors && part.colors.empty())
+            out.colors.resize(out.vertices.size(), vec3(1.0f, 1.0f, 1.0f));
+        else if (withColors)
+            out.colors.insert(out.colors.end(), part.colors.begin(), part.colors.end());
+
+        // A mirroring transform turns the winding inside out.
+        for (size_t t = 0; t + 2 < part.indices.size(); t += 3)
+        {
+            out.indices.push_back(base + part.indices[t]);
+            out.indices.push_back(base + part.indices[t + (mirrored ? 2 : 1)]);
+            out.indices.push_back(base + part.indices[t + (mirrored ? 1 : 2)]);
+        }
+    }
+}
+
+bool isGltfPath(const char *path)
+{
+    string p = path ? path : "";
+    size_t dot = p.find_last_of('.');
+    if (dot == string::npos)
+        return false;
+    string extension = p.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".gltf" || extension == ".glb";
+}
+
+bool importGltfStatic(const char *filePath, vector<MeshInstance> &meshes, string &error)
+{
+    ProfileScope scope("importGltfStatic");
+    meshes.clear();
+
+    GltfDocument doc;
+    if (!openDocument(filePath, doc, error))
+        return false;
+
+    vector<vector<GltfPrimitive>> primitives;
+    if (!readMeshes(doc, false, primitives, error))
+        return false;
+
+    vector<size_t> order;
+    vector<int> parents;
+    if (!walkScene(doc, order, parents, error))
+        return false;
+
+    struct Placement
+    {
+        const GltfPrimitive *primitive;
+        size_t world; // index into worlds
+    };
+
+    const JsonValue &nodes = doc.json["nodes"];
+    vector<mat4> worlds(order.size());
+    vector<Placement> placements;
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const JsonValue &node = nodes[order[i]];
+        mat4 local = nodeLocalTransform(node);
+        worlds[i] = parents[i] < 0 ? local : worlds[parents[i]] * local;
+
+        size_t mesh = jsonSize(node["mesh"], SIZE_MAX);
+        if (mesh >= primitives.size())
+            continue;
+        for (const GltfPrimitive &primitive : primitives[mesh])
+        {
+            if (!primitive.skipped && !primitive.mesh.indices.empty())
+            {
+                Placement placement = {&primitive, i};
+                placements.push_back(placement);
+            }
+        }
+    }
+
+    // Merged per material in material order, primitives without one last,
+    // matching what aiProcess_PreTransformVertices hands the Assimp path.
+    vector<int> materials;
+    for (const Placement &placement : placements)
+        materials.push_back(placement.primitive->material);
+    sort(materials.begin(), materials.end(), [](int a, int b)
+         { return (a < 0 ? INT32_MAX : a) < (b < 0 ? INT32_MAX : b); });
+    materials.erase(unique(materials.begin(), materials.end()), materials.end());
+
+    {
+        ProfileScope mergeScope("mergeGltfPrimitives");
+        for (int material : materials)
+        {
+            size_t vertexCount = 0;
+            size_t indexCount = 0;
+            bool withTexcoords = false;
+            bool withColors = false;
+            for (const Placement &placement : placements)
+            {
+                if (placement.primitive->material != material)
+                    continue;
+                const MeshInstance &part = placement.primitive->mesh;
+                vertexCount += part.vertices.size();
+                indexCount += part.indices.size();
+                withTexcoords = withTexcoords || !part.texcoords.empty();
+                withColors = withColors || !part.colors.empty();
+            }
+
+            MeshInstance merged{};
+            merged.vertices.reserve(vertexCount);
+            merged.normals.reserve(vertexCount);
+            merged.texcoords.reserve(withTexcoords ? vertexCount : 0);
+            merged.colors.reserve(withColors ? vertexCount : 0);
+            merged.indices.reserve(indexCount);
+            for (const Placement &placement : placements)
+            {
+                if (placement.primitive->material == material)
+                    appendTransformed(merged, placement.primitive->mesh, worlds[placement.world], withTexcoords,
+                                      withColors);
+            }
+
+            merged.hasBones = false;
+            merged.boneInfluences = 0;
+            merged.diffuseRef = resolveMaterialTexture(doc, material);
+            meshes.push_back(move(merged));
+        }
+    }
+
+    if (meshes.empty())
+    {
+        error = "no triangle geometry";
+        return false;
+    }
+    return true;
+}
+
+bool importGltfHierarchical(const char *filePath, HierarchicalModel &model,
+                            vector<SkinCompactionStats> &skins, string &error)
+{
+    ProfileScope scope("importGltfHierarchical");
+    skins.clear();
+
+    GltfDocument doc;
+    if (!openDocument(filePath, doc, error))
+        return false;
+
+    vector<vector<GltfPrimitive>> primitives;
+    if (!readMeshes(doc, true, primitives, error))
+        return false;
+
+    vector<size_t> order;
+    vector<int> parents;
+    if (!walkScene(doc, order, parents, error))
+        return false;
+
+    const JsonValue &nodes = doc.json["nodes"];
+    const vector<string> names = nodeNames(doc);
+
+    // A mesh is skinned by the first node that places it with a skin.
+    vector<int> meshSkins(primitives.size(), -1);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        size_t mesh = jsonSize(nodes[i]["mesh"], SIZE_MAX);
+        if (mesh < meshSkins.size() && meshSkins[mesh] < 0)
+            meshSkins[mesh] = nodes[i]["skin"].asInt(-1);
+    }
+
+    // Every primitive becomes a mesh of its own, as in Assimp's importer.
+    vector<vector<unsigned int>> meshIndices(primitives.size());
+    {
+        ProfileScope skinScope("readGltfSkins");
+        for (size_t m = 0; m < primitives.size(); m++)
+        {
+            vector<string> boneNames;
+            vector<mat4> boneOffsets;
+            if (meshSkins[m] >= 0)
+            {
+                const JsonValue &skin = doc.json["skins"][static_cast<size_t>(meshSkins[m])];
+                const JsonValue &joints = skin["joints"];
+                if (skin.has("inverseBindMatrices") &&
+                    !readAccessor(doc, skin["inverseBindMatrices"].asInt(), boneOffsets, error))
+                    return false;
+                boneOffsets.resize(joints.size(), mat4(1.0f));
+                for (size_t j = 0; j < joints.size(); j++)
+                {
+                    size_t joint = jsonSize(joints[j], SIZE_MAX);
+                    if (joint >= names.size())
+                    {
+                        error = "skin joint is not a node";
+                        return false;
+                    }
+                    boneNames.push_back(names[joint]);
+                }
+            }
+
+            for (GltfPrimitive &primitive : primitives[m])
+            {
+                if (primitive.skipped || primitive.mesh.indices.empty())
+                    continue;
+
+                MeshInstance &mesh = primitive.mesh;
+                mesh.hasBones = false;
+                mesh.boneInfluences = 0;
+                SkinCompactionStats stats = {0, 0, 0, 0};
+                if (!boneNames.empty() && !primitive.influences.items.empty())
+                {
+                    for (const BoneInfluence &influence : primitive.influences.items)
+                    {
+                        if (influence.bone < 0 || influence.bone >= static_cast<int>(boneNames.size()))
+                        {
+                            error = "joint index outside its skin";
+                            return false;
+                        }
+                    }
+                    stats = compactSkin(mesh, boneNames, boneOffsets, primitive.influences);
+                }
+                primitive.influences = SkinInfluences();
+
+                mesh.diffuseRef = resolveMaterialTexture(doc, primitive.material);
+                meshIndices[m].push_back(static_cast<unsigned int>(model.asset->meshes.size()));
+                model.asset->meshes.push_back(move(mesh));
+                skins.push_back(stats);
+            }
+        }
+    }
+
+    {
+        ProfileScope nodeScope("buildNodeHierarchy");
+        size_t rootCount = 0;
+        for (int parent : parents)
+            rootCount += parent < 0 ? 1 : 0;
+
+        // Several scene roots hang under a synthetic "ROOT", as in Assimp.
+        const bool syntheticRoot = rootCount != 1;
+        model.nodes.clear();
+        model.nodes.reserve(order.size() + (syntheticRoot ? 1 : 0));
+        if (syntheticRoot)
+        {
+            HierarchicalNode root;
+            root.name = "ROOT";
+            root.localTransform = mat4(1.0f);
+            root.parent = nullptr;
+            model.nodes.push_back(root);
+        }
+
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const JsonValue &source = nodes[order[i]];
+            HierarchicalNode node;
+            node.name = names[order[i]];
+            node.localTransform = nodeLocalTransform(source);
+            size_t mesh = jsonSize(source["mesh"], SIZE_MAX);
+            if (mesh < meshIndices.size())
+                node.meshIndices = meshIndices[mesh];
+
+            if (parents[i] >= 0)
+                node.parent = &model.nodes[parents[i] + (syntheticRoot ? 1 : 0)];
+            else
+                node.parent = syntheticRoot ? &model.nodes[0] : nullptr;
+            model.nodes.push_back(node);
+            if (model.nodes.back().parent)
+                model.nodes.back().parent->children.push_back(&model.nodes.back());
+        }
+
+        for (HierarchicalNode &node : model.nodes)
+        {
+            node.currentTransform = node.localTransform;
+            node.basePosition = vec3(0.0f, 0.0f, 0.0f);
+            node.baseRotation = vec3(0.0f, 0.0f, 0.0f);
+            node.baseScale = vec3(1.0f, 1.0f, 1.0f);
+            node.animRotation = vec3(0.0f, 0.0f, 0.0f);
+            node.animTranslation = vec3(0.0f, 0.0f, 0.0f);
+        }
+        model.rootNode = model.nodes.empty() ? nullptr : &model.nodes[0];
+    }
+
+    ProfileScope animationScope("loadAnimations");
+    const JsonValue &animations = doc.json["animations"];
+    for (size_t a = 0; a < animations.size(); a++)
+    {
+        const JsonValue &animation = animations[a];
+        const JsonValue &samplers = animation["samplers"];
+        const JsonValue &channels = animation["channels"];
+
+        // Key times in milliseconds, the ticks Assimp reports for glTF.
+        Animation clip;
+        clip.name = animation["name"].asString();
+        clip.ticksPerSecond = 1000.0f;
+        clip.duration = 0.0f;
+
+        vector<int> channelOfNode(nodes.size(), -1);
+        vector<size_t> channelNodes;
+        for (size_t c = 0; c < channels.size(); c++)
+        {
+            const JsonValue &target = channels[c]["target"];
+            const string &path = target["path"].asString();
+            size_t node = jsonSize(target["node"], SIZE_MAX);
+            if (node >= nodes.size() || (path != "translation" && path != "rotation" && path != "scale"))
+                continue;
+
+            const JsonValue &sampler = samplers[jsonSize(channels[c]["sampler"], SIZE_MAX)];
+            vector<float> times;
+            if (!readAccessor(doc, sampler["input"].asInt(-1), times, error))
+                return false;
+
+            // Cubic spline outputs hold in-tangent, value, out-tangent per
+            // key; the animator interpolates linearly, so only values count.
+            const bool cubic = sampler["interpolation"].asString() == "CUBICSPLINE";
+            const size_t step = cubic ? 3 : 1;
+            const size_t offset = cubic ? 1 : 0;
+
+            if (channelOfNode[node] < 0)
+            {
+                channelOfNode[node] = static_cast<int>(clip.nodeAnimations.size());
+                channelNodes.push_back(node);
+                clip.nodeAnimations.push_back(NodeAnimation());
+                clip.nodeAnimations.back().nodeName = names[node];
+            }
+            NodeAnimation &nodeAnim = clip.nodeAnimations[channelOfNode[node]];
+
+            if (path == "rotation")
+            {
+                vector<vec4> values;
+                if (!readAccessor(doc, sampler["output"].asInt(-1), values, error))
+                    return false;
+                if (values.size() < times.size() * step)
+                {
+                    error = "animation sampler output too short";
+                    return false;
+                }
+                nodeAnim.rotationKeys.resize(times.size());
+                for (size_t k = 0; k < times.size(); k++)
+                {
+                    const vec4 &q = values[k * step + offset];
+                    nodeAnim.rotationKeys[k].time = times[k] * 1000.0f;
+                    nodeAnim.rotationKeys[k].value = quat(q.w, q.x, q.y, q.z);
+                }
+            }
+            else
+            {
+                vector<vec3> values;
+                if (!readAccessor(doc, sampler["output"].asInt(-1), values, error))
+                    return false;
+                if (values.size() < times.size() * step)
+                {
+                    error = "animation sampler output too short";
+                    return false;
+                }
+                vector<VectorKey> &keys = path == "translation" ? nodeAnim.positionKeys : nodeAnim.scaleKeys;
+                keys.resize(times.size());
+                for (size_t k = 0; k < times.size(); k++)
+                {
+                    keys[k].time = times[k] * 1000.0f;
+                    keys[k].value = values[k * step + offset];
+                }
+            }
+
+            if (!times.empty())
+                clip.duration = std::max(clip.duration, times.back() * 1000.0f);
+        }
+
+        // A node animated on some paths holds its rest value on the others.
+        for (size_t c = 0; c < clip.nodeAnimations.size(); c++)
+        {
+            NodeAnimation &nodeAnim = clip.nodeAnimations[c];
+            vec3 translation, scale;
+            quat rotation;
+            nodeRestPose(nodes[channelNodes[c]], translation, rotation, scale);
+            if (nodeAnim.positionKeys.empty())
+            {
+                VectorKey key = {0.0f, translation};
+                nodeAnim.positionKeys.push_back(key);
+            }
+            if (nodeAnim.rotationKeys.empty())
+            {
+                QuaternionKey key = {0.0f, rotation};
+                nodeAnim.rotationKeys.push_back(key);
+            }
+            if (nodeAnim.scaleKeys.empty())
+            {
+                VectorKey key = {0.0f, scale};
+                nodeAnim.scaleKeys.push_back(key);
+            }
+        }
+
+        if (!clip.nodeAnimations.empty())
+            model.asset->animationClips.push_back(clip);
+    }
+
+    if (model.asset->meshes.empty())
+    {
+        error = "no triangle geometry";
+        return false;
+    }
+    return true;
+}
+
+void setGltfImporter(GltfImporter importer)
+{
+    selectedImporter = importer;
+}
+
+GltfImporter gltfImporter()
+{
+    return selectedImporter;
+}
+
+void recordGltfImportComparison(const char *path, const GltfImportSample &native, const GltfImportSample &assimp)
+{
+    ComparisonRecord record;
+    record.path = path ? path : "";
+    record.native = native;
+    record.assimp = assimp;
+
+    lock_guard<mutex> lock(comparisonsMutex);
+    comparisons.push_back(record);
+
+    cout << "[gltf] " << record.path << ": native " << fixed << setprecision(1) << native.ms
+         << " ms, Assimp " << assimp.ms << " ms";
+    if (native.ms > 0.0)
+    {
+        cout << " (" << assimp.ms / native.ms << "x)";
+    }
+    if (native.vertices != assimp.vertices || native.triangles != assimp.triangles)
+    {
+        cout << "; vertices " << native.vertices << " vs " << assimp.vertices
+             << ", triangles " << native.triangles << " vs " << assimp.triangles;
+    }
+    cout << defaultfloat << endl;
+}
+
+void printGltfImportReport()
+{
+    lock_guard<mutex> lock(comparisonsMutex);
+    if (comparisons.empty())
+        return;
+
+    double totalNative = 0.0;
+    double totalAssimp = 0.0;
+
+    cout << "\n=== glTF importer comparison ===\n";
+    cout << left << setw(64) << "asset" << right << setw(8) << "meshes" << setw(12) << "triangles"
+         << setw(12) << "native ms" << setw(12) << "Assimp ms" << setw(10) << "speedup" << "\n";
+    for (const ComparisonRecord &r : comparisons)
+    {
+        cout << left << setw(64) << r.path << right << setw(8) << r.native.meshes << setw(12) << r.native.triangles
+             << fixed << setprecision(1) << setw(12) << r.native.ms << setw(12) << r.assimp.ms;
+        if (r.native.ms > 0.0)
+        {
+            cout << setw(9) << r.assimp.ms / r.native.ms << "x";
+        }
+        cout << "\n";
+
+        totalNative += r.native.ms;
+        totalAssimp += r.assimp.ms;
+    }
+    cout << left << setw(84) << "total" << right << setw(12) << totalNative << setw(12) << totalAssimp;
+    if (totalNative > 0.0)
+    {
+        cout << setw(9) << totalAssimp / totalNative << "x";
+    }
+    cout << defaultfloat << endl;
+}
@@ -41,6 +41,29 @@ void rebuildNodePointers(HierarchicalModel &hmodel,
     }
 }
 
+void copyNodeTree(HierarchicalModel &dst, const HierarchicalModel &src)
+{
+    dst.nodes = src.nodes;
+    dst.rootNode = nullptr;
+    if (src.nodes.empty())
+        return;
+
+    const HierarchicalNode *from = src.nodes.data();
+    HierarchicalNode *to = dst.nodes.data();
+    auto repoint = [from, to](HierarchicalNode *node) -> HierarchicalNode *
+    {
+        return node ? to + (node - from) : nullptr;
+    };
+
+    for (HierarchicalNode &node : dst.nodes)
+    {
+        node.parent = repoint(node.parent);
+        for (HierarchicalNode *&child : node.children)
+            child = repoint(child);
+    }
+    dst.rootNode = src.rootNode ? repoint(src.rootNode) : to;
+}
+
 void collectHierarchy(HierarchicalNode *node, vector<pair<string, string>> &pairs, string &rootName)
 {
     if (!node)
@@ -0,0 +1,956 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+#include "mesh_cache.h"
+#include "asset_pack.h"
+#include "baked_assets.h"
+#include "load_profiler.h"
+#include "animation_clips.h"
+#include "hash_utils.h"
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+    const uint32_t MESH_CACHE_MAGIC = 0x48534D44; // "DMSH"
+    const char *MESH_CACHE_DIR = "assets/cache";
+
+    bool cacheEnabled = true;
+
+    struct MeshLoadRecord
+    {
+        string path;
+        bool warm;
+        double loadMs;
+        double coldMs;
+    };
+
+    vector<MeshLoadRecord> loadRecords;
+    // Loads are recorded from the loader threads.
+    mutex loadRecordsMutex;
+
+    // Header fields before the stamp: five u32s, the hash and the size.
+    const long HEADER_STAMP_OFFSET = 5 * 4 + 8 + 8;
+
+    string getDirectory(const string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        if (slash == string::npos)
+            return "";
+        return path.substr(0, slash + 1);
+    }
+
+    bool endsWith(const string &s, const char *suffix)
+    {
+        size_t n = strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+
+    // .gltf files keep their geometry in side buffers, so those are part of
+    // the source too. Embedded data: URIs are already covered by the json.
+    vector<string> gltfBufferPaths(const string &sourcePath, const AssetFile &json)
+    {
+        vector<string> paths;
+        string text(reinterpret_cast<const char *>(json.data()), json.size());
+        string directory = getDirectory(sourcePath);
+        size_t pos = 0;
+        while ((pos = text.find("\"uri\"", pos)) != string::npos)
+        {
+            pos += 5;
+            size_t open = text.find('"', text.find(':', pos));
+            if (open == string::npos)
+                break;
+            size_t close = text.find('"', open + 1);
+            if (close == string::npos)
+                break;
+            string uri = text.substr(open + 1, close - open - 1);
+            pos = close + 1;
+
+            if (uri.compare(0, 5, "data:") == 0 || !endsWith(uri, ".bin"))
+                continue;
+            paths.push_back(directory + uri);
+        }
+        return paths;
+    }
+
+    // Size and stamp of the source and its buffers, from the file system
+    // or the pack index; only a .gltf's json is read.
+    bool stampMeshSource(const string &sourcePath, uint64_t &size, uint64_t &stamp)
+    {
+        ProfileScope scope("stampMeshSource");
+        if (!assetStamp(sourcePath.c_str(), size, stamp))
+            return false;
+        if (!endsWith(sourcePath, ".gltf"))
+            return true;
+
+        AssetFile json;
+        if (!json.open(sourcePath.c_str()))
+            return false;
+        stamp = fnv1a(&stamp, sizeof(stamp));
+        for (const string &path : gltfBufferPaths(sourcePath, json))
+        {
+            uint64_t bufferSize = 0;
+            uint64_t bufferStamp = 0;
+            if (!assetStamp(path.c_str(), bufferSize, bufferStamp))
+                continue;
+            size += bufferSize;
+            stamp = fnv1a(&bufferStamp, sizeof(bufferStamp), stamp);
+        }
+        return true;
+    }
+
+    // Content hash of the source and its buffers. Only needed when a cache
+    // entry is written or its stamp no longer matches.
+    uint64_t hashMeshSource(const string &sourcePath)
+    {
+        ProfileScope scope("hashMeshSource");
+        AssetFile source;
+        if (!source.open(sourcePath.c_str()))
+            return 0;
+
+        uint64_t hash = fnv1a(source.data(), source.size());
+        if (endsWith(sourcePath, ".gltf"))
+        {
+            for (const string &path : gltfBufferPaths(sourcePath, source))
+            {
+                AssetFile buffer;
+                if (buffer.open(path.c_str()))
+                    hash = fnv1a(buffer.data(), buffer.size(), hash);
+            }
+        }
+        return hash;
+    }
+
+    void makeCacheDirectory()
+    {
+#if defined(_WIN32)
+        _mkdir("assets");
+        _mkdir(MESH_CACHE_DIR);
+#else
+        mkdir("assets", 0755);
+        mkdir(MESH_CACHE_DIR, 0755);
+#endif
+    }
+
+    class CacheWriter
+    {
+    public:
+        vector<unsigned char> buffer;
+
+        void bytes(const void *data, size_t size)
+        {
+            const unsigned char *p = static_cast<const unsigned char *>(data);
+            buffer.insert(buffer.end(), p, p + size);
+        }
+
+        void u32(uint32_t v) { bytes(&v, sizeof(v)); }
+        void i32(int32_t v) { bytes(&v, sizeof(v)); }
+        void u64(uint64_t v) { bytes(&v, sizeof(v)); }
+        void f32(float v) { bytes(&v, sizeof(v)); }
+        void f64(double v) { bytes(&v, sizeof(v)); }
+        void matrix(const mat4 &m) { bytes(&m, sizeof(mat4)); }
+
+        void str(const string &s)
+        {
+            u32(static_cast<uint32_t>(s.size()));
+            bytes(s.data(), s.size());
+        }
+
+        template <typename T>
+        void array(const vector<T> &v)
+        {
+            u64(static_cast<uint64_t>(v.size()));
+            if (!v.empty())
+                bytes(v.data(), v.size() * sizeof(T));
+        }
+
+        size_t size() const { return buffer.size(); }
+
+        // Fills in a value written as a placeholder at offset.
+        void patchU64(size_t offset, uint64_t v)
+        {
+            memcpy(&buffer[offset], &v, sizeof(v));
+        }
+    };
+
+    class CacheReader
+    {
+    public:
+        CacheReader(const unsigned char *data, size_t size)
+            : begin(data), cur(data), end(data + size), ok(true)
+        {
+        }
+
+        bool good() const { return ok; }
+        size_t size() const { return static_cast<size_t>(end - begin); }
+
+        bool bytes(void *out, size_t size)
+        {
+            if (!ok || static_cast<size_t>(end - cur) < size)
+            {
+                ok = false;
+                return false;
+            }
+            memcpy(out, cur, size);
+            cur += size;
+            return true;
+        }
+
+        uint32_t u32()
+        {
+            uint32_t v = 0;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        int32_t i32()
+        {
+            int32_t v = 0;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        uint64_t u64()
+        {
+            uint64_t v = 0;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        float f32()
+        {
+            float v = 0.0f;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        double f64()
+        {
+            double v = 0.0;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        mat4 matrix()
+        {
+            mat4 m(1.0f);
+            bytes(&m, sizeof(mat4));
+            return m;
+        }
+
+        string str()
+        {
+            uint32_t size = u32();
+            if (!ok || static_cast<size_t>(end - cur) < size)
+            {
+                ok = false;
+                return string();
+            }
+            string s(reinterpret_cast<const char *>(cur), size);
+            cur += size;
+            return s;
+        }
+
+        template <typename T>
+        void array(vector<T> &out)
+        {
+            uint64_t count = u64();
+            if (!ok || count > static_cast<uint64_t>(end - cur) / sizeof(T))
+            {
+                ok = false;
+                out.clear();
+                return;
+            }
+            const T *first = reinterpret_cast<const T *>(cur);
+            out.assign(first, first + count);
+            cur += count * sizeof(T);
+        }
+
+        // An array left where it is: its bytes in the buffer, or nullptr.
+        template <typename T>
+        const unsigned char *view(size_t &size)
+        {
+            uint64_t count = u64();
+            size = 0;
+            if (!ok || count > static_cast<uint64_t>(end - cur) / sizeof(T))
+            {
+                ok = false;
+                return nullptr;
+            }
+            const unsigned char *first = cur;
+            size = static_cast<size_t>(count) * sizeof(T);
+            cur += size;
+            return first;
+        }
+
+        template <typename T>
+        void skip()
+        {
+            size_t size = 0;
+            view<T>(size);
+        }
+
+        size_t offset() const { return static_cast<size_t>(cur - begin); }
+
+    private:
+        const unsigned char *begin;
+        const unsigned char *cur;
+        const unsigned char *end;
+        bool ok;
+    };
+
+    void writeHeader(CacheWriter &w, const MeshCacheKey &key, double importMs)
+    {
+        w.u32(MESH_CACHE_MAGIC);
+        w.u32(MESH_CACHE_VERSION);
+        w.u32(static_cast<uint32_t>(key.kind));
+        w.u32(key.importFlags);
+        w.u32(key.vertexAttributes);
+        w.u64(key.baked ? 0 : hashMeshSource(key.sourcePath));
+        w.u64(key.sourceSize);
+        w.u64(key.sourceStamp);
+        w.f64(importMs);
+    }
+
+    // staleStamp is set when the entry is still good but was written under
+    // another stamp (the source was touched, or moved into the pack).
+    bool readHeader(CacheReader &r, const MeshCacheKey &key, double &importMs, bool &staleStamp,
+                    uint32_t &storedAttributes)
+    {
+        staleStamp = false;
+        if (r.u32() != MESH_CACHE_MAGIC)
+            return false;
+        if (r.u32() != MESH_CACHE_VERSION)
+            return false;
+        if (r.u32() != static_cast<uint32_t>(key.kind))
+            return false;
+        if (r.u32() != key.importFlags)
+            return false;
+        storedAttributes = r.u32();
+        if ((storedAttributes & key.vertexAttributes) != key.vertexAttributes)
+            return false;
+        uint64_t hash = r.u64();
+        if (r.u64() != key.sourceSize)
+            return false;
+        if (r.u64() != key.sourceStamp)
+        {
+            if (key.baked || hash != hashMeshSource(key.sourcePath))
+                return false;
+            staleStamp = true;
+        }
+        importMs = r.f64();
+        return r.good();
+    }
+
+    // Records the current stamp in an entry found good by its hash, so the
+    // next load trusts the stamp again.
+    void refreshCacheStamp(const MeshCacheKey &key)
+    {
+        FILE *file = fopen(key.cachePath.c_str(), "r+b");
+        if (!file)
+            return;
+        if (fseek(file, HEADER_STAMP_OFFSET, SEEK_SET) == 0)
+            fwrite(&key.sourceStamp, sizeof(key.sourceStamp), 1, file);
+        fclose(file);
+    }
+
+    // Each mesh starts with its CPU streams, which a warm load skips and
+    // decodes later only if asked to keep them (readMeshCacheStreams), and
+    // ends with the vertex and element buffers exactly as uploaded.
+    void writeMesh(CacheWriter &w, const MeshInstance &mesh)
+    {
+        w.array(mesh.vertices);
+        w.array(mesh.normals);
+        w.array(mesh.texcoords);
+        w.array(mesh.colors);
+        w.array(mesh.indices);
+        w.array(mesh.lodIndices);
+        w.array(mesh.boneIds);
+        w.array(mesh.boneWeights);
+
+        w.array(mesh.lods);
+        w.array(mesh.clusters);
+
+        w.u32(mesh.hasBones ? 1 : 0);
+        if (mesh.hasBones)
+        {
+            w.array(mesh.boneMatrices);
+            w.i32(mesh.boneInfluences);
+            w.u32(static_cast<uint32_t>(mesh.boneNameToIndex.size()));
+            for (const auto &bone : mesh.boneNameToIndex)
+            {
+                w.str(bone.first);
+                w.i32(bone.second);
+            }
+        }
+
+        w.u32(static_cast<uint32_t>(mesh.diffuseRef.source));
+        w.str(mesh.diffuseRef.path);
+        w.array(mesh.diffuseRef.data);
+        w.i32(mesh.diffuseRef.width);
+        w.i32(mesh.diffuseRef.height);
+
+        const PackedVertexLayout &layout = mesh.vertexLayout;
+        w.i32(layout.stride);
+        w.u32((layout.skinned ? 1u : 0u) | (layout.wideBoneIds ? 2u : 0u) | (layout.hasTexcoords ? 4u : 0u) |
+              (layout.hasColors ? 8u : 0u) | (mesh.hasNormals ? 16u : 0u));
+        w.i32(layout.texcoordOffset);
+        w.i32(layout.colorOffset);
+        w.i32(layout.boneIdOffset);
+        w.i32(layout.weightOffset);
+        w.i32(mesh.vertexCount);
+        w.bytes(&mesh.boundsMin, sizeof(vec3));
+        w.bytes(&mesh.boundsMax, sizeof(vec3));
+
+        vector<unsigned char> elements;
+        w.u32(packMeshElements(mesh, elements));
+        w.i32(static_cast<int32_t>(mesh.indices.size()));
+        w.array(mesh.packedVertices);
+        w.array(elements);
+    }
+
+    void readStreams(CacheReader &r, MeshInstance &mesh, unsigned int streams)
+    {
+        if (streams & MESH_CPU_POSITIONS)
+            r.array(mesh.vertices);
+        else
+            r.skip<vec3>();
+
+        if (streams & MESH_CPU_ATTRIBUTES)
+        {
+            r.array(mesh.normals);
+            r.array(mesh.texcoords);
+            r.array(mesh.colors);
+        }
+        else
+        {
+            r.skip<vec3>();
+            r.skip<vec2>();
+            r.skip<vec3>();
+        }
+
+        if (streams & MESH_CPU_INDICES)
+        {
+            r.array(mesh.indices);
+            r.array(mesh.lodIndices);
+        }
+        else
+        {
+            r.skip<unsigned int>();
+            r.skip<unsigned int>();
+        }
+
+        if (streams & MESH_CPU_SKIN)
+        {
+            r.array(mesh.boneIds);
+            r.array(mesh.boneWeights);
+        }
+        else
+        {
+            r.skip<ivec4>();
+            r.skip<vec4>();
+        }
+    }
+
+    // Everything but the CPU streams, with the buffers left in the file
+    // for view to point at. An entry packed for more vertex attributes than
+    // are used now has its streams read instead, to be packed again without
+    // the extra ones.
+    bool readMesh(CacheReader &r, MeshInstance &mesh, const shared_ptr<AssetFile> &file, bool repack)
+    {
+        shared_ptr<MeshCacheView> view = make_shared<MeshCacheView>();
+        view->file = file;
+        view->streamsOffset = r.offset();
+        readStreams(r, mesh, repack ? MESH_CPU_ALL : MESH_CPU_NONE);
+        mesh.cpuStreams = repack ? MESH_CPU_ALL : MESH_CPU_NONE;
+
+        r.array(mesh.lods);
+        r.array(mesh.clusters);
+
+        mesh.hasBones = r.u32() != 0;
+        mesh.boneInfluences = 0;
+        if (mesh.hasBones)
+        {
+            r.array(mesh.boneMatrices);
+            mesh.boneInfluences = r.i32();
+            uint32_t boneCount = r.u32();
+            for (uint32_t b = 0; b < boneCount && r.good(); b++)
+            {
+                string name = r.str();
+                mesh.boneNameToIndex[name] = r.i32();
+            }
+        }
+
+        mesh.diffuseRef.source = static_cast<TextureRef::Source>(r.u32());
+        mesh.diffuseRef.path = r.str();
+        r.array(mesh.diffuseRef.data);
+        mesh.diffuseRef.width = r.i32();
+        mesh.diffuseRef.height = r.i32();
+
+        PackedVertexLayout &layout = mesh.vertexLayout;
+        layout.stride = r.i32();
+        uint32_t flags = r.u32();
+        layout.skinned = (flags & 1u) != 0;
+        layout.wideBoneIds = (flags & 2u) != 0;
+        layout.hasTexcoords = (flags & 4u) != 0;
+        layout.hasColors = (flags & 8u) != 0;
+        mesh.hasNormals = (flags & 16u) != 0;
+        layout.texcoordOffset = r.i32();
+        layout.colorOffset = r.i32();
+        layout.boneIdOffset = r.i32();
+        layout.weightOffset = r.i32();
+        mesh.vertexCount = r.i32();
+        r.bytes(&mesh.boundsMin, sizeof(vec3));
+        r.bytes(&mesh.boundsMax, sizeof(vec3));
+
+        mesh.indexType = static_cast<GLenum>(r.u32());
+        mesh.indexCount = r.i32();
+        view->vertexData = r.view<unsigned char>(view->vertexSize);
+        view->elementData = r.view<unsigned char>(view->elementSize);
+        if (!r.good() || layout.stride <= 0 ||
+            view->vertexSize != static_cast<size_t>(mesh.vertexCount) * layout.stride ||
+            (mesh.indexType != GL_UNSIGNED_SHORT && mesh.indexType != GL_UNSIGNED_INT))
+            return false;
+
+        if (!repack)
+            mesh.cacheView = view;
+        return true;
+    }
+
+    // Clips are stored as an index (name, duration, rate and the byte range
+    // of the keyframes) followed by the keyframe bodies, so a load can read
+    // the index alone and decode a body when the clip is first played.
+    void writeClips(CacheWriter &w, const vector<Animation> &clips)
+    {
+        w.u32(static_cast<uint32_t>(clips.size()));
+        vector<size_t> rangeFields;
+        for (const Animation &clip : clips)
+        {
+            w.str(clip.name);
+            w.f32(clip.duration);
+            w.f32(clip.ticksPerSecond);
+            rangeFields.push_back(w.size());
+            w.u64(0);
+            w.u64(0);
+        }
+
+        for (size_t a = 0; a < clips.size(); a++)
+        {
+            const Animation &clip = clips[a];
+            size_t start = w.size();
+            // The name is repeated so a body read on its own can be checked
+            // against the index it was found through.
+            w.str(clip.name);
+            w.u32(static_cast<uint32_t>(clip.nodeAnimations.size()));
+            for (const NodeAnimation &channel : clip.nodeAnimations)
+            {
+                w.str(channel.nodeName);
+                w.array(channel.positionKeys);
+                w.array(channel.rotationKeys);
+                w.array(channel.scaleKeys);
+            }
+            w.patchU64(rangeFields[a], start);
+            w.patchU64(rangeFields[a] + sizeof(uint64_t), w.size() - start);
+        }
+    }
+
+    bool readClipBody(CacheReader &r, Animation &clip)
+    {
+        if (r.str() != clip.name)
+            return false;
+
+        uint32_t channelCount = r.u32();
+        vector<NodeAnimation> channels(r.good() ? channelCount : 0);
+        for (uint32_t c = 0; c < channelCount && r.good(); c++)
+        {
+            NodeAnimation &channel = channels[c];
+            channel.nodeName = r.str();
+            r.array(channel.positionKeys);
+            r.array(channel.rotationKeys);
+            r.array(channel.scaleKeys);
+        }
+        if (!r.good())
+            return false;
+        clip.nodeAnimations.swap(channels);
+        return true;
+    }
+
+    bool readClipIndex(CacheReader &r, vector<Animation> &clips)
+    {
+        uint32_t clipCount = r.u32();
+        clips.assign(r.good() ? clipCount : 0, Animation());
+        for (uint32_t a = 0; a < clipCount && r.good(); a++)
+        {
+            Animation &clip = clips[a];
+            clip.name = r.str();
+            clip.duration = r.f32();
+            clip.ticksPerSecond = r.f32();
+            clip.sourceOffset = r.u64();
+            clip.sourceSize = r.u64();
+            clip.resident = false;
+            if (clip.sourceSize == 0 || clip.sourceOffset > r.size() ||
+                clip.sourceSize > r.size() - clip.sourceOffset)
+                return false;
+        }
+        return r.good();
+    }
+
+    bool commitCacheFile(const MeshCacheKey &key, const CacheWriter &w)
+    {
+        // The build creates the bake output directory.
+        if (!key.baked)
+            makeCacheDirectory();
+
+        // Write to a temporary name first so an interrupted write never
+        // leaves a truncated cache behind under the real name.
+        string tempPath = key.cachePath + ".tmp";
+        FILE *file = fopen(tempPath.c_str(), "wb");
+        if (!file)
+        {
+            cerr << "mesh cache: cannot write '" << tempPath << "'\n";
+            return false;
+        }
+        size_t written = fwrite(w.buffer.data(), 1, w.buffer.size(), file);
+        fclose(file);
+        if (written != w.buffer.size())
+        {
+            remove(tempPath.c_str());
+            return false;
+        }
+        remove(key.cachePath.c_str());
+        return rename(tempPath.c_str(), key.cachePath.c_str()) == 0;
+    }
+}
+
+MeshCacheKey makeMeshCacheKey(const char *sourcePath, MeshCacheKind kind, uint32_t importFlags)
+{
+    MeshCacheKey key;
+    key.sourcePath = sourcePath ? sourcePath : "";
+    key.kind = kind;
+    key.importFlags = importFlags;
+    key.vertexAttributes = usedVertexAttributes();
+    key.sourceSize = 0;
+    key.sourceStamp = 0;
+    key.valid = false;
+    key.baked = false;
+    key.cachePath = string(MESH_CACHE_DIR) + "/" + flattenAssetPath(key.sourcePath) +
+                    (kind == MESH_CACHE_HIERARCHICAL ? ".hier" : ".static") + ".mcache";
+
+    if (!cacheEnabled)
+        return key;
+
+    key.valid = stampMeshSource(key.sourcePath, key.sourceSize, key.sourceStamp);
+    return key;
+}
+
+MeshCacheKey makeBakedMeshKey(const char *sourcePath, MeshCacheKind kind, uint32_t importFlags,
+                              const char *outputPath)
+{
+    MeshCacheKey key;
+    key.sourcePath = sourcePath ? sourcePath : "";
+    key.kind = kind;
+    key.importFlags = importFlags;
+    key.vertexAttributes = usedVertexAttributes();
+    key.sourceSize = 0;
+    key.sourceStamp = 0;
+    key.valid = true;
+    key.baked = true;
+    key.cachePath = outputPath ? string(outputPath)
+                               : bakedAssetPath(key.sourcePath, kind == MESH_CACHE_HIERARCHICAL ? ".hier.mcache"
+                                                                                              : ".static.mcache");
+    return key;
+}
+
+string meshCachePath(const char *sourcePath, MeshCacheKind kind)
+{
+    string source = sourcePath ? sourcePath : "";
+    const char *suffix = kind == MESH_CACHE_HIERARCHICAL ? ".hier.mcache" : ".static.mcache";
+    if (MESH_BAKED_ONLY)
+        return bakedAssetPath(source, suffix);
+    return string(MESH_CACHE_DIR) + "/" + flattenAssetPath(source) + suffix;
+}
+
+bool readStaticMeshCache(const MeshCacheKey &key, vector<MeshInstance> &meshes, double &importMs)
+{
+    ProfileScope scope("readMeshCache");
+    if ((!cacheEnabled && !key.baked) || !key.valid)
+        return false;
+
+    shared_ptr<AssetFile> file = make_shared<AssetFile>();
+    if (!file->open(key.cachePath.c_str()))
+        return false;
+
+    CacheReader r(file->data(), file->size());
+    bool staleStamp = false;
+    uint32_t storedAttributes = 0;
+    if (!readHeader(r, key, importMs, staleStamp, storedAttributes))
+        return false;
+    bool repack = storedAttributes != key.vertexAttributes;
+
+    uint32_t meshCount = r.u32();
+    vector<MeshInstance> loaded(r.good() ? meshCount : 0);
+    for (uint32_t m = 0; m < meshCount && r.good(); m++)
+    {
+        if (!readMesh(r, loaded[m], file, repack))
+            return false;
+    }
+    if (!r.good() || loaded.empty())
+        return false;
+
+    meshes.swap(loaded);
+    if (staleStamp)
+        refreshCacheStamp(key);
+    return true;
+}
+
+bool writeStaticMeshCache(const MeshCacheKey &key, const vector<MeshInstance> &meshes, double importMs)
+{
+    ProfileScope scope("writeMeshCache");
+    if ((!cacheEnabled && !key.baked) || !key.valid)
+        return false;
+
+    CacheWriter w;
+    writeHeader(w, key, importMs);
+    w.u32(static_cast<uint32_t>(meshes.size()));
+    for (const MeshInstance &mesh : meshes)
+    {
+        writeMesh(w, mesh);
+    }
+    return commitCacheFile(key, w);
+}
+
+bool readHierarchicalMeshCache(const MeshCacheKey &key, HierarchicalModel &model, double &importMs)
+{
+    ProfileScope scope("readMeshCache");
+    if ((!cacheEnabled && !key.baked) || !key.valid)
+        return false;
+
+    shared_ptr<AssetFile> file = make_shared<AssetFile>();
+    if (!file->open(key.cachePath.c_str()))
+        return false;
+
+    CacheReader r(file->data(), file->size());
+    bool staleStamp = false;
+    uint32_t storedAttributes = 0;
+    if (!readHeader(r, key, importMs, staleStamp, storedAttributes))
+        return false;
+    bool repack = storedAttributes != key.vertexAttributes;
+
+    uint32_t meshCount = r.u32();
+    vector<MeshInstance> meshes(r.good() ? meshCount : 0);
+    for (uint32_t m = 0; m < meshCount && r.good(); m++)
+    {
+        if (!readMesh(r, meshes[m], file, repack))
+            return false;
+    }
+
+    mat4 globalInverse = r.matrix();
+    mat4 originalRoot = r.matrix();
+
+    // Nodes are stored in pre-order with parent indices, so every parent is
+    // already in place when its children are read back.
+    uint32_t nodeCount = r.u32();
+    vector<HierarchicalNode> nodes;
+    nodes.reserve(r.good() ? nodeCount : 0);
+    for (uint32_t n = 0; n < nodeCount && r.good(); n++)
+    {
+        HierarchicalNode node;
+        node.name = r.str();
+        node.localTransform = r.matrix();
+        node.currentTransform = node.localTransform;
+        int32_t parentIdx = r.i32();
+        r.array(node.meshIndices);
+
+        if (parentIdx >= static_cast<int32_t>(n) || (n > 0 && parentIdx < 0))
+            return false;
+
+        node.parent = parentIdx >= 0 ? &nodes[parentIdx] : nullptr;
+        node.basePosition = vec3(0.0f, 0.0f, 0.0f);
+        node.baseRotation = vec3(0.0f, 0.0f, 0.0f);
+        node.baseScale = vec3(1.0f, 1.0f, 1.0f);
+        node.animRotation = vec3(0.0f, 0.0f, 0.0f);
+        node.animTranslation = vec3(0.0f, 0.0f, 0.0f);
+        node.animationTransform = mat4(1.0f);
+        node.hasAnimationTransform = false;
+
+        nodes.push_back(node);
+        if (node.parent)
+        {
+            node.parent->children.push_back(&nodes.back());
+        }
+    }
+
+    vector<Animation> clips;
+    if (!readClipIndex(r, clips))
+        return false;
+    if (!lazyAnimationClips())
+    {
+        for (Animation &clip : clips)
+        {
+            CacheReader body(file->data() + clip.sourceOffset, static_cast<size_t>(clip.sourceSize));
+            if (!readClipBody(body, clip))
+                return false;
+            clip.resident = true;
+        }
+    }
+
+    if (!r.good() || meshes.empty() || nodes.empty())
+        return false;
+
+    if (!model.asset)
+    {
+        model.asset = make_shared<ModelAsset>();
+        model.asset->path = key.sourcePath;
+        model.asset->refCount = 0;
+        model.asset->loadMs = 0.0;
+        model.asset->keepCpuStreams = MESH_CPU_NONE;
+        model.asset->cpuBytesReleased = 0;
+    }
+    model.asset->meshes.swap(meshes);
+    model.asset->animationClips.swap(clips);
+    model.asset->clipSource = key.cachePath;
+    model.nodes.swap(nodes);
+    model.rootNode = &model.nodes[0];
+    model.globalInverseTransform = globalInverse;
+    model.originalRootTransform = originalRoot;
+    if (staleStamp)
+        refreshCacheStamp(key);
+    return true;
+}
+
+bool writeHierarchicalMeshCache(const MeshCacheKey &key, const HierarchicalModel &model, double importMs)
+{
+    ProfileScope scope("writeMeshCache");
+    if ((!cacheEnabled && !key.baked) || !key.valid || model.nodes.empty() || !model.asset)
+        return false;
+
+    CacheWriter w;
+    writeHeader(w, key, importMs);
+
+    w.u32(static_cast<uint32_t>(model.asset->meshes.size()));
+    for (const MeshInstance &mesh : model.asset->meshes)
+    {
+        writeMesh(w, mesh);
+    }
+
+    w.matrix(model.globalInverseTransform);
+    w.matrix(model.originalRootTransform);
+
+    w.u32(static_cast<uint32_t>(model.nodes.size()));
+    for (const HierarchicalNode &node : model.nodes)
+    {
+        w.str(node.name);
+        w.matrix(node.localTransform);
+        w.i32(node.parent ? static_cast<int32_t>(node.parent - &model.nodes[0]) : -1);
+        w.array(node.meshIndices);
+    }
+
+    writeClips(w, model.asset->animationClips);
+    return commitCacheFile(key, w);
+}
+
+bool readMeshCacheClip(const string &cachePath, Animation &clip)
+{
+    ProfileScope scope("readClip", clip.name);
+    AssetFile file;
+    if (clip.sourceSize == 0 || !file.open(cachePath.c_str()))
+        return false;
+
+    CacheReader header(file.data(), file.size());
+    if (header.u32() != MESH_CACHE_MAGIC || header.u32() != MESH_CACHE_VERSION)
+        return false;
+    if (clip.sourceOffset > file.size() || clip.sourceSize > file.size() - clip.sourceOffset)
+        return false;
+
+    CacheReader body(file.data() + clip.sourceOffset, static_cast<size_t>(clip.sourceSize));
+    return readClipBody(body, clip);
+}
+
+bool readMeshCacheStreams(MeshInstance &mesh, unsigned int streams)
+{
+    if (!mesh.cacheView || streams == MESH_CPU_NONE)
+        return false;
+
+    ProfileScope scope("readMeshCacheStreams");
+    const AssetFile &file = *mesh.cacheView->file;
+    size_t offset = mesh.cacheView->streamsOffset;
+    CacheReader r(file.data() + offset, file.size() - offset);
+    readStreams(r, mesh, streams);
+    if (!r.good())
+        return false;
+    mesh.cpuStreams |= streams;
+    return true;
+}
+
+void setMeshCacheEnabled(bool enabled)
+{
+    cacheEnabled = enabled;
+}
+
+bool isMeshCacheEnabled()
+{
+    return cacheEnabled;
+}
+
+void recordMeshLoadTiming(const char *sourcePath, bool warm, double loadMs, double coldMs)
+{
+    MeshLoadRecord record;
+    record.path = sourcePath ? sourcePath : "";
+    record.warm = warm;
+    record.loadMs = loadMs;
+    record.coldMs = coldMs;
+
+    lock_guard<mutex> lock(loadRecordsMutex);
+    loadRecords.push_back(record);
+
+    cout << (warm ? "[warm] " : "[cold] ") << record.path << ": "
+         << fixed << setprecision(1) << loadMs << " ms";
+    if (warm && coldMs > 0.0)
+    {
+        cout << " (cold import was " << coldMs << " ms)";
+    }
+    cout << defaultfloat << endl;
+}
+
+void printMeshCacheReport()
+{
+    lock_guard<mutex> lock(loadRecordsMutex);
+    if (loadRecords.empty())
+        return;
+
+    double totalLoad = 0.0;
+    double totalCold = 0.0;
+    int warmCount = 0;
+
+    cout << "\n=== Mesh load report ===\n";
+    cout << left << setw(64) << "asset" << setw(8) << "path"
+         << right << setw(12) << "load ms" << setw(12) << "cold ms" << setw(10) << "speedup" << "\n";
+    for (const MeshLoadRecord &r : loadRecords)
+    {
+        cout << left << setw(64) << r.path << setw(8) << (r.warm ? "warm" : "cold")
+             << right << fixed << setprecision(1) << setw(12) << r.loadMs << setw(12) << r.coldMs;
+        if (r.warm && r.loadMs > 0.0 && r.coldMs > 0.0)
+        {
+            cout << setw(9) << r.coldMs / r.loadMs << "x";
+        }
+        cout << "\n";
+
+        totalLoad += r.loadMs;
+        totalCold += r.coldMs;
+        if (r.warm)
+            warmCount++;
+    }
+    cout << left << setw(72) << "total" << right << setw(12) << totalLoad << setw(12) << totalCold << "\n";
+    cout << warmCount << "/" << loadRecords.size() << " loads served from the mesh cache\n"
+         << defaultfloat << endl;
+}
@@ -2,6 +2,11 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <set>
 #include <assimp/scene.h>
 #include <assimp/cimport.h>
 #include <assimp/postprocess.h>
@@ -10,7 +15,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "mesh_loader.h"
-#include "texture_loader.h"
+#include "asset_pack.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "skin_compaction.h"
+#include "gltf_loader.h"
+#include "texture_cache.h"
+#include "texture_decode.h"
+#include "load_profiler.h"
+#include "alloc_counter.h"
 #include "glm_compat.h"
 #include "transform_utils.h"
 
@@ -50,38 +64,49 @@ namespace
         return directory + texturePath;
     }
 
-    GLuint loadEmbeddedTexture(const aiScene *scene, const string &texPath)
+    bool resolveEmbeddedTexture(const aiScene *scene, const string &texPath, TextureRef &ref)
     {
         if (!scene)
-            return 0;
+            return false;
 
         const aiTexture *embedded = scene->GetEmbeddedTexture(texPath.c_str());
         if (!embedded)
         {
-            return 0;
+            return false;
         }
 
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(embedded->pcData);
         if (embedded->mHeight == 0)
         {
-            const unsigned char *data = reinterpret_cast<const unsigned char *>(embedded->pcData);
             size_t dataSize = static_cast<size_t>(embedded->mWidth);
-            return LoadTextureFromMemory(data, dataSize, true, false, nullptr, nullptr, nullptr);
+            ref.source = TextureRef::EMBEDDED_COMPRESSED;
+            ref.data.assign(data, data + dataSize);
+            ref.width = 0;
+            ref.height = 0;
         }
         else
         {
             size_t pixelCount = static_cast<size_t>(embedded->mWidth) * static_cast<size_t>(embedded->mHeight);
-            vector<unsigned char> pixels(pixelCount * 4);
-            memcpy(pixels.data(), embedded->pcData, pixels.size());
-            return UploadTextureFromPixels(pixels.data(), embedded->mWidth, embedded->mHeight, 4, true);
+            ref.source = TextureRef::EMBEDDED_RAW;
+            ref.data.assign(data, data + pixelCount * 4);
+            ref.width = static_cast<int>(embedded->mWidth);
+            ref.height = static_cast<int>(embedded->mHeight);
         }
+        return true;
     }
 
-    GLuint loadMaterialTexture(const aiScene *scene,
-                               const aiMaterial *material,
-                               const string &modelPath)
+    TextureRef resolveMaterialTexture(const aiScene *scene,
+                                      const aiMaterial *material,
+                                      const string &modelPath)
     {
+        TextureRef ref;
+        ref.source = TextureRef::NONE;
+        ref.width = 0;
+        ref.height = 0;
+        ref.channels = 0;
+
         if (!scene || !material)
-            return 0;
+            return ref;
 
         const aiTextureType textureTypes[] = {
             aiTextureType_DIFFUSE,
@@ -98,29 +123,61 @@ namespace
             string texPathStr = texPath.C_Str();
             if (!texPathStr.empty() && texPathStr[0] == '*')
             {
-                GLuint tex = loadEmbeddedTexture(scene, texPathStr);
-                if (tex != 0)
+                if (resolveEmbeddedTexture(scene, texPathStr, ref))
                 {
-                    return tex;
+                    return ref;
                 }
                 continue;
             }
 
             string fullPath = buildTexturePath(modelPath, texPathStr);
-            GLuint tex = LoadTexture(fullPath.c_str(), true, true, nullptr, nullptr, nullptr);
-            if (tex != 0)
+            if (assetExists(fullPath.c_str()))
             {
-                return tex;
+                ref.source = TextureRef::FILE_PATH;
+                ref.path = fullPath;
+                return ref;
             }
 
-            cerr << "loadMaterialTexture: failed to load external texture '"
+            cerr << "resolveMaterialTexture: cannot open external texture '"
                  << fullPath << "' referenced by '" << modelPath << "'\n";
         }
 
-        return 0;
+        return ref;
     }
 }
 
+// Decodes each distinct image of an import once. Meshes repeating an image
+// already decoded in this import, or already resident in the texture cache,
+// pick it up from the cache at upload time instead. Deferred images stay
+// encoded; the upload hands them to texture streaming.
+static void decodeMeshTexture(MeshInstance &instance, set<string> &decodedKeys)
+{
+    if (lazyTextureLoading())
+        return;
+
+    TextureRef &ref = instance.diffuseRef;
+    ref.cacheKey = textureCacheKey(ref, true, ref.source == TextureRef::FILE_PATH);
+    if (ref.cacheKey.empty())
+        return;
+
+    if (!decodedKeys.insert(ref.cacheKey).second)
+    {
+        vector<unsigned char>().swap(ref.data);
+        recordTextureDecode(true);
+        return;
+    }
+    if (isTextureCached(ref.cacheKey))
+    {
+        // Encoded bytes stay until upload in case the texture is released
+        // in the meantime.
+        recordTextureDecode(true);
+        return;
+    }
+
+    decodeTexturePixels(ref);
+    recordTextureDecode(false);
+}
+
 static mat4 convertAiMatrix(const aiMatrix4x4 &aiMat)
 {
     mat4 to;
@@ -190,269 +247,226 @@ static void buildNodeNameMap(HierarchicalModel &result)
     }
 }
 
+static_assert(sizeof(aiVector3D) == sizeof(vec3), "processMesh copies aiVector3D arrays as vec3");
+
 static MeshInstance processMesh(const aiMesh *mesh, const aiScene *scene, const char *filePath)
 {
+    ProfileScope scope("processMesh");
     MeshInstance instance{};
 
-    for (unsigned int v = 0; v < mesh->mNumVertices; v++)
-    {
-        instance.vertices.push_back(vec3(
-            mesh->mVertices[v].x,
-            mesh->mVertices[v].y,
-            mesh->mVertices[v].z));
+    // Streams the file lacks or the mesh program never reads are left
+    // empty; packing then leaves them out and the shader sees constants.
+    const unsigned int used = usedVertexAttributes();
+    const bool keepTexcoords = (used & VERTEX_ATTRIB_TEXCOORD) && mesh->HasTextureCoords(0);
+    const bool keepColors = (used & VERTEX_ATTRIB_COLOR) && mesh->HasVertexColors(0);
 
-        if (mesh->HasNormals())
-        {
-            instance.normals.push_back(vec3(
-                mesh->mNormals[v].x,
-                mesh->mNormals[v].y,
-                mesh->mNormals[v].z));
-        }
+    // aiVector3D is three floats, laid out like vec3, so positions and
+    // normals are copied in bulk. Every stream is sized once up front.
+    const size_t vertexCount = mesh->mNumVertices;
+    instance.vertices.resize(vertexCount);
+    if (vertexCount > 0)
+        memcpy(static_cast<void *>(instance.vertices.data()), mesh->mVertices, vertexCount * sizeof(vec3));
 
-        if (mesh->HasTextureCoords(0))
-        {
-            instance.texcoords.push_back(vec2(
-                mesh->mTextureCoords[0][v].x,
-                mesh->mTextureCoords[0][v].y));
-        }
-        else
-        {
-            instance.texcoords.push_back(vec2(0.0f, 0.0f));
-        }
+    if (mesh->HasNormals())
+    {
+        instance.normals.resize(vertexCount);
+        if (vertexCount > 0)
+            memcpy(static_cast<void *>(instance.normals.data()), mesh->mNormals, vertexCount * sizeof(vec3));
+    }
 
-        if (mesh->HasVertexColors(0))
-        {
-            instance.colors.push_back(vec3(
-                mesh->mColors[0][v].r,
-                mesh->mColors[0][v].g,
-                mesh->mColors[0][v].b));
-        }
-        else
-        {
-            instance.colors.push_back(vec3(1.0f, 1.0f, 1.0f));
-        }
+    if (keepTexcoords)
+    {
+        instance.texcoords.resize(vertexCount);
+        const aiVector3D *uvs = mesh->mTextureCoords[0];
+        for (size_t v = 0; v < vertexCount; v++)
+            instance.texcoords[v] = vec2(uvs[v].x, uvs[v].y);
+    }
+
+    if (keepColors)
+    {
+        instance.colors.resize(vertexCount);
+        const aiColor4D *colors = mesh->mColors[0];
+        for (size_t v = 0; v < vertexCount; v++)
+            instance.colors[v] = vec3(colors[v].r, colors[v].g, colors[v].b);
     }
 
+    // Triangulated, so nearly every face has three indices; points and
+    // lines only make the reservation generous.
+    instance.indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
     for (unsigned int f = 0; f < mesh->mNumFaces; f++)
     {
-        aiFace face = mesh->mFaces[f];
-        for (unsigned int i = 0; i < face.mNumIndices; i++)
-        {
-            instance.indices.push_back(face.mIndices[i]);
-        }
+        const aiFace &face = mesh->mFaces[f];
+        instance.indices.insert(instance.indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
     }
 
     instance.hasBones = false;
-    instance.boneIds.resize(instance.vertices.size(), ivec4(-1, -1, -1, -1));
-    instance.boneWeights.resize(instance.vertices.size(), vec4(0.0f, 0.0f, 0.0f, 0.0f));
+    instance.boneInfluences = 0;
     instance.boneMatrices.clear();
     instance.boneNameToIndex.clear();
-    instance.VBO_boneIds = 0;
-    instance.VBO_boneWeights = 0;
 
     const aiMaterial *material = (mesh->mMaterialIndex >= 0 && mesh->mMaterialIndex < static_cast<int>(scene->mNumMaterials))
                                      ? scene->mMaterials[mesh->mMaterialIndex]
                                      : nullptr;
-    instance.diffuseTexture = loadMaterialTexture(scene, material, filePath);
-    instance.hasDiffuseTexture = instance.diffuseTexture != 0;
+    instance.diffuseRef = resolveMaterialTexture(scene, material, filePath);
 
     return instance;
 }
 
-static void processBones(MeshInstance &instance, const aiMesh *mesh)
+// Gathers every influence the file lists and hands them to compactSkin.
+static SkinCompactionStats processBones(MeshInstance &instance, const aiMesh *mesh)
 {
+    ProfileScope scope("processBones");
+    instance.boneInfluences = 0;
     if (!mesh->HasBones())
     {
-        return;
+        SkinCompactionStats none = {0, 0, 0, 0};
+        return none;
     }
 
-    instance.hasBones = true;
+    const size_t vertexCount = instance.vertices.size();
+    SkinInfluences influences;
+    influences.reset(vertexCount);
+    vector<string> boneNames;
+    vector<mat4> boneOffsets;
+    vector<int> boneSlots(mesh->mNumBones);
+    map<string, int> listedBones;
+    boneNames.reserve(mesh->mNumBones);
+    boneOffsets.reserve(mesh->mNumBones);
 
     for (unsigned int b = 0; b < mesh->mNumBones; b++)
     {
         const aiBone *bone = mesh->mBones[b];
         string boneName = string(bone->mName.C_Str());
 
-        int boneIndex;
-        auto it = instance.boneNameToIndex.find(boneName);
-        if (it == instance.boneNameToIndex.end())
+        auto it = listedBones.find(boneName);
+        if (it == listedBones.end())
         {
-            boneIndex = static_cast<int>(instance.boneMatrices.size());
-            instance.boneNameToIndex[boneName] = boneIndex;
-            instance.boneMatrices.push_back(convertAiMatrix(bone->mOffsetMatrix));
+            boneSlots[b] = static_cast<int>(boneNames.size());
+            listedBones[boneName] = boneSlots[b];
+            boneNames.push_back(boneName);
+            boneOffsets.push_back(convertAiMatrix(bone->mOffsetMatrix));
         }
         else
         {
-            boneIndex = it->second;
+            boneSlots[b] = it->second;
         }
 
         for (unsigned int w = 0; w < bone->mNumWeights; w++)
         {
             const aiVertexWeight &weight = bone->mWeights[w];
-            unsigned int vertexId = weight.mVertexId;
-            float weightValue = weight.mWeight;
-
-            if (vertexId >= instance.vertices.size())
-                continue;
-
-            for (int i = 0; i < MeshInstance::MAX_BONE_INFLUENCES; i++)
-            {
-                if (instance.boneWeights[vertexId][i] == 0.0f)
-                {
-                    instance.boneIds[vertexId][i] = boneIndex;
-                    instance.boneWeights[vertexId][i] = weightValue;
-                    break;
-                }
-            }
+            if (weight.mVertexId < vertexCount && weight.mWeight > 0.0f)
+                influences.count(weight.mVertexId);
         }
     }
 
-    for (size_t v = 0; v < instance.vertices.size(); v++)
+    influences.allocate();
+    for (unsigned int b = 0; b < mesh->mNumBones; b++)
     {
-        float sum = instance.boneWeights[v].x + instance.boneWeights[v].y +
-                    instance.boneWeights[v].z + instance.boneWeights[v].w;
-        if (sum > 0.0f)
+        const aiBone *bone = mesh->mBones[b];
+        for (unsigned int w = 0; w < bone->mNumWeights; w++)
         {
-            instance.boneWeights[v] /= sum;
+            const aiVertexWeight &weight = bone->mWeights[w];
+            if (weight.mVertexId >= vertexCount || !(weight.mWeight > 0.0f))
+                continue;
+
+            BoneInfluence influence;
+            influence.bone = boneSlots[b];
+            influence.weight = weight.mWeight;
+            influences.add(weight.mVertexId, influence);
         }
     }
+
+    return compactSkin(instance, boneNames, boneOffsets, influences);
 }
 
-static void createMeshBuffers(MeshInstance &instance)
+static void packMeshVertices(MeshInstance &instance)
 {
-    glGenVertexArrays(1, &instance.VAO);
-    glBindVertexArray(instance.VAO);
-
-    // Vertices
-    glGenBuffers(1, &instance.VBO_vertices);
-    glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_vertices);
-    glBufferData(GL_ARRAY_BUFFER,
-                 instance.vertices.size() * sizeof(vec3),
-                 instance.vertices.data(),
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glEnableVertexAttribArray(0);
-
-    // Normals
-    if (!instance.normals.empty())
-    {
-        glGenBuffers(1, &instance.VBO_normals);
-        glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_normals);
-        glBufferData(GL_ARRAY_BUFFER,
-                     instance.normals.size() * sizeof(vec3),
-                     instance.normals.data(),
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(1);
-    }
-
-    // Texture coordinates
-    if (!instance.texcoords.empty())
-    {
-        glGenBuffers(1, &instance.VBO_texcoords);
-        glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_texcoords);
-        glBufferData(GL_ARRAY_BUFFER,
-                     instance.texcoords.size() * sizeof(vec2),
-                     instance.texcoords.data(),
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(2);
-    }
-
-    // Colors
-    if (!instance.colors.empty())
-    {
-        glGenBuffers(1, &instance.VBO_colors);
-        glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_colors);
-        glBufferData(GL_ARRAY_BUFFER,
-                     instance.colors.size() * sizeof(vec3),
-                     instance.colors.data(),
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(3);
-    }
-
-    // Bone IDs and weights
-    if (instance.hasBones && !instance.boneIds.empty())
+    ProfileScope scope("packMeshVertices");
+    const unsigned int used = usedVertexAttributes();
+    const size_t vertexCount = instance.vertices.size();
+    bool skinned = instance.hasBones && instance.boneIds.size() == vertexCount;
+    bool hasTexcoords = (used & VERTEX_ATTRIB_TEXCOORD) && instance.texcoords.size() == vertexCount;
+    bool hasColors = (used & VERTEX_ATTRIB_COLOR) && instance.colors.size() == vertexCount;
+    instance.vertexLayout = makePackedVertexLayout(skinned, instance.boneMatrices.size(), hasTexcoords, hasColors);
+    instance.vertexCount = static_cast<GLsizei>(vertexCount);
+    instance.hasNormals = !instance.normals.empty();
+    instance.cpuStreams = MESH_CPU_ALL;
+
+    const PackedVertexLayout &layout = instance.vertexLayout;
+    const size_t stride = static_cast<size_t>(layout.stride);
+    instance.packedVertices.assign(vertexCount * stride, 0);
+
+    for (size_t v = 0; v < vertexCount; v++)
     {
-        glGenBuffers(1, &instance.VBO_boneIds);
-        glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_boneIds);
-        glBufferData(GL_ARRAY_BUFFER,
-                     instance.boneIds.size() * sizeof(ivec4),
-                     instance.boneIds.data(),
-                     GL_STATIC_DRAW);
-        glVertexAttribIPointer(5, 4, GL_INT, 0, nullptr);
-        glEnableVertexAttribArray(5);
+        unsigned char *out = &instance.packedVertices[v * stride];
 
-        glGenBuffers(1, &instance.VBO_boneWeights);
-        glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_boneWeights);
-        glBufferData(GL_ARRAY_BUFFER,
-                     instance.boneWeights.size() * sizeof(vec4),
-                     instance.boneWeights.data(),
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(6);
-    }
+        memcpy(out, &instance.vertices[v], sizeof(vec3));
 
-    // Indices
-    glGenBuffers(1, &instance.EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, instance.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 instance.indices.size() * sizeof(unsigned int),
-                 instance.indices.data(),
-                 GL_STATIC_DRAW);
+        uint32_t normal = v < instance.normals.size() ? packNormal1010102(instance.normals[v]) : 0;
+        memcpy(out + 12, &normal, sizeof(normal));
 
-    glBindVertexArray(0);
-    instance.ready = true;
-}
-
-void MeshInstance::draw(GLuint shaderID, const mat4 &model, const mat4 &view, const mat4 &proj) const
-{
-    if (!ready)
-        return;
+        if (hasTexcoords)
+        {
+            const vec2 &uv = instance.texcoords[v];
+            uint16_t halfUv[2] = {packHalf(uv.x), packHalf(uv.y)};
+            memcpy(out + layout.texcoordOffset, halfUv, sizeof(halfUv));
+        }
 
-    GLint locSampler = glGetUniformLocation(shaderID, "diffuseTexture");
-    GLint locHasTexture = glGetUniformLocation(shaderID, "hasTexture");
-    if (hasDiffuseTexture && diffuseTexture != 0)
-    {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseTexture);
-        if (locSampler >= 0)
+        if (hasColors)
         {
-            glUniform1i(locSampler, 0);
+            uint32_t rgba = packUnorm8x4(vec4(instance.colors[v], 1.0f));
+            memcpy(out + layout.colorOffset, &rgba, sizeof(rgba));
         }
-        if (locHasTexture >= 0)
+
+        if (!skinned)
+            continue;
+
+        // Unused influences carry id -1 and weight 0; any valid id will do.
+        const ivec4 &ids = instance.boneIds[v];
+        if (layout.wideBoneIds)
         {
-            glUniform1i(locHasTexture, 1);
+            uint16_t wide[4];
+            for (int i = 0; i < 4; i++)
+                wide[i] = static_cast<uint16_t>(ids[i] < 0 ? 0 : ids[i]);
+            memcpy(out + layout.boneIdOffset, wide, sizeof(wide));
         }
-    }
-    else
-    {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        if (locHasTexture >= 0)
+        else
         {
-            glUniform1i(locHasTexture, 0);
+            for (int i = 0; i < 4; i++)
+                out[layout.boneIdOffset + i] = static_cast<unsigned char>(ids[i] < 0 ? 0 : ids[i]);
         }
-    }
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+        uint32_t weights = packBoneWeights(instance.boneWeights[v]);
+        memcpy(out + layout.weightOffset, &weights, sizeof(weights));
+    }
 }
 
-static void loadAnimations(HierarchicalModel &result, const aiScene *scene)
+GLenum packMeshElements(const MeshInstance &mesh, vector<unsigned char> &elements)
 {
-    result.hasEmbeddedAnimation = scene->mNumAnimations > 0;
-    result.activeAnimation = -1;
-    result.currentAnimationTime = 0.0f;
-
-    if (scene->mNumAnimations == 0)
+    size_t count = mesh.indices.size() + mesh.lodIndices.size();
+    if (mesh.vertexCount <= 65536)
     {
-        cout << "No animations found" << endl;
-        return;
+        elements.resize(count * sizeof(unsigned short));
+        unsigned short *out = reinterpret_cast<unsigned short *>(elements.data());
+        for (unsigned int index : mesh.indices)
+            *out++ = static_cast<unsigned short>(index);
+        for (unsigned int index : mesh.lodIndices)
+            *out++ = static_cast<unsigned short>(index);
+        return GL_UNSIGNED_SHORT;
     }
 
+    elements.resize(count * sizeof(unsigned int));
+    if (!mesh.indices.empty())
+        memcpy(elements.data(), mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    if (!mesh.lodIndices.empty())
+        memcpy(elements.data() + mesh.indices.size() * sizeof(unsigned int), mesh.lodIndices.data(),
+               mesh.lodIndices.size() * sizeof(unsigned int));
+    return GL_UNSIGNED_INT;
+}
+
+static void loadAnimations(ModelAsset &asset, const aiScene *scene)
+{
+    ProfileScope scope("loadAnimations");
     for (unsigned int a = 0; a < scene->mNumAnimations; a++)
     {
         const aiAnimation *animation = scene->mAnimations[a];
@@ -503,188 +517,346 @@ static void loadAnimations(HierarchicalModel &result, const aiScene *scene)
 
             clip.nodeAnimations.push_back(nodeAnimClip);
         }
-        result.animationClips.push_back(clip);
+        asset.animationClips.push_back(clip);
     }
+}
+
+static void applyAnimationDefaults(HierarchicalModel &result)
+{
+    result.hasEmbeddedAnimation = !result.asset->animationClips.empty();
+    result.activeAnimation = -1;
+    result.currentAnimationTime = 0.0f;
 
-    if (!result.animationClips.empty())
+    if (result.asset->animationClips.empty())
     {
-        result.activeAnimation = 0;
-        result.animated = true;
+        cout << "No animations found" << endl;
+        return;
     }
+
+    result.activeAnimation = 0;
+    result.animated = true;
 }
 
-vector<MeshInstance> load_mesh(const char *filePath)
+static void computeMeshBounds(MeshInstance &instance)
 {
-    vector<MeshInstance> result;
+    instance.boundsMin = vec3(FLT_MAX);
+    instance.boundsMax = vec3(-FLT_MAX);
+    for (const vec3 &v : instance.vertices)
+    {
+        instance.boundsMin = glm::min(instance.boundsMin, v);
+        instance.boundsMax = glm::max(instance.boundsMax, v);
+    }
+    if (instance.vertices.empty())
+    {
+        instance.boundsMin = vec3(0.0f);
+        instance.boundsMax = vec3(0.0f);
+    }
+}
 
-    const aiScene *scene = aiImportFile(
-        filePath,
-        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_PreTransformVertices);
+// Bounds and the packed vertex stream of a fresh import, both written to
+// the mesh cache with the streams they came from.
+static void prepareMeshBuffers(MeshInstance &instance)
+{
+    computeMeshBounds(instance);
+    packMeshVertices(instance);
+}
 
-    if (!scene || !scene->mRootNode)
+static void expandBounds(const mat4 &transform, const MeshInstance &mesh, vec3 &boundsMin, vec3 &boundsMax)
+{
+    for (int corner = 0; corner < 8; corner++)
     {
-        cerr << "Assimp error loading '" << filePath << "': "
-             << aiGetErrorString() << endl;
-        return result;
+        vec3 local((corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+                   (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                   (corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+        vec3 p = vec3(transform * vec4(local, 1.0f));
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+}
+
+void computeModelBounds(const vector<MeshInstance> &meshes, vec3 &boundsMin, vec3 &boundsMax)
+{
+    boundsMin = vec3(FLT_MAX);
+    boundsMax = vec3(-FLT_MAX);
+    for (const MeshInstance &mesh : meshes)
+    {
+        boundsMin = glm::min(boundsMin, mesh.boundsMin);
+        boundsMax = glm::max(boundsMax, mesh.boundsMax);
     }
+    if (meshes.empty())
+    {
+        boundsMin = vec3(0.0f);
+        boundsMax = vec3(0.0f);
+    }
+}
 
-    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+void computeHierarchicalBounds(const HierarchicalModel &model, vec3 &boundsMin, vec3 &boundsMax)
+{
+    boundsMin = vec3(FLT_MAX);
+    boundsMax = vec3(-FLT_MAX);
+
+    // Nodes are stored in pre-order, so a parent's global transform is
+    // always known before its children are reached.
+    vector<mat4> globals(model.nodes.size());
+    for (size_t i = 0; i < model.nodes.size(); i++)
     {
-        const aiMesh *mesh = scene->mMeshes[m];
-        MeshInstance instance{};
+        const HierarchicalNode &node = model.nodes[i];
+        globals[i] = node.localTransform;
+        if (node.parent)
+        {
+            size_t parentIdx = static_cast<size_t>(node.parent - &model.nodes[0]);
+            if (parentIdx < i)
+                globals[i] = globals[parentIdx] * node.localTransform;
+        }
 
-        for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+        for (unsigned int meshIdx : node.meshIndices)
         {
-            instance.vertices.push_back(vec3(
-                mesh->mVertices[v].x,
-                mesh->mVertices[v].y,
-                mesh->mVertices[v].z));
+            if (model.asset && meshIdx < model.asset->meshes.size())
+                expandBounds(globals[i], model.asset->meshes[meshIdx], boundsMin, boundsMax);
+        }
+    }
 
-            if (mesh->HasNormals())
-            {
-                instance.normals.push_back(vec3(
-                    mesh->mNormals[v].x,
-                    mesh->mNormals[v].y,
-                    mesh->mNormals[v].z));
-            }
+    if (boundsMin.x > boundsMax.x)
+    {
+        boundsMin = vec3(0.0f);
+        boundsMax = vec3(0.0f);
+    }
+}
 
-            if (mesh->HasTextureCoords(0))
-            {
-                instance.texcoords.push_back(vec2(
-                    mesh->mTextureCoords[0][v].x,
-                    mesh->mTextureCoords[0][v].y));
-            }
-            else
-            {
-                instance.texcoords.push_back(vec2(0.0f, 0.0f));
-            }
+static double elapsedMs(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
 
-            if (mesh->HasVertexColors(0))
-            {
-                instance.colors.push_back(vec3(
-                    mesh->mColors[0][v].r,
-                    mesh->mColors[0][v].g,
-                    mesh->mColors[0][v].b));
-            }
-            else
-            {
-                instance.colors.push_back(vec3(1.0f, 1.0f, 1.0f));
-            }
-        }
+static const unsigned int STATIC_IMPORT_FLAGS =
+    aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_PreTransformVertices;
+
+static const unsigned int HIERARCHICAL_IMPORT_FLAGS =
+    aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs;
 
-        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+static GltfImportSample sampleImport(const vector<MeshInstance> &meshes, double ms)
+{
+    GltfImportSample sample = {ms, meshes.size(), 0, 0};
+    for (const MeshInstance &mesh : meshes)
+    {
+        sample.vertices += mesh.vertices.size();
+        sample.triangles += mesh.indices.size() / 3;
+    }
+    return sample;
+}
+
+static bool parseStaticAssimp(const char *filePath, vector<MeshInstance> &result)
+{
+    const aiScene *scene = nullptr;
+    {
+        ProfileScope scope("aiImportFile");
+        scene = aiImportFileEx(filePath, STATIC_IMPORT_FLAGS, assetFileIO());
+    }
+
+    if (!scene || !scene->mRootNode)
+    {
+        cerr << "Assimp error loading '" << filePath << "': "
+             << aiGetErrorString() << endl;
+        return false;
+    }
+
+    result.reserve(scene->mNumMeshes);
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        result.push_back(processMesh(scene->mMeshes[m], scene, filePath));
+    }
+
+    aiReleaseImport(scene);
+    return true;
+}
+
+// glTF files go through the native reader unless it declines the file or
+// Assimp is selected; everything else, FBX included, goes through Assimp.
+static bool parseStaticSource(const char *filePath, vector<MeshInstance> &result)
+{
+    GltfImporter importer = gltfImporter();
+    if (importer != GLTF_IMPORT_ASSIMP && isGltfPath(filePath))
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        string error;
+        if (importGltfStatic(filePath, result, error))
         {
-            aiFace face = mesh->mFaces[f];
-            for (unsigned int i = 0; i < face.mNumIndices; i++)
+            double nativeMs = elapsedMs(start);
+            if (importer == GLTF_IMPORT_COMPARE)
             {
-                instance.indices.push_back(face.mIndices[i]);
+                vector<MeshInstance> reference;
+                start = chrono::steady_clock::now();
+                if (parseStaticAssimp(filePath, reference))
+                {
+                    recordGltfImportComparison(filePath, sampleImport(result, nativeMs),
+                                               sampleImport(reference, elapsedMs(start)));
+                }
             }
+            return true;
         }
+        cerr << "[gltf] " << filePath << ": " << error << ", importing with Assimp" << endl;
+        result.clear();
+    }
+    return parseStaticAssimp(filePath, result);
+}
 
-        glGenVertexArrays(1, &instance.VAO);
-        glBindVertexArray(instance.VAO);
-        glGenBuffers(1, &instance.VBO_vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_vertices);
-        glBufferData(GL_ARRAY_BUFFER,
-                     instance.vertices.size() * sizeof(vec3),
-                     instance.vertices.data(),
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(0);
-
-        if (!instance.normals.empty())
-        {
-            glGenBuffers(1, &instance.VBO_normals);
-            glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_normals);
-            glBufferData(GL_ARRAY_BUFFER,
-                         instance.normals.size() * sizeof(vec3),
-                         instance.normals.data(),
-                         GL_STATIC_DRAW);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-            glEnableVertexAttribArray(1);
-        }
+// The cold half of import_mesh: parse the source and run every processing
+// step whose result the mesh cache stores.
+static bool importStaticSource(const char *filePath, vector<MeshInstance> &result)
+{
+    if (!parseStaticSource(filePath, result))
+        return false;
 
-        if (!instance.texcoords.empty())
+    for (size_t m = 0; m < result.size(); m++)
+    {
+        string label = string(filePath) + "#" + to_string(m);
+        MeshOptimizationStats stats = optimizeMesh(result[m]);
+        printMeshOptimizationStats(label, stats);
+        size_t clusters = buildMeshClusters(result[m]);
+        if (clusters > 0)
         {
-            glGenBuffers(1, &instance.VBO_texcoords);
-            glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_texcoords);
-            glBufferData(GL_ARRAY_BUFFER,
-                         instance.texcoords.size() * sizeof(vec2),
-                         instance.texcoords.data(),
-                         GL_STATIC_DRAW);
-            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-            glEnableVertexAttribArray(2);
+            cout << ("[cluster] " + label + ": " + to_string(clusters) + " clusters\n") << flush;
         }
+        buildMeshLods(result[m]);
+        printMeshLods(label, result[m]);
+    }
+    return true;
+}
 
-        if (!instance.colors.empty())
-        {
-            glGenBuffers(1, &instance.VBO_colors);
-            glBindBuffer(GL_ARRAY_BUFFER, instance.VBO_colors);
-            glBufferData(GL_ARRAY_BUFFER,
-                         instance.colors.size() * sizeof(vec3),
-                         instance.colors.data(),
-                         GL_STATIC_DRAW);
-            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-            glEnableVertexAttribArray(3);
-        }
+bool import_mesh(const char *filePath, vector<MeshInstance> &result)
+{
+    ProfileScope scope("import_mesh", filePath);
+    AllocationScope allocations;
+    result.clear();
 
-        glGenBuffers(1, &instance.EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, instance.EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     instance.indices.size() * sizeof(unsigned int),
-                     instance.indices.data(),
-                     GL_STATIC_DRAW);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    MeshCacheKey cacheKey = MESH_BAKED_ONLY ? makeBakedMeshKey(filePath, MESH_CACHE_STATIC, STATIC_IMPORT_FLAGS)
+                                            : makeMeshCacheKey(filePath, MESH_CACHE_STATIC, STATIC_IMPORT_FLAGS);
 
-        glBindVertexArray(0);
+    double coldMs = 0.0;
+    bool warm = readStaticMeshCache(cacheKey, result, coldMs);
+    if (!warm)
+    {
+        if (MESH_BAKED_ONLY)
+        {
+            cerr << "No baked mesh for '" << filePath << "' at '" << cacheKey.cachePath << "'" << endl;
+            return false;
+        }
+        if (!importStaticSource(filePath, result))
+            return false;
 
-        const aiMaterial *material = (mesh->mMaterialIndex >= 0 && mesh->mMaterialIndex < static_cast<int>(scene->mNumMaterials))
-                                         ? scene->mMaterials[mesh->mMaterialIndex]
-                                         : nullptr;
-        instance.diffuseTexture = loadMaterialTexture(scene, material, filePath);
-        instance.hasDiffuseTexture = instance.diffuseTexture != 0;
+        for (MeshInstance &instance : result)
+            prepareMeshBuffers(instance);
+        coldMs = elapsedMs(start);
+        writeStaticMeshCache(cacheKey, result, coldMs);
+    }
 
-        instance.ready = true;
-        result.push_back(instance);
+    set<string> decodedKeys;
+    for (MeshInstance &instance : result)
+    {
+        if (warm && !instance.cacheView)
+            prepareMeshBuffers(instance);
+        decodeMeshTexture(instance, decodedKeys);
     }
 
-    aiReleaseImport(scene);
-    return result;
+    double loadMs = elapsedMs(start);
+    recordMeshLoadTiming(filePath, warm, loadMs, warm ? coldMs : loadMs);
+    recordLoadAllocations(filePath, warm, allocations.used());
+    return !result.empty();
 }
 
-HierarchicalModel load_mesh_hierarchical(const char *filePath)
+// result.asset must exist.
+static bool parseHierarchicalAssimp(const char *filePath, HierarchicalModel &result,
+                                    vector<SkinCompactionStats> &skins)
 {
-    HierarchicalModel result;
-    result.modelIndex = -1;
-    result.worldPosition = vec3(0.0f, 0.0f, 0.0f);
-    result.worldRotation = vec3(0.0f, 0.0f, 0.0f);
-    result.worldScale = vec3(1.0f, 1.0f, 1.0f);
-    result.animated = false;
-
-    const aiScene *scene = aiImportFile(
-        filePath,
-        aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    const aiScene *scene = nullptr;
+    {
+        ProfileScope scope("aiImportFile");
+        scene = aiImportFileEx(filePath, HIERARCHICAL_IMPORT_FLAGS, assetFileIO());
+    }
 
     if (!scene || !scene->mRootNode)
     {
         cerr << "Assimp error loading hierarchical model '" << filePath << "': "
              << aiGetErrorString() << endl;
-        return result;
+        return false;
     }
 
+    result.asset->meshes.reserve(scene->mNumMeshes);
+    skins.reserve(scene->mNumMeshes);
     for (unsigned int m = 0; m < scene->mNumMeshes; m++)
     {
         const aiMesh *mesh = scene->mMeshes[m];
-        MeshInstance instance = processMesh(mesh, scene, filePath);
-        processBones(instance, mesh);
-        createMeshBuffers(instance);
+        result.asset->meshes.push_back(processMesh(mesh, scene, filePath));
+        skins.push_back(processBones(result.asset->meshes.back(), mesh));
+    }
 
-        result.meshes.push_back(instance);
+    {
+        ProfileScope scope("buildNodeHierarchy");
+        int totalNodes = countNodes(scene->mRootNode);
+        result.nodes.clear();
+        result.nodes.reserve(totalNodes);
+        result.rootNode = buildNodeHierarchy(scene->mRootNode, nullptr, result.nodes, true);
+    }
+
+    loadAnimations(*result.asset, scene);
+    aiReleaseImport(scene);
+    return true;
+}
+
+static bool parseHierarchicalSource(const char *filePath, HierarchicalModel &result,
+                                    vector<SkinCompactionStats> &skins)
+{
+    GltfImporter importer = gltfImporter();
+    if (importer != GLTF_IMPORT_ASSIMP && isGltfPath(filePath))
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        string error;
+        if (importGltfHierarchical(filePath, result, skins, error))
+        {
+            double nativeMs = elapsedMs(start);
+            if (importer == GLTF_IMPORT_COMPARE)
+            {
+                HierarchicalModel reference;
+                reference.asset = make_shared<ModelAsset>();
+                vector<SkinCompactionStats> referenceSkins;
+                start = chrono::steady_clock::now();
+                if (parseHierarchicalAssimp(filePath, reference, referenceSkins))
+                {
+                    recordGltfImportComparison(filePath, sampleImport(result.asset->meshes, nativeMs),
+                                               sampleImport(reference.asset->meshes, elapsedMs(start)));
+                }
+            }
+            return true;
+        }
+        cerr << "[gltf] " << filePath << ": " << error << ", importing with Assimp" << endl;
+        result.asset->meshes.clear();
+        result.asset->animationClips.clear();
+        result.nodes.clear();
+        result.rootNode = nullptr;
+        skins.clear();
     }
+    return parseHierarchicalAssimp(filePath, result, skins);
+}
+
+// The cold half of import_mesh_hierarchical. result.asset must exist.
+static bool importHierarchicalSource(const char *filePath, HierarchicalModel &result)
+{
+    vector<SkinCompactionStats> skins;
+    if (!parseHierarchicalSource(filePath, result, skins))
+        return false;
 
-    int totalNodes = countNodes(scene->mRootNode);
-    result.nodes.clear();
-    result.nodes.reserve(totalNodes);
-    result.rootNode = buildNodeHierarchy(scene->mRootNode, nullptr, result.nodes, true);
+    for (size_t m = 0; m < result.asset->meshes.size(); m++)
+    {
+        MeshInstance &instance = result.asset->meshes[m];
+        string label = string(filePath) + "#" + to_string(m);
+        if (m < skins.size())
+            printSkinCompactionStats(label, skins[m]);
+        MeshOptimizationStats stats = optimizeMesh(instance);
+        printMeshOptimizationStats(label, stats);
+        buildMeshLods(instance);
+        printMeshLods(label, instance);
+    }
 
     if (result.rootNode)
     {
@@ -697,46 +869,220 @@ HierarchicalModel load_mesh_hierarchical(const char *filePath)
         result.originalRootTransform = mat4(1.0f);
         result.globalInverseTransform = mat4(1.0f);
     }
+    return true;
+}
+
+bool import_mesh_hierarchical(const char *filePath, HierarchicalModel &result)
+{
+    ProfileScope scope("import_mesh_hierarchical", filePath);
+    AllocationScope allocations;
+    result.modelIndex = -1;
+    result.worldPosition = vec3(0.0f, 0.0f, 0.0f);
+    result.worldRotation = vec3(0.0f, 0.0f, 0.0f);
+    result.worldScale = vec3(1.0f, 1.0f, 1.0f);
+    result.animated = false;
+    result.rootNode = nullptr;
+    result.asset = make_shared<ModelAsset>();
+    result.asset->path = filePath;
+    result.asset->refCount = 0;
+    result.asset->loadMs = 0.0;
+    result.asset->keepCpuStreams = MESH_CPU_NONE;
+    result.asset->cpuBytesReleased = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    MeshCacheKey cacheKey = MESH_BAKED_ONLY
+                                ? makeBakedMeshKey(filePath, MESH_CACHE_HIERARCHICAL, HIERARCHICAL_IMPORT_FLAGS)
+                                : makeMeshCacheKey(filePath, MESH_CACHE_HIERARCHICAL, HIERARCHICAL_IMPORT_FLAGS);
+
+    double coldMs = 0.0;
+    bool warm = readHierarchicalMeshCache(cacheKey, result, coldMs);
+    if (!warm)
+    {
+        if (MESH_BAKED_ONLY)
+        {
+            cerr << "No baked hierarchical model for '" << filePath << "' at '" << cacheKey.cachePath << "'" << endl;
+            return false;
+        }
+        if (!importHierarchicalSource(filePath, result))
+            return false;
+
+        // Just converted, so resident; they are read back by range from the
+        // cache written here only on later loads.
+        for (Animation &clip : result.asset->animationClips)
+        {
+            clip.sourceOffset = 0;
+            clip.sourceSize = 0;
+            clip.resident = true;
+            clip.lastUsed = chrono::steady_clock::now();
+        }
+
+        for (MeshInstance &instance : result.asset->meshes)
+            prepareMeshBuffers(instance);
+        coldMs = elapsedMs(start);
+        writeHierarchicalMeshCache(cacheKey, result, coldMs);
+    }
 
-    loadAnimations(result, scene);
+    set<string> decodedKeys;
+    for (MeshInstance &instance : result.asset->meshes)
+    {
+        if (warm && !instance.cacheView)
+            prepareMeshBuffers(instance);
+        decodeMeshTexture(instance, decodedKeys);
+    }
+    computeHierarchicalBounds(result, result.asset->boundsMin, result.asset->boundsMax);
+
+    applyAnimationDefaults(result);
     buildNodeNameMap(result);
-    aiReleaseImport(scene);
 
-    return result;
+    double loadMs = elapsedMs(start);
+    result.asset->loadMs = loadMs;
+    recordMeshLoadTiming(filePath, warm, loadMs, warm ? coldMs : loadMs);
+    recordLoadAllocations(filePath, warm, allocations.used());
+    return !result.asset->meshes.empty() && result.rootNode;
 }
 
-void cleanupMesh(MeshInstance &mesh)
+// Swaps a file or compressed texture for its decoded pixels, widened to the
+// four channels EMBEDDED_RAW implies. Orientation is fixed here the same way
+// decodeTexturePixels would at runtime.
+static void bakeMeshTexture(TextureRef &ref)
 {
-    if (mesh.VBO_vertices)
-        glDeleteBuffers(1, &mesh.VBO_vertices);
-    if (mesh.VBO_normals)
-        glDeleteBuffers(1, &mesh.VBO_normals);
-    if (mesh.VBO_texcoords)
-        glDeleteBuffers(1, &mesh.VBO_texcoords);
-    if (mesh.VBO_colors)
-        glDeleteBuffers(1, &mesh.VBO_colors);
-    if (mesh.VBO_boneIds)
-        glDeleteBuffers(1, &mesh.VBO_boneIds);
-    if (mesh.VBO_boneWeights)
-        glDeleteBuffers(1, &mesh.VBO_boneWeights);
-    if (mesh.VAO)
-        glDeleteVertexArrays(1, &mesh.VAO);
-    mesh.boneIds.clear();
-    mesh.boneWeights.clear();
-    mesh.boneMatrices.clear();
-    mesh.boneNameToIndex.clear();
-    mesh.hasBones = false;
+    if (ref.source != TextureRef::FILE_PATH && ref.source != TextureRef::EMBEDDED_COMPRESSED)
+        return;
+
+    if (!decodeTexturePixels(ref))
+    {
+        cerr << "bake: dropping undecodable texture '" << ref.path << "'" << endl;
+        ref.source = TextureRef::NONE;
+        ref.path.clear();
+        return;
+    }
+
+    size_t pixelCount = static_cast<size_t>(ref.width) * ref.height;
+    vector<unsigned char> rgba(pixelCount * 4);
+    for (size_t p = 0; p < pixelCount; p++)
+    {
+        const unsigned char *src = &ref.pixels[p * ref.channels];
+        unsigned char *dst = &rgba[p * 4];
+        bool gray = ref.channels < 3;
+        dst[0] = src[0];
+        dst[1] = gray ? src[0] : src[1];
+        dst[2] = gray ? src[0] : src[2];
+        dst[3] = ref.channels == 2 ? src[1] : (ref.channels == 4 ? src[3] : 255);
+    }
+
+    ref.source = TextureRef::EMBEDDED_RAW;
+    ref.path.clear();
+    ref.data.swap(rgba);
+    ref.channels = 4;
+    vector<unsigned char>().swap(ref.pixels);
 }
 
-void cleanupHierarchicalModel(HierarchicalModel &model)
+bool bake_mesh(const char *filePath, const char *outputPath, bool hierarchical)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    MeshCacheKind kind = hierarchical ? MESH_CACHE_HIERARCHICAL : MESH_CACHE_STATIC;
+    MeshCacheKey key = makeBakedMeshKey(filePath, kind,
+                                        hierarchical ? HIERARCHICAL_IMPORT_FLAGS : STATIC_IMPORT_FLAGS,
+                                        outputPath);
+
+    bool written = false;
+    size_t meshCount = 0;
+    if (hierarchical)
+    {
+        HierarchicalModel model;
+        model.asset = make_shared<ModelAsset>();
+        model.asset->path = filePath;
+        if (!importHierarchicalSource(filePath, model))
+            return false;
+
+        for (MeshInstance &mesh : model.asset->meshes)
+        {
+            prepareMeshBuffers(mesh);
+            bakeMeshTexture(mesh.diffuseRef);
+        }
+        meshCount = model.asset->meshes.size();
+        written = writeHierarchicalMeshCache(key, model, elapsedMs(start));
+    }
+    else
+    {
+        vector<MeshInstance> meshes;
+        if (!importStaticSource(filePath, meshes))
+            return false;
+
+        for (MeshInstance &mesh : meshes)
+        {
+            prepareMeshBuffers(mesh);
+            bakeMeshTexture(mesh.diffuseRef);
+        }
+        meshCount = meshes.size();
+        written = writeStaticMeshCache(key, meshes, elapsedMs(start));
+    }
+
+    if (!written)
+    {
+        cerr << "bake: failed to write '" << key.cachePath << "'" << endl;
+        return false;
+    }
+    cout << "[bake] " << filePath << " -> " << key.cachePath << ": " << meshCount << " meshes, "
+         << fixed << setprecision(1) << elapsedMs(start) << " ms" << defaultfloat << endl;
+    return true;
+}
+
+template <typename T>
+static size_t streamBytes(const vector<T> &stream)
+{
+    return stream.capacity() * sizeof(T);
+}
+
+template <typename T>
+static size_t freeStream(vector<T> &stream)
+{
+    size_t bytes = streamBytes(stream);
+    vector<T>().swap(stream);
+    return bytes;
+}
+
+size_t meshCpuBytes(const MeshInstance &mesh)
+{
+    return streamBytes(mesh.vertices) + streamBytes(mesh.normals) + streamBytes(mesh.texcoords) +
+           streamBytes(mesh.colors) + streamBytes(mesh.indices) + streamBytes(mesh.boneIds) +
+           streamBytes(mesh.boneWeights) + streamBytes(mesh.packedVertices) + streamBytes(mesh.lodIndices);
+}
+
+size_t releaseMeshCpuData(MeshInstance &mesh, unsigned int keepCpuStreams)
 {
-    for (MeshInstance &mesh : model.meshes)
+    size_t released = freeStream(mesh.packedVertices);
+    if (!(keepCpuStreams & MESH_CPU_POSITIONS))
+        released += freeStream(mesh.vertices);
+    if (!(keepCpuStreams & MESH_CPU_INDICES))
+    {
+        released += freeStream(mesh.indices);
+        released += freeStream(mesh.lodIndices);
+    }
+    if (!(keepCpuStreams & MESH_CPU_ATTRIBUTES))
+    {
+        released += freeStream(mesh.normals);
+        released += freeStream(mesh.texcoords);
+        released += freeStream(mesh.colors);
+    }
+    if (!(keepCpuStreams & MESH_CPU_SKIN))
     {
-        cleanupMesh(mesh);
+        released += freeStream(mesh.boneIds);
+        released += freeStream(mesh.boneWeights);
     }
+    mesh.cpuStreams &= keepCpuStreams;
+    return released;
+}
+
+// Releases per-instance state only. The shared asset's GPU resources are
+// freed by the asset registry once its last instance lets go of it.
+void cleanupHierarchicalModel(HierarchicalModel &model)
+{
     model.nodes.clear();
     model.nodeNameMap.clear();
-    model.animationClips.clear();
+    model.boneMatricesPerMesh.clear();
+    model.rootNode = nullptr;
+    model.asset.reset();
     model.activeAnimation = -1;
     model.currentAnimationTime = 0.0f;
 }
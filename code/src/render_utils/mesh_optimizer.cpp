@@ -0,0 +1,597 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+#include "mesh_optimizer.h"
+#include "load_profiler.h"
+#include "hash_utils.h"
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+    // LRU cache modelled by the Forsyth ordering. Larger than the FIFO used
+    // for analysis, as in the original paper.
+    const int FORSYTH_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    // Clusters may be split further while their cache efficiency stays
+    // within this factor of the whole cluster's.
+    const float OVERDRAW_SPLIT_THRESHOLD = 1.05f;
+
+    bool hasStream(size_t streamSize, size_t vertexCount)
+    {
+        return streamSize == vertexCount && vertexCount > 0;
+    }
+
+    uint64_t hashVertex(const MeshInstance &mesh, size_t v)
+    {
+        size_t n = mesh.vertices.size();
+        uint64_t hash = fnv1a(&mesh.vertices[v], sizeof(vec3));
+        if (hasStream(mesh.normals.size(), n))
+            hash = fnv1a(&mesh.normals[v], sizeof(vec3), hash);
+        if (hasStream(mesh.texcoords.size(), n))
+            hash = fnv1a(&mesh.texcoords[v], sizeof(vec2), hash);
+        if (hasStream(mesh.colors.size(), n))
+            hash = fnv1a(&mesh.colors[v], sizeof(vec3), hash);
+        if (hasStream(mesh.boneIds.size(), n))
+            hash = fnv1a(&mesh.boneIds[v], sizeof(ivec4), hash);
+        if (hasStream(mesh.boneWeights.size(), n))
+            hash = fnv1a(&mesh.boneWeights[v], sizeof(vec4), hash);
+        return hash;
+    }
+
+    bool sameVertex(const MeshInstance &mesh, size_t a, size_t b)
+    {
+        size_t n = mesh.vertices.size();
+        if (memcmp(&mesh.vertices[a], &mesh.vertices[b], sizeof(vec3)) != 0)
+            return false;
+        if (hasStream(mesh.normals.size(), n) && memcmp(&mesh.normals[a], &mesh.normals[b], sizeof(vec3)) != 0)
+            return false;
+        if (hasStream(mesh.texcoords.size(), n) && memcmp(&mesh.texcoords[a], &mesh.texcoords[b], sizeof(vec2)) != 0)
+            return false;
+        if (hasStream(mesh.colors.size(), n) && memcmp(&mesh.colors[a], &mesh.colors[b], sizeof(vec3)) != 0)
+            return false;
+        if (hasStream(mesh.boneIds.size(), n) && memcmp(&mesh.boneIds[a], &mesh.boneIds[b], sizeof(ivec4)) != 0)
+            return false;
+        if (hasStream(mesh.boneWeights.size(), n) && memcmp(&mesh.boneWeights[a], &mesh.boneWeights[b], sizeof(vec4)) != 0)
+            return false;
+        return true;
+    }
+
+    // Points every index at the first of its bit-identical duplicates.
+    void weldVertices(const MeshInstance &mesh, vector<unsigned int> &indices)
+    {
+        size_t n = mesh.vertices.size();
+        vector<uint64_t> hashes(n);
+        vector<unsigned int> order(n);
+        for (size_t v = 0; v < n; v++)
+        {
+            hashes[v] = hashVertex(mesh, v);
+            order[v] = static_cast<unsigned int>(v);
+        }
+        sort(order.begin(), order.end(), [&hashes](unsigned int a, unsigned int b)
+             { return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : a < b; });
+
+        vector<unsigned int> canonical(n);
+        for (size_t i = 0; i < n;)
+        {
+            size_t end = i + 1;
+            while (end < n && hashes[order[end]] == hashes[order[i]])
+                end++;
+
+            for (size_t a = i; a < end; a++)
+            {
+                canonical[order[a]] = order[a];
+                for (size_t b = i; b < a; b++)
+                {
+                    if (canonical[order[b]] == order[b] && sameVertex(mesh, order[a], order[b]))
+                    {
+                        canonical[order[a]] = order[b];
+                        break;
+                    }
+                }
+            }
+            i = end;
+        }
+
+        for (unsigned int &index : indices)
+        {
+            index = canonical[index];
+        }
+    }
+
+    void removeDegenerateTriangles(const MeshInstance &mesh, vector<unsigned int> &indices)
+    {
+        size_t out = 0;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            unsigned int a = indices[t], b = indices[t + 1], c = indices[t + 2];
+            if (a == b || b == c || a == c)
+                continue;
+
+            const vec3 &pa = mesh.vertices[a];
+            const vec3 &pb = mesh.vertices[b];
+            const vec3 &pc = mesh.vertices[c];
+            if (pa == pb || pb == pc || pa == pc)
+                continue;
+
+            indices[out++] = a;
+            indices[out++] = b;
+            indices[out++] = c;
+        }
+        indices.resize(out);
+    }
+
+    float forsythVertexScore(int cachePosition, unsigned int liveTriangles)
+    {
+        if (liveTriangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                score = LAST_TRIANGLE_SCORE;
+            }
+            else
+            {
+                float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+        score += VALENCE_BOOST_SCALE * pow(static_cast<float>(liveTriangles), -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation".
+    vector<unsigned int> optimizeVertexCache(const vector<unsigned int> &indices, size_t vertexCount)
+    {
+        size_t triangleCount = indices.size() / 3;
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+        if (triangleCount == 0)
+            return result;
+
+        // Per-vertex list of triangles that still need emitting.
+        vector<unsigned int> liveTriangles(vertexCount, 0);
+        for (unsigned int index : indices)
+            liveTriangles[index]++;
+
+        vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+
+        vector<unsigned int> adjacency(indices.size());
+        vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+        }
+
+        vector<int> cachePosition(vertexCount, -1);
+        vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScore[v] = forsythVertexScore(-1, liveTriangles[v]);
+
+        vector<float> triangleScore(triangleCount);
+        vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                               vertexScore[indices[t * 3 + 2]];
+        }
+
+        vector<unsigned int> cache;
+        vector<unsigned int> nextCache;
+        cache.reserve(FORSYTH_CACHE_SIZE + 3);
+        nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+        size_t fallbackCursor = 0;
+        int best = -1;
+        float bestScore = -1.0f;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            if (triangleScore[t] > bestScore)
+            {
+                bestScore = triangleScore[t];
+                best = static_cast<int>(t);
+            }
+        }
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+        {
+            if (best < 0)
+            {
+                while (fallbackCursor < triangleCount && emitted[fallbackCursor])
+                    fallbackCursor++;
+                best = static_cast<int>(fallbackCursor);
+            }
+
+            const unsigned int *tri = &indices[best * 3];
+            emitted[best] = true;
+            result.insert(result.end(), tri, tri + 3);
+
+            // Drop the triangle from its vertices' live lists.
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = tri[k];
+                unsigned int *list = &adjacency[adjacencyStart[v]];
+                for (unsigned int i = 0; i < liveTriangles[v]; i++)
+                {
+                    if (list[i] == static_cast<unsigned int>(best))
+                    {
+                        list[i] = list[liveTriangles[v] - 1];
+                        break;
+                    }
+                }
+                liveTriangles[v]--;
+            }
+
+            // Move the triangle's vertices to the front of the LRU cache.
+            nextCache.assign(tri, tri + 3);
+            for (unsigned int v : cache)
+            {
+                if (v != tri[0] && v != tri[1] && v != tri[2])
+                    nextCache.push_back(v);
+            }
+            cache.swap(nextCache);
+
+            for (size_t i = 0; i < cache.size(); i++)
+            {
+                unsigned int v = cache[i];
+                cachePosition[v] = i < static_cast<size_t>(FORSYTH_CACHE_SIZE) ? static_cast<int>(i) : -1;
+                vertexScore[v] = forsythVertexScore(cachePosition[v], liveTriangles[v]);
+            }
+
+            // Rescore triangles touching the cache and pick the next one.
+            best = -1;
+            bestScore = -1.0f;
+            for (unsigned int v : cache)
+            {
+                for (unsigned int i = 0; i < liveTriangles[v]; i++)
+                {
+                    unsigned int t = adjacency[adjacencyStart[v] + i];
+                    float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                                  vertexScore[indices[t * 3 + 2]];
+                    triangleScore[t] = score;
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = static_cast<int>(t);
+                    }
+                }
+            }
+
+            if (cache.size() > static_cast<size_t>(FORSYTH_CACHE_SIZE))
+                cache.resize(FORSYTH_CACHE_SIZE);
+        }
+
+        return result;
+    }
+
+    // Splits cache-ordered triangles into clusters and sorts the clusters so
+    // that outward-facing ones draw first, in the spirit of Sander et al.,
+    // "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+    void optimizeOverdraw(const MeshInstance &mesh, vector<unsigned int> &indices)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2)
+            return;
+
+        // Hard boundaries: triangles where the FIFO cache misses all three
+        // vertices, so reordering there costs no cache efficiency.
+        vector<size_t> clusterStarts;
+        vector<unsigned int> fifo(VERTEX_CACHE_SIZE, ~0u);
+        size_t fifoHead = 0;
+        vector<unsigned int> misses(triangleCount, 0);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                if (find(fifo.begin(), fifo.end(), v) == fifo.end())
+                {
+                    fifo[fifoHead] = v;
+                    fifoHead = (fifoHead + 1) % VERTEX_CACHE_SIZE;
+                    misses[t]++;
+                }
+            }
+            if (t == 0 || misses[t] == 3)
+                clusterStarts.push_back(t);
+        }
+        clusterStarts.push_back(triangleCount);
+
+        // Soft boundaries: split a hard cluster wherever the running miss
+        // ratio has settled close to the cluster's own.
+        vector<size_t> splitStarts;
+        for (size_t c = 0; c + 1 < clusterStarts.size(); c++)
+        {
+            size_t begin = clusterStarts[c];
+            size_t end = clusterStarts[c + 1];
+            unsigned int clusterMisses = 0;
+            for (size_t t = begin; t < end; t++)
+                clusterMisses += misses[t];
+            float clusterAcmr = static_cast<float>(clusterMisses) / (end - begin);
+
+            splitStarts.push_back(begin);
+            unsigned int runningMisses = 0;
+            size_t runningStart = begin;
+            for (size_t t = begin; t < end; t++)
+            {
+                runningMisses += misses[t];
+                float runningAcmr = static_cast<float>(runningMisses) / (t + 1 - runningStart);
+                if (t + 1 < end && t + 1 - runningStart >= VERTEX_CACHE_SIZE &&
+                    runningAcmr <= clusterAcmr * OVERDRAW_SPLIT_THRESHOLD && misses[t + 1] >= 2)
+                {
+                    splitStarts.push_back(t + 1);
+                    runningStart = t + 1;
+                    runningMisses = 0;
+                }
+            }
+        }
+        splitStarts.push_back(triangleCount);
+
+        size_t clusterCount = splitStarts.size() - 1;
+        if (clusterCount < 2)
+            return;
+
+        vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        vector<float> sortKeys(clusterCount);
+        vector<vec3> clusterCentroid(clusterCount, vec3(0.0f));
+        vector<vec3> clusterNormal(clusterCount, vec3(0.0f));
+        vector<float> clusterArea(clusterCount, 0.0f);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            for (size_t t = splitStarts[c]; t < splitStarts[c + 1]; t++)
+            {
+                const vec3 &a = mesh.vertices[indices[t * 3]];
+                const vec3 &b = mesh.vertices[indices[t * 3 + 1]];
+                const vec3 &p = mesh.vertices[indices[t * 3 + 2]];
+                vec3 n = cross(b - a, p - a);
+                float area = length(n);
+                clusterCentroid[c] += (a + b + p) * (area / 3.0f);
+                clusterNormal[c] += n;
+                clusterArea[c] += area;
+            }
+            meshCentroid += clusterCentroid[c];
+            meshArea += clusterArea[c];
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            vec3 centroid = clusterArea[c] > 0.0f ? clusterCentroid[c] / clusterArea[c] : meshCentroid;
+            float normalLength = length(clusterNormal[c]);
+            vec3 normal = normalLength > 0.0f ? clusterNormal[c] / normalLength : vec3(0.0f);
+            sortKeys[c] = dot(centroid - meshCentroid, normal);
+        }
+
+        vector<size_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+            order[c] = c;
+        stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b)
+                    { return sortKeys[a] > sortKeys[b]; });
+
+        vector<unsigned int> sorted;
+        sorted.reserve(indices.size());
+        for (size_t c : order)
+        {
+            sorted.insert(sorted.end(), indices.begin() + splitStarts[c] * 3, indices.begin() + splitStarts[c + 1] * 3);
+        }
+        indices.swap(sorted);
+    }
+
+    // Median cuts along the longest axis of the triangle centroids.
+    void splitClusters(const vector<vec3> &centroids, vector<unsigned int> &triangles, size_t begin, size_t end,
+                       vector<pair<size_t, size_t>> &ranges)
+    {
+        if (end - begin <= CLUSTER_MAX_TRIANGLES)
+        {
+            ranges.push_back(make_pair(begin, end));
+            return;
+        }
+
+        vec3 lo = centroids[triangles[begin]];
+        vec3 hi = lo;
+        for (size_t i = begin; i < end; i++)
+        {
+            lo = glm::min(lo, centroids[triangles[i]]);
+            hi = glm::max(hi, centroids[triangles[i]]);
+        }
+        vec3 extent = hi - lo;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+        size_t mid = begin + (end - begin) / 2;
+        nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end,
+                    [&centroids, axis](unsigned int a, unsigned int b)
+                    { return centroids[a][axis] < centroids[b][axis]; });
+
+        splitClusters(centroids, triangles, begin, mid, ranges);
+        splitClusters(centroids, triangles, mid, end, ranges);
+    }
+
+    template <typename T>
+    void remapStream(vector<T> &stream, const vector<unsigned int> &newToOld)
+    {
+        if (stream.empty())
+            return;
+
+        vector<T> remapped(newToOld.size());
+        for (size_t i = 0; i < newToOld.size(); i++)
+            remapped[i] = stream[newToOld[i]];
+        stream.swap(remapped);
+    }
+
+    // Renumbers vertices in first-use order and drops unreferenced ones.
+    void optimizeVertexFetch(MeshInstance &mesh, vector<unsigned int> &indices)
+    {
+        size_t n = mesh.vertices.size();
+        vector<unsigned int> oldToNew(n, ~0u);
+        vector<unsigned int> newToOld;
+        newToOld.reserve(n);
+        for (unsigned int &index : indices)
+        {
+            if (oldToNew[index] == ~0u)
+            {
+                oldToNew[index] = static_cast<unsigned int>(newToOld.size());
+                newToOld.push_back(index);
+            }
+            index = oldToNew[index];
+        }
+
+        remapStream(mesh.vertices, newToOld);
+        if (hasStream(mesh.normals.size(), n))
+            remapStream(mesh.normals, newToOld);
+        if (hasStream(mesh.texcoords.size(), n))
+            remapStream(mesh.texcoords, newToOld);
+        if (hasStream(mesh.colors.size(), n))
+            remapStream(mesh.colors, newToOld);
+        if (hasStream(mesh.boneIds.size(), n))
+            remapStream(mesh.boneIds, newToOld);
+        if (hasStream(mesh.boneWeights.size(), n))
+            remapStream(mesh.boneWeights, newToOld);
+    }
+}
+
+size_t buildMeshClusters(MeshInstance &mesh)
+{
+    ProfileScope scope("buildMeshClusters");
+    mesh.clusters.clear();
+    size_t triangleCount = mesh.indices.size() / 3;
+    if (triangleCount < CLUSTER_MIN_MESH_TRIANGLES || mesh.hasBones)
+        return 0;
+
+    vector<vec3> centroids(triangleCount);
+    vector<unsigned int> triangles(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        centroids[t] = (mesh.vertices[mesh.indices[t * 3]] + mesh.vertices[mesh.indices[t * 3 + 1]] +
+                        mesh.vertices[mesh.indices[t * 3 + 2]]) / 3.0f;
+        triangles[t] = static_cast<unsigned int>(t);
+    }
+
+    vector<pair<size_t, size_t>> ranges;
+    splitClusters(centroids, triangles, 0, triangleCount, ranges);
+
+    vector<unsigned int> indices;
+    indices.reserve(mesh.indices.size());
+    vector<unsigned int> clusterIndices;
+    for (const pair<size_t, size_t> &range : ranges)
+    {
+        clusterIndices.clear();
+        for (size_t i = range.first; i < range.second; i++)
+        {
+            const unsigned int *tri = &mesh.indices[triangles[i] * 3];
+            clusterIndices.insert(clusterIndices.end(), tri, tri + 3);
+        }
+        clusterIndices = optimizeVertexCache(clusterIndices, mesh.vertices.size());
+
+        MeshCluster cluster;
+        cluster.firstIndex = static_cast<GLsizei>(indices.size());
+        cluster.indexCount = static_cast<GLsizei>(clusterIndices.size());
+        cluster.boundsMin = mesh.vertices[clusterIndices[0]];
+        cluster.boundsMax = cluster.boundsMin;
+        for (unsigned int index : clusterIndices)
+        {
+            cluster.boundsMin = glm::min(cluster.boundsMin, mesh.vertices[index]);
+            cluster.boundsMax = glm::max(cluster.boundsMax, mesh.vertices[index]);
+        }
+        mesh.clusters.push_back(cluster);
+        indices.insert(indices.end(), clusterIndices.begin(), clusterIndices.end());
+    }
+
+    // Keep vertex fetch in step with the new triangle order.
+    optimizeVertexFetch(mesh, indices);
+    mesh.indices.swap(indices);
+    return mesh.clusters.size();
+}
+
+void optimizeVertexCacheOrder(vector<unsigned int> &indices, size_t vertexCount)
+{
+    indices = optimizeVertexCache(indices, vertexCount);
+}
+
+void analyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount,
+                        unsigned int cacheSize, float &acmr, float &atvr)
+{
+    acmr = 0.0f;
+    atvr = 0.0f;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || cacheSize == 0)
+        return;
+
+    // A timestamp per vertex is enough to model a FIFO cache: a vertex is
+    // resident while fewer than cacheSize misses happened since it entered.
+    vector<size_t> insertedAt(vertexCount, 0);
+    vector<bool> seen(vertexCount, false);
+    size_t misses = 0;
+    size_t unique = 0;
+    for (unsigned int index : indices)
+    {
+        if (index >= vertexCount)
+            continue;
+        if (!seen[index])
+        {
+            seen[index] = true;
+            unique++;
+        }
+        else if (misses - insertedAt[index] < cacheSize)
+        {
+            continue;
+        }
+        insertedAt[index] = misses;
+        misses++;
+    }
+
+    acmr = static_cast<float>(misses) / triangleCount;
+    atvr = unique > 0 ? static_cast<float>(misses) / unique : 0.0f;
+}
+
+MeshOptimizationStats optimizeMesh(MeshInstance &mesh)
+{
+    ProfileScope scope("optimizeMesh");
+    MeshOptimizationStats stats;
+    stats.verticesBefore = mesh.vertices.size();
+    stats.trianglesBefore = mesh.indices.size() / 3;
+    analyzeVertexCache(mesh.indices, mesh.vertices.size(), VERTEX_CACHE_SIZE, stats.acmrBefore, stats.atvrBefore);
+
+    vector<unsigned int> indices = mesh.indices;
+    if (!mesh.vertices.empty() && !indices.empty())
+    {
+        weldVertices(mesh, indices);
+        removeDegenerateTriangles(mesh, indices);
+        indices = optimizeVertexCache(indices, mesh.vertices.size());
+        optimizeOverdraw(mesh, indices);
+        optimizeVertexFetch(mesh, indices);
+        mesh.indices.swap(indices);
+    }
+
+    stats.verticesAfter = mesh.vertices.size();
+    stats.trianglesAfter = mesh.indices.size() / 3;
+    analyzeVertexCache(mesh.indices, mesh.vertices.size(), VERTEX_CACHE_SIZE, stats.acmrAfter, stats.atvrAfter);
+    return stats;
+}
+
+void printMeshOptimizationStats(const string &label, const MeshOptimizationStats &stats)
+{
+    ostringstream line;
+    line << "[optimize] " << label << ": verts " << stats.verticesBefore << " -> " << stats.verticesAfter
+         << ", tris " << stats.trianglesBefore << " -> " << stats.trianglesAfter
+         << fixed << setprecision(3)
+         << ", ACMR " << stats.acmrBefore << " -> " << stats.acmrAfter
+         << ", ATVR " << stats.atvrBefore << " -> " << stats.atvrAfter
+         << (stats.verticesAfter <= 65536 ? ", 16-bit indices" : "");
+    printLoadLine(line.str());
+}
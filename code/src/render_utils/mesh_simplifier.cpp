@@ -0,0 +1,546 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+#include "load_profiler.h"
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+    // Meshes smaller than this are cheap enough to always draw in full.
+    const size_t LOD_MIN_TRIANGLES = 128;
+
+    // A level is kept only if it drops at least this share of the
+    // triangles of the level before it.
+    const float LOD_MIN_REDUCTION = 0.2f;
+
+    // Deviation the first simplified level may add, relative to the mesh
+    // radius. Each further level may add twice as much as the one before.
+    const float LOD_BASE_ERROR = 0.0125f;
+
+    // Border edges resist moving inward much more than faces resist moving
+    // off their plane.
+    const double BORDER_WEIGHT = 10.0;
+
+    enum VertexKind
+    {
+        KIND_MANIFOLD,
+        KIND_BORDER,
+        KIND_SEAM,
+        KIND_LOCKED
+    };
+
+    // Symmetric 4x4 error matrix plus the total weight behind it, so the
+    // error reads as a weighted mean squared distance.
+    struct Quadric
+    {
+        double a00, a11, a22, a01, a02, a12;
+        double b0, b1, b2;
+        double c;
+        double weight;
+    };
+
+    void addPlane(Quadric &q, const vec3 &n, float d, double weight)
+    {
+        q.a00 += weight * n.x * n.x;
+        q.a11 += weight * n.y * n.y;
+        q.a22 += weight * n.z * n.z;
+        q.a01 += weight * n.x * n.y;
+        q.a02 += weight * n.x * n.z;
+        q.a12 += weight * n.y * n.z;
+        q.b0 += weight * n.x * d;
+        q.b1 += weight * n.y * d;
+        q.b2 += weight * n.z * d;
+        q.c += weight * d * d;
+        q.weight += weight;
+    }
+
+    void addQuadric(Quadric &q, const Quadric &r)
+    {
+        q.a00 += r.a00;
+        q.a11 += r.a11;
+        q.a22 += r.a22;
+        q.a01 += r.a01;
+        q.a02 += r.a02;
+        q.a12 += r.a12;
+        q.b0 += r.b0;
+        q.b1 += r.b1;
+        q.b2 += r.b2;
+        q.c += r.c;
+        q.weight += r.weight;
+    }
+
+    float quadricError(const Quadric &q, const vec3 &p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+                   2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+                   2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+        if (q.weight > 0.0)
+            e /= q.weight;
+        return static_cast<float>(e > 0.0 ? e : 0.0);
+    }
+
+    // remap[v] is the first vertex sharing v's position; wedge[v] links all
+    // vertices at one position into a ring.
+    void buildPositionClasses(const vector<vec3> &positions, vector<unsigned int> &remap,
+                              vector<unsigned int> &wedge)
+    {
+        size_t n = positions.size();
+        vector<unsigned int> order(n);
+        for (size_t v = 0; v < n; v++)
+            order[v] = static_cast<unsigned int>(v);
+
+        auto positionLess = [&positions](unsigned int a, unsigned int b)
+        {
+            const vec3 &pa = positions[a];
+            const vec3 &pb = positions[b];
+            if (pa.x != pb.x)
+                return pa.x < pb.x;
+            if (pa.y != pb.y)
+                return pa.y < pb.y;
+            if (pa.z != pb.z)
+                return pa.z < pb.z;
+            return a < b;
+        };
+        sort(order.begin(), order.end(), positionLess);
+
+        remap.assign(n, 0);
+        wedge.assign(n, 0);
+        for (size_t i = 0; i < n;)
+        {
+            size_t end = i + 1;
+            while (end < n && positions[order[end]] == positions[order[i]])
+                end++;
+
+            unsigned int first = order[i];
+            for (size_t k = i; k < end; k++)
+            {
+                remap[order[k]] = first;
+                wedge[order[k]] = order[k + 1 < end ? k + 1 : i];
+            }
+            i = end;
+        }
+    }
+
+    // Directed edges of the current triangles, grouped by source vertex.
+    struct EdgeAdjacency
+    {
+        vector<unsigned int> start;
+        vector<unsigned int> target;
+
+        void build(const vector<unsigned int> &indices, size_t vertexCount)
+        {
+            start.assign(vertexCount + 1, 0);
+            for (unsigned int index : indices)
+                start[index + 1]++;
+            for (size_t v = 0; v < vertexCount; v++)
+                start[v + 1] += start[v];
+
+            target.resize(indices.size());
+            vector<unsigned int> fill(start.begin(), start.end() - 1);
+            for (size_t t = 0; t + 2 < indices.size(); t += 3)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int a = indices[t + k];
+                    unsigned int b = indices[t + (k + 1) % 3];
+                    target[fill[a]++] = b;
+                }
+            }
+        }
+
+        bool has(unsigned int a, unsigned int b) const
+        {
+            for (unsigned int i = start[a]; i < start[a + 1]; i++)
+            {
+                if (target[i] == b)
+                    return true;
+            }
+            return false;
+        }
+    };
+
+    // True if some copy of b links back to some copy of a, i.e. the open
+    // edge a->b is only open because of a seam.
+    bool hasReverseAtPosition(const EdgeAdjacency &edges, const vector<unsigned int> &wedge,
+                              unsigned int a, unsigned int b)
+    {
+        unsigned int bw = b;
+        do
+        {
+            unsigned int aw = a;
+            do
+            {
+                if ((aw != a || bw != b) && edges.has(bw, aw))
+                    return true;
+                aw = wedge[aw];
+            } while (aw != a);
+            bw = wedge[bw];
+        } while (bw != b);
+        return false;
+    }
+
+    void classifyVertices(const EdgeAdjacency &edges, const vector<unsigned int> &wedge, size_t vertexCount,
+                          vector<unsigned char> &kind, vector<unsigned int> &openNext,
+                          vector<unsigned int> &openPrev, vector<bool> &seamEdgeFrom)
+    {
+        vector<unsigned int> openOut(vertexCount, 0);
+        vector<unsigned int> openIn(vertexCount, 0);
+        openNext.assign(vertexCount, ~0u);
+        openPrev.assign(vertexCount, ~0u);
+        seamEdgeFrom.assign(vertexCount, false);
+        vector<bool> borderEdgeFrom(vertexCount, false);
+
+        for (size_t a = 0; a < vertexCount; a++)
+        {
+            for (unsigned int i = edges.start[a]; i < edges.start[a + 1]; i++)
+            {
+                unsigned int b = edges.target[i];
+                if (edges.has(b, static_cast<unsigned int>(a)))
+                    continue;
+
+                openOut[a]++;
+                openIn[b]++;
+                openNext[a] = b;
+                openPrev[b] = static_cast<unsigned int>(a);
+                if (hasReverseAtPosition(edges, wedge, static_cast<unsigned int>(a), b))
+                    seamEdgeFrom[a] = true;
+                else
+                    borderEdgeFrom[a] = true;
+            }
+        }
+
+        kind.assign(vertexCount, KIND_LOCKED);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            bool simpleOpen = openOut[v] == 1 && openIn[v] == 1;
+            if (wedge[v] == v)
+            {
+                if (openOut[v] == 0 && openIn[v] == 0)
+                    kind[v] = KIND_MANIFOLD;
+                else if (simpleOpen && borderEdgeFrom[v] && borderEdgeFrom[openPrev[v]])
+                    kind[v] = KIND_BORDER;
+            }
+            else
+            {
+                unsigned int twin = wedge[v];
+                bool pair = wedge[twin] == v;
+                bool twinOpen = openOut[twin] == 1 && openIn[twin] == 1;
+                if (pair && simpleOpen && twinOpen && seamEdgeFrom[v] && seamEdgeFrom[openPrev[v]])
+                    kind[v] = KIND_SEAM;
+            }
+        }
+    }
+
+    // The copy of `to` that `from`'s seam twin should collapse onto.
+    unsigned int findSeamTarget(const EdgeAdjacency &edges, const vector<unsigned int> &wedge,
+                                unsigned int twin, unsigned int to)
+    {
+        unsigned int candidate = to;
+        do
+        {
+            if (candidate != to && (edges.has(twin, candidate) || edges.has(candidate, twin)))
+                return candidate;
+            candidate = wedge[candidate];
+        } while (candidate != to);
+        return ~0u;
+    }
+
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        float error;
+    };
+
+    // Rejects collapses that would turn a surrounding triangle over.
+    bool collapseFlips(const vector<unsigned int> &indices, const vector<vec3> &positions,
+                       const vector<unsigned int> &remap, const vector<unsigned int> &trianglesStart,
+                       const vector<unsigned int> &triangles, unsigned int fromClass, unsigned int toClass,
+                       const vec3 &target)
+    {
+        for (unsigned int i = trianglesStart[fromClass]; i < trianglesStart[fromClass + 1]; i++)
+        {
+            const unsigned int *tri = &indices[triangles[i] * 3];
+            vec3 p[3];
+            vec3 q[3];
+            bool removed = false;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int c = remap[tri[k]];
+                if (c == toClass)
+                    removed = true;
+                p[k] = positions[tri[k]];
+                q[k] = c == fromClass ? target : p[k];
+            }
+            if (removed)
+                continue;
+
+            vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+            vec3 after = cross(q[1] - q[0], q[2] - q[0]);
+            if (dot(before, after) <= 0.0f)
+                return true;
+        }
+        return false;
+    }
+}
+
+vector<unsigned int> simplifyMesh(const vector<unsigned int> &indices, const vector<vec3> &positions,
+                                  size_t targetIndexCount, float maxError, float &resultError)
+{
+    resultError = 0.0f;
+    vector<unsigned int> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+    size_t vertexCount = positions.size();
+    if (result.size() <= targetIndexCount || vertexCount == 0)
+        return result;
+
+    vector<unsigned int> remap;
+    vector<unsigned int> wedge;
+    buildPositionClasses(positions, remap, wedge);
+
+    EdgeAdjacency edges;
+    vector<unsigned char> kind;
+    vector<unsigned int> openNext;
+    vector<unsigned int> openPrev;
+    vector<bool> seamEdgeFrom;
+    edges.build(result, vertexCount);
+    classifyVertices(edges, wedge, vertexCount, kind, openNext, openPrev, seamEdgeFrom);
+
+    // Quadrics live on position classes, so seam twins share one.
+    vector<Quadric> quadrics(vertexCount, Quadric());
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+        const vec3 &a = positions[result[t]];
+        const vec3 &b = positions[result[t + 1]];
+        const vec3 &c = positions[result[t + 2]];
+        vec3 normal = cross(b - a, c - a);
+        float area = length(normal);
+        if (area <= 0.0f)
+            continue;
+        normal /= area;
+
+        for (int k = 0; k < 3; k++)
+            addPlane(quadrics[remap[result[t + k]]], normal, -dot(normal, a), area * 0.5f);
+
+        // Border edges add a plane through the edge, perpendicular to the face.
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int from = result[t + k];
+            unsigned int to = result[t + (k + 1) % 3];
+            if (edges.has(to, from) || hasReverseAtPosition(edges, wedge, from, to))
+                continue;
+
+            vec3 edge = positions[to] - positions[from];
+            float edgeLength = length(edge);
+            if (edgeLength <= 0.0f)
+                continue;
+            vec3 side = normalize(cross(edge, normal));
+            double weight = BORDER_WEIGHT * edgeLength * edgeLength;
+            addPlane(quadrics[remap[from]], side, -dot(side, positions[from]), weight);
+            addPlane(quadrics[remap[to]], side, -dot(side, positions[from]), weight);
+        }
+    }
+
+    float maxErrorSq = maxError * maxError;
+    vector<unsigned int> collapseTo(vertexCount);
+    vector<bool> passLocked(vertexCount);
+    vector<unsigned int> trianglesStart;
+    vector<unsigned int> triangles;
+    vector<Collapse> candidates;
+
+    while (result.size() > targetIndexCount)
+    {
+        // Cheapest legal collapse out of each vertex.
+        candidates.clear();
+        for (size_t u = 0; u < vertexCount; u++)
+        {
+            if (kind[u] == KIND_LOCKED || edges.start[u] == edges.start[u + 1])
+                continue;
+
+            Collapse best = {static_cast<unsigned int>(u), ~0u, 0.0f};
+            const Quadric &q = quadrics[remap[u]];
+            auto consider = [&](unsigned int v)
+            {
+                if (v == ~0u || remap[v] == remap[u])
+                    return;
+                if (kind[u] == KIND_SEAM && wedge[v] == v)
+                    return;
+                float error = quadricError(q, positions[v]);
+                if (best.to == ~0u || error < best.error)
+                {
+                    best.to = v;
+                    best.error = error;
+                }
+            };
+
+            if (kind[u] == KIND_MANIFOLD)
+            {
+                for (unsigned int i = edges.start[u]; i < edges.start[u + 1]; i++)
+                    consider(edges.target[i]);
+            }
+            else
+            {
+                consider(openNext[u]);
+                consider(openPrev[u]);
+            }
+
+            if (best.to != ~0u)
+                candidates.push_back(best);
+        }
+        if (candidates.empty())
+            break;
+
+        sort(candidates.begin(), candidates.end(), [](const Collapse &a, const Collapse &b)
+             { return a.error < b.error; });
+
+        // Triangles around each position class, for the flip test.
+        trianglesStart.assign(vertexCount + 1, 0);
+        for (unsigned int index : result)
+            trianglesStart[remap[index] + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            trianglesStart[v + 1] += trianglesStart[v];
+        triangles.resize(result.size());
+        {
+            vector<unsigned int> fill(trianglesStart.begin(), trianglesStart.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+                triangles[fill[remap[result[i]]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        for (size_t v = 0; v < vertexCount; v++)
+            collapseTo[v] = static_cast<unsigned int>(v);
+        fill(passLocked.begin(), passLocked.end(), false);
+
+        // Collapse in cost order, each position class at most once per
+        // pass, until the pass has removed about enough triangles.
+        size_t goal = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        size_t collapses = 0;
+        for (const Collapse &collapse : candidates)
+        {
+            if (collapse.error > maxErrorSq || removed >= goal)
+                break;
+
+            unsigned int fromClass = remap[collapse.from];
+            unsigned int toClass = remap[collapse.to];
+            if (passLocked[fromClass] || passLocked[toClass])
+                continue;
+
+            unsigned int twin = ~0u;
+            unsigned int twinTarget = ~0u;
+            if (kind[collapse.from] == KIND_SEAM)
+            {
+                twin = wedge[collapse.from];
+                twinTarget = findSeamTarget(edges, wedge, twin, collapse.to);
+                if (twinTarget == ~0u)
+                    continue;
+            }
+
+            if (collapseFlips(result, positions, remap, trianglesStart, triangles, fromClass, toClass,
+                              positions[collapse.to]))
+                continue;
+
+            collapseTo[collapse.from] = collapse.to;
+            if (twin != ~0u)
+                collapseTo[twin] = twinTarget;
+
+            addQuadric(quadrics[toClass], quadrics[fromClass]);
+            passLocked[fromClass] = true;
+            passLocked[toClass] = true;
+            resultError = std::max(resultError, collapse.error);
+            removed += kind[collapse.from] == KIND_BORDER ? 1 : 2;
+            collapses++;
+        }
+        if (collapses == 0)
+            break;
+
+        size_t out = 0;
+        for (size_t t = 0; t < result.size(); t += 3)
+        {
+            unsigned int a = collapseTo[result[t]];
+            unsigned int b = collapseTo[result[t + 1]];
+            unsigned int c = collapseTo[result[t + 2]];
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+                continue;
+            result[out++] = a;
+            result[out++] = b;
+            result[out++] = c;
+        }
+        result.resize(out);
+
+        edges.build(result, vertexCount);
+        classifyVertices(edges, wedge, vertexCount, kind, openNext, openPrev, seamEdgeFrom);
+    }
+
+    resultError = sqrt(resultError);
+    return result;
+}
+
+void buildMeshLods(MeshInstance &mesh)
+{
+    ProfileScope scope("buildMeshLods");
+    mesh.lods.clear();
+    mesh.lodIndices.clear();
+
+    MeshLod full;
+    full.firstIndex = 0;
+    full.indexCount = static_cast<GLsizei>(mesh.indices.size());
+    full.error = 0.0f;
+    mesh.lods.push_back(full);
+
+    if (mesh.indices.size() / 3 < LOD_MIN_TRIANGLES || mesh.vertices.empty())
+        return;
+
+    vec3 boundsMin = mesh.vertices[0];
+    vec3 boundsMax = mesh.vertices[0];
+    for (const vec3 &v : mesh.vertices)
+    {
+        boundsMin = glm::min(boundsMin, v);
+        boundsMax = glm::max(boundsMax, v);
+    }
+    float radius = 0.5f * length(boundsMax - boundsMin);
+
+    vector<unsigned int> previous = mesh.indices;
+    float error = 0.0f;
+    float levelError = LOD_BASE_ERROR * radius;
+    for (int level = 1; level < MeshInstance::MAX_LODS; level++, levelError *= 2.0f)
+    {
+        size_t target = previous.size() / 6 * 3;
+        float achieved = 0.0f;
+        vector<unsigned int> simplified = simplifyMesh(previous, mesh.vertices, target, levelError, achieved);
+        if (simplified.empty() || simplified.size() > previous.size() * (1.0f - LOD_MIN_REDUCTION))
+            break;
+
+        optimizeVertexCacheOrder(simplified, mesh.vertices.size());
+        error += achieved;
+
+        MeshLod lod;
+        lod.firstIndex = static_cast<GLsizei>(mesh.indices.size() + mesh.lodIndices.size());
+        lod.indexCount = static_cast<GLsizei>(simplified.size());
+        lod.error = error;
+        mesh.lods.push_back(lod);
+        mesh.lodIndices.insert(mesh.lodIndices.end(), simplified.begin(), simplified.end());
+
+        previous.swap(simplified);
+    }
+}
+
+void printMeshLods(const string &label, const MeshInstance &mesh)
+{
+    if (mesh.lods.size() < 2)
+        return;
+
+    ostringstream line;
+    line << "[lod] " << label << ": tris";
+    for (size_t i = 0; i < mesh.lods.size(); i++)
+    {
+        line << (i == 0 ? " " : " / ") << mesh.lods[i].indexCount / 3;
+    }
+    line << ", error " << fixed << setprecision(4) << mesh.lods.back().error;
+    printLoadLine(line.str());
+}
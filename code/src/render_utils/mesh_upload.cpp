@@ -0,0 +1,353 @@
+#include <vector>
+
+#include "mesh_loader.h"
+#include "mesh_cache.h"
+#include "texture_loader.h"
+#include "texture_cache.h"
+#include "texture_streaming.h"
+#include "vertex_format.h"
+#include "load_profiler.h"
+
+using namespace glm;
+using namespace std;
+
+// The GL side of meshes: buffers, vertex layouts, textures and draws.
+// Importing, which desert_bake shares, is in mesh_loader.cpp and
+// vertex_format.cpp.
+
+static void uploadMeshTexture(MeshInstance &instance)
+{
+    // Deferred textures are uploaded by the first draw that needs them.
+    if (lazyTextureLoading())
+        deferMeshTexture(instance);
+    if (instance.diffuseStream)
+    {
+        instance.diffuseTexture = 0;
+        instance.hasDiffuseTexture = true;
+        return;
+    }
+
+    ProfileScope scope("uploadTexture");
+    TextureRef &ref = instance.diffuseRef;
+    GLuint tex = 0;
+    if (!ref.cacheKey.empty())
+    {
+        tex = acquireCachedTexture(ref.cacheKey);
+        if (tex == 0 && ref.pixels.empty())
+        {
+            decodeTexturePixels(ref);
+        }
+        if (tex == 0 && !ref.pixels.empty())
+        {
+            tex = UploadTextureFromPixels(ref.pixels.data(), ref.width, ref.height, ref.channels, true);
+
+            // Only the uploading mesh counts it, sharers add nothing.
+            size_t bytes = textureBytes(ref.width, ref.height, ref.channels);
+            addCachedTexture(ref.cacheKey, tex, bytes);
+            if (tex != 0)
+            {
+                instance.gpuBytes += bytes;
+            }
+        }
+    }
+
+    vector<unsigned char>().swap(ref.pixels);
+    vector<unsigned char>().swap(ref.data);
+
+    instance.diffuseTexture = tex;
+    instance.hasDiffuseTexture = tex != 0;
+}
+
+static void createMeshBuffers(MeshInstance &instance)
+{
+    ProfileScope scope("createMeshBuffers");
+
+    // A warm load uploads straight from the mesh cache file; a cold one from
+    // the streams it just built. Simplified levels follow the full mesh in
+    // the element buffer either way.
+    const unsigned char *vertexData = instance.packedVertices.data();
+    size_t vertexSize = instance.packedVertices.size();
+    vector<unsigned char> elements;
+    const unsigned char *elementData = nullptr;
+    size_t elementSize = 0;
+    if (instance.cacheView)
+    {
+        vertexData = instance.cacheView->vertexData;
+        vertexSize = instance.cacheView->vertexSize;
+        elementData = instance.cacheView->elementData;
+        elementSize = instance.cacheView->elementSize;
+    }
+    else
+    {
+        instance.indexType = packMeshElements(instance, elements);
+        instance.indexCount = static_cast<GLsizei>(instance.indices.size());
+        elementData = elements.data();
+        elementSize = elements.size();
+    }
+
+    glGenVertexArrays(1, &instance.VAO);
+    glBindVertexArray(instance.VAO);
+
+    glGenBuffers(1, &instance.VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instance.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexSize, vertexData, GL_STATIC_DRAW);
+    bindPackedVertexLayout(instance.vertexLayout);
+
+    glGenBuffers(1, &instance.EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, instance.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementSize, elementData, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+
+    instance.vertexBytes = vertexSize;
+    vector<unsigned char>().swap(instance.packedVertices);
+
+    instance.gpuBytes = vertexSize + elementSize;
+    if (instance.lods.empty())
+    {
+        MeshLod full;
+        full.firstIndex = 0;
+        full.indexCount = instance.indexCount;
+        full.error = 0.0f;
+        instance.lods.push_back(full);
+    }
+    instance.ready = true;
+}
+
+static void bindMeshTexture(const MeshInstance &mesh, GLuint shaderID)
+{
+    GLint locSampler = glGetUniformLocation(shaderID, "diffuseTexture");
+    GLint locHasTexture = glGetUniformLocation(shaderID, "hasTexture");
+    GLuint texture = mesh.diffuseStream ? resolveStreamedTexture(mesh.diffuseStream) : mesh.diffuseTexture;
+    if (mesh.hasDiffuseTexture && texture != 0)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (locSampler >= 0)
+        {
+            glUniform1i(locSampler, 0);
+        }
+        if (locHasTexture >= 0)
+        {
+            glUniform1i(locHasTexture, 1);
+        }
+    }
+    else
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (locHasTexture >= 0)
+        {
+            glUniform1i(locHasTexture, 0);
+        }
+    }
+}
+
+static size_t indexByteOffset(const MeshInstance &mesh, GLsizei firstIndex)
+{
+    return static_cast<size_t>(firstIndex) *
+           (mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int));
+}
+
+void MeshInstance::draw(GLuint shaderID, const mat4 &model, const mat4 &view, const mat4 &proj, int lod) const
+{
+    if (!ready)
+        return;
+
+    bindMeshTexture(*this, shaderID);
+
+    GLsizei count = indexCount;
+    size_t offset = 0;
+    if (lod > 0 && lod < static_cast<int>(lods.size()))
+    {
+        count = lods[lod].indexCount;
+        offset = indexByteOffset(*this, lods[lod].firstIndex);
+    }
+
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, count, indexType, reinterpret_cast<const void *>(offset));
+    glBindVertexArray(0);
+}
+
+void MeshInstance::drawClusters(GLuint shaderID, const vector<unsigned int> &visibleClusters) const
+{
+    if (!ready || visibleClusters.empty())
+        return;
+
+    bindMeshTexture(*this, shaderID);
+
+    // Neighbouring clusters are adjacent in the index buffer, so runs of
+    // visible ones merge into a single range.
+    vector<GLsizei> counts;
+    vector<const void *> offsets;
+    for (size_t i = 0; i < visibleClusters.size();)
+    {
+        const MeshCluster &first = clusters[visibleClusters[i]];
+        GLsizei count = first.indexCount;
+        size_t next = i + 1;
+        while (next < visibleClusters.size() && visibleClusters[next] == visibleClusters[next - 1] + 1)
+        {
+            count += clusters[visibleClusters[next]].indexCount;
+            next++;
+        }
+        counts.push_back(count);
+        offsets.push_back(reinterpret_cast<const void *>(indexByteOffset(*this, first.firstIndex)));
+        i = next;
+    }
+
+    glBindVertexArray(VAO);
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), indexType, offsets.data(),
+                        static_cast<GLsizei>(counts.size()));
+    glBindVertexArray(0);
+}
+
+size_t upload_mesh(vector<MeshInstance> &meshes, unsigned int keepCpuStreams)
+{
+    ProfileScope scope("upload_mesh");
+    size_t released = 0;
+    for (MeshInstance &instance : meshes)
+    {
+        createMeshBuffers(instance);
+        uploadMeshTexture(instance);
+        if (instance.cacheView)
+        {
+            readMeshCacheStreams(instance, keepCpuStreams);
+            instance.cacheView.reset();
+        }
+        released += releaseMeshCpuData(instance, keepCpuStreams);
+    }
+    return released;
+}
+
+vector<MeshInstance> load_mesh(const char *filePath)
+{
+    ProfileScope scope("load_mesh", filePath);
+    vector<MeshInstance> result;
+    if (import_mesh(filePath, result))
+    {
+        upload_mesh(result);
+    }
+    return result;
+}
+
+size_t upload_mesh_hierarchical(HierarchicalModel &model, unsigned int keepCpuStreams)
+{
+    if (!model.asset)
+        return 0;
+
+    return upload_mesh(model.asset->meshes, keepCpuStreams);
+}
+
+HierarchicalModel load_mesh_hierarchical(const char *filePath)
+{
+    ProfileScope scope("load_mesh_hierarchical", filePath);
+    HierarchicalModel result;
+    if (import_mesh_hierarchical(filePath, result))
+    {
+        upload_mesh_hierarchical(result);
+    }
+    return result;
+}
+
+void cleanupMesh(MeshInstance &mesh)
+{
+    if (mesh.VBO)
+        glDeleteBuffers(1, &mesh.VBO);
+    if (mesh.EBO)
+        glDeleteBuffers(1, &mesh.EBO);
+    if (mesh.VAO)
+        glDeleteVertexArrays(1, &mesh.VAO);
+    releaseCachedTexture(mesh.diffuseTexture);
+    releaseStreamedTexture(mesh.diffuseStream);
+    mesh.VAO = 0;
+    mesh.VBO = 0;
+    mesh.EBO = 0;
+    mesh.diffuseTexture = 0;
+    mesh.hasDiffuseTexture = false;
+    mesh.ready = false;
+    mesh.boneIds.clear();
+    mesh.boneWeights.clear();
+    mesh.boneMatrices.clear();
+    mesh.boneNameToIndex.clear();
+    mesh.hasBones = false;
+}
+
+void cleanupModelAsset(ModelAsset &asset)
+{
+    for (MeshInstance &mesh : asset.meshes)
+    {
+        cleanupMesh(mesh);
+    }
+    asset.meshes.clear();
+    asset.animationClips.clear();
+}
+
+void bindPackedVertexLayout(const PackedVertexLayout &layout)
+{
+    const GLsizei stride = layout.stride;
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void *>(0));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, reinterpret_cast<const void *>(12));
+    glEnableVertexAttribArray(1);
+
+    // Generic attribute values are context state, not VAO state, but every
+    // mesh wants the same constants so setting them here is enough.
+    if (layout.hasTexcoords)
+    {
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<const void *>(static_cast<size_t>(layout.texcoordOffset)));
+        glEnableVertexAttribArray(2);
+    }
+    else
+    {
+        glDisableVertexAttribArray(2);
+        glVertexAttrib2f(2, 0.0f, 0.0f);
+    }
+
+    if (layout.hasColors)
+    {
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                              reinterpret_cast<const void *>(static_cast<size_t>(layout.colorOffset)));
+        glEnableVertexAttribArray(3);
+    }
+    else
+    {
+        glDisableVertexAttribArray(3);
+        glVertexAttrib4f(3, 1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    if (layout.skinned)
+    {
+        glVertexAttribIPointer(5, 4, layout.wideBoneIds ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, stride,
+                               reinterpret_cast<const void *>(static_cast<size_t>(layout.boneIdOffset)));
+        glEnableVertexAttribArray(5);
+
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                              reinterpret_cast<const void *>(static_cast<size_t>(layout.weightOffset)));
+        glEnableVertexAttribArray(6);
+    }
+}
+
+unsigned int queryProgramVertexAttributes(GLuint program)
+{
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+
+    unsigned int attributes = 0;
+    vector<GLchar> name(static_cast<size_t>(maxLength > 0 ? maxLength : 1));
+    for (GLint i = 0; i < count; i++)
+    {
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib(program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), nullptr, &size, &type,
+                          name.data());
+        GLint location = glGetAttribLocation(program, name.data());
+        if (location >= 0 && location < 32)
+            attributes |= 1u << location;
+    }
+    return attributes;
+}
@@ -11,11 +11,41 @@
 using namespace std;
 using namespace glm;
 
+// Bounding spheres at least this tall, as a fraction of half the viewport
+// height, draw at full detail. Each halving drops one level.
+static const float LOD_FULL_DETAIL_SCREEN_SIZE = 0.5f;
+
+static float lodBias = 0.0f;
+static LodFrameStats lodStats = {};
+
+void setLodBias(float bias)
+{
+    lodBias = bias;
+}
+
+float getLodBias()
+{
+    return lodBias;
+}
+
+void beginLodFrame()
+{
+    lodStats = LodFrameStats();
+}
+
+const LodFrameStats &getLodFrameStats()
+{
+    return lodStats;
+}
+
 ModelRenderer::ModelRenderer(GLuint shaderProgramID)
 {
     shaderProgram = shaderProgramID;
     uniforms = new ShaderUniformManager();
     uniforms->initialize(shaderProgramID);
+    proxyVAO = 0;
+    proxyVBO = 0;
+    proxyEBO = 0;
 }
 
 ModelRenderer::~ModelRenderer()
@@ -26,6 +56,12 @@ ModelRenderer::~ModelRenderer()
         delete uniforms;
         uniforms = nullptr;
     }
+    if (proxyVBO)
+        glDeleteBuffers(1, &proxyVBO);
+    if (proxyEBO)
+        glDeleteBuffers(1, &proxyEBO);
+    if (proxyVAO)
+        glDeleteVertexArrays(1, &proxyVAO);
 }
 
 void ModelRenderer::setViewProjection(const mat4 &view, const mat4 &proj, const vec3 &cameraPos)
@@ -111,6 +147,83 @@ mat4 ModelRenderer::buildNodeTransform(const HierarchicalNode *node, const mat4
     return parentGlobal * nodeTransform;
 }
 
+int ModelRenderer::selectLod(const MeshInstance &mesh, const mat4 &modelMatrix, const mat4 &view, const mat4 &proj) const
+{
+    if (mesh.lods.size() < 2)
+        return 0;
+
+    mat4 modelView = view * modelMatrix;
+    vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+    float scale = std::max(length(vec3(modelView[0])),
+                           std::max(length(vec3(modelView[1])), length(vec3(modelView[2]))));
+    float radius = 0.5f * length(mesh.boundsMax - mesh.boundsMin) * scale;
+    float depth = -(modelView * vec4(center, 1.0f)).z;
+    if (radius <= 0.0f || depth <= radius)
+        return 0;
+
+    float screenSize = radius * proj[1][1] / depth;
+    float level = log2(LOD_FULL_DETAIL_SCREEN_SIZE / screenSize) + lodBias;
+    if (level <= 0.0f)
+        return 0;
+    return std::min(static_cast<int>(level), static_cast<int>(mesh.lods.size()) - 1);
+}
+
+void ModelRenderer::drawMesh(const MeshInstance &mesh, const mat4 &modelMatrix, const mat4 &view, const mat4 &proj)
+{
+    if (!mesh.ready)
+        return;
+
+    // Planes taken from the full model-view-projection are in model space,
+    // so mesh and cluster bounds are tested as stored. Skinned meshes can
+    // leave their rest-pose bounds and are always drawn. A mesh's texture
+    // is only requested once it gets past here.
+    Frustum frustum = extractFrustum(proj * view * modelMatrix);
+    if (!mesh.hasBones && !boxInFrustum(frustum, mesh.boundsMin, mesh.boundsMax))
+    {
+        lodStats.meshesCulled++;
+        return;
+    }
+
+    int lod = selectLod(mesh, modelMatrix, view, proj);
+    lodStats.trianglesFullDetail += mesh.indexCount / 3;
+
+    // Clustered meshes at full detail submit only the clusters in view.
+    if (lod == 0 && !mesh.clusters.empty())
+    {
+        GLsizei visibleIndices = 0;
+        visibleClusters.clear();
+        for (size_t i = 0; i < mesh.clusters.size(); i++)
+        {
+            const MeshCluster &cluster = mesh.clusters[i];
+            if (boxInFrustum(frustum, cluster.boundsMin, cluster.boundsMax))
+            {
+                visibleClusters.push_back(static_cast<unsigned int>(i));
+                visibleIndices += cluster.indexCount;
+            }
+        }
+        lodStats.clustersTested += mesh.clusters.size();
+        lodStats.clustersDrawn += visibleClusters.size();
+        if (visibleClusters.empty())
+            return;
+
+        lodStats.draws++;
+        lodStats.trianglesDrawn += visibleIndices / 3;
+        lodStats.drawsPerLevel[0]++;
+        if (visibleClusters.size() == mesh.clusters.size())
+            mesh.draw(shaderProgram, modelMatrix, view, proj, 0);
+        else
+            mesh.drawClusters(shaderProgram, visibleClusters);
+        return;
+    }
+
+    GLsizei indices = lod < static_cast<int>(mesh.lods.size()) ? mesh.lods[lod].indexCount : mesh.indexCount;
+    lodStats.draws++;
+    lodStats.trianglesDrawn += indices / 3;
+    lodStats.drawsPerLevel[lod]++;
+
+    mesh.draw(shaderProgram, modelMatrix, view, proj, lod);
+}
+
 void ModelRenderer::renderMesh(const MeshInstance &mesh, const mat4 &modelMatrix, const mat4 &view, const mat4 &proj)
 {
     if (!isValidMatrix(modelMatrix))
@@ -122,16 +235,11 @@ void ModelRenderer::renderMesh(const MeshInstance &mesh, const mat4 &modelMatrix
     if (mesh.hasBones)
     {
         uniforms->setHasBones(true);
-
-        GLint locBoneMatrices = glGetUniformLocation(shaderProgram, "finalBonesMatrices");
-        if (locBoneMatrices >= 0)
-        {
-            glUniformMatrix4fv(locBoneMatrices, mesh.boneMatrices.size(), GL_FALSE, value_ptr(mesh.boneMatrices[0]));
-        }
+        uniforms->setBonePalette(mesh.boneMatrices, mesh.boneInfluences);
     }
 
     uniforms->setModelMatrix(modelMatrix);
-    mesh.draw(shaderProgram, modelMatrix, view, proj);
+    drawMesh(mesh, modelMatrix, view, proj);
 }
 
 void ModelRenderer::renderNode(HierarchicalNode *node,
@@ -156,36 +264,24 @@ void ModelRenderer::renderNode(HierarchicalNode *node,
     // Draw all meshes on this node
     for (unsigned int meshIdx : node->meshIndices)
     {
-        if (meshIdx < model.meshes.size())
+        if (meshIdx < model.asset->meshes.size())
         {
-            const MeshInstance &mesh = model.meshes[meshIdx];
+            const MeshInstance &mesh = model.asset->meshes[meshIdx];
 
             if (mesh.hasBones && meshIdx < model.boneMatricesPerMesh.size() &&
                 !model.boneMatricesPerMesh[meshIdx].empty())
             {
-
+                // Palettes are compacted at import, so this is only the
+                // bones the mesh's vertices actually reference.
                 uniforms->setHasBones(true);
-
-                const auto &boneMatrices = model.boneMatricesPerMesh[meshIdx];
-                const GLsizei MAX_BONES_CPU = 100;
-                GLsizei boneCount = static_cast<GLsizei>(
-                    std::min(boneMatrices.size(), static_cast<size_t>(MAX_BONES_CPU)));
-
-                GLint locBoneMatrices = glGetUniformLocation(shaderProgram, "finalBonesMatrices");
-                if (locBoneMatrices >= 0)
-                {
-                    glUniformMatrix4fv(locBoneMatrices,
-                                       boneCount,
-                                       GL_FALSE,
-                                       value_ptr(boneMatrices[0]));
-                }
+                uniforms->setBonePalette(model.boneMatricesPerMesh[meshIdx], mesh.boneInfluences);
             }
             else
             {
                 uniforms->setHasBones(false);
             }
 
-            model.meshes[meshIdx].draw(shaderProgram, global, view, proj);
+            drawMesh(model.asset->meshes[meshIdx], global, view, proj);
         }
     }
 
@@ -212,31 +308,22 @@ void ModelRenderer::renderHierarchicalModel(HierarchicalModel &model,
 
     for (unsigned int meshIdx : model.rootNode->meshIndices)
     {
-        if (meshIdx < model.meshes.size())
+        if (meshIdx < model.asset->meshes.size())
         {
-            const MeshInstance &mesh = model.meshes[meshIdx];
+            const MeshInstance &mesh = model.asset->meshes[meshIdx];
 
             if (mesh.hasBones && meshIdx < model.boneMatricesPerMesh.size() &&
                 !model.boneMatricesPerMesh[meshIdx].empty())
             {
-
                 uniforms->setHasBones(true);
-
-                GLint locBoneMatrices = glGetUniformLocation(shaderProgram, "finalBonesMatrices");
-                if (locBoneMatrices >= 0)
-                {
-                    glUniformMatrix4fv(locBoneMatrices,
-                                       model.boneMatricesPerMesh[meshIdx].size(),
-                                       GL_FALSE,
-                                       value_ptr(model.boneMatricesPerMesh[meshIdx][0]));
-                }
+                uniforms->setBonePalette(model.boneMatricesPerMesh[meshIdx], mesh.boneInfluences);
             }
             else
             {
                 uniforms->setHasBones(false);
             }
 
-            model.meshes[meshIdx].draw(shaderProgram, rootGlobal, view, proj);
+            drawMesh(model.asset->meshes[meshIdx], rootGlobal, view, proj);
         }
     }
 
@@ -285,7 +372,7 @@ void ModelRenderer::renderMeshes(const vector<MeshInstance> &meshes,
         }
 
         uniforms->setModelMatrix(modelMatrix);
-        meshes[i].draw(shaderProgram, modelMatrix, view, proj);
+        drawMesh(meshes[i], modelMatrix, view, proj);
 
         GLenum err;
         while ((err = glGetError()) != GL_NO_ERROR)
@@ -295,6 +382,69 @@ void ModelRenderer::renderMeshes(const vector<MeshInstance> &meshes,
     }
 }
 
+void ModelRenderer::renderProxies(const vector<SceneProxy> &proxies)
+{
+    if (proxies.empty())
+        return;
+
+    if (!proxyVAO)
+    {
+        const float corners[] = {
+            0.0f, 0.0f, 0.0f,
+            1.0f, 0.0f, 0.0f,
+            1.0f, 1.0f, 0.0f,
+            0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 1.0f,
+            1.0f, 0.0f, 1.0f,
+            1.0f, 1.0f, 1.0f,
+            0.0f, 1.0f, 1.0f};
+        const unsigned int edges[] = {
+            0, 1, 1, 2, 2, 3, 3, 0,
+            4, 5, 5, 6, 6, 7, 7, 4,
+            0, 4, 1, 5, 2, 6, 3, 7};
+
+        glGenVertexArrays(1, &proxyVAO);
+        glBindVertexArray(proxyVAO);
+
+        glGenBuffers(1, &proxyVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, proxyVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(0);
+
+        glGenBuffers(1, &proxyEBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, proxyEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(edges), edges, GL_STATIC_DRAW);
+
+        glBindVertexArray(0);
+    }
+
+    uniforms->setHasBones(false);
+    GLint locHasTexture = glGetUniformLocation(shaderProgram, "hasTexture");
+    if (locHasTexture >= 0)
+    {
+        glUniform1i(locHasTexture, 0);
+    }
+
+    // The box has no normal or colour streams; feed constants instead.
+    glVertexAttrib3f(1, 0.0f, 1.0f, 0.0f);
+    glVertexAttrib3f(3, 0.9f, 0.75f, 0.45f);
+
+    glBindVertexArray(proxyVAO);
+    for (const SceneProxy &proxy : proxies)
+    {
+        mat4 modelMatrix = buildModelMatrix(proxy.position, proxy.rotation, proxy.scale);
+        modelMatrix = translate(modelMatrix, proxy.boundsMin);
+        modelMatrix = glm::scale(modelMatrix, proxy.boundsMax - proxy.boundsMin);
+        if (!isValidMatrix(modelMatrix))
+            continue;
+
+        uniforms->setModelMatrix(modelMatrix);
+        glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+}
+
 void ModelRenderer::setPointLights(const vector<vec3> &positions, const vector<vec3> &colors,
                                    const vector<float> &intensities,
                                    const vector<float> &constants,
@@ -1,9 +1,17 @@
+#include <chrono>
+#include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <map>
 
 #include "mesh_loader.h"
 #include "glm_compat.h"
 #include "scene_manager.h"
 #include "hierarchy_utils.h"
+#include "asset_loader.h"
+#include "texture_streaming.h"
+#include "frustum.h"
+#include "renderer.h"
 
 using namespace std;
 using namespace glm;
@@ -16,12 +24,69 @@ vector<ModelRange> modelRanges;
 vector<MeshTransform> meshTransforms;
 vector<MeshTransform> localTransforms;
 
+// Every add reserves a slot straight away so transforms and animations can
+// be set before the model's data is resident.
+// requested is set from the asset request until the slot is unloaded;
+// wanted is whether the slot's zone keeps it loaded.
+struct StaticModelSlot
+{
+    string path;
+    shared_ptr<ModelAsset> asset;
+    bool resolved;
+    bool requested;
+    bool wanted;
+    MeshTransform transform;
+};
+static vector<StaticModelSlot> staticModels;
+
+struct HierarchicalModelSlot
+{
+    string path;
+    bool resolved;
+    bool requested;
+    bool wanted;
+    bool configured;
+};
+static vector<HierarchicalModelSlot> hierarchicalSlots;
+
+// Zone streaming groups slots into square cells over the terrain by their
+// position. Cells within the load radius of the camera are loaded, cells
+// beyond the unload radius released, and a cell in between keeps its state.
+// A zero cell size keeps every slot loaded.
+typedef pair<int, int> ZoneCell;
+static float zoneCellSize = 0.0f;
+static float zoneLoadRadius = 0.0f;
+static float zoneUnloadRadius = 0.0f;
+static map<ZoneCell, bool> zoneCellLoaded;
+static size_t zoneLoads = 0;
+static size_t zoneUnloads = 0;
+
+// Releases run on the GL thread, so they are spread over frames.
+static const int ZONE_UNLOADS_PER_FRAME = 1;
+
+static chrono::steady_clock::time_point sceneStart;
+static bool firstStreamingFrame = true;
+static bool sceneStreamed = false;
+
+// Models that are off screen load after everything visible.
+static const float OFFSCREEN_PRIORITY_PENALTY = 100000.0f;
+// Stand-in radius, in model units before scaling, while a model's bounds are unknown.
+static const float UNKNOWN_MODEL_RADIUS = 5.0f;
+
 void setupScene(GLuint shaderProgramID)
 {
     shaderProgram = shaderProgramID;
     meshes.clear();
     meshTransforms.clear();
     modelRanges.clear();
+    staticModels.clear();
+    hierarchicalSlots.clear();
+    zoneCellLoaded.clear();
+    zoneLoads = 0;
+    zoneUnloads = 0;
+    sceneStart = chrono::steady_clock::now();
+    firstStreamingFrame = true;
+    sceneStreamed = false;
 }
 
 bool getModelRange(int modelIndex, int &start, int &count)
@@ -33,61 +98,471 @@ bool getModelRange(int modelIndex, int &start, int &count)
     return true;
 }
 
-void addMesh(const char *filePath)
+static void placeStaticModel(size_t index)
 {
-    vector<MeshInstance> loaded = load_mesh(filePath);
-    if (loaded.empty())
+    const StaticModelSlot &slot = staticModels[index];
+    size_t start = meshes.size();
+    size_t count = slot.asset ? slot.asset->meshes.size() : 0;
+
+    for (size_t i = 0; i < count; i++)
     {
-        cerr << "addMesh: failed to load '" << filePath << "'" << endl;
-        return;
+        meshes.push_back(shareMeshInstance(slot.asset->meshes[i]));
+        meshTransforms.push_back(slot.transform);
     }
 
-    size_t start = meshes.size();
+    modelRanges[index] = {start, count};
+}
 
-    for (auto &mesh : loaded)
+// Takes the model's meshes out of the flat list and drops the slot's
+// reference on the asset; the last reference frees its GPU and CPU data.
+static void unloadStaticModel(size_t index)
+{
+    StaticModelSlot &slot = staticModels[index];
+    ModelRange removed = modelRanges[index];
+    meshes.erase(meshes.begin() + removed.start, meshes.begin() + removed.start + removed.count);
+    meshTransforms.erase(meshTransforms.begin() + removed.start,
+                         meshTransforms.begin() + removed.start + removed.count);
+    for (ModelRange &range : modelRanges)
     {
-        meshes.push_back(mesh);
-
-        MeshTransform t{};
-        t.position = vec3(0.0f, 0.0f, 0.0f);
-        t.rotation = vec3(0.0f, 0.0f, 0.0f);
-        t.scale = vec3(1.0f, 1.0f, 1.0f);
-        t.animated = false;
-        t.animTime = 0.0f;
-        meshTransforms.push_back(t);
+        if (range.start > removed.start)
+            range.start -= removed.count;
     }
+    modelRanges[index] = {meshes.size(), 0};
 
-    size_t count = loaded.size();
-    modelRanges.push_back({start, count});
+    releaseModelAsset(slot.asset);
+    slot.resolved = false;
+    slot.requested = false;
 }
 
-void addHierarchicalMesh(const char *filePath)
+static void requestStaticModel(size_t index)
 {
-    HierarchicalModel hmodel = load_mesh_hierarchical(filePath);
-    if (hmodel.meshes.empty() || !hmodel.rootNode)
+    staticModels[index].requested = true;
+    auto onReady = [index](const shared_ptr<ModelAsset> &asset)
     {
-        cerr << "addHierarchicalMesh: failed to load '" << filePath << "'" << endl;
+        if (index >= staticModels.size())
+            return;
+        if (!asset)
+            cerr << "addMesh: failed to load '" << staticModels[index].path << "'" << endl;
+        staticModels[index].asset = asset;
+        staticModels[index].resolved = true;
+        placeStaticModel(index);
+    };
+    requestStaticAsset(staticModels[index].path.c_str(), onReady);
+}
+
+static bool zonesEnabled()
+{
+    return zoneCellSize > 0.0f;
+}
+
+void addMesh(const char *filePath)
+{
+    size_t index = staticModels.size();
+    StaticModelSlot slot;
+    slot.path = filePath ? filePath : "";
+    slot.resolved = false;
+    slot.requested = false;
+    // With zones the first streaming update decides, once transforms are set.
+    slot.wanted = !zonesEnabled();
+    slot.transform.position = vec3(0.0f, 0.0f, 0.0f);
+    slot.transform.rotation = vec3(0.0f, 0.0f, 0.0f);
+    slot.transform.scale = vec3(1.0f, 1.0f, 1.0f);
+    slot.transform.animated = false;
+    slot.transform.animTime = 0.0f;
+    staticModels.push_back(slot);
+    modelRanges.push_back({meshes.size(), 0});
+
+    if (slot.wanted)
+        requestStaticModel(index);
+}
+
+// Copies the loaded prototype into a reserved slot, keeping whatever
+// per-instance state was set on the slot while the model was loading.
+// Only the per-instance parts are copied; the geometry stays shared
+// through the asset.
+static void bindHierarchicalInstance(size_t index, const HierarchicalModel *prototype)
+{
+    if (index >= hierarchicalModels.size())
         return;
+
+    HierarchicalModel &slot = hierarchicalModels[index];
+    slot.asset = prototype->asset;
+    copyNodeTree(slot, *prototype);
+    slot.currentAnimationTime = prototype->currentAnimationTime;
+    slot.hasEmbeddedAnimation = prototype->hasEmbeddedAnimation;
+    slot.globalInverseTransform = prototype->globalInverseTransform;
+    slot.originalRootTransform = prototype->originalRootTransform;
+    slot.boneMatricesPerMesh = prototype->boneMatricesPerMesh;
+    slot.nodeNameMap = prototype->nodeNameMap;
+    if (!hierarchicalSlots[index].configured)
+    {
+        slot.animated = prototype->animated;
     }
+    if (slot.activeAnimation < 0 || slot.activeAnimation >= (int)slot.asset->animationClips.size())
+    {
+        slot.activeAnimation = prototype->activeAnimation;
+    }
+}
+
+static void requestHierarchicalModel(size_t index)
+{
+    hierarchicalSlots[index].requested = true;
+    auto onReady = [index](const HierarchicalModel *prototype)
+    {
+        if (index >= hierarchicalSlots.size())
+            return;
+        hierarchicalSlots[index].resolved = true;
+        if (!prototype)
+        {
+            cerr << "addHierarchicalMesh: failed to load '" << hierarchicalSlots[index].path << "'" << endl;
+            return;
+        }
+        bindHierarchicalInstance(index, prototype);
+    };
+    requestHierarchicalAsset(hierarchicalSlots[index].path.c_str(), onReady);
+}
 
+// Drops the instance's node tree and its reference on the asset. Placement,
+// animation choice and orbits stay on the slot for when it comes back.
+static void unloadHierarchicalModel(size_t index)
+{
+    HierarchicalModel &model = hierarchicalModels[index];
+    releaseModelAnimator(index);
+    releaseModelAsset(model.asset);
+    model.nodes.clear();
+    model.nodeNameMap.clear();
+    model.boneMatricesPerMesh.clear();
+    model.rootNode = nullptr;
+    hierarchicalSlots[index].resolved = false;
+    hierarchicalSlots[index].requested = false;
+}
+
+void addHierarchicalMesh(const char *filePath)
+{
+    HierarchicalModel hmodel;
     hmodel.modelIndex = hierarchicalModels.size();
+    hmodel.rootNode = nullptr;
+    hmodel.worldPosition = vec3(0.0f, 0.0f, 0.0f);
+    hmodel.worldRotation = vec3(0.0f, 0.0f, 0.0f);
+    hmodel.worldScale = vec3(1.0f, 1.0f, 1.0f);
+    hmodel.animated = false;
+    hmodel.activeAnimation = -1;
+    hmodel.currentAnimationTime = 0.0f;
+    hmodel.hasEmbeddedAnimation = false;
 
     hmodel.useOrbitalMotion = false;
     hmodel.orbitalParentIdx = -1;
     hmodel.orbitalChildIdx = -1;
 
-    vector<pair<string, string>> parentChildPairs;
-    string rootName = "";
-    collectHierarchy(hmodel.rootNode, parentChildPairs, rootName);
+    size_t index = hierarchicalModels.size();
+    hierarchicalModels.push_back(move(hmodel));
+
+    HierarchicalModelSlot slot;
+    slot.path = filePath ? filePath : "";
+    slot.resolved = false;
+    slot.requested = false;
+    slot.wanted = !zonesEnabled();
+    slot.configured = false;
+    hierarchicalSlots.push_back(slot);
+
+    if (slot.wanted)
+        requestHierarchicalModel(index);
+}
+
+void finishSceneLoads()
+{
+    // Blocking loads bring in every slot; zones release the far ones on
+    // later frames.
+    for (size_t i = 0; i < staticModels.size(); i++)
+    {
+        staticModels[i].wanted = true;
+        if (!staticModels[i].requested)
+            requestStaticModel(i);
+    }
+    for (size_t i = 0; i < hierarchicalSlots.size(); i++)
+    {
+        hierarchicalSlots[i].wanted = true;
+        if (!hierarchicalSlots[i].requested)
+            requestHierarchicalModel(i);
+    }
+
+    finishAssetLoads();
+    sceneStreamed = true;
+}
 
-    hierarchicalModels.push_back(hmodel);
-    rebuildNodePointers(hierarchicalModels.back(), parentChildPairs, rootName);
+static mat4 buildSlotMatrix(const vec3 &position, const vec3 &rotation, const vec3 &scale)
+{
+    mat4 model = identity_mat4();
+    model = translate(model, position);
+    model = rotate_x_deg(model, rotation.x);
+    model = rotate_y_deg(model, rotation.y);
+    model = rotate_z_deg(model, rotation.z);
+    model = glm::scale(model, scale);
+    return model;
+}
+
+// Distance from the camera to the model's bounds, pushed back when the
+// model is outside the view.
+static float streamingPriority(const string &path, bool hierarchical, const mat4 &modelMatrix,
+                               const vec3 &cameraPos, const Frustum &frustum)
+{
+    vec3 center;
+    float radius;
+    bool visible;
+
+    vec3 localMin, localMax;
+    if (getAssetBounds(path.c_str(), hierarchical, localMin, localMax))
+    {
+        vec3 worldMin, worldMax;
+        transformBounds(modelMatrix, localMin, localMax, worldMin, worldMax);
+        center = (worldMin + worldMax) * 0.5f;
+        radius = length(worldMax - worldMin) * 0.5f;
+        visible = boxInFrustum(frustum, worldMin, worldMax);
+    }
+    else
+    {
+        center = vec3(modelMatrix[3]);
+        radius = UNKNOWN_MODEL_RADIUS * length(vec3(modelMatrix[0]));
+        visible = sphereInFrustum(frustum, center, radius);
+    }
+
+    float priority = std::max(0.0f, length(center - cameraPos) - radius);
+    if (!visible)
+        priority += OFFSCREEN_PRIORITY_PENALTY;
+    return priority;
+}
+
+void setSceneZoneStreaming(float cellSize, float loadRadius, float unloadRadius)
+{
+    zoneCellSize = std::max(0.0f, cellSize);
+    zoneLoadRadius = loadRadius;
+    zoneUnloadRadius = std::max(loadRadius, unloadRadius);
+    zoneCellLoaded.clear();
+}
+
+static ZoneCell zoneCellAt(const vec3 &position)
+{
+    return ZoneCell((int)floor(position.x / zoneCellSize), (int)floor(position.z / zoneCellSize));
+}
+
+// Ground distance from the camera to the nearest point of the cell.
+static float zoneCellDistance(const ZoneCell &cell, const vec3 &cameraPos)
+{
+    float minX = cell.first * zoneCellSize;
+    float minZ = cell.second * zoneCellSize;
+    float dx = std::max(std::max(minX - cameraPos.x, cameraPos.x - (minX + zoneCellSize)), 0.0f);
+    float dz = std::max(std::max(minZ - cameraPos.z, cameraPos.z - (minZ + zoneCellSize)), 0.0f);
+    return sqrt(dx * dx + dz * dz);
+}
+
+// Decides which cells stay loaded for this camera position, requests the
+// slots of cells coming into range and unloads slots of cells left behind.
+static void updateSceneZones(const vec3 &cameraPos)
+{
+    // A cell seen for the first time between the radii keeps whatever its
+    // models already are, so nothing loaded is thrown away on arrival.
+    map<ZoneCell, bool> loadedBefore;
+    for (const StaticModelSlot &slot : staticModels)
+        loadedBefore[zoneCellAt(slot.transform.position)] |= slot.requested;
+    for (size_t i = 0; i < hierarchicalSlots.size(); i++)
+        loadedBefore[zoneCellAt(hierarchicalModels[i].worldPosition)] |= hierarchicalSlots[i].requested;
+
+    map<ZoneCell, bool> cells;
+    for (const auto &entry : loadedBefore)
+    {
+        const ZoneCell &cell = entry.first;
+        float distance = zoneCellDistance(cell, cameraPos);
+        auto previous = zoneCellLoaded.find(cell);
+        bool wasLoaded = previous != zoneCellLoaded.end() ? previous->second : entry.second;
+        bool loaded = distance <= zoneLoadRadius || (wasLoaded && distance <= zoneUnloadRadius);
+        cells[cell] = loaded;
+    }
+    zoneCellLoaded.swap(cells);
+
+    int unloads = 0;
+    for (size_t i = 0; i < staticModels.size(); i++)
+    {
+        StaticModelSlot &slot = staticModels[i];
+        slot.wanted = zoneCellLoaded[zoneCellAt(slot.transform.position)];
+        if (slot.wanted && !slot.requested)
+        {
+            requestStaticModel(i);
+            zoneLoads++;
+        }
+        else if (!slot.wanted && slot.resolved && unloads < ZONE_UNLOADS_PER_FRAME)
+        {
+            unloadStaticModel(i);
+            zoneUnloads++;
+            unloads++;
+        }
+    }
+    for (size_t i = 0; i < hierarchicalSlots.size(); i++)
+    {
+        HierarchicalModelSlot &slot = hierarchicalSlots[i];
+        slot.wanted = zoneCellLoaded[zoneCellAt(hierarchicalModels[i].worldPosition)];
+        if (slot.wanted && !slot.requested)
+        {
+            requestHierarchicalModel(i);
+            zoneLoads++;
+        }
+        else if (!slot.wanted && slot.resolved && unloads < ZONE_UNLOADS_PER_FRAME)
+        {
+            unloadHierarchicalModel(i);
+            zoneUnloads++;
+            unloads++;
+        }
+    }
+}
+
+void startSceneZones(const vec3 &cameraPos)
+{
+    if (zonesEnabled())
+        updateSceneZones(cameraPos);
+}
+
+bool updateSceneStreaming(const vec3 &cameraPos, const mat4 &viewProj, double uploadBudgetMs)
+{
+    if (zonesEnabled())
+    {
+        updateSceneZones(cameraPos);
+        // Once the first pass is in, later zone loads only need uploading.
+        if (sceneStreamed)
+        {
+            if (pendingAssetLoads())
+                pumpAssetUploads(uploadBudgetMs);
+            return false;
+        }
+    }
+    if (sceneStreamed)
+        return false;
+
+    Frustum frustum = extractFrustum(viewProj);
+
+    // Instances share one load per file, so each file takes the priority
+    // of its most urgent instance.
+    map<pair<string, bool>, float> priorities;
+    for (const StaticModelSlot &slot : staticModels)
+    {
+        if (slot.resolved || !slot.requested)
+            continue;
+        mat4 m = buildSlotMatrix(slot.transform.position, slot.transform.rotation, slot.transform.scale);
+        float p = streamingPriority(slot.path, false, m, cameraPos, frustum);
+        auto key = make_pair(slot.path, false);
+        if (priorities.find(key) == priorities.end() || p < priorities[key])
+            priorities[key] = p;
+    }
+    for (size_t i = 0; i < hierarchicalSlots.size(); i++)
+    {
+        if (hierarchicalSlots[i].resolved || !hierarchicalSlots[i].requested)
+            continue;
+        const HierarchicalModel &hmodel = hierarchicalModels[i];
+        mat4 m = buildSlotMatrix(hmodel.worldPosition, hmodel.worldRotation, hmodel.worldScale);
+        float p = streamingPriority(hierarchicalSlots[i].path, true, m, cameraPos, frustum);
+        auto key = make_pair(hierarchicalSlots[i].path, true);
+        if (priorities.find(key) == priorities.end() || p < priorities[key])
+            priorities[key] = p;
+    }
+    for (const auto &entry : priorities)
+    {
+        setAssetPriority(entry.first.first.c_str(), entry.first.second, entry.second);
+    }
+
+    pumpAssetUploads(uploadBudgetMs);
+
+    // With zones only the models in range count towards a streamed scene.
+    size_t resident = 0;
+    size_t total = 0;
+    for (const StaticModelSlot &slot : staticModels)
+    {
+        resident += slot.wanted && slot.resolved ? 1 : 0;
+        total += slot.wanted ? 1 : 0;
+    }
+    for (const HierarchicalModelSlot &slot : hierarchicalSlots)
+    {
+        resident += slot.wanted && slot.resolved ? 1 : 0;
+        total += slot.wanted ? 1 : 0;
+    }
+
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - sceneStart).count();
+    if (firstStreamingFrame)
+    {
+        cout << "First frame after " << elapsed << " ms with " << resident << "/" << total
+             << " models resident" << endl;
+        firstStreamingFrame = false;
+    }
+
+    if (resident < total || pendingAssetLoads())
+        return false;
+
+    cout << "All " << total << (zonesEnabled() ? " models in range" : " models")
+         << " streamed in after " << elapsed << " ms" << endl;
+    sceneStreamed = true;
+    return true;
+}
+
+void getSceneProxies(vector<SceneProxy> &proxies)
+{
+    proxies.clear();
+    if (sceneStreamed && !zonesEnabled())
+        return;
+
+    SceneProxy proxy;
+    for (const StaticModelSlot &slot : staticModels)
+    {
+        if (slot.resolved || !slot.requested ||
+            !getAssetBounds(slot.path.c_str(), false, proxy.boundsMin, proxy.boundsMax))
+            continue;
+        proxy.position = slot.transform.position;
+        proxy.rotation = slot.transform.rotation;
+        proxy.scale = slot.transform.scale;
+        proxies.push_back(proxy);
+    }
+    for (size_t i = 0; i < hierarchicalSlots.size(); i++)
+    {
+        const HierarchicalModelSlot &slot = hierarchicalSlots[i];
+        if (slot.resolved || !slot.requested ||
+            !getAssetBounds(slot.path.c_str(), true, proxy.boundsMin, proxy.boundsMax))
+            continue;
+        proxy.position = hierarchicalModels[i].worldPosition;
+        proxy.rotation = hierarchicalModels[i].worldRotation;
+        proxy.scale = hierarchicalModels[i].worldScale;
+        proxies.push_back(proxy);
+    }
+}
+
+void printSceneZoneReport()
+{
+    if (!zonesEnabled())
+        return;
+
+    size_t loadedCells = 0;
+    for (const auto &entry : zoneCellLoaded)
+        loadedCells += entry.second ? 1 : 0;
+    size_t resident = 0;
+    for (const StaticModelSlot &slot : staticModels)
+        resident += slot.resolved ? 1 : 0;
+    for (const HierarchicalModelSlot &slot : hierarchicalSlots)
+        resident += slot.resolved ? 1 : 0;
+
+    cout << "\n=== Scene zones ===\n";
+    cout << fixed << setprecision(0) << zoneCellSize << "-unit cells, loading within " << zoneLoadRadius
+         << " and unloading beyond " << zoneUnloadRadius << " units\n" << defaultfloat;
+    cout << loadedCells << "/" << zoneCellLoaded.size() << " cells loaded, " << resident << "/"
+         << staticModels.size() + hierarchicalSlots.size() << " models resident\n";
+    cout << zoneLoads << " zone loads, " << zoneUnloads << " zone unloads so far" << endl;
 }
 
 void setMeshTransform(int modelIndex, vec3 position, vec3 rotation, vec3 scale, bool animated)
 {
     if (modelIndex < 0 || modelIndex >= (int)modelRanges.size())
         return;
+
+    MeshTransform &stored = staticModels[modelIndex].transform;
+    stored.position = position;
+    stored.rotation = rotation;
+    stored.scale = scale;
+    stored.animated = animated;
+
     ModelRange r = modelRanges[modelIndex];
     for (size_t i = r.start; i < r.start + r.count; ++i)
     {
@@ -98,6 +573,14 @@ void setMeshTransform(int modelIndex, vec3 position, vec3 rotation, vec3 scale,
     }
 }
 
+bool getMeshTransform(int modelIndex, MeshTransform &transform)
+{
+    if (modelIndex < 0 || modelIndex >= (int)staticModels.size())
+        return false;
+    transform = staticModels[modelIndex].transform;
+    return true;
+}
+
 void setSubmeshTransform(int meshGlobalIndex, vec3 position, vec3 rotation, vec3 scale, bool animated)
 {
     if (meshGlobalIndex < 0 || meshGlobalIndex >= (int)localTransforms.size())
@@ -120,6 +603,7 @@ void setHierarchicalMeshTransform(int hierarchicalIndex, vec3 position, vec3 rot
     hierarchicalModels[hierarchicalIndex].worldRotation = rotation;
     hierarchicalModels[hierarchicalIndex].worldScale = scale;
     hierarchicalModels[hierarchicalIndex].animated = animated;
+    hierarchicalSlots[hierarchicalIndex].configured = true;
 }
 
 void setOrbitalMotion(int parentIndex, int childIndex)
@@ -139,22 +623,27 @@ void setOrbitalMotion(int parentIndex, int childIndex)
 
 void cleanupScene()
 {
+    stopAssetLoader();
 
-    for (MeshInstance &mesh : meshes)
+    for (StaticModelSlot &slot : staticModels)
     {
-        cleanupMesh(mesh);
+        releaseModelAsset(slot.asset);
     }
 
     for (HierarchicalModel &model : hierarchicalModels)
     {
+        releaseModelAsset(model.asset);
         cleanupHierarchicalModel(model);
     }
 
     meshes.clear();
+    staticModels.clear();
+    hierarchicalSlots.clear();
     meshTransforms.clear();
     hierarchicalModels.clear();
     modelRanges.clear();
     localTransforms.clear();
+    stopTextureStreaming();
     shaderProgram = 0;
     cout << "Scene cleaned up." << endl;
 }
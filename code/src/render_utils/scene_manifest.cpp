@@ -0,0 +1,235 @@
+#include <iostream>
+#include <map>
+#include <set>
+
+#include "scene_manifest.h"
+#include "scene_manager.h"
+#include "animate.h"
+#include "asset_pack.h"
+#include "json_reader.h"
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+    bool readVec3(const JsonValue &value, vec3 &out)
+    {
+        if (!value.isArray() || value.size() != 3)
+            return false;
+        for (size_t i = 0; i < 3; i++)
+        {
+            if (!value[i].isNumber())
+                return false;
+            out[i] = (float)value[i].asNumber();
+        }
+        return true;
+    }
+
+    bool readVec2(const JsonValue &value, vec2 &out)
+    {
+        if (!value.isArray() || value.size() != 2)
+            return false;
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (!value[i].isNumber())
+                return false;
+            out[i] = (float)value[i].asNumber();
+        }
+        return true;
+    }
+
+    // A scale is either one number for all three axes or an [x, y, z].
+    bool readScale(const JsonValue &value, vec3 &out)
+    {
+        if (value.isNumber())
+        {
+            out = vec3((float)value.asNumber());
+            return true;
+        }
+        return readVec3(value, out);
+    }
+
+    bool readInstance(const JsonValue &entry, bool hierarchical, int index, SceneInstance &instance, string &error)
+    {
+        instance.name = entry["name"].asString();
+        instance.model = entry["model"].asString();
+        instance.hierarchical = hierarchical;
+        instance.index = index;
+        instance.position = vec3(0.0f);
+        instance.rotation = vec3(0.0f);
+        instance.scale = vec3(1.0f);
+        instance.placed = entry.has("position");
+        instance.animated = entry["animated"].asBool(false);
+        instance.onGround = entry["ground"].asBool(false) || entry.has("groundAt");
+        instance.groundElsewhere = entry.has("groundAt");
+        instance.groundAt = vec2(0.0f);
+        instance.animation = entry["animation"].asInt(-1);
+
+        if (instance.model.empty())
+        {
+            error = "has no model";
+            return false;
+        }
+        if (instance.placed && !readVec3(entry["position"], instance.position))
+        {
+            error = "position is not [x, y, z]";
+            return false;
+        }
+        if (entry.has("rotation") && !readVec3(entry["rotation"], instance.rotation))
+        {
+            error = "rotation is not [x, y, z]";
+            return false;
+        }
+        if (entry.has("scale") && !readScale(entry["scale"], instance.scale))
+        {
+            error = "scale is not a number or [x, y, z]";
+            return false;
+        }
+        if (instance.groundElsewhere && !readVec2(entry["groundAt"], instance.groundAt))
+        {
+            error = "groundAt is not [x, z]";
+            return false;
+        }
+        if (instance.animation >= 0 && !hierarchical)
+        {
+            error = "static models have no animation clips";
+            return false;
+        }
+        instance.worldPosition = instance.position;
+        return true;
+    }
+
+    // Ground heights are applied by placeSceneManifest; until then a ground
+    // instance sits at its height above zero.
+    void applyPlacement(const SceneInstance &instance, const vec3 &position)
+    {
+        if (!instance.placed)
+            return;
+        if (instance.hierarchical)
+            setHierarchicalMeshTransform(instance.index, position, instance.rotation, instance.scale, instance.animated);
+        else
+            setMeshTransform(instance.index, position, instance.rotation, instance.scale, instance.animated);
+    }
+}
+
+bool loadSceneManifest(const char *path, SceneManifest &manifest)
+{
+    manifest.path = path ? path : "";
+    manifest.instances.clear();
+    manifest.orbits.clear();
+
+    AssetFile file;
+    if (!file.open(path))
+    {
+        cerr << "loadSceneManifest: cannot read '" << manifest.path << "'" << endl;
+        return false;
+    }
+
+    JsonValue doc;
+    string error;
+    if (!parseJson((const char *)file.data(), file.size(), doc, error))
+    {
+        cerr << "loadSceneManifest: '" << manifest.path << "': " << error << endl;
+        return false;
+    }
+
+    static const char *lists[2] = {"hierarchical", "static"};
+    for (int list = 0; list < 2; list++)
+    {
+        const JsonValue &entries = doc[lists[list]];
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            SceneInstance instance;
+            if (!readInstance(entries[i], list == 0, (int)i, instance, error))
+            {
+                cerr << "loadSceneManifest: '" << manifest.path << "': " << lists[list] << " instance " << i;
+                if (!entries[i]["name"].asString().empty())
+                    cerr << " ('" << entries[i]["name"].asString() << "')";
+                cerr << " " << error << endl;
+                return false;
+            }
+            manifest.instances.push_back(instance);
+        }
+    }
+
+    set<string> names;
+    for (const SceneInstance &instance : manifest.instances)
+    {
+        if (!instance.name.empty() && !names.insert(instance.name).second)
+        {
+            cerr << "loadSceneManifest: '" << manifest.path << "': instance name '" << instance.name
+                 << "' used twice" << endl;
+            return false;
+        }
+    }
+
+    const JsonValue &orbits = doc["orbits"];
+    for (size_t i = 0; i < orbits.size(); i++)
+    {
+        const SceneInstance *parent = findSceneInstance(manifest, orbits[i]["parent"].asString().c_str());
+        const SceneInstance *child = findSceneInstance(manifest, orbits[i]["child"].asString().c_str());
+        if (!parent || !child || !parent->hierarchical || !child->hierarchical)
+        {
+            cerr << "loadSceneManifest: '" << manifest.path << "': orbit " << i
+                 << " does not name two hierarchical instances" << endl;
+            return false;
+        }
+        manifest.orbits.push_back({parent->index, child->index});
+    }
+    return true;
+}
+
+void addSceneManifest(SceneManifest &manifest)
+{
+    // Every slot is added before anything is placed, so the loader threads
+    // start on all the files together. Instances of one file share a load.
+    map<string, int> uses;
+    for (const SceneInstance &instance : manifest.instances)
+    {
+        if (instance.hierarchical)
+            addHierarchicalMesh(instance.model.c_str());
+        else
+            addMesh(instance.model.c_str());
+        uses[instance.model]++;
+    }
+
+    for (const SceneInstance &instance : manifest.instances)
+    {
+        applyPlacement(instance, instance.position);
+        if (instance.hierarchical && instance.animation >= 0)
+            setHierarchicalActiveAnimation(instance.index, instance.animation);
+    }
+
+    for (const SceneOrbit &orbit : manifest.orbits)
+        setOrbitalMotion(orbit.parent, orbit.child);
+
+    cout << "Scene manifest '" << manifest.path << "': " << manifest.instances.size() << " instances of "
+         << uses.size() << " models, " << manifest.orbits.size() << " orbiting pairs" << endl;
+}
+
+void placeSceneManifest(SceneManifest &manifest, const function<float(float, float)> &heightAt)
+{
+    for (SceneInstance &instance : manifest.instances)
+    {
+        instance.worldPosition = instance.position;
+        if (!instance.onGround)
+            continue;
+
+        vec2 at = instance.groundElsewhere ? instance.groundAt : vec2(instance.position.x, instance.position.z);
+        instance.worldPosition.y += heightAt(at.x, at.y);
+        applyPlacement(instance, instance.worldPosition);
+    }
+}
+
+const SceneInstance *findSceneInstance(const SceneManifest &manifest, const char *name)
+{
+    if (!name || !*name)
+        return nullptr;
+    for (const SceneInstance &instance : manifest.instances)
+    {
+        if (instance.name == name)
+            return &instance;
+    }
+    return nullptr;
+}
@@ -0,0 +1,413 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <set>
+
+#include "scene_snapshot.h"
+#include "animate.h"
+#include "mesh_cache.h"
+#include "asset_pack.h"
+#include "mapped_file.h"
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+    const uint32_t SNAPSHOT_MAGIC = 0x50534e44; // "DNSP"
+
+    class SnapshotWriter
+    {
+    public:
+        vector<unsigned char> buffer;
+
+        void bytes(const void *data, size_t size)
+        {
+            const unsigned char *p = static_cast<const unsigned char *>(data);
+            buffer.insert(buffer.end(), p, p + size);
+        }
+
+        void u32(uint32_t v) { bytes(&v, sizeof(v)); }
+        void i32(int32_t v) { bytes(&v, sizeof(v)); }
+        void u64(uint64_t v) { bytes(&v, sizeof(v)); }
+        void f32(float v) { bytes(&v, sizeof(v)); }
+        void flag(bool v) { u32(v ? 1 : 0); }
+        void vec(const vec3 &v) { bytes(&v, sizeof(vec3)); }
+
+        void str(const string &s)
+        {
+            u32(static_cast<uint32_t>(s.size()));
+            bytes(s.data(), s.size());
+        }
+
+        template <typename T>
+        void valueMap(const map<size_t, T> &values)
+        {
+            u64(static_cast<uint64_t>(values.size()));
+            for (const auto &entry : values)
+            {
+                u64(static_cast<uint64_t>(entry.first));
+                bytes(&entry.second, sizeof(T));
+            }
+        }
+    };
+
+    class SnapshotReader
+    {
+    public:
+        SnapshotReader(const unsigned char *data, size_t size)
+            : cur(data), end(data + size), ok(true)
+        {
+        }
+
+        bool good() const { return ok; }
+
+        bool bytes(void *out, size_t size)
+        {
+            if (!ok || static_cast<size_t>(end - cur) < size)
+            {
+                ok = false;
+                return false;
+            }
+            memcpy(out, cur, size);
+            cur += size;
+            return true;
+        }
+
+        uint32_t u32()
+        {
+            uint32_t v = 0;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        int32_t i32()
+        {
+            int32_t v = 0;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        uint64_t u64()
+        {
+            uint64_t v = 0;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        float f32()
+        {
+            float v = 0.0f;
+            bytes(&v, sizeof(v));
+            return v;
+        }
+
+        bool flag() { return u32() != 0; }
+
+        vec3 vec()
+        {
+            vec3 v(0.0f);
+            bytes(&v, sizeof(vec3));
+            return v;
+        }
+
+        string str()
+        {
+            uint32_t size = u32();
+            if (!ok || static_cast<size_t>(end - cur) < size)
+            {
+                ok = false;
+                return string();
+            }
+            string s(reinterpret_cast<const char *>(cur), size);
+            cur += size;
+            return s;
+        }
+
+        // A count is checked against the bytes left, so a damaged file
+        // cannot ask for a huge allocation.
+        uint64_t count(size_t elementSize)
+        {
+            uint64_t n = u64();
+            if (ok && n > static_cast<uint64_t>(end - cur) / elementSize)
+                ok = false;
+            return ok ? n : 0;
+        }
+
+        template <typename T>
+        void valueMap(map<size_t, T> &values)
+        {
+            values.clear();
+            uint64_t n = count(sizeof(uint64_t) + sizeof(T));
+            for (uint64_t i = 0; i < n; i++)
+            {
+                size_t key = static_cast<size_t>(u64());
+                T value;
+                bytes(&value, sizeof(T));
+                values[key] = value;
+            }
+        }
+
+    private:
+        const unsigned char *cur;
+        const unsigned char *end;
+        bool ok;
+    };
+
+    string instanceKey(const SceneInstance &instance)
+    {
+        return (instance.hierarchical ? "H " : "S ") + instance.model;
+    }
+}
+
+void captureSceneSnapshot(const SceneManifest &manifest, SceneSnapshot &snapshot)
+{
+    snapshot.manifestPath = manifest.path;
+    snapshot.instanceModels.clear();
+    snapshot.assets.clear();
+    snapshot.staticTransforms.clear();
+    snapshot.hierarchicalModels.clear();
+
+    set<string> seen;
+    for (const SceneInstance &instance : manifest.instances)
+    {
+        string key = instanceKey(instance);
+        snapshot.instanceModels.push_back(key);
+        if (!seen.insert(key).second)
+            continue;
+
+        SnapshotAsset asset;
+        asset.sourcePath = instance.model;
+        asset.hierarchical = instance.hierarchical;
+        asset.cachePath = meshCachePath(instance.model.c_str(),
+                                        instance.hierarchical ? MESH_CACHE_HIERARCHICAL : MESH_CACHE_STATIC);
+        snapshot.assets.push_back(asset);
+    }
+
+    for (const SceneInstance &instance : manifest.instances)
+    {
+        if (instance.hierarchical)
+        {
+            if (instance.index >= (int)hierarchicalModels.size())
+                continue;
+            const HierarchicalModel &hmodel = hierarchicalModels[instance.index];
+            SnapshotHierarchicalModel model;
+            model.position = hmodel.worldPosition;
+            model.rotation = hmodel.worldRotation;
+            model.scale = hmodel.worldScale;
+            model.animated = hmodel.animated;
+            model.activeAnimation = hmodel.activeAnimation;
+            snapshot.hierarchicalModels.push_back(model);
+        }
+        else
+        {
+            MeshTransform transform;
+            if (getMeshTransform(instance.index, transform))
+                snapshot.staticTransforms.push_back(transform);
+        }
+    }
+
+    saveRendererState(snapshot.renderer);
+}
+
+void restoreSceneSnapshot(const SceneSnapshot &snapshot)
+{
+    for (size_t i = 0; i < snapshot.staticTransforms.size(); i++)
+    {
+        const MeshTransform &t = snapshot.staticTransforms[i];
+        setMeshTransform((int)i, t.position, t.rotation, t.scale, t.animated);
+    }
+    for (size_t i = 0; i < snapshot.hierarchicalModels.size(); i++)
+    {
+        const SnapshotHierarchicalModel &m = snapshot.hierarchicalModels[i];
+        setHierarchicalMeshTransform((int)i, m.position, m.rotation, m.scale, m.animated);
+        if (m.activeAnimation >= 0)
+            setHierarchicalActiveAnimation((int)i, m.activeAnimation);
+    }
+    restoreRendererState(snapshot.renderer);
+}
+
+bool writeSceneSnapshot(const char *path, const SceneSnapshot &snapshot)
+{
+    SnapshotWriter w;
+    w.u32(SNAPSHOT_MAGIC);
+    w.u32(SCENE_SNAPSHOT_VERSION);
+
+    w.str(snapshot.manifestPath);
+    w.u64(snapshot.instanceModels.size());
+    for (const string &model : snapshot.instanceModels)
+        w.str(model);
+    w.u64(snapshot.assets.size());
+    for (const SnapshotAsset &asset : snapshot.assets)
+    {
+        w.str(asset.sourcePath);
+        w.flag(asset.hierarchical);
+        w.str(asset.cachePath);
+    }
+
+    w.vec(snapshot.cameraPosition);
+    w.f32(snapshot.cameraYaw);
+    w.f32(snapshot.cameraPitch);
+    w.f32(snapshot.cameraZoom);
+    w.f32(snapshot.timeOfDay);
+    w.f32(snapshot.targetTimeOfDay);
+    w.f32(snapshot.startTimeOfDay);
+    w.f32(snapshot.dayNightProgress);
+    w.flag(snapshot.dayNightTransitioning);
+    w.flag(snapshot.pointLightsEnabled);
+    w.flag(snapshot.spotLightsEnabled);
+    w.f32(snapshot.lightTime);
+    w.f32(snapshot.leviathanSpawnTime);
+    w.flag(snapshot.leviathanSpawned);
+    w.f32(snapshot.shipOrbitAngle);
+
+    w.u64(snapshot.staticTransforms.size());
+    for (const MeshTransform &t : snapshot.staticTransforms)
+    {
+        w.vec(t.position);
+        w.vec(t.rotation);
+        w.vec(t.scale);
+        w.flag(t.animated);
+        w.f32(t.animTime);
+    }
+    w.u64(snapshot.hierarchicalModels.size());
+    for (const SnapshotHierarchicalModel &m : snapshot.hierarchicalModels)
+    {
+        w.vec(m.position);
+        w.vec(m.rotation);
+        w.vec(m.scale);
+        w.flag(m.animated);
+        w.i32(m.activeAnimation);
+    }
+
+    w.f32(snapshot.renderer.heatTime);
+    w.valueMap(snapshot.renderer.animationTimes);
+    w.valueMap(snapshot.renderer.basePositions);
+    w.valueMap(snapshot.renderer.orbitAngles);
+    w.valueMap(snapshot.renderer.parentBasePositions);
+    w.valueMap(snapshot.renderer.animatorTimes);
+
+    // Written under a temporary name first, so a crash mid-write leaves the
+    // previous snapshot intact.
+    string tempPath = string(path) + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+    {
+        cerr << "scene snapshot: cannot write '" << tempPath << "'\n";
+        return false;
+    }
+    size_t written = fwrite(w.buffer.data(), 1, w.buffer.size(), file);
+    fclose(file);
+    if (written != w.buffer.size())
+    {
+        remove(tempPath.c_str());
+        cerr << "scene snapshot: short write to '" << tempPath << "'\n";
+        return false;
+    }
+    remove(path);
+    if (rename(tempPath.c_str(), path) != 0)
+    {
+        cerr << "scene snapshot: cannot replace '" << path << "'\n";
+        return false;
+    }
+    return true;
+}
+
+bool readSceneSnapshot(const char *path, const SceneManifest &manifest, SceneSnapshot &snapshot)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    SnapshotReader r(file.data(), file.size());
+    if (r.u32() != SNAPSHOT_MAGIC || r.u32() != SCENE_SNAPSHOT_VERSION)
+    {
+        cerr << "scene snapshot: '" << path << "' is from another version, ignored\n";
+        return false;
+    }
+
+    snapshot.manifestPath = r.str();
+    snapshot.instanceModels.resize(r.count(sizeof(uint32_t)));
+    for (string &model : snapshot.instanceModels)
+        model = r.str();
+
+    // Slots are addressed by index, so the instance list must be the same.
+    bool matches = r.good() && snapshot.manifestPath == manifest.path &&
+                   snapshot.instanceModels.size() == manifest.instances.size();
+    for (size_t i = 0; matches && i < manifest.instances.size(); i++)
+        matches = snapshot.instanceModels[i] == instanceKey(manifest.instances[i]);
+    if (!matches)
+    {
+        cerr << "scene snapshot: '" << path << "' was taken of a different scene, ignored\n";
+        return false;
+    }
+
+    snapshot.assets.resize(r.count(3 * sizeof(uint32_t)));
+    for (SnapshotAsset &asset : snapshot.assets)
+    {
+        asset.sourcePath = r.str();
+        asset.hierarchical = r.flag();
+        asset.cachePath = r.str();
+    }
+
+    snapshot.cameraPosition = r.vec();
+    snapshot.cameraYaw = r.f32();
+    snapshot.cameraPitch = r.f32();
+    snapshot.cameraZoom = r.f32();
+    snapshot.timeOfDay = r.f32();
+    snapshot.targetTimeOfDay = r.f32();
+    snapshot.startTimeOfDay = r.f32();
+    snapshot.dayNightProgress = r.f32();
+    snapshot.dayNightTransitioning = r.flag();
+    snapshot.pointLightsEnabled = r.flag();
+    snapshot.spotLightsEnabled = r.flag();
+    snapshot.lightTime = r.f32();
+    snapshot.leviathanSpawnTime = r.f32();
+    snapshot.leviathanSpawned = r.flag();
+    snapshot.shipOrbitAngle = r.f32();
+
+    snapshot.staticTransforms.resize(r.count(3 * sizeof(vec3) + sizeof(uint32_t) + sizeof(float)));
+    for (MeshTransform &t : snapshot.staticTransforms)
+    {
+        t.position = r.vec();
+        t.rotation = r.vec();
+        t.scale = r.vec();
+        t.animated = r.flag();
+        t.animTime = r.f32();
+    }
+    snapshot.hierarchicalModels.resize(r.count(3 * sizeof(vec3) + sizeof(uint32_t) + sizeof(int32_t)));
+    for (SnapshotHierarchicalModel &m : snapshot.hierarchicalModels)
+    {
+        m.position = r.vec();
+        m.rotation = r.vec();
+        m.scale = r.vec();
+        m.animated = r.flag();
+        m.activeAnimation = r.i32();
+    }
+
+    snapshot.renderer.heatTime = r.f32();
+    r.valueMap(snapshot.renderer.animationTimes);
+    r.valueMap(snapshot.renderer.basePositions);
+    r.valueMap(snapshot.renderer.orbitAngles);
+    r.valueMap(snapshot.renderer.parentBasePositions);
+    r.valueMap(snapshot.renderer.animatorTimes);
+
+    if (!r.good())
+    {
+        cerr << "scene snapshot: '" << path << "' is truncated, ignored\n";
+        return false;
+    }
+
+    size_t cold = 0;
+    for (const SnapshotAsset &asset : snapshot.assets)
+    {
+        if (!assetExists(asset.cachePath.c_str()))
+            cold++;
+    }
+    cout << "Resuming from scene snapshot '" << path << "': " << snapshot.assets.size() << " models, "
+         << snapshot.assets.size() - cold << " with cache files";
+    if (cold > 0)
+        cout << ", " << cold << " to import again";
+    cout << endl;
+    return true;
+}
@@ -23,6 +23,8 @@ void ShaderUniformManager::initialize(GLuint shaderProgramID)
     locLightDir = glGetUniformLocation(shaderProgram, "lightDir");
     locLightColor = glGetUniformLocation(shaderProgram, "lightColor");
     locHasBones = glGetUniformLocation(shaderProgram, "hasBones");
+    locBoneMatrices = glGetUniformLocation(shaderProgram, "finalBonesMatrices");
+    locBoneInfluences = glGetUniformLocation(shaderProgram, "boneInfluences");
     locFogColor = glGetUniformLocation(shaderProgram, "fogColor");
     locFogDensity = glGetUniformLocation(shaderProgram, "fogDensity");
     locFogStart = glGetUniformLocation(shaderProgram, "fogStart");
@@ -78,6 +80,15 @@ void ShaderUniformManager::setHasBones(bool hasBones)
         glUniform1i(locHasBones, hasBones);
 }
 
+void ShaderUniformManager::setBonePalette(const vector<mat4> &palette, int influences)
+{
+    GLsizei count = static_cast<GLsizei>(std::min(palette.size(), static_cast<size_t>(MeshInstance::MAX_BONES)));
+    if (locBoneMatrices >= 0 && count > 0)
+        glUniformMatrix4fv(locBoneMatrices, count, GL_FALSE, value_ptr(palette[0]));
+    if (locBoneInfluences >= 0)
+        glUniform1i(locBoneInfluences, influences);
+}
+
 void ShaderUniformManager::setFog(const vec3 &fogColor, float fogDensity, float fogStart, float fogEnd, float fogHeight, float fogHeightRange)
 {
     if (locFogColor >= 0)
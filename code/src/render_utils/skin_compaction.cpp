@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <sstream>
+
+#include "skin_compaction.h"
+#include "glm_compat.h"
+#include "load_profiler.h"
+
+using namespace glm;
+using namespace std;
+
+void SkinInfluences::reset(size_t vertexCount)
+{
+    first.assign(vertexCount + 1, 0);
+    items.clear();
+    cursor.clear();
+}
+
+void SkinInfluences::allocate()
+{
+    for (size_t v = 1; v < first.size(); v++)
+        first[v] += first[v - 1];
+    items.resize(first.empty() ? 0 : first.back());
+    cursor.assign(first.begin(), first.empty() ? first.end() : first.end() - 1);
+}
+
+SkinCompactionStats compactSkin(MeshInstance &instance,
+                                const vector<string> &boneNames,
+                                const vector<mat4> &boneOffsets,
+                                SkinInfluences &influences)
+{
+    SkinCompactionStats stats = {0, 0, 0, 0};
+    stats.bonesListed = boneNames.size();
+
+    const size_t vertexCount = instance.vertices.size();
+    instance.boneIds.assign(vertexCount, ivec4(-1, -1, -1, -1));
+    instance.boneWeights.assign(vertexCount, vec4(0.0f, 0.0f, 0.0f, 0.0f));
+    instance.boneMatrices.clear();
+    instance.boneNameToIndex.clear();
+
+    auto strongerFirst = [](const BoneInfluence &a, const BoneInfluence &b)
+    {
+        return a.weight > b.weight || (a.weight == b.weight && a.bone < b.bone);
+    };
+
+    vector<int> paletteIndex(boneNames.size(), -1);
+    for (size_t v = 0; v < vertexCount && v < influences.vertexCount(); v++)
+    {
+        BoneInfluence *list = influences.items.data() + influences.first[v];
+        size_t listed = influences.first[v + 1] - influences.first[v];
+        if (listed > static_cast<size_t>(MeshInstance::MAX_BONE_INFLUENCES))
+            stats.verticesCapped++;
+
+        int count = static_cast<int>(std::min(listed, static_cast<size_t>(MeshInstance::MAX_BONE_INFLUENCES)));
+        partial_sort(list, list + count, list + listed, strongerFirst);
+
+        float sum = 0.0f;
+        for (int i = 0; i < count; i++)
+            sum += list[i].weight;
+
+        for (int i = 0; i < count; i++)
+        {
+            int &slot = paletteIndex[list[i].bone];
+            if (slot < 0)
+            {
+                slot = static_cast<int>(instance.boneMatrices.size());
+                instance.boneMatrices.push_back(boneOffsets[list[i].bone]);
+                instance.boneNameToIndex[boneNames[list[i].bone]] = slot;
+            }
+            instance.boneIds[v][i] = slot;
+            instance.boneWeights[v][i] = list[i].weight / sum;
+        }
+        stats.maxInfluences = std::max(stats.maxInfluences, count);
+    }
+    stats.bonesKept = instance.boneMatrices.size();
+
+    // Bones listed without a single weight leave nothing to skin.
+    instance.hasBones = !instance.boneMatrices.empty();
+    instance.boneInfluences = stats.maxInfluences;
+    if (!instance.hasBones)
+    {
+        vector<ivec4>().swap(instance.boneIds);
+        vector<vec4>().swap(instance.boneWeights);
+    }
+    if (stats.bonesKept > static_cast<size_t>(MeshInstance::MAX_BONES))
+    {
+        cerr << "Warning: mesh uses " << stats.bonesKept << " bones, the shader palette holds "
+             << MeshInstance::MAX_BONES << endl;
+    }
+    return stats;
+}
+
+void printSkinCompactionStats(const string &label, const SkinCompactionStats &stats)
+{
+    if (stats.bonesListed == 0)
+        return;
+
+    ostringstream line;
+    line << "[skin] " << label << ": bones " << stats.bonesListed << " -> " << stats.bonesKept
+         << ", up to " << stats.maxInfluences << " influences per vertex";
+    if (stats.verticesCapped > 0)
+    {
+        line << ", " << stats.verticesCapped << " vertices capped to " << MeshInstance::MAX_BONE_INFLUENCES;
+    }
+    printLoadLine(line.str());
+}
@@ -0,0 +1,198 @@
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "texture_cache.h"
+#include "hash_utils.h"
+
+using namespace std;
+
+namespace
+{
+    struct CachedTexture
+    {
+        GLuint texture;
+        int refCount;
+        size_t bytes;
+    };
+
+    // Lookups happen on loader threads, so everything below is guarded.
+    mutex cacheMutex;
+    map<string, CachedTexture> texturesByKey;
+    map<GLuint, string> keysByTexture;
+
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t decodes = 0;
+    size_t decodesSkipped = 0;
+    size_t bytesShared = 0;
+    size_t texturesDeleted = 0;
+
+    // Lexical clean-up so "a/./b.png", "a//b.png" and "a/c/../b.png" share
+    // an entry. Leading ".." components are kept.
+    string normalizePath(const string &path)
+    {
+        string unified = path;
+        for (char &c : unified)
+        {
+            if (c == '\\')
+                c = '/';
+        }
+
+        bool absolute = !unified.empty() && unified[0] == '/';
+        vector<string> parts;
+        size_t start = 0;
+        while (start <= unified.size())
+        {
+            size_t end = unified.find('/', start);
+            if (end == string::npos)
+                end = unified.size();
+            string part = unified.substr(start, end - start);
+            if (part == "..")
+            {
+                if (!parts.empty() && parts.back() != "..")
+                    parts.pop_back();
+                else if (!absolute)
+                    parts.push_back(part);
+            }
+            else if (!part.empty() && part != ".")
+            {
+                parts.push_back(part);
+            }
+            start = end + 1;
+        }
+
+        string result = absolute ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            if (i > 0)
+                result += '/';
+            result += parts[i];
+        }
+        return result;
+    }
+}
+
+string textureCacheKey(const TextureRef &ref, bool srgb, bool flipVertically)
+{
+    string key;
+    switch (ref.source)
+    {
+    case TextureRef::FILE_PATH:
+        key = "file:" + normalizePath(ref.path);
+        break;
+    case TextureRef::EMBEDDED_COMPRESSED:
+    case TextureRef::EMBEDDED_RAW:
+    {
+        char hash[64];
+        snprintf(hash, sizeof(hash), "mem:%016llx:%zu:%dx%d",
+                 static_cast<unsigned long long>(fnv1a(ref.data.data(), ref.data.size())),
+                 ref.data.size(), ref.width, ref.height);
+        key = hash;
+        break;
+    }
+    default:
+        return string();
+    }
+
+    key += srgb ? "|srgb" : "|linear";
+    key += flipVertically ? "|flip" : "";
+    return key;
+}
+
+size_t textureBytes(int width, int height, int channels)
+{
+    return static_cast<size_t>(width) * height * channels * 4 / 3;
+}
+
+bool isTextureCached(const string &key)
+{
+    lock_guard<mutex> lock(cacheMutex);
+    return texturesByKey.count(key) > 0;
+}
+
+void recordTextureDecode(bool skipped)
+{
+    lock_guard<mutex> lock(cacheMutex);
+    if (skipped)
+        decodesSkipped++;
+    else
+        decodes++;
+}
+
+GLuint acquireCachedTexture(const string &key)
+{
+    lock_guard<mutex> lock(cacheMutex);
+    auto it = texturesByKey.find(key);
+    if (it == texturesByKey.end())
+        return 0;
+
+    it->second.refCount++;
+    hits++;
+    bytesShared += it->second.bytes;
+    return it->second.texture;
+}
+
+void addCachedTexture(const string &key, GLuint texture, size_t bytes)
+{
+    if (texture == 0 || key.empty())
+        return;
+
+    lock_guard<mutex> lock(cacheMutex);
+    CachedTexture &entry = texturesByKey[key];
+    entry.texture = texture;
+    entry.refCount = 1;
+    entry.bytes = bytes;
+    keysByTexture[texture] = key;
+    misses++;
+}
+
+bool releaseTextureReference(GLuint texture)
+{
+    if (texture == 0)
+        return false;
+
+    lock_guard<mutex> lock(cacheMutex);
+    auto keyIt = keysByTexture.find(texture);
+    if (keyIt != keysByTexture.end())
+    {
+        auto it = texturesByKey.find(keyIt->second);
+        if (it != texturesByKey.end() && --it->second.refCount > 0)
+            return false;
+
+        if (it != texturesByKey.end())
+            texturesByKey.erase(it);
+        keysByTexture.erase(keyIt);
+        texturesDeleted++;
+    }
+    return true;
+}
+
+void printTextureCacheReport()
+{
+    lock_guard<mutex> lock(cacheMutex);
+    if (hits + misses == 0)
+        return;
+
+    size_t residentBytes = 0;
+    int references = 0;
+    for (const auto &pair : texturesByKey)
+    {
+        residentBytes += pair.second.bytes;
+        references += pair.second.refCount;
+    }
+
+    cout << "\n=== Texture cache ===\n";
+    cout << hits + misses << " texture requests: " << misses << " uploaded, " << hits << " shared ("
+         << fixed << setprecision(1) << 100.0 * hits / (hits + misses) << "% hit rate)\n";
+    cout << decodes << " images decoded, " << decodesSkipped << " decodes skipped\n";
+    cout << texturesByKey.size() << " textures resident with " << references << " references, "
+         << setprecision(2) << residentBytes / (1024.0 * 1024.0) << " MB; "
+         << bytesShared / (1024.0 * 1024.0) << " MB of duplicate uploads avoided";
+    if (texturesDeleted > 0)
+        cout << "; " << texturesDeleted << " released";
+    cout << defaultfloat << endl;
+}
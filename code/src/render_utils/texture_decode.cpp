@@ -0,0 +1,52 @@
+#include "texture_decode.h"
+#include "texture_loader.h"
+#include "load_profiler.h"
+
+using namespace std;
+
+namespace
+{
+    bool lazyLoading = false;
+}
+
+void setLazyTextureLoading(bool enabled)
+{
+    lazyLoading = enabled;
+}
+
+bool lazyTextureLoading()
+{
+    return lazyLoading;
+}
+
+bool decodeTexturePixels(TextureRef &ref)
+{
+    ProfileScope scope("decodeTexture");
+    bool decoded = false;
+
+    switch (ref.source)
+    {
+    case TextureRef::FILE_PATH:
+        decoded = DecodeImageFile(ref.path.c_str(), true, ref.pixels, ref.width, ref.height, ref.channels);
+        break;
+    case TextureRef::EMBEDDED_COMPRESSED:
+        decoded = DecodeImageMemory(ref.data.data(), ref.data.size(), false, ref.pixels,
+                                    ref.width, ref.height, ref.channels);
+        break;
+    case TextureRef::EMBEDDED_RAW:
+        ref.pixels.swap(ref.data);
+        ref.channels = 4;
+        decoded = true;
+        break;
+    default:
+        break;
+    }
+
+    // The encoded bytes are only needed until the pixels exist.
+    vector<unsigned char>().swap(ref.data);
+    if (!decoded)
+    {
+        vector<unsigned char>().swap(ref.pixels);
+    }
+    return decoded;
+}
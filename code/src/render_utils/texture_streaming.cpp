@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "texture_streaming.h"
+#include "texture_decode.h"
+#include "texture_cache.h"
+#include "texture_loader.h"
+#include "texture_upload.h"
+#include "load_profiler.h"
+
+using namespace std;
+
+namespace
+{
+    struct StreamingStats
+    {
+        size_t deferred;
+        size_t requested;
+        size_t uploaded;
+        size_t failed;
+        size_t discarded;
+        double latencyMs;
+        double maxLatencyMs;
+        double uploadMs;
+    };
+
+    // Deferred images by texture cache key. The decode thread works through
+    // them while the GL thread defers and releases them, so the map, the
+    // users counts and both queues share one lock.
+    mutex streamMutex;
+    condition_variable decodeReady;
+    map<string, shared_ptr<StreamedTexture>> texturesByKey;
+    deque<shared_ptr<StreamedTexture>> decodeQueue;
+    deque<shared_ptr<StreamedTexture>> uploadQueue;
+    thread decodeThread;
+    bool decodeThreadStarted = false;
+    bool stopping = false;
+    StreamingStats stats = {0, 0, 0, 0, 0, 0.0, 0.0, 0.0};
+
+    // Textures whose pixels are going up through the pixel buffers, GL
+    // thread only. The name is held here because a release clears the
+    // texture's own.
+    struct InFlightUpload
+    {
+        shared_ptr<StreamedTexture> texture;
+        GLuint name;
+    };
+    deque<InFlightUpload> inFlight;
+
+    // Drawn in place of a texture still on its way; a flat mid grey reads
+    // as unlit material rather than as a missing texture.
+    GLuint placeholder = 0;
+
+    double msSince(chrono::steady_clock::time_point from)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - from).count();
+    }
+
+    // One thread is enough: a request is one image, and the GL thread only
+    // uploads a few per frame anyway.
+    void decodeLoop()
+    {
+        for (;;)
+        {
+            shared_ptr<StreamedTexture> texture;
+            {
+                unique_lock<mutex> lock(streamMutex);
+                decodeReady.wait(lock, [] { return stopping || !decodeQueue.empty(); });
+                if (stopping)
+                    return;
+                texture = decodeQueue.front();
+                decodeQueue.pop_front();
+                if (texture->users <= 0)
+                {
+                    stats.discarded++;
+                    continue;
+                }
+            }
+
+            if (!isTextureCached(texture->ref.cacheKey))
+            {
+                decodeTexturePixels(texture->ref);
+                recordTextureDecode(false);
+            }
+            else
+            {
+                recordTextureDecode(true);
+            }
+
+            lock_guard<mutex> lock(streamMutex);
+            uploadQueue.push_back(texture);
+        }
+    }
+
+    // Makes textures resident once their upload has completed on the GPU;
+    // until then their meshes keep drawing the placeholder.
+    void finishInFlightUploads()
+    {
+        for (auto it = inFlight.begin(); it != inFlight.end();)
+        {
+            shared_ptr<StreamedTexture> texture = it->texture;
+            GLuint name = it->name;
+            bool released = false;
+            {
+                lock_guard<mutex> lock(streamMutex);
+                released = texture->users <= 0;
+            }
+            if (released)
+            {
+                cancelTextureUpload(name);
+                glDeleteTextures(1, &name);
+                it = inFlight.erase(it);
+                lock_guard<mutex> lock(streamMutex);
+                stats.discarded++;
+                continue;
+            }
+            if (!textureUploadComplete(name))
+            {
+                ++it;
+                continue;
+            }
+
+            addCachedTexture(texture->ref.cacheKey, name, texture->bytes);
+            texture->texture = name;
+            texture->state = StreamedTexture::RESIDENT;
+            it = inFlight.erase(it);
+
+            lock_guard<mutex> lock(streamMutex);
+            double latency = msSince(texture->requested);
+            stats.uploaded++;
+            stats.latencyMs += latency;
+            stats.maxLatencyMs = max(stats.maxLatencyMs, latency);
+        }
+    }
+
+    GLuint placeholderTexture()
+    {
+        if (placeholder == 0)
+        {
+            const unsigned char grey[4] = {128, 128, 128, 255};
+            placeholder = UploadTextureFromPixels(grey, 1, 1, 4, true);
+        }
+        return placeholder;
+    }
+}
+
+void deferMeshTexture(MeshInstance &instance)
+{
+    TextureRef &ref = instance.diffuseRef;
+    ref.cacheKey = textureCacheKey(ref, true, ref.source == TextureRef::FILE_PATH);
+    if (ref.cacheKey.empty())
+        return;
+
+    lock_guard<mutex> lock(streamMutex);
+    shared_ptr<StreamedTexture> &texture = texturesByKey[ref.cacheKey];
+    if (!texture)
+    {
+        texture = make_shared<StreamedTexture>();
+        texture->ref = move(ref);
+        texture->state = StreamedTexture::UNLOADED;
+        texture->texture = 0;
+        texture->bytes = 0;
+        texture->users = 0;
+        stats.deferred++;
+    }
+    texture->users++;
+    instance.diffuseStream = texture;
+
+    // Later meshes with this image find it through the map; the copy in the
+    // mesh is no longer needed.
+    instance.diffuseRef.source = TextureRef::NONE;
+    vector<unsigned char>().swap(instance.diffuseRef.data);
+    vector<unsigned char>().swap(instance.diffuseRef.pixels);
+}
+
+GLuint resolveStreamedTexture(const shared_ptr<StreamedTexture> &texture)
+{
+    switch (texture->state)
+    {
+    case StreamedTexture::RESIDENT:
+        return texture->texture;
+    case StreamedTexture::FAILED:
+        return 0;
+    case StreamedTexture::QUEUED:
+        return placeholderTexture();
+    default:
+        break;
+    }
+
+    texture->requested = chrono::steady_clock::now();
+    texture->state = StreamedTexture::QUEUED;
+
+    // Resident under another path into the cache (an eager load of the same
+    // image): share it straight away.
+    GLuint cached = acquireCachedTexture(texture->ref.cacheKey);
+    lock_guard<mutex> lock(streamMutex);
+    stats.requested++;
+    if (cached != 0)
+    {
+        texture->texture = cached;
+        texture->state = StreamedTexture::RESIDENT;
+        stats.uploaded++;
+        vector<unsigned char>().swap(texture->ref.data);
+        return cached;
+    }
+
+    if (!decodeThreadStarted)
+    {
+        decodeThread = thread(decodeLoop);
+        decodeThreadStarted = true;
+    }
+    decodeQueue.push_back(texture);
+    decodeReady.notify_one();
+    return placeholderTexture();
+}
+
+size_t pumpTextureUploads(double budgetMs)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t uploaded = 0;
+    for (;;)
+    {
+        shared_ptr<StreamedTexture> texture;
+        {
+            lock_guard<mutex> lock(streamMutex);
+            if (uploadQueue.empty())
+                break;
+            if (uploaded > 0 && msSince(start) >= budgetMs)
+                break;
+            texture = uploadQueue.front();
+            uploadQueue.pop_front();
+            if (texture->users <= 0)
+            {
+                stats.discarded++;
+                continue;
+            }
+        }
+
+        ProfileScope scope("uploadTexture");
+        chrono::steady_clock::time_point uploadStart = chrono::steady_clock::now();
+        TextureRef &ref = texture->ref;
+        GLuint tex = acquireCachedTexture(ref.cacheKey);
+        if (tex == 0 && ref.pixels.empty())
+        {
+            // The decode was skipped for a cached texture released since.
+            decodeTexturePixels(ref);
+        }
+        if (tex == 0 && !ref.pixels.empty())
+        {
+            texture->bytes = textureBytes(ref.width, ref.height, ref.channels);
+
+            // Through the pixel buffers the texture stays queued, drawn as
+            // the placeholder, until finishInFlightUploads sees it complete.
+            GLuint name = 0;
+            if (pixelBufferUploads())
+                name = queueTextureUpload(ref.pixels, ref.width, ref.height, ref.channels, true);
+            if (name != 0)
+            {
+                inFlight.push_back(InFlightUpload{texture, name});
+                vector<unsigned char>().swap(ref.pixels);
+                vector<unsigned char>().swap(ref.data);
+                uploaded++;
+
+                lock_guard<mutex> lock(streamMutex);
+                stats.uploadMs += msSince(uploadStart);
+                continue;
+            }
+
+            tex = UploadTextureFromPixels(ref.pixels.data(), ref.width, ref.height, ref.channels, true);
+            addCachedTexture(ref.cacheKey, tex, texture->bytes);
+        }
+        vector<unsigned char>().swap(ref.pixels);
+        vector<unsigned char>().swap(ref.data);
+
+        texture->texture = tex;
+        texture->state = tex != 0 ? StreamedTexture::RESIDENT : StreamedTexture::FAILED;
+        uploaded++;
+
+        lock_guard<mutex> lock(streamMutex);
+        double latency = msSince(texture->requested);
+        stats.uploadMs += msSince(uploadStart);
+        if (tex != 0)
+        {
+            stats.uploaded++;
+            stats.latencyMs += latency;
+            stats.maxLatencyMs = max(stats.maxLatencyMs, latency);
+        }
+        else
+        {
+            stats.failed++;
+            cerr << "Texture streaming: cannot decode '" << (ref.path.empty() ? ref.cacheKey : ref.path) << "'\n";
+        }
+    }
+
+    if (!inFlight.empty())
+    {
+        pumpPixelBufferUploads();
+        finishInFlightUploads();
+    }
+    return uploaded;
+}
+
+void releaseStreamedTexture(shared_ptr<StreamedTexture> &texture)
+{
+    if (!texture)
+        return;
+
+    GLuint resident = 0;
+    {
+        lock_guard<mutex> lock(streamMutex);
+        if (--texture->users <= 0)
+        {
+            auto it = texturesByKey.find(texture->ref.cacheKey);
+            if (it != texturesByKey.end() && it->second == texture)
+                texturesByKey.erase(it);
+            if (texture->state == StreamedTexture::RESIDENT)
+                resident = texture->texture;
+
+            // A queued texture belongs to the decode thread, which drops it
+            // unused; anything else frees its bytes here.
+            if (texture->state != StreamedTexture::QUEUED)
+            {
+                vector<unsigned char>().swap(texture->ref.data);
+                vector<unsigned char>().swap(texture->ref.pixels);
+            }
+            texture->texture = 0;
+            texture->state = StreamedTexture::UNLOADED;
+        }
+    }
+    releaseCachedTexture(resident);
+    texture.reset();
+}
+
+void stopTextureStreaming()
+{
+    {
+        lock_guard<mutex> lock(streamMutex);
+        stopping = true;
+    }
+    decodeReady.notify_all();
+    if (decodeThread.joinable())
+        decodeThread.join();
+
+    for (InFlightUpload &upload : inFlight)
+    {
+        cancelTextureUpload(upload.name);
+        glDeleteTextures(1, &upload.name);
+    }
+    inFlight.clear();
+    stopPixelBufferUploads();
+
+    lock_guard<mutex> lock(streamMutex);
+    decodeQueue.clear();
+    uploadQueue.clear();
+    decodeThreadStarted = false;
+    stopping = false;
+    if (placeholder != 0)
+    {
+        glDeleteTextures(1, &placeholder);
+        placeholder = 0;
+    }
+}
+
+void printTextureStreamingReport()
+{
+    lock_guard<mutex> lock(streamMutex);
+    if (stats.deferred == 0)
+        return;
+
+    size_t pending = stats.requested - stats.uploaded - stats.failed - stats.discarded;
+    cout << "\n=== Texture streaming ===\n";
+    cout << stats.deferred << " images deferred at import, " << stats.requested << " drawn so far: "
+         << stats.uploaded << " resident, " << pending << " pending";
+    if (stats.failed > 0)
+        cout << ", " << stats.failed << " failed";
+    cout << "\n" << stats.deferred - stats.requested << " never drawn (no decode, no upload)";
+    if (stats.discarded > 0)
+        cout << "; " << stats.discarded << " released before their upload";
+    cout << "\n";
+    if (stats.uploaded > 0)
+    {
+        cout << fixed << setprecision(1) << "first draw to resident: " << stats.latencyMs / stats.uploaded
+             << " ms average, " << stats.maxLatencyMs << " ms worst; " << stats.uploadMs
+             << " ms uploading\n" << defaultfloat;
+    }
+    cout << endl;
+}
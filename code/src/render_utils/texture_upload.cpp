@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <list>
+
+#include "texture_upload.h"
+#include "texture_loader.h"
+#include "load_profiler.h"
+
+using namespace std;
+
+namespace
+{
+    // Enough that a frame rarely finds them all in flight: the GPU is
+    // usually done with a buffer a frame or two after its upload.
+    const int PIXEL_BUFFER_COUNT = 4;
+
+    struct PixelBuffer
+    {
+        GLuint buffer;
+        size_t size;
+        GLsync fence; // after the last upload from it, 0 once signalled
+    };
+
+    // Levels are issued in order, each one's rows box-filtered from the
+    // level above as they are issued, so a mip chain costs frames the same
+    // way the base level does.
+    struct PendingUpload
+    {
+        GLuint texture;
+        int channels;
+        GLenum format;
+        int level;
+        int width; // of the level being issued
+        int height;
+        vector<unsigned char> pixels; // of the level, filled as issued
+        vector<unsigned char> parent; // the level above, empty for the base
+        int parentWidth;
+        int parentHeight;
+        int nextRow;
+        GLsync fence; // after the 1x1 level, 0 until it is issued
+    };
+
+    struct UploadStats
+    {
+        size_t queued;
+        size_t completed;
+        size_t cancelled;
+        size_t bytes;
+        size_t frames;
+        size_t busyFrames;
+        size_t maxFrameBytes;
+        double maxFrameMs;
+    };
+
+    bool enabled = false;
+    size_t ringBytes = 16 << 20;
+    size_t bytesPerFrame = 4 << 20;
+
+    vector<PixelBuffer> buffers;
+    int nextBuffer = 0;
+
+    // In the order queued; rows are issued front to back.
+    list<PendingUpload> uploads;
+    UploadStats stats = {0, 0, 0, 0, 0, 0, 0, 0.0};
+
+    bool fenceSignalled(GLsync fence)
+    {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+    }
+
+    void createBuffers()
+    {
+        size_t size = max<size_t>(ringBytes / PIXEL_BUFFER_COUNT, 1);
+        buffers.resize(PIXEL_BUFFER_COUNT);
+        for (PixelBuffer &buffer : buffers)
+        {
+            glGenBuffers(1, &buffer.buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            buffer.size = size;
+            buffer.fence = 0;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        nextBuffer = 0;
+    }
+
+    // Copies rows of the upload into the bound buffer and issues them.
+    // Falls back to glBufferSubData if the driver will not map it.
+    void issueRows(PixelBuffer &buffer, PendingUpload &upload, int rows)
+    {
+        size_t rowBytes = static_cast<size_t>(upload.width) * upload.channels;
+        size_t bytes = rowBytes * rows;
+        size_t offset = rowBytes * upload.nextRow;
+        if (upload.level > 0)
+        {
+            upload.pixels.resize(offset + bytes);
+            HalveImageRows(upload.parent.data(), upload.parentWidth, upload.parentHeight, upload.channels,
+                           upload.nextRow, rows, &upload.pixels[offset]);
+        }
+        const unsigned char *src = &upload.pixels[offset];
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.buffer);
+        if (bytes > buffer.size)
+        {
+            // A single row wider than the buffer; grow it for this and later
+            // uploads.
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            buffer.size = bytes;
+        }
+
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            memcpy(mapped, src, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else
+        {
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, bytes, src);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, upload.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.nextRow, upload.width, rows, upload.format,
+                        GL_UNSIGNED_BYTE, nullptr);
+        buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        upload.nextRow += rows;
+    }
+
+    // Moves on to the next level once every row of this one is issued.
+    // False after the 1x1 level, when the upload is done.
+    bool nextLevel(PendingUpload &upload)
+    {
+        if (upload.width == 1 && upload.height == 1)
+        {
+            vector<unsigned char>().swap(upload.pixels);
+            vector<unsigned char>().swap(upload.parent);
+            return false;
+        }
+
+        // Reserved rather than sized: rows are only written, and paid for,
+        // as they are issued.
+        upload.parent.swap(upload.pixels);
+        upload.parentWidth = upload.width;
+        upload.parentHeight = upload.height;
+        upload.level++;
+        upload.width = max(1, upload.width / 2);
+        upload.height = max(1, upload.height / 2);
+        vector<unsigned char>().swap(upload.pixels);
+        upload.pixels.reserve(static_cast<size_t>(upload.width) * upload.height * upload.channels);
+        upload.nextRow = 0;
+        return true;
+    }
+
+    void deleteUpload(PendingUpload &upload)
+    {
+        if (upload.fence)
+        {
+            glDeleteSync(upload.fence);
+            upload.fence = 0;
+        }
+    }
+}
+
+void setPixelBufferUploads(bool enable, size_t ringSize, size_t frameBytes)
+{
+    enabled = enable;
+    ringBytes = ringSize;
+    bytesPerFrame = max<size_t>(frameBytes, 1);
+}
+
+bool pixelBufferUploads()
+{
+    return enabled;
+}
+
+GLuint queueTextureUpload(vector<unsigned char> &pixels, int width, int height, int channels, bool srgb)
+{
+    GLenum format = GL_RGB;
+    GLenum internalFormat = GL_RGB8;
+    if (!deriveFormats(channels, srgb, format, internalFormat))
+    {
+        cerr << "queueTextureUpload: unsupported channel count (" << channels << ")\n";
+        return 0;
+    }
+    if (width <= 0 || height <= 0 || pixels.size() < static_cast<size_t>(width) * height * channels)
+    {
+        cerr << "queueTextureUpload: invalid pixel data\n";
+        return 0;
+    }
+
+    // Storage only, for every level; the rows arrive from the pixel buffers.
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    for (int level = 0, w = width, h = height;; level++, w = max(1, w / 2), h = max(1, h / 2))
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        if (w == 1 && h == 1)
+            break;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    uploads.push_back(PendingUpload());
+    PendingUpload &upload = uploads.back();
+    upload.texture = tex;
+    upload.channels = channels;
+    upload.format = format;
+    upload.level = 0;
+    upload.width = width;
+    upload.height = height;
+    upload.pixels.swap(pixels);
+    upload.parentWidth = 0;
+    upload.parentHeight = 0;
+    upload.nextRow = 0;
+    upload.fence = 0;
+    stats.queued++;
+    return tex;
+}
+
+size_t pumpPixelBufferUploads()
+{
+    if (uploads.empty())
+        return 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (buffers.empty())
+        createBuffers();
+
+    // Rows are tightly packed whatever the channel count.
+    GLint alignment = 4;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    size_t issued = 0;
+    bool busy = false;
+    for (PendingUpload &upload : uploads)
+    {
+        if (upload.fence)
+            continue;
+
+        while (issued < bytesPerFrame)
+        {
+            if (upload.nextRow >= upload.height)
+            {
+                if (!nextLevel(upload))
+                {
+                    upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                    break;
+                }
+                continue;
+            }
+
+            size_t rowBytes = static_cast<size_t>(upload.width) * upload.channels;
+            PixelBuffer &buffer = buffers[nextBuffer];
+            if (buffer.fence)
+            {
+                if (!fenceSignalled(buffer.fence))
+                {
+                    busy = true;
+                    break;
+                }
+                glDeleteSync(buffer.fence);
+                buffer.fence = 0;
+            }
+
+            // At least one row, even past the frame's budget, so every
+            // upload moves.
+            size_t fit = min(buffer.size, bytesPerFrame - issued) / rowBytes;
+            int rows = static_cast<int>(min<size_t>(max<size_t>(fit, 1), upload.height - upload.nextRow));
+            issueRows(buffer, upload, rows);
+            issued += rowBytes * rows;
+            nextBuffer = (nextBuffer + 1) % PIXEL_BUFFER_COUNT;
+        }
+        if (busy || issued >= bytesPerFrame)
+            break;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+    if (busy)
+        stats.busyFrames++;
+    if (issued > 0)
+    {
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        stats.frames++;
+        stats.bytes += issued;
+        stats.maxFrameBytes = max(stats.maxFrameBytes, issued);
+        stats.maxFrameMs = max(stats.maxFrameMs, ms);
+    }
+    return issued;
+}
+
+bool textureUploadComplete(GLuint texture)
+{
+    for (auto it = uploads.begin(); it != uploads.end(); ++it)
+    {
+        if (it->texture != texture)
+            continue;
+        if (!it->fence || !fenceSignalled(it->fence))
+            return false;
+        deleteUpload(*it);
+        uploads.erase(it);
+        stats.completed++;
+        return true;
+    }
+    return true;
+}
+
+void cancelTextureUpload(GLuint texture)
+{
+    for (auto it = uploads.begin(); it != uploads.end(); ++it)
+    {
+        if (it->texture == texture)
+        {
+            deleteUpload(*it);
+            uploads.erase(it);
+            stats.cancelled++;
+            return;
+        }
+    }
+}
+
+void stopPixelBufferUploads()
+{
+    for (PendingUpload &upload : uploads)
+        deleteUpload(upload);
+    uploads.clear();
+
+    for (PixelBuffer &buffer : buffers)
+    {
+        if (buffer.fence)
+            glDeleteSync(buffer.fence);
+        glDeleteBuffers(1, &buffer.buffer);
+    }
+    buffers.clear();
+}
+
+void printPixelBufferUploadReport()
+{
+    if (stats.queued == 0)
+        return;
+
+    cout << "\n=== Pixel buffer uploads ===\n";
+    cout << stats.queued << " textures queued, " << stats.completed << " complete, " << uploads.size()
+         << " in flight";
+    if (stats.cancelled > 0)
+        cout << ", " << stats.cancelled << " cancelled";
+    cout << "\n" << fixed << setprecision(1) << stats.bytes / (1024.0 * 1024.0) << " MB over " << stats.frames
+         << " frames through " << PIXEL_BUFFER_COUNT << " buffers of " << ringBytes / PIXEL_BUFFER_COUNT / 1024
+         << " KB; at most " << stats.maxFrameBytes / 1024 << " KB and " << stats.maxFrameMs << " ms in a frame\n"
+         << defaultfloat;
+    if (stats.busyFrames > 0)
+        cout << stats.busyFrames << " frames found every buffer still in flight and waited for the next\n";
+    cout << endl;
+}
@@ -0,0 +1,151 @@
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "vertex_format.h"
+
+using namespace std;
+using namespace glm;
+
+namespace
+{
+    atomic<unsigned int> usedAttributes(VERTEX_ATTRIBS_ALL);
+}
+
+PackedVertexLayout makePackedVertexLayout(bool skinned, size_t boneCount, bool hasTexcoords, bool hasColors)
+{
+    PackedVertexLayout layout;
+    layout.skinned = skinned;
+    layout.wideBoneIds = skinned && boneCount > 255;
+    layout.hasTexcoords = hasTexcoords;
+    layout.hasColors = hasColors;
+
+    GLsizei offset = PACKED_VERTEX_BASE_SIZE;
+    layout.texcoordOffset = offset;
+    if (hasTexcoords)
+        offset += 4;
+    layout.colorOffset = offset;
+    if (hasColors)
+        offset += 4;
+    layout.boneIdOffset = offset;
+    if (skinned)
+        offset += layout.wideBoneIds ? 8 : 4;
+    layout.weightOffset = offset;
+    if (skinned)
+        offset += 4;
+    layout.stride = offset;
+    return layout;
+}
+
+void setUsedVertexAttributes(unsigned int attributes)
+{
+    usedAttributes.store(attributes);
+}
+
+unsigned int usedVertexAttributes()
+{
+    return usedAttributes.load();
+}
+
+static uint32_t snorm10(float v)
+{
+    v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+    int32_t q = static_cast<int32_t>(lround(v * 511.0f));
+    return static_cast<uint32_t>(q) & 0x3FFu;
+}
+
+uint32_t packNormal1010102(const vec3 &n)
+{
+    return snorm10(n.x) | (snorm10(n.y) << 10) | (snorm10(n.z) << 20);
+}
+
+uint16_t packHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (((bits >> 23) & 0xFFu) == 0xFFu)
+    {
+        // Inf stays inf, NaN stays a (quiet) NaN.
+        return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+    }
+    if (exponent >= 31)
+    {
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return static_cast<uint16_t>(sign);
+
+        // Subnormal half: shift the implicit leading one in and round.
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u)))
+            half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFFu;
+    // Round to nearest even; a carry into the exponent is still correct.
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        half++;
+    return static_cast<uint16_t>(half);
+}
+
+static uint32_t unorm8(float v)
+{
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return static_cast<uint32_t>(lround(v * 255.0f));
+}
+
+uint32_t packUnorm8x4(const vec4 &v)
+{
+    return unorm8(v.x) | (unorm8(v.y) << 8) | (unorm8(v.z) << 16) | (unorm8(v.w) << 24);
+}
+
+uint32_t packBoneWeights(const vec4 &weights)
+{
+    uint32_t q[4];
+    int total = 0;
+    int largest = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        q[i] = unorm8(weights[i]);
+        total += static_cast<int>(q[i]);
+        if (weights[i] > weights[largest])
+            largest = i;
+    }
+
+    // Give the rounding error to the dominant influence so a skinned vertex
+    // is not pulled towards the origin.
+    if (total > 0 && total != 255)
+    {
+        int fixed = static_cast<int>(q[largest]) + (255 - total);
+        q[largest] = static_cast<uint32_t>(fixed < 0 ? 0 : (fixed > 255 ? 255 : fixed));
+    }
+    return q[0] | (q[1] << 8) | (q[2] << 16) | (q[3] << 24);
+}
+
+size_t legacyVertexSize(bool hasNormals, bool skinned)
+{
+    size_t size = sizeof(vec3) + sizeof(vec2) + sizeof(vec3);
+    if (hasNormals)
+        size += sizeof(vec3);
+    if (skinned)
+        size += sizeof(ivec4) + sizeof(vec4);
+    return size;
+}
+
+size_t elidedVertexSize(const PackedVertexLayout &layout)
+{
+    return (layout.hasTexcoords ? 0 : 4) + (layout.hasColors ? 0 : 4);
+}
@@ -1,5 +1,6 @@
 #include <cmath>
 #include <map>
+#include <memory>
 #include <string>
 #include <iostream>
 #include <glm/glm.hpp>
@@ -19,7 +20,7 @@
 using namespace std;
 using namespace glm;
 
-static map<size_t, Animator *> animators;
+static map<size_t, unique_ptr<Animator>> animators;
 
 static float fogDensity = 0.01f;
 static float fogStart = 200.0f;
@@ -29,8 +30,19 @@ static float fogHeightRange = 60.0f;
 
 static float heatDelta = 0.0f;
 
+// Per-model clocks and positions advanced every frame; see RendererState.
+static map<size_t, float> animationTimes;
+static map<size_t, vec3> basePositions;
+static map<size_t, float> orbitAngles;
+static map<size_t, vec3> parentBasePositions;
+// Clip times from a restored snapshot, applied when each animator is made.
+static map<size_t, float> restoredAnimatorTimes;
+
 void renderScene(float delta, const mat4 &view, const mat4 &proj, GLuint shaderProgramID, const vec3 &cameraPos, float timeOfDay){
-    if (meshes.empty())
+    static vector<SceneProxy> proxies;
+    getSceneProxies(proxies);
+
+    if (meshes.empty() && proxies.empty())
         return;
 
     glEnable(GL_DEPTH_TEST);
@@ -57,6 +69,7 @@ void renderScene(float delta, const mat4 &view, const mat4 &proj, GLuint shaderP
     renderer->setHeatShimmerIntensity(1.5f);
 
     renderer->renderMeshes(meshes, meshTransforms, delta, view, proj);
+    renderer->renderProxies(proxies);
 };
 
 void renderHierarchicalMeshes(float delta, const mat4 &view, const mat4 &proj, GLuint shaderProgramID, const vec3 &cameraPos, float timeOfDay){
@@ -91,7 +104,7 @@ void renderHierarchicalMeshes(float delta, const mat4 &view, const mat4 &proj, G
     {
         HierarchicalModel &hmodel = hierarchicalModels[modelIdx];
 
-        if (!hmodel.rootNode)
+        if (!hmodel.rootNode || !hmodel.asset)
             continue;
 
         if (hmodel.useOrbitalMotion &&
@@ -109,8 +122,6 @@ void renderHierarchicalMeshes(float delta, const mat4 &view, const mat4 &proj, G
             );
         }
 
-        static map<size_t, float> animationTimes;
-
         if (animationTimes.find(modelIdx) == animationTimes.end())
         {
             animationTimes[modelIdx] = 0.0f;
@@ -120,15 +131,21 @@ void renderHierarchicalMeshes(float delta, const mat4 &view, const mat4 &proj, G
 
         if (animators.find(modelIdx) == animators.end())
         {
-            animators[modelIdx] = new Animator(&hmodel);
+            animators[modelIdx].reset(new Animator(&hmodel));
             if (hmodel.activeAnimation >= 0 &&
-                hmodel.activeAnimation < (int)hmodel.animationClips.size())
+                hmodel.activeAnimation < (int)hmodel.asset->animationClips.size())
             {
                 animators[modelIdx]->setActiveAnimation(hmodel.activeAnimation);
             }
+            auto restored = restoredAnimatorTimes.find(modelIdx);
+            if (restored != restoredAnimatorTimes.end())
+            {
+                animators[modelIdx]->setCurrentTime(restored->second);
+                restoredAnimatorTimes.erase(restored);
+            }
         }
 
-        Animator *animator = animators[modelIdx];
+        Animator *animator = animators[modelIdx].get();
 
         if (hmodel.activeAnimation >= 0 &&
             hmodel.activeAnimation != animator->getCurrentAnimation())
@@ -148,7 +165,6 @@ void renderHierarchicalMeshes(float delta, const mat4 &view, const mat4 &proj, G
 
         if (!hmodel.hasEmbeddedAnimation)
         {
-            static map<size_t, vec3> basePositions;
             if (basePositions.find(modelIdx) == basePositions.end())
             {
                 basePositions[modelIdx] = hmodel.worldPosition;
@@ -182,7 +198,9 @@ void renderHierarchicalMeshes(float delta, const mat4 &view, const mat4 &proj, G
     }
 };
 
-void updateDynamicLights(GLuint shaderProgramID, float time, const vec3 &cameraPos, bool enablePointLights, bool enableSpotLights)
+void updateDynamicLights(GLuint shaderProgramID, float time, const vec3 &cameraPos,
+                         const vec3 &leviathanPos, const vec3 &ship1Pos, const vec3 &ship2Pos,
+                         bool enablePointLights, bool enableSpotLights)
 {
     static ModelRenderer *renderer = nullptr;
     if (!renderer)
@@ -192,48 +210,6 @@ void updateDynamicLights(GLuint shaderProgramID, float time, const vec3 &cameraP
 
     glUseProgram(shaderProgramID);
 
-    vec3 leviathanPos = vec3(0.0f, 0.0f, 0.0f);
-    if (!hierarchicalModels.empty() && hierarchicalModels.size() > 0)
-    {
-        leviathanPos = hierarchicalModels[0].worldPosition;
-    }
-
-    vec3 ship1Pos = vec3(100.0f, 30.0f, 35.0f);
-    vec3 ship2Pos = vec3(50.0f, 20.0f, -10.0f);
-
-    if (!hierarchicalModels.empty() && hierarchicalModels.size() > 0)
-    {
-        float leviathanHeight = 10.0f;
-        float hoverRadius = 40.0f;
-        float hoverHeight = leviathanPos.y + leviathanHeight + 25.0f;
-
-        static float ship1OrbitAngle = 0.0f;
-        ship1OrbitAngle = fmod(time * 0.2f, 2.0f * 3.14159f);
-
-        ship1Pos = vec3(
-            leviathanPos.x + cos(ship1OrbitAngle) * hoverRadius,
-            hoverHeight,
-            leviathanPos.z + sin(ship1OrbitAngle) * hoverRadius);
-
-        float ship2OrbitAngle = ship1OrbitAngle + 3.14159f;
-        ship2Pos = vec3(
-            leviathanPos.x + cos(ship2OrbitAngle) * hoverRadius,
-            hoverHeight,
-            leviathanPos.z + sin(ship2OrbitAngle) * hoverRadius);
-    }
-    else
-    {
-
-        if (meshTransforms.size() > 3)
-        {
-            ship1Pos = meshTransforms[3].position;
-        }
-        if (meshTransforms.size() > 5)
-        {
-            ship2Pos = meshTransforms[5].position;
-        }
-    }
-
     vec3 toLeviathan1 = normalize(leviathanPos - ship1Pos);
     vec3 toLeviathan2 = normalize(leviathanPos - ship2Pos);
 
@@ -307,9 +283,6 @@ void updateOrbitalMotion(HierarchicalModel &parentModel,
                          float orbitSpeed,
                          float forwardSpeed)
 {
-    static map<size_t, float> orbitAngles;
-    static map<size_t, vec3> parentBasePositions;
-
     size_t parentIdx = parentModel.modelIndex;
     size_t childIdx = childModel.modelIndex;
 
@@ -340,6 +313,51 @@ void updateOrbitalMotion(HierarchicalModel &parentModel,
 
 };
 
+void saveRendererState(RendererState &state)
+{
+    state.heatTime = heatDelta;
+    state.animationTimes = animationTimes;
+    state.basePositions = basePositions;
+    state.orbitAngles = orbitAngles;
+    state.parentBasePositions = parentBasePositions;
+
+    // A model not resident yet keeps the time it was restored with.
+    state.animatorTimes = restoredAnimatorTimes;
+    for (const auto &entry : animators)
+    {
+        state.animatorTimes[entry.first] = entry.second->getCurrentTime();
+    }
+}
+
+void releaseModelAnimator(size_t modelIdx)
+{
+    auto found = animators.find(modelIdx);
+    if (found == animators.end())
+        return;
+
+    restoredAnimatorTimes[modelIdx] = found->second->getCurrentTime();
+    animators.erase(found);
+}
+
+void restoreRendererState(const RendererState &state)
+{
+    heatDelta = state.heatTime;
+    animationTimes = state.animationTimes;
+    basePositions = state.basePositions;
+    orbitAngles = state.orbitAngles;
+    parentBasePositions = state.parentBasePositions;
+    restoredAnimatorTimes = state.animatorTimes;
+    for (auto &entry : animators)
+    {
+        auto restored = restoredAnimatorTimes.find(entry.first);
+        if (restored != restoredAnimatorTimes.end())
+        {
+            entry.second->setCurrentTime(restored->second);
+            restoredAnimatorTimes.erase(restored);
+        }
+    }
+}
+
 DayNightParams calculateDayNightCycle(float timeOfDay)
 {
     DayNightParams params;
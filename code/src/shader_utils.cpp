@@ -1,30 +1,32 @@
 #include "shader_utils.h"
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
+#include "asset_pack.h"
+#include "load_profiler.h"
+
 using namespace std;
 
 static char *readShaderSource(const char *shaderFile)
 {
-    FILE *shader_file = fopen(shaderFile, "rb");
-    if (!shader_file)
+    AssetFile shader_file;
+    if (!shader_file.open(shaderFile))
     {
         cerr << "readShaderSource: failed to open shader file: " << shaderFile << endl;
         return nullptr;
     }
-    fseek(shader_file, 0, SEEK_END);
-    long size = ftell(shader_file);
-    fseek(shader_file, 0, SEEK_SET);
+    size_t size = shader_file.size();
     char *buffer_val = new char[size + 1];
-    fread(buffer_val, 1, size, shader_file);
+    memcpy(buffer_val, shader_file.data(), size);
     buffer_val[size] = '\0';
-    fclose(shader_file);
     return buffer_val;
 }
 
 static void AddShader(GLuint program, const char *file, GLenum type)
 {
+    ProfileScope scope("compileShader");
     char *src = readShaderSource(file);
     GLuint sh = glCreateShader(type);
 
@@ -49,13 +51,19 @@ static void AddShader(GLuint program, const char *file, GLenum type)
 
 GLuint CompileShaders(const char *vertex_shader, const char *fragment_shader)
 {
+    ProfileScope scope("CompileShaders", string(vertex_shader) + " + " + fragment_shader);
     GLuint program = glCreateProgram();
     AddShader(program, vertex_shader, GL_VERTEX_SHADER);
     AddShader(program, fragment_shader, GL_FRAGMENT_SHADER);
 
-    glLinkProgram(program);
     GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    {
+        // Drivers often defer compilation to link time, so this is where
+        // most of the shader cost shows up.
+        ProfileScope linkScope("glLinkProgram");
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+    }
 
     if (!success)
     {
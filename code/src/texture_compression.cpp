@@ -0,0 +1,604 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "texture_compression.h"
+#include "texture_loader.h"
+#include "load_profiler.h"
+
+using namespace std;
+
+namespace
+{
+    const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+    const uint32_t DDSD_CAPS = 0x1;
+    const uint32_t DDSD_HEIGHT = 0x2;
+    const uint32_t DDSD_WIDTH = 0x4;
+    const uint32_t DDSD_PIXELFORMAT = 0x1000;
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDSD_LINEARSIZE = 0x80000;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDSCAPS_COMPLEX = 0x8;
+    const uint32_t DDSCAPS_TEXTURE = 0x1000;
+    const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+    const uint32_t DXGI_BC1_UNORM = 71;
+    const uint32_t DXGI_BC1_UNORM_SRGB = 72;
+    const uint32_t DXGI_BC3_UNORM = 77;
+    const uint32_t DXGI_BC3_UNORM_SRGB = 78;
+    const uint32_t DXGI_BC5_UNORM = 83;
+    const uint32_t DXGI_BC7_UNORM = 98;
+    const uint32_t DXGI_BC7_UNORM_SRGB = 99;
+
+    // The largest texture GL 3.3 hardware takes; also keeps every size below
+    // from overflowing.
+    const uint32_t MAX_DDS_DIMENSION = 16384;
+
+    struct DdsPixelFormat
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t masks[4];
+    };
+
+    struct DdsHeader
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t linearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DdsPixelFormat format;
+        uint32_t caps[4];
+        uint32_t reserved2;
+    };
+
+    struct DdsHeaderDx10
+    {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    uint32_t fourCC(const char *code)
+    {
+        return static_cast<uint32_t>(code[0]) | static_cast<uint32_t>(code[1]) << 8 |
+               static_cast<uint32_t>(code[2]) << 16 | static_cast<uint32_t>(code[3]) << 24;
+    }
+
+    size_t levelBytes(BlockFormat format, int width, int height)
+    {
+        size_t blocks = ((static_cast<size_t>(width) + 3) / 4) * ((static_cast<size_t>(height) + 3) / 4);
+        return blocks * blockFormatBytes(format);
+    }
+
+    // Fills in offsets and sizes for levels of the image's size.
+    void layoutLevels(CompressedImage &image, int levelCount)
+    {
+        image.levels.clear();
+        int width = image.width;
+        int height = image.height;
+        size_t offset = 0;
+        for (int level = 0; level < levelCount; level++)
+        {
+            CompressedLevel info;
+            info.width = width;
+            info.height = height;
+            info.offset = offset;
+            info.size = levelBytes(image.format, width, height);
+            image.levels.push_back(info);
+            offset += info.size;
+            width = max(1, width / 2);
+            height = max(1, height / 2);
+        }
+    }
+
+    int fullChainLength(int width, int height)
+    {
+        int levels = 1;
+        while (width > 1 || height > 1)
+        {
+            width = max(1, width / 2);
+            height = max(1, height / 2);
+            levels++;
+        }
+        return levels;
+    }
+
+    uint16_t packRgb565(const float colour[3])
+    {
+        int r = static_cast<int>(colour[0] * 31.0f / 255.0f + 0.5f);
+        int g = static_cast<int>(colour[1] * 63.0f / 255.0f + 0.5f);
+        int b = static_cast<int>(colour[2] * 31.0f / 255.0f + 0.5f);
+        r = min(max(r, 0), 31);
+        g = min(max(g, 0), 63);
+        b = min(max(b, 0), 31);
+        return static_cast<uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    void unpackRgb565(uint16_t packed, int colour[3])
+    {
+        int r = packed >> 11 & 31;
+        int g = packed >> 5 & 63;
+        int b = packed & 31;
+        colour[0] = r << 3 | r >> 2;
+        colour[1] = g << 2 | g >> 4;
+        colour[2] = b << 3 | b >> 2;
+    }
+
+    // BC1 colour block: endpoints at the extremes of the texels along their
+    // principal axis, each texel taking the nearest of the four palette
+    // colours. Also the colour half of BC3, which always reads four colours.
+    void encodeColourBlock(const unsigned char texels[16][4], unsigned char *out)
+    {
+        float mean[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 3; c++)
+                mean[c] += texels[i][c] / 16.0f;
+        }
+
+        float cov[3][3] = {{0.0f}};
+        for (int i = 0; i < 16; i++)
+        {
+            float d[3] = {texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2]};
+            for (int a = 0; a < 3; a++)
+            {
+                for (int b = 0; b < 3; b++)
+                    cov[a][b] += d[a] * d[b];
+            }
+        }
+
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3];
+            for (int a = 0; a < 3; a++)
+                next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+            float length = sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+            if (length < 1e-6f)
+                break;
+            for (int a = 0; a < 3; a++)
+                axis[a] = next[a] / length;
+        }
+
+        float lowest = 0.0f;
+        float highest = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] +
+                      (texels[i][2] - mean[2]) * axis[2];
+            lowest = min(lowest, t);
+            highest = max(highest, t);
+        }
+
+        float end0[3];
+        float end1[3];
+        for (int c = 0; c < 3; c++)
+        {
+            end0[c] = mean[c] + axis[c] * highest;
+            end1[c] = mean[c] + axis[c] * lowest;
+        }
+        uint16_t c0 = packRgb565(end0);
+        uint16_t c1 = packRgb565(end1);
+        if (c0 < c1)
+            swap(c0, c1);
+
+        int palette[4][3];
+        unpackRgb565(c0, palette[0]);
+        unpackRgb565(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+        }
+
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0;
+                int bestDistance = 1 << 30;
+                for (int p = 0; p < 4; p++)
+                {
+                    int dr = texels[i][0] - palette[p][0];
+                    int dg = texels[i][1] - palette[p][1];
+                    int db = texels[i][2] - palette[p][2];
+                    int distance = dr * dr + dg * dg + db * db;
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<uint32_t>(best) << (2 * i);
+            }
+        }
+
+        out[0] = c0 & 0xff;
+        out[1] = c0 >> 8;
+        out[2] = c1 & 0xff;
+        out[3] = c1 >> 8;
+        for (int b = 0; b < 4; b++)
+            out[4 + b] = indices >> (8 * b) & 0xff;
+    }
+
+    // BC4 block, one channel: eight interpolated values between the block's
+    // minimum and maximum. The alpha half of BC3 and each half of BC5.
+    void encodeChannelBlock(const unsigned char texels[16][4], int channel, unsigned char *out)
+    {
+        int lowest = 255;
+        int highest = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            lowest = min(lowest, static_cast<int>(texels[i][channel]));
+            highest = max(highest, static_cast<int>(texels[i][channel]));
+        }
+
+        int palette[8];
+        palette[0] = highest;
+        palette[1] = lowest;
+        for (int p = 2; p < 8; p++)
+            palette[p] = ((8 - p) * highest + (p - 1) * lowest + 3) / 7;
+
+        uint64_t indices = 0;
+        if (highest != lowest)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0;
+                int bestDistance = 256;
+                for (int p = 0; p < 8; p++)
+                {
+                    int distance = abs(texels[i][channel] - palette[p]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<uint64_t>(best) << (3 * i);
+            }
+        }
+
+        out[0] = static_cast<unsigned char>(highest);
+        out[1] = static_cast<unsigned char>(lowest);
+        for (int b = 0; b < 6; b++)
+            out[2 + b] = indices >> (8 * b) & 0xff;
+    }
+
+    void encodeLevel(const vector<unsigned char> &rgba, int width, int height, BlockFormat format,
+                     unsigned char *out)
+    {
+        size_t blockBytes = blockFormatBytes(format);
+        for (int by = 0; by < (height + 3) / 4; by++)
+        {
+            for (int bx = 0; bx < (width + 3) / 4; bx++)
+            {
+                // Edge blocks repeat the last row and column.
+                unsigned char texels[16][4];
+                for (int j = 0; j < 4; j++)
+                {
+                    for (int i = 0; i < 4; i++)
+                    {
+                        int x = min(bx * 4 + i, width - 1);
+                        int y = min(by * 4 + j, height - 1);
+                        memcpy(texels[j * 4 + i], &rgba[(static_cast<size_t>(y) * width + x) * 4], 4);
+                    }
+                }
+
+                switch (format)
+                {
+                case BLOCK_BC1:
+                    encodeColourBlock(texels, out);
+                    break;
+                case BLOCK_BC3:
+                    encodeChannelBlock(texels, 3, out);
+                    encodeColourBlock(texels, out + 8);
+                    break;
+                case BLOCK_BC5:
+                    encodeChannelBlock(texels, 0, out);
+                    encodeChannelBlock(texels, 1, out + 8);
+                    break;
+                default:
+                    break;
+                }
+                out += blockBytes;
+            }
+        }
+    }
+
+    void flipColourRows(unsigned char *block, int rows)
+    {
+        reverse(block + 4, block + 4 + rows);
+    }
+
+    void flipChannelRows(unsigned char *block, int rows)
+    {
+        uint64_t bits = 0;
+        for (int b = 0; b < 6; b++)
+            bits |= static_cast<uint64_t>(block[2 + b]) << (8 * b);
+
+        uint64_t flipped = bits;
+        for (int row = 0; row < rows; row++)
+        {
+            uint64_t mask = 0xfffULL << (12 * (rows - 1 - row));
+            flipped &= ~(0xfffULL << (12 * row));
+            flipped |= ((bits & mask) >> (12 * (rows - 1 - row))) << (12 * row);
+        }
+        for (int b = 0; b < 6; b++)
+            block[2 + b] = flipped >> (8 * b) & 0xff;
+    }
+
+}
+
+const char *blockFormatName(BlockFormat format)
+{
+    switch (format)
+    {
+    case BLOCK_BC1:
+        return "BC1";
+    case BLOCK_BC3:
+        return "BC3";
+    case BLOCK_BC5:
+        return "BC5";
+    case BLOCK_BC7:
+        return "BC7";
+    }
+    return "?";
+}
+
+size_t blockFormatBytes(BlockFormat format)
+{
+    return format == BLOCK_BC1 ? 8 : 16;
+}
+
+bool EncodeCompressedImage(const unsigned char *pixels, int width, int height, int channels,
+                           CompressedImage &image)
+{
+    if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+        return false;
+
+    ProfileScope scope("EncodeCompressedImage");
+    image.format = channels == 4 ? BLOCK_BC3 : channels == 2 ? BLOCK_BC5 : BLOCK_BC1;
+    image.width = width;
+    image.height = height;
+    image.channels = channels;
+    layoutLevels(image, fullChainLength(width, height));
+    image.data.assign(image.levels.back().offset + image.levels.back().size, 0);
+
+    // Work in RGBA so every format reads its channels from the same place.
+    vector<unsigned char> level(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+    {
+        const unsigned char *src = pixels + i * channels;
+        unsigned char *dst = &level[i * 4];
+        dst[0] = src[0];
+        dst[1] = channels >= 2 ? src[1] : src[0];
+        dst[2] = channels >= 3 ? src[2] : (channels == 1 ? src[0] : 0);
+        dst[3] = channels == 4 ? src[3] : 255;
+    }
+
+    vector<unsigned char> next;
+    int levelWidth = width;
+    int levelHeight = height;
+    for (size_t i = 0; i < image.levels.size(); i++)
+    {
+        encodeLevel(level, levelWidth, levelHeight, image.format, &image.data[image.levels[i].offset]);
+        if (i + 1 < image.levels.size())
+        {
+            int nextWidth = max(1, levelWidth / 2);
+            int nextHeight = max(1, levelHeight / 2);
+            next.resize(static_cast<size_t>(nextWidth) * nextHeight * 4);
+            HalveImageRows(level.data(), levelWidth, levelHeight, 4, 0, nextHeight, next.data());
+            level.swap(next);
+            levelWidth = nextWidth;
+            levelHeight = nextHeight;
+        }
+    }
+    return true;
+}
+
+bool WriteDdsFile(const char *path, const CompressedImage &image)
+{
+    if (!path || image.levels.empty() || image.format == BLOCK_BC7)
+        return false;
+
+    DdsHeader header;
+    memset(&header, 0, sizeof(header));
+    header.size = sizeof(DdsHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+    header.height = image.height;
+    header.width = image.width;
+    header.linearSize = static_cast<uint32_t>(image.levels[0].size);
+    header.mipMapCount = static_cast<uint32_t>(image.levels.size());
+    header.format.size = sizeof(DdsPixelFormat);
+    header.format.flags = DDPF_FOURCC;
+    header.format.fourCC = fourCC(image.format == BLOCK_BC1 ? "DXT1" : image.format == BLOCK_BC3 ? "DXT5" : "ATI2");
+    header.caps[0] = DDSCAPS_TEXTURE;
+    if (image.levels.size() > 1)
+    {
+        header.flags |= DDSD_MIPMAPCOUNT;
+        header.caps[0] |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    }
+
+    // Same write-then-rename as the other bake outputs.
+    string tempPath = string(path) + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+    {
+        cerr << "WriteDdsFile: cannot write '" << tempPath << "'\n";
+        return false;
+    }
+    bool ok = fwrite(&DDS_MAGIC, sizeof(DDS_MAGIC), 1, file) == 1 &&
+              fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(image.data.data(), 1, image.data.size(), file) == image.data.size();
+    fclose(file);
+    if (!ok)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    remove(path);
+    return rename(tempPath.c_str(), path) == 0;
+}
+
+bool ReadDdsImage(const unsigned char *bytes, size_t size, CompressedImage &image, string &error)
+{
+    uint32_t magic = 0;
+    DdsHeader header;
+    if (!bytes || size < sizeof(magic) + sizeof(header))
+    {
+        error = "too short for a DDS header";
+        return false;
+    }
+    memcpy(&magic, bytes, sizeof(magic));
+    memcpy(&header, bytes + sizeof(magic), sizeof(header));
+    if (magic != DDS_MAGIC || header.size != sizeof(DdsHeader) || header.width == 0 || header.height == 0)
+    {
+        error = "not a DDS file";
+        return false;
+    }
+    if (header.width > MAX_DDS_DIMENSION || header.height > MAX_DDS_DIMENSION)
+    {
+        error = to_string(header.width) + "x" + to_string(header.height) + " is larger than " +
+                to_string(MAX_DDS_DIMENSION) + " texels a side";
+        return false;
+    }
+    if (!(header.format.flags & DDPF_FOURCC))
+    {
+        error = "uncompressed DDS";
+        return false;
+    }
+
+    size_t offset = sizeof(magic) + sizeof(header);
+    uint32_t code = header.format.fourCC;
+    if (code == fourCC("DXT1"))
+        image.format = BLOCK_BC1;
+    else if (code == fourCC("DXT5"))
+        image.format = BLOCK_BC3;
+    else if (code == fourCC("ATI2") || code == fourCC("BC5U"))
+        image.format = BLOCK_BC5;
+    else if (code == fourCC("DX10"))
+    {
+        DdsHeaderDx10 dx10;
+        if (size < offset + sizeof(dx10))
+        {
+            error = "truncated DX10 header";
+            return false;
+        }
+        memcpy(&dx10, bytes + offset, sizeof(dx10));
+        offset += sizeof(dx10);
+        if (dx10.arraySize > 1)
+        {
+            error = "texture arrays are not supported";
+            return false;
+        }
+        switch (dx10.dxgiFormat)
+        {
+        case DXGI_BC1_UNORM:
+        case DXGI_BC1_UNORM_SRGB:
+            image.format = BLOCK_BC1;
+            break;
+        case DXGI_BC3_UNORM:
+        case DXGI_BC3_UNORM_SRGB:
+            image.format = BLOCK_BC3;
+            break;
+        case DXGI_BC5_UNORM:
+            image.format = BLOCK_BC5;
+            break;
+        case DXGI_BC7_UNORM:
+        case DXGI_BC7_UNORM_SRGB:
+            image.format = BLOCK_BC7;
+            break;
+        default:
+            error = "unsupported DXGI format " + to_string(dx10.dxgiFormat);
+            return false;
+        }
+    }
+    else
+    {
+        error = "unsupported compression";
+        return false;
+    }
+
+    image.width = static_cast<int>(header.width);
+    image.height = static_cast<int>(header.height);
+    image.channels = image.format == BLOCK_BC1 ? 3 : image.format == BLOCK_BC5 ? 2 : 4;
+    uint32_t levelCount = (header.flags & DDSD_MIPMAPCOUNT) && header.mipMapCount > 0 ? header.mipMapCount : 1;
+    levelCount = min(levelCount, static_cast<uint32_t>(fullChainLength(image.width, image.height)));
+    layoutLevels(image, static_cast<int>(levelCount));
+
+    size_t dataSize = 0;
+    for (const CompressedLevel &level : image.levels)
+    {
+        if (level.size > size - offset - dataSize)
+        {
+            error = "truncated mip chain";
+            return false;
+        }
+        dataSize += level.size;
+    }
+    image.data.assign(bytes + offset, bytes + offset + dataSize);
+    return true;
+}
+
+bool FlipCompressedImage(CompressedImage &image)
+{
+    if (image.format == BLOCK_BC7)
+        return false;
+    for (const CompressedLevel &level : image.levels)
+    {
+        if (level.height > 4 && level.height % 4 != 0)
+            return false;
+    }
+
+    size_t blockBytes = blockFormatBytes(image.format);
+    for (const CompressedLevel &level : image.levels)
+    {
+        int rows = min(level.height, 4);
+        size_t rowBytes = static_cast<size_t>((level.width + 3) / 4) * blockBytes;
+        int blockRows = (level.height + 3) / 4;
+        unsigned char *base = &image.data[level.offset];
+
+        for (int row = 0; row < blockRows / 2; row++)
+        {
+            swap_ranges(base + row * rowBytes, base + (row + 1) * rowBytes,
+                        base + (blockRows - 1 - row) * rowBytes);
+        }
+        for (size_t at = 0; at < level.size; at += blockBytes)
+        {
+            unsigned char *block = base + at;
+            switch (image.format)
+            {
+            case BLOCK_BC1:
+                flipColourRows(block, rows);
+                break;
+            case BLOCK_BC3:
+                flipChannelRows(block, rows);
+                flipColourRows(block + 8, rows);
+                break;
+            case BLOCK_BC5:
+                flipChannelRows(block, rows);
+                flipChannelRows(block + 8, rows);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return true;
+}
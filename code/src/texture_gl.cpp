@@ -0,0 +1,386 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "texture_loader.h"
+#include "texture_compression.h"
+#include "texture_cache.h"
+#include "baked_assets.h"
+#include "asset_pack.h"
+#include "load_profiler.h"
+
+using namespace std;
+
+// The GL side of textures: uploads and the cache's deletes. Decoding and the
+// DDS format, which desert_bake shares, are in texture_loader.cpp and
+// texture_compression.cpp.
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+namespace
+{
+    bool compressedTexturesEnabled = false;
+
+    bool endsWith(const string &text, const char *suffix)
+    {
+        size_t length = strlen(suffix);
+        return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+    }
+
+    // The block-compressed version of a texture: the path itself when it names
+    // a DDS file, otherwise the one desert_bake wrote for it, if there is one.
+    // Zero, quietly or with a message, whenever the decode path should be used.
+    GLuint loadCompressedTexture(const char *path, bool srgb, bool flipVertically, int &width, int &height,
+                                 int &channels)
+    {
+        string ddsPath = path;
+        if (!endsWith(ddsPath, ".dds"))
+        {
+            ddsPath = bakedAssetPath(path, ".dds");
+            if (!assetExists(ddsPath.c_str()))
+                return 0;
+        }
+
+        AssetFile file;
+        if (!file.open(ddsPath.c_str()))
+            return 0;
+
+        CompressedImage image;
+        string error;
+        if (!ReadDdsImage(file.data(), file.size(), image, error))
+        {
+            cerr << "LoadTexture: '" << ddsPath << "': " << error << "\n";
+            return 0;
+        }
+        if (flipVertically && !FlipCompressedImage(image))
+        {
+            cerr << "LoadTexture: cannot flip " << blockFormatName(image.format) << " texture '" << ddsPath
+                 << "' in place, decoding the source instead\n";
+            return 0;
+        }
+        if (!compressedFormatSupported(image.format, srgb))
+        {
+            cerr << "LoadTexture: driver has no " << blockFormatName(image.format) << (srgb ? " sRGB" : "")
+                 << " support, decoding '" << path << "' instead\n";
+            return 0;
+        }
+
+        GLuint tex = UploadCompressedImage(image, srgb);
+        if (tex == 0)
+        {
+            cerr << "LoadTexture: failed to upload '" << ddsPath << "'\n";
+            return 0;
+        }
+
+        // Against what the uncompressed texture and its generated mips take.
+        size_t uncompressed = textureBytes(image.width, image.height, 4);
+        size_t compressed = image.data.size();
+        cout << "[texture] " << path << ": " << blockFormatName(image.format) << " " << image.width << "x"
+             << image.height << ", " << image.levels.size() << " levels, " << compressed / 1024 << " KB ("
+             << uncompressed / 1024 << " KB as RGBA8)\n";
+
+        width = image.width;
+        height = image.height;
+        channels = image.channels;
+        return tex;
+    }
+
+    // Extensions are read once; the answer cannot change for a context.
+    struct CompressionSupport
+    {
+        bool checked;
+        bool s3tc;
+        bool s3tcSrgb;
+        bool bptc;
+    };
+    CompressionSupport support = {false, false, false, false};
+
+    void checkCompressionSupport()
+    {
+        if (support.checked)
+            return;
+        support.checked = true;
+
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        support.bptc = major > 4 || (major == 4 && minor >= 2);
+
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+            if (!name)
+                continue;
+            if (strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                support.s3tc = true;
+            else if (strcmp(name, "GL_EXT_texture_sRGB") == 0 || strcmp(name, "GL_EXT_texture_compression_s3tc_srgb") == 0)
+                support.s3tcSrgb = true;
+            else if (strcmp(name, "GL_ARB_texture_compression_bptc") == 0)
+                support.bptc = true;
+        }
+    }
+
+    GLenum glBlockFormat(BlockFormat format, bool srgb)
+    {
+        switch (format)
+        {
+        case BLOCK_BC1:
+            return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BLOCK_BC3:
+            return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BLOCK_BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        case BLOCK_BC7:
+            return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+        return 0;
+    }
+}
+
+bool deriveFormats(int channels, bool srgb, GLenum &format, GLenum &internalFormat)
+{
+    switch (channels)
+    {
+    case 1:
+        format = GL_RED;
+        internalFormat = GL_R8;
+        return true;
+    case 2:
+        format = GL_RG;
+        internalFormat = GL_RG8;
+        return true;
+    case 3:
+        format = GL_RGB;
+        internalFormat = srgb ? GL_SRGB8 : GL_RGB8;
+        return true;
+    case 4:
+        format = GL_RGBA;
+        internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void setCompressedTextureLoading(bool enabled)
+{
+    compressedTexturesEnabled = enabled;
+}
+
+GLuint UploadTextureFromPixels(const unsigned char *pixels,
+                               int width,
+                               int height,
+                               int channels,
+                               bool srgb)
+{
+    if (!pixels || width <= 0 || height <= 0 || channels <= 0)
+    {
+        cerr << "UploadTextureFromPixels: invalid pixel data\n";
+        return 0;
+    }
+
+    GLenum format = GL_RGB;
+    GLenum internalFormat = GL_RGB;
+    if (!deriveFormats(channels, srgb, format, internalFormat))
+    {
+        cerr << "UploadTextureFromPixels: unsupported channel count (" << channels << ")\n";
+        return 0;
+    }
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    {
+        ProfileScope scope("glTexImage2D");
+        glTexImage2D(GL_TEXTURE_2D,
+                     0,
+                     internalFormat,
+                     width,
+                     height,
+                     0,
+                     format,
+                     GL_UNSIGNED_BYTE,
+                     pixels);
+    }
+    {
+        ProfileScope scope("glGenerateMipmap");
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return tex;
+}
+
+GLuint LoadTexture(const char *path,
+                   bool srgb,
+                   bool flipVertically,
+                   int *outWidth,
+                   int *outHeight,
+                   int *outChannels)
+{
+    if (!path)
+    {
+        cerr << "LoadTexture: null path provided\n";
+        return 0;
+    }
+    ProfileScope scope("LoadTexture", path);
+
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    if (compressedTexturesEnabled)
+    {
+        GLuint tex = loadCompressedTexture(path, srgb, flipVertically, width, height, channels);
+        if (tex != 0)
+        {
+            if (outWidth)
+                *outWidth = width;
+            if (outHeight)
+                *outHeight = height;
+            if (outChannels)
+                *outChannels = channels;
+            return tex;
+        }
+    }
+
+    vector<unsigned char> pixels;
+    bool decoded = DecodeImageFile(path, flipVertically, pixels, width, height, channels);
+    if (outWidth)
+        *outWidth = width;
+    if (outHeight)
+        *outHeight = height;
+    if (outChannels)
+        *outChannels = channels;
+    if (!decoded)
+    {
+        cerr << "LoadTexture: failed to load image '" << path << "'\n";
+        return 0;
+    }
+
+    return UploadTextureFromPixels(pixels.data(), width, height, channels, srgb);
+}
+
+GLuint LoadTextureFromMemory(const unsigned char *buffer,
+                             size_t bufferSize,
+                             bool srgb,
+                             bool flipVertically,
+                             int *outWidth,
+                             int *outHeight,
+                             int *outChannels)
+{
+    if (!buffer || bufferSize == 0)
+    {
+        cerr << "LoadTextureFromMemory: invalid buffer\n";
+        return 0;
+    }
+
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    vector<unsigned char> pixels;
+    bool decoded = DecodeImageMemory(buffer, bufferSize, flipVertically, pixels, width, height, channels);
+    if (outWidth)
+        *outWidth = width;
+    if (outHeight)
+        *outHeight = height;
+    if (outChannels)
+        *outChannels = channels;
+    if (!decoded)
+    {
+        cerr << "LoadTextureFromMemory: failed to parse texture\n";
+        return 0;
+    }
+
+    return UploadTextureFromPixels(pixels.data(), width, height, channels, srgb);
+}
+
+bool compressedFormatSupported(BlockFormat format, bool srgb)
+{
+    checkCompressionSupport();
+    switch (format)
+    {
+    case BLOCK_BC1:
+    case BLOCK_BC3:
+        return support.s3tc && (!srgb || support.s3tcSrgb);
+    case BLOCK_BC5:
+        return true; // RGTC is core since GL 3.0
+    case BLOCK_BC7:
+        return support.bptc;
+    }
+    return false;
+}
+
+GLuint UploadCompressedImage(const CompressedImage &image, bool srgb)
+{
+    if (image.levels.empty())
+        return 0;
+
+    // Errors left by earlier calls would otherwise be blamed on a level.
+    // Bounded, since a lost context may keep reporting one.
+    for (int pending = 0; pending < 16 && glGetError() != GL_NO_ERROR; pending++)
+    {
+    }
+
+    GLenum internalFormat = glBlockFormat(image.format, srgb);
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size()) - 1);
+
+    {
+        ProfileScope scope("glCompressedTexImage2D");
+        for (size_t i = 0; i < image.levels.size(); i++)
+        {
+            const CompressedLevel &level = image.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), internalFormat, level.width,
+                                   level.height, 0, static_cast<GLsizei>(level.size), &image.data[level.offset]);
+            GLenum error = glGetError();
+            if (error != GL_NO_ERROR)
+            {
+                cerr << "UploadCompressedImage: level " << i << " (" << level.width << "x" << level.height
+                     << ", " << level.size << " bytes) failed with GL error 0x" << hex << error << dec << "\n";
+                glBindTexture(GL_TEXTURE_2D, 0);
+                glDeleteTextures(1, &tex);
+                return 0;
+            }
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return tex;
+}
+
+void releaseCachedTexture(GLuint texture)
+{
+    if (releaseTextureReference(texture))
+        glDeleteTextures(1, &texture);
+}
@@ -1,155 +1,221 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "texture_loader.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
 
 #include "stb_image.h"
+#include "baked_assets.h"
+#include "asset_pack.h"
+#include "load_profiler.h"
 
 using namespace std;
 
 namespace
 {
-bool deriveFormats(int channels, bool srgb, GLenum &format, GLenum &internalFormat)
+const uint32_t BAKED_TEXTURE_MAGIC = 0x58455444; // "DTEX"
+const uint32_t BAKED_TEXTURE_VERSION = 1;
+
+struct BakedTextureHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+};
+
+void copyRows(const unsigned char *src, int width, int height, int channels, bool flipVertically,
+              vector<unsigned char> &pixels)
 {
-    switch (channels)
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+    pixels.resize(rowBytes * height);
+    if (flipVertically)
     {
-    case 1:
-        format = GL_RED;
-        internalFormat = GL_R8;
-        return true;
-    case 2:
-        format = GL_RG;
-        internalFormat = GL_RG8;
-        return true;
-    case 3:
-        format = GL_RGB;
-        internalFormat = srgb ? GL_SRGB8 : GL_RGB8;
-        return true;
-    case 4:
-        format = GL_RGBA;
-        internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
-        return true;
-    default:
-        return false;
+        for (int y = 0; y < height; y++)
+        {
+            memcpy(&pixels[rowBytes * y], src + rowBytes * (height - 1 - y), rowBytes);
+        }
+    }
+    else
+    {
+        memcpy(pixels.data(), src, pixels.size());
     }
 }
+
+bool takeDecodedPixels(stbi_uc *data, int width, int height, int channels, bool flipVertically,
+                       vector<unsigned char> &pixels)
+{
+    copyRows(data, width, height, channels, flipVertically, pixels);
+    stbi_image_free(data);
+    return true;
+}
 }
 
-GLuint UploadTextureFromPixels(const unsigned char *pixels,
-                               int width,
-                               int height,
-                               int channels,
-                               bool srgb)
+bool DecodeImageFile(const char *path,
+                     bool flipVertically,
+                     vector<unsigned char> &pixels,
+                     int &width,
+                     int &height,
+                     int &channels)
 {
-    if (!pixels || width <= 0 || height <= 0 || channels <= 0)
+    width = height = channels = 0;
+    if (!path)
+        return false;
+
+    ProfileScope scope("DecodeImageFile");
+
+#ifdef DESERT_BAKED_ASSETS
+    string bakedPath = bakedAssetPath(path, ".dtex");
+    if (!ReadBakedTexture(bakedPath.c_str(), flipVertically, pixels, width, height, channels))
     {
-        cerr << "UploadTextureFromPixels: invalid pixel data\n";
-        return 0;
+        cerr << "DecodeImageFile: no baked texture for '" << path << "' at '" << bakedPath << "'\n";
+        return false;
     }
-
-    GLenum format = GL_RGB;
-    GLenum internalFormat = GL_RGB;
-    if (!deriveFormats(channels, srgb, format, internalFormat))
+    return true;
+#else
+    AssetFile file;
+    if (!file.open(path))
     {
-        cerr << "UploadTextureFromPixels: unsupported channel count (" << channels << ")\n";
-        return 0;
+        cerr << "DecodeImageFile: failed to open image '" << path << "'\n";
+        return false;
     }
-
-    GLuint tex = 0;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 internalFormat,
-                 width,
-                 height,
-                 0,
-                 format,
-                 GL_UNSIGNED_BYTE,
-                 pixels);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glBindTexture(GL_TEXTURE_2D, 0);
-    return tex;
+    stbi_uc *data = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, 0);
+    if (!data)
+    {
+        cerr << "DecodeImageFile: failed to load image '" << path << "': " << stbi_failure_reason() << "\n";
+        return false;
+    }
+    return takeDecodedPixels(data, width, height, channels, flipVertically, pixels);
+#endif
 }
 
-GLuint LoadTexture(const char *path,
-                   bool srgb,
-                   bool flipVertically,
-                   int *outWidth,
-                   int *outHeight,
-                   int *outChannels)
+bool DecodeImageMemory(const unsigned char *buffer,
+                       size_t bufferSize,
+                       bool flipVertically,
+                       vector<unsigned char> &pixels,
+                       int &width,
+                       int &height,
+                       int &channels)
 {
-    if (!path)
+    width = height = channels = 0;
+    if (!buffer || bufferSize == 0)
+        return false;
+
+    ProfileScope scope("DecodeImageMemory");
+
+    stbi_uc *data = stbi_load_from_memory(buffer, static_cast<int>(bufferSize), &width, &height, &channels, 0);
+    if (!data)
     {
-        cerr << "LoadTexture: null path provided\n";
-        return 0;
+        cerr << "DecodeImageMemory: failed to parse texture: " << stbi_failure_reason() << "\n";
+        return false;
     }
+    return takeDecodedPixels(data, width, height, channels, flipVertically, pixels);
+}
+
+bool WriteBakedTexture(const char *sourcePath, const char *outputPath)
+{
+    if (!sourcePath || !outputPath)
+        return false;
 
     int width = 0;
     int height = 0;
     int channels = 0;
-
-    stbi_set_flip_vertically_on_load(flipVertically ? 1 : 0);
-    stbi_uc *data = stbi_load(path, &width, &height, &channels, 0);
-    stbi_set_flip_vertically_on_load(0);
-    if (outWidth)
-        *outWidth = width;
-    if (outHeight)
-        *outHeight = height;
-    if (outChannels)
-        *outChannels = channels;
+    stbi_uc *data = stbi_load(sourcePath, &width, &height, &channels, 0);
     if (!data)
     {
-        cerr << "LoadTexture: failed to load image '" << path << "': " << stbi_failure_reason() << "\n";
-        return 0;
+        cerr << "WriteBakedTexture: failed to load image '" << sourcePath << "': " << stbi_failure_reason() << "\n";
+        return false;
     }
 
-    GLuint tex = UploadTextureFromPixels(data, width, height, channels, srgb);
+    BakedTextureHeader header;
+    header.magic = BAKED_TEXTURE_MAGIC;
+    header.version = BAKED_TEXTURE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    size_t pixelBytes = static_cast<size_t>(width) * height * channels;
+
+    // Same write-then-rename as the mesh cache, so a failed bake never
+    // leaves a truncated file that looks up to date.
+    string tempPath = string(outputPath) + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+    {
+        cerr << "WriteBakedTexture: cannot write '" << tempPath << "'\n";
+        stbi_image_free(data);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(data, 1, pixelBytes, file) == pixelBytes;
+    fclose(file);
     stbi_image_free(data);
-    return tex;
+
+    if (!ok)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    remove(outputPath);
+    return rename(tempPath.c_str(), outputPath) == 0;
 }
 
-GLuint LoadTextureFromMemory(const unsigned char *buffer,
-                             size_t bufferSize,
-                             bool srgb,
-                             bool flipVertically,
-                             int *outWidth,
-                             int *outHeight,
-                             int *outChannels)
+bool ReadBakedTexture(const char *bakedPath,
+                      bool flipVertically,
+                      vector<unsigned char> &pixels,
+                      int &width,
+                      int &height,
+                      int &channels)
 {
-    if (!buffer || bufferSize == 0)
+    width = height = channels = 0;
+
+    AssetFile file;
+    if (!bakedPath || !file.open(bakedPath) || file.size() < sizeof(BakedTextureHeader))
+        return false;
+
+    BakedTextureHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != BAKED_TEXTURE_MAGIC || header.version != BAKED_TEXTURE_VERSION ||
+        header.width <= 0 || header.height <= 0 || header.channels <= 0 || header.channels > 4)
     {
-        cerr << "LoadTextureFromMemory: invalid buffer\n";
-        return 0;
+        cerr << "ReadBakedTexture: '" << bakedPath << "' is not a baked texture\n";
+        return false;
     }
 
-    int width = 0;
-    int height = 0;
-    int channels = 0;
-
-    stbi_set_flip_vertically_on_load(flipVertically ? 1 : 0);
-    stbi_uc *data = stbi_load_from_memory(buffer, static_cast<int>(bufferSize), &width, &height, &channels, 0);
-    stbi_set_flip_vertically_on_load(0);
-    if (outWidth)
-        *outWidth = width;
-    if (outHeight)
-        *outHeight = height;
-    if (outChannels)
-        *outChannels = channels;
-    if (!data)
+    size_t pixelBytes = static_cast<size_t>(header.width) * header.height * header.channels;
+    if (file.size() - sizeof(header) < pixelBytes)
     {
-        cerr << "LoadTextureFromMemory: failed to parse texture: " << stbi_failure_reason() << "\n";
-        return 0;
+        cerr << "ReadBakedTexture: '" << bakedPath << "' is truncated\n";
+        return false;
     }
 
-    GLuint tex = UploadTextureFromPixels(data, width, height, channels, srgb);
-    stbi_image_free(data);
-    return tex;
+    copyRows(file.data() + sizeof(header), header.width, header.height, header.channels, flipVertically, pixels);
+    width = header.width;
+    height = header.height;
+    channels = header.channels;
+    return true;
+}
+
+void HalveImageRows(const unsigned char *source, int width, int height, int channels, int firstRow, int rows,
+                    unsigned char *out)
+{
+    int outWidth = max(1, width / 2);
+    for (int y = firstRow; y < firstRow + rows; y++)
+    {
+        const unsigned char *row0 = source + static_cast<size_t>(min(y * 2, height - 1)) * width * channels;
+        const unsigned char *row1 = source + static_cast<size_t>(min(y * 2 + 1, height - 1)) * width * channels;
+        for (int x = 0; x < outWidth; x++)
+        {
+            int x0 = min(x * 2, width - 1) * channels;
+            int x1 = min(x * 2 + 1, width - 1) * channels;
+            for (int c = 0; c < channels; c++)
+            {
+                int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                *out++ = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
 }
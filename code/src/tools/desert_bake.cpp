@@ -0,0 +1,163 @@
+// Offline asset converter, run by the build for every source asset:
+//
+//   desert_bake mesh <source> <output> [--hierarchical]
+//   desert_bake texture <source> <output>
+//   desert_bake compress <source> <output>
+//   desert_bake pack <output> <list-file>
+//   desert_bake replay <read-trace> [--prefetch]
+//
+// Source paths are given relative to code/, exactly as the game asks for
+// them, since baked meshes are looked up by that path. The pack list file
+// names one such path per line.
+//
+// compress writes the image as a block-compressed DDS with its mip chain
+// (BC1, or BC3 with alpha, BC5 with two channels), which the game uploads
+// as it is when compressed texture loading is on.
+//
+// replay reads every range of a recorded asset read trace in order, as a
+// launch would, and reports how long that took; with --prefetch the
+// trace is first handed to the prefetch thread as the game does. Run it
+// after dropping the page cache (scripts/bench_cold_load.sh) to measure
+// cold-cache startup I/O with and without prefetching.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "asset_pack.h"
+#include "asset_prefetch.h"
+#include "mesh_loader.h"
+#include "texture_compression.h"
+#include "texture_loader.h"
+
+using namespace std;
+
+static int replayReads(const char *tracePath, bool prefetch)
+{
+    ifstream trace(tracePath);
+    if (!trace)
+    {
+        cerr << "desert_bake: cannot read trace '" << tracePath << "'\n";
+        return 1;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (prefetch)
+        startAssetPrefetch(tracePath);
+
+    vector<unsigned char> buffer;
+    size_t reads = 0;
+    uint64_t bytes = 0;
+    unsigned checksum = 0;
+    string line;
+    while (getline(trace, line))
+    {
+        unsigned long long offset = 0;
+        unsigned long long size = 0;
+        int pathStart = 0;
+        if (sscanf(line.c_str(), "%llu %llu %n", &offset, &size, &pathStart) != 2 || pathStart == 0)
+            continue;
+
+        FILE *file = fopen(line.c_str() + pathStart, "rb");
+        if (!file)
+            continue;
+        buffer.resize(static_cast<size_t>(size));
+        size_t got = 0;
+        if (fseek(file, static_cast<long>(offset), SEEK_SET) == 0)
+            got = fread(buffer.data(), 1, buffer.size(), file);
+        fclose(file);
+
+        for (size_t i = 0; i < got; i += 4096)
+            checksum += buffer[i];
+        reads++;
+        bytes += got;
+    }
+    waitForAssetPrefetch();
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "[replay] " << (prefetch ? "prefetch" : "no prefetch") << ": " << reads << " reads, " << fixed
+         << setprecision(1) << bytes / (1024.0 * 1024.0) << " MB in " << ms << " ms (checksum " << checksum
+         << ")" << endl;
+    return 0;
+}
+
+static int usage()
+{
+    cerr << "usage: desert_bake mesh <source> <output> [--hierarchical]\n"
+         << "       desert_bake texture <source> <output>\n"
+         << "       desert_bake compress <source> <output>\n"
+         << "       desert_bake pack <output> <list-file>\n"
+         << "       desert_bake replay <read-trace> [--prefetch]\n";
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 || argc == 4)
+    {
+        if (strcmp(argv[1], "replay") == 0)
+            return replayReads(argv[2], argc == 4 && strcmp(argv[3], "--prefetch") == 0);
+    }
+    if (argc < 4)
+        return usage();
+
+    string mode = argv[1];
+    const char *source = argv[2];
+    const char *output = argv[3];
+
+    if (mode == "mesh")
+    {
+        bool hierarchical = argc > 4 && strcmp(argv[4], "--hierarchical") == 0;
+        return bake_mesh(source, output, hierarchical) ? 0 : 1;
+    }
+
+    if (mode == "texture")
+    {
+        if (!WriteBakedTexture(source, output))
+            return 1;
+        cout << "[bake] " << source << " -> " << output << endl;
+        return 0;
+    }
+
+    if (mode == "compress")
+    {
+        vector<unsigned char> pixels;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        CompressedImage image;
+        if (!DecodeImageFile(source, false, pixels, width, height, channels) ||
+            !EncodeCompressedImage(pixels.data(), width, height, channels, image) || !WriteDdsFile(output, image))
+            return 1;
+        cout << "[bake] " << source << " -> " << output << " (" << blockFormatName(image.format) << ", "
+             << image.levels.size() << " levels, " << image.data.size() / 1024 << " KB)" << endl;
+        return 0;
+    }
+
+    if (mode == "pack")
+    {
+        ifstream list(argv[3]);
+        if (!list)
+        {
+            cerr << "desert_bake: cannot read pack list '" << argv[3] << "'\n";
+            return 1;
+        }
+        vector<string> paths;
+        string line;
+        while (getline(list, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                paths.push_back(line);
+        }
+        return writeAssetPack(argv[2], paths) ? 0 : 1;
+    }
+
+    return usage();
+}
@@ -0,0 +1,29 @@
+#!/bin/bash
+#
+# Cold-cache startup I/O with and without the recorded-order prefetch.
+# Launch the game once first so code/assets/cache/asset_reads.trace exists.
+# Dropping the page cache needs root: sudo ./scripts/bench_cold_load.sh
+cd "$(dirname "$0")"/../code || exit 1
+
+TRACE=assets/cache/asset_reads.trace
+BAKE=../build/desert_bake
+RUNS=${RUNS:-3}
+
+if [ ! -f "$TRACE" ]; then
+  echo "no $TRACE yet; run the game once to record it" >&2
+  exit 1
+fi
+
+drop_caches() {
+  sync
+  if [ "$(uname)" = "Darwin" ]; then
+    purge
+  else
+    echo 3 > /proc/sys/vm/drop_caches
+  fi
+}
+
+for i in $(seq "$RUNS"); do
+  drop_caches && "$BAKE" replay "$TRACE"
+  drop_caches && "$BAKE" replay "$TRACE" --prefetch
+done
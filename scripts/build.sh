@@ -8,6 +8,6 @@ rm -rf build
 
 # Create fresh build directory and configure
 mkdir build && cd build
-cmake .. -DCMAKE_BUILD_TYPE=Release \
+cmake .. -DCMAKE_BUILD_TYPE=Release -DDESERT_BAKE_ASSETS=ON \
   -DCMAKE_OSX_SYSROOT="$(xcrun --show-sdk-path)"
 make -j